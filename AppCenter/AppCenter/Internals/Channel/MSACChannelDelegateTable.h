@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@protocol MSACChannelDelegate;
+
+/**
+ * Immutable snapshot of channel delegates, sorted by the methods of `MSACChannelDelegate` they implement.
+ *
+ * @discussion Which delegates respond to each method is worked out once when the snapshot is created, notifying delegates looks them up
+ * by selector and doesn't lock nor check them again. Channels replace their snapshot when a delegate is added or removed, a snapshot keeps
+ * the one it replaces alive so that channels can load their snapshot without locking nor retaining it. Delegates are not retained.
+ */
+@interface MSACChannelDelegateTable : NSObject
+
+/**
+ * Initializes a new `MSACChannelDelegateTable` instance.
+ *
+ * @param delegates The delegates.
+ *
+ * @return A new `MSACChannelDelegateTable` instance.
+ */
+- (instancetype)initWithDelegates:(NSArray<id<MSACChannelDelegate>> *)delegates;
+
+/**
+ * Initializes a new `MSACChannelDelegateTable` instance replacing another one.
+ *
+ * @param delegates The delegates.
+ * @param previousTable The table replaced, kept alive as long as the new table.
+ *
+ * @return A new `MSACChannelDelegateTable` instance.
+ */
+- (instancetype)initWithDelegates:(NSArray<id<MSACChannelDelegate>> *)delegates
+                    previousTable:(nullable MSACChannelDelegateTable *)previousTable;
+
+/**
+ * Call a block for each delegate responding to a selector.
+ *
+ * @param selector The selector.
+ * @param block The block.
+ */
+- (void)enumerateDelegatesForSelector:(SEL)selector withBlock:(void (^)(id<MSACChannelDelegate> delegate))block;
+
+@end
+
+NS_ASSUME_NONNULL_END
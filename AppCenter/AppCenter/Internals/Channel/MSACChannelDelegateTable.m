@@ -0,0 +1,140 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <objc/runtime.h>
+
+#import "MSACChannelDelegate.h"
+#import "MSACChannelDelegateTable.h"
+
+/**
+ * Weak reference to a delegate.
+ */
+@interface MSACChannelDelegateReference : NSObject {
+@public
+  __weak id<MSACChannelDelegate> _delegate;
+}
+@end
+
+@implementation MSACChannelDelegateReference
+@end
+
+@interface MSACChannelDelegateTable () {
+
+  /**
+   * References to the delegates, one per delegate.
+   */
+  NSArray<MSACChannelDelegateReference *> *_references;
+
+  /**
+   * References to the delegates responding to each method of `MSACChannelDelegate`, followed by all the delegates. They are retained by
+   * `_references`.
+   */
+  __unsafe_unretained MSACChannelDelegateReference **_delegates;
+
+  /**
+   * Ranges of `_delegates` responding to each method of `MSACChannelDelegate`, in the order of the methods.
+   */
+  NSRange *_ranges;
+
+  /**
+   * Range of `_delegates` holding all the delegates, to notify of selectors that are not part of `MSACChannelDelegate`.
+   */
+  NSRange _allDelegatesRange;
+
+  /**
+   * Pointers to `_ranges` keyed by selector. Selectors are unique pointers, they are hashed and compared as such.
+   */
+  CFMutableDictionaryRef _rangesBySelector;
+}
+
+/**
+ * The table replaced by this one, it may still be in use by a channel that loaded it before it was replaced.
+ */
+@property(nonatomic, readonly, nullable) MSACChannelDelegateTable *previousTable;
+
+@end
+
+@implementation MSACChannelDelegateTable
+
+- (instancetype)initWithDelegates:(NSArray<id<MSACChannelDelegate>> *)delegates {
+  return [self initWithDelegates:delegates previousTable:nil];
+}
+
+- (instancetype)initWithDelegates:(NSArray<id<MSACChannelDelegate>> *)delegates
+                    previousTable:(nullable MSACChannelDelegateTable *)previousTable {
+  if ((self = [super init])) {
+    _previousTable = previousTable;
+    NSMutableArray<MSACChannelDelegateReference *> *references = [NSMutableArray new];
+    for (id<MSACChannelDelegate> delegate in delegates) {
+      MSACChannelDelegateReference *reference = [MSACChannelDelegateReference new];
+      reference->_delegate = delegate;
+      [references addObject:reference];
+    }
+    _references = references;
+    unsigned int requiredCount = 0;
+    unsigned int optionalCount = 0;
+    struct objc_method_description *requiredMethods =
+        protocol_copyMethodDescriptionList(@protocol(MSACChannelDelegate), YES, YES, &requiredCount);
+    struct objc_method_description *optionalMethods =
+        protocol_copyMethodDescriptionList(@protocol(MSACChannelDelegate), NO, YES, &optionalCount);
+    unsigned int selectorsCount = requiredCount + optionalCount;
+    NSMutableArray<NSArray<MSACChannelDelegateReference *> *> *referencesBySelector = [NSMutableArray new];
+    NSUInteger delegatesCount = references.count;
+    for (unsigned int i = 0; i < selectorsCount; i++) {
+      SEL selector = i < requiredCount ? requiredMethods[i].name : optionalMethods[i - requiredCount].name;
+      NSMutableArray<MSACChannelDelegateReference *> *respondingReferences = [NSMutableArray new];
+      for (NSUInteger j = 0; j < delegates.count; j++) {
+        if ([delegates[j] respondsToSelector:selector]) {
+          [respondingReferences addObject:references[j]];
+        }
+      }
+      [referencesBySelector addObject:respondingReferences];
+      delegatesCount += respondingReferences.count;
+    }
+    [referencesBySelector addObject:references];
+    _delegates = (__unsafe_unretained MSACChannelDelegateReference **)calloc(MAX(delegatesCount, 1), sizeof(id));
+    _ranges = calloc(MAX(selectorsCount, 1), sizeof(NSRange));
+    _rangesBySelector = CFDictionaryCreateMutable(kCFAllocatorDefault, selectorsCount, NULL, NULL);
+    NSUInteger location = 0;
+    for (NSUInteger i = 0; i < referencesBySelector.count; i++) {
+      NSRange range = NSMakeRange(location, referencesBySelector[i].count);
+      for (MSACChannelDelegateReference *reference in referencesBySelector[i]) {
+        _delegates[location++] = reference;
+      }
+      if (i < selectorsCount) {
+        _ranges[i] = range;
+        SEL selector = i < requiredCount ? requiredMethods[i].name : optionalMethods[i - requiredCount].name;
+        CFDictionarySetValue(_rangesBySelector, (const void *)selector, &_ranges[i]);
+      } else {
+        _allDelegatesRange = range;
+      }
+    }
+    free(requiredMethods);
+    free(optionalMethods);
+  }
+  return self;
+}
+
+- (void)dealloc {
+  free(_delegates);
+  free(_ranges);
+  CFRelease(_rangesBySelector);
+}
+
+- (void)enumerateDelegatesForSelector:(SEL)selector withBlock:(void (^)(id<MSACChannelDelegate> delegate))block {
+  const NSRange *range = CFDictionaryGetValue(_rangesBySelector, (const void *)selector);
+  BOOL checked = range != NULL;
+  if (!checked) {
+    range = &_allDelegatesRange;
+  }
+  for (NSUInteger i = range->location; i < NSMaxRange(*range); i++) {
+    id<MSACChannelDelegate> delegate = _delegates[i]->_delegate;
+
+    // Delegates deallocated since the table has been created are nil.
+    if (delegate && (checked || [delegate respondsToSelector:selector])) {
+      block(delegate);
+    }
+  }
+}
+
+@end
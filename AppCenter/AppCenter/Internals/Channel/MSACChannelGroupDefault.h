@@ -32,6 +32,21 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (instancetype)initWithHttpClient:(id<MSACHttpClientProtocol>)httpClient installId:(NSUUID *)installId logUrl:(NSString *)logUrl;
 
+/**
+ * Initializes a new `MSACChannelGroupDefault` instance.
+ *
+ * @param httpClient The HTTP client.
+ * @param installId A unique installation identifier.
+ * @param logUrl A base URL to use for backend communication.
+ * @param storageBackend The backend storing the logs.
+ *
+ * @return A new `MSACChannelGroupDefault` instance.
+ */
+- (instancetype)initWithHttpClient:(id<MSACHttpClientProtocol>)httpClient
+                         installId:(NSUUID *)installId
+                            logUrl:(NSString *)logUrl
+                    storageBackend:(MSACStorageBackend)storageBackend;
+
 /**
  * Collection of channel delegates.
  */
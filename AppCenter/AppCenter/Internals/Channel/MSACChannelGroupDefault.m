@@ -5,38 +5,190 @@
 #import "AppCenter+Internal.h"
 #import "MSACAppCenterIngestion.h"
 #import "MSACChannelGroupDefaultPrivate.h"
+#import "MSACChannelDelegateTable.h"
 #import "MSACChannelUnitConfiguration.h"
 #import "MSACChannelUnitDefault.h"
+#import "MSACChannelUnitDefaultPrivate.h"
 #import "MSACDispatcherUtil.h"
+#import "MSACEnqueueRing.h"
+#import "MSACFlushScheduler.h"
 #import "MSACLogDBStorage.h"
+#import "MSACLogSegmentStorage.h"
+#import "MSACLogVolatileStorage.h"
+#import "MSACTimerWheel.h"
+#import "MSACUploadBudget.h"
+#import "MSACUploadWindow.h"
+#import "MSAC_Reachability.h"
 
 static char *const kMSACLogsDispatchQueue = "com.microsoft.appcenter.ChannelGroupQueue";
+static char *const kMSACLogsReaderDispatchQueue = "com.microsoft.appcenter.ChannelGroupReaderQueue";
+
+/**
+ * Maximum number of logs saved in a single transaction.
+ */
+static const NSUInteger kMSACGroupCommitMaxLogsCount = 50;
+
+/**
+ * Maximum time, in seconds, a saved log is kept uncommitted. Logs with critical persistence are always committed right away.
+ */
+static const NSTimeInterval kMSACGroupCommitWindow = 0.5;
+
+/**
+ * Maximum number of unused pages of the logs database freed at once.
+ */
+static const NSUInteger kMSACIncrementalVacuumMaxPagesCount = 64;
+
+/**
+ * Time, in seconds, without logs deleted after which unused pages of the logs database are freed.
+ */
+static const NSTimeInterval kMSACIncrementalVacuumIdleDelay = 10;
+
+/**
+ * Maximum number of logs of a legacy logs table migrated at once.
+ */
+static const NSUInteger kMSACIncrementalMigrationChunkSize = 100;
+
+/**
+ * Maximum number of expired logs deleted at once, pruning continues right away when that many logs have been deleted.
+ */
+static const NSUInteger kMSACExpiredLogsPruningChunkSize = 100;
+
+/**
+ * Time, in seconds, after the channel group creation before expired logs are pruned for the first time.
+ */
+static const NSTimeInterval kMSACExpiredLogsPruningInitialDelay = 60;
+
+/**
+ * Time, in seconds, between two prunings of expired logs.
+ */
+static const NSTimeInterval kMSACExpiredLogsPruningInterval = 60 * 60;
+
+@interface MSACChannelGroupDefault () {
+
+  /**
+   * The delegate table, retained. It is published and loaded with atomic operations.
+   */
+  void *_delegateTablePointer;
+}
+
+@end
 
 @implementation MSACChannelGroupDefault
 
 #pragma mark - Initialization
 
 - (instancetype)initWithHttpClient:(id<MSACHttpClientProtocol>)httpClient installId:(NSUUID *)installId logUrl:(NSString *)logUrl {
+  return [self initWithHttpClient:httpClient installId:installId logUrl:logUrl storageBackend:MSACStorageBackendDatabase];
+}
+
+- (instancetype)initWithHttpClient:(id<MSACHttpClientProtocol>)httpClient
+                         installId:(NSUUID *)installId
+                            logUrl:(NSString *)logUrl
+                    storageBackend:(MSACStorageBackend)storageBackend {
   self = [self initWithIngestion:[[MSACAppCenterIngestion alloc] initWithHttpClient:httpClient
                                                                             baseUrl:logUrl
-                                                                          installId:[installId UUIDString]]];
+                                                                          installId:[installId UUIDString]]
+                  storageBackend:storageBackend];
   return self;
 }
 
 - (instancetype)initWithIngestion:(nullable MSACAppCenterIngestion *)ingestion {
+  return [self initWithIngestion:ingestion storageBackend:MSACStorageBackendDatabase];
+}
+
+- (instancetype)initWithIngestion:(nullable MSACAppCenterIngestion *)ingestion storageBackend:(MSACStorageBackend)storageBackend {
   if ((self = [self init])) {
     dispatch_queue_t serialQueue = dispatch_queue_create(kMSACLogsDispatchQueue, DISPATCH_QUEUE_SERIAL);
     _logsDispatchQueue = serialQueue;
     _channels = [NSMutableArray<id<MSACChannelUnitProtocol>> new];
     _delegates = [NSHashTable weakObjectsHashTable];
-    _storage = [MSACLogDBStorage new];
+    _delegateTablePointer = (__bridge_retained void *)[[MSACChannelDelegateTable alloc] initWithDelegates:@[]];
+    __weak typeof(self) weakSelf = self;
+    MSACLogEvictionHandler evictionHandler = ^(NSDictionary<NSString *, NSNumber *> *evictedLogsCounts) {
+      typeof(self) strongSelf = weakSelf;
+      [strongSelf storageDidEvictLogs:evictedLogsCounts];
+    };
+    if (storageBackend == MSACStorageBackendSegmentFiles) {
+
+      // Segment files are appended to, they don't need group commit nor vacuum.
+      MSACLogSegmentStorage *storage = [MSACLogSegmentStorage new];
+      storage.evictionHandler = evictionHandler;
+      _storage = storage;
+    } else {
+      MSACLogDBStorage *storage = [MSACLogDBStorage new];
+      [storage enableGroupCommitWithMaxChangesCount:kMSACGroupCommitMaxLogsCount window:kMSACGroupCommitWindow queue:serialQueue];
+      [storage enableIncrementalVacuumWithMaxPagesCount:kMSACIncrementalVacuumMaxPagesCount
+                                              idleDelay:kMSACIncrementalVacuumIdleDelay
+                                                  queue:serialQueue];
+
+      // Logs of a legacy logs table are migrated in the background, they are sent once migrated.
+      [storage enableIncrementalMigrationWithChunkSize:kMSACIncrementalMigrationChunkSize queue:serialQueue];
+
+      // Batches are loaded on a queue of their own while logs keep being saved.
+      [storage enableReaderConnectionWithReaderQueue:dispatch_queue_create(kMSACLogsReaderDispatchQueue, DISPATCH_QUEUE_SERIAL)
+                                               queue:serialQueue];
+      storage.evictionHandler = evictionHandler;
+      storage.lostLogsHandler = ^(NSDictionary<NSString *, NSNumber *> *lostLogsCounts) {
+        typeof(self) strongSelf = weakSelf;
+        [strongSelf storageDidLoseLogs:lostLogsCounts];
+      };
+      _storage = storage;
+    }
+
+    // Volatile logs are kept in memory, they are moved to the storage when memory runs low or the application goes to background.
+    _volatileStorage = [MSACLogVolatileStorage new];
+    _volatileStorage.evictionHandler = ^(NSDictionary<NSString *, NSNumber *> *droppedLogsCounts) {
+      typeof(self) strongSelf = weakSelf;
+      [strongSelf discountDeletedLogs:droppedLogsCounts];
+    };
+    _memoryPressureSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                                   DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+                                                   dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+    dispatch_source_set_event_handler(_memoryPressureSource, ^{
+      typeof(self) strongSelf = weakSelf;
+      if (strongSelf) {
+        dispatch_async(strongSelf.logsDispatchQueue, ^{
+          [strongSelf persistVolatileLogs];
+        });
+      }
+    });
+    dispatch_resume(_memoryPressureSource);
+
+    // Channels with the default flush interval share the view of the network, they send logs as it allows.
+    _flushScheduler = [MSACFlushScheduler new];
+
+    // Logs enqueued from any thread are pushed into a ring, they are stored by a single block on the logs dispatch queue.
+    _enqueueRing = [[MSACEnqueueRing alloc] initWithCapacity:kMSACEnqueueRingCapacity
+                                                       queue:serialQueue
+                                                     handler:^(id<MSACLog> log, NSString *internalId, MSACFlags flags, id target) {
+                                                       [(MSACChannelUnitDefault *)target enqueuePreparedItem:log
+                                                                                                  internalId:internalId
+                                                                                                       flags:flags];
+                                                     }];
+
+    // Channels flush their queue with a shared timer, waking up once for all of them.
+    _timerWheel = [[MSACTimerWheel alloc] initWithQueue:serialQueue tolerance:kMSACTimerWheelTolerance];
+
+    // Batches are pipelined, each channel within its own window and all of them within a shared budget.
+    _uploadBudget = [[MSACUploadBudget alloc] initWithLimit:kMSACMaxPendingBatchesDefault];
+    _maxPendingBatchesPerChannel = kMSACMaxPendingBatchesPerChannelDefault;
     if (ingestion) {
       _ingestion = ingestion;
     }
+    [self scheduleExpiredLogsPruningAfterDelay:kMSACExpiredLogsPruningInitialDelay];
   }
   return self;
 }
 
+- (void)dealloc {
+  if (_memoryPressureSource) {
+    dispatch_source_cancel(_memoryPressureSource);
+  }
+  if (_delegateTablePointer) {
+    CFRelease(_delegateTablePointer);
+  }
+}
+
 - (id<MSACChannelUnitProtocol>)addChannelUnitWithConfiguration:(MSACChannelUnitConfiguration *)configuration {
   return [self addChannelUnitWithConfiguration:configuration withIngestion:self.ingestion];
 }
@@ -49,6 +201,14 @@ static char *const kMSACLogsDispatchQueue = "com.microsoft.appcenter.ChannelGrou
                                                         storage:self.storage
                                                   configuration:configuration
                                               logsDispatchQueue:self.logsDispatchQueue];
+    channel.volatileStorage = self.volatileStorage;
+    channel.flushScheduler = self.flushScheduler;
+    channel.timerWheel = self.timerWheel;
+    channel.enqueueRing = self.enqueueRing;
+    channel.uploadWindow = [[MSACUploadWindow alloc] initWithSize:configuration.pendingBatchesLimit
+                                                          maxSize:MAX(self.maxPendingBatchesPerChannel, configuration.pendingBatchesLimit)];
+    channel.uploadBudget = self.uploadBudget;
+    [self.uploadBudget addChannel:channel];
     [channel addDelegate:self];
     dispatch_async(self.logsDispatchQueue, ^{
       // Schedule sending any pending log.
@@ -72,31 +232,161 @@ static char *const kMSACLogsDispatchQueue = "com.microsoft.appcenter.ChannelGrou
   return nil;
 }
 
+#pragma mark - Storage
+
+- (void)storageDidEvictLogs:(NSDictionary<NSString *, NSNumber *> *)evictedLogsCounts {
+  for (NSString *groupId in evictedLogsCounts) {
+    MSACLogWarning([MSACAppCenter logTag], @"Storage is full, %@ log(s) of %@ deleted to make room for new logs.",
+                   evictedLogsCounts[groupId], groupId);
+  }
+  [self discountDeletedLogs:evictedLogsCounts];
+}
+
+- (void)storageDidLoseLogs:(NSDictionary<NSString *, NSNumber *> *)lostLogsCounts {
+  for (NSString *groupId in lostLogsCounts) {
+    MSACLogError([MSACAppCenter logTag], @"Failed to commit logs to the storage, %@ log(s) of %@ lost.", lostLogsCounts[groupId], groupId);
+  }
+  [self discountDeletedLogs:lostLogsCounts];
+}
+
+- (void)discountDeletedLogs:(NSDictionary<NSString *, NSNumber *> *)deletedLogsCounts {
+  for (NSString *groupId in deletedLogsCounts) {
+    NSUInteger count = deletedLogsCounts[groupId].unsignedIntegerValue;
+
+    // Pending logs are counted to trigger sending them, deleted ones should not be counted anymore.
+    MSACChannelUnitDefault *channel = (MSACChannelUnitDefault *)[self channelUnitForGroupId:groupId];
+    channel.itemsCount -= MIN(channel.itemsCount, count);
+  }
+}
+
+- (void)persistVolatileLogs {
+  [self.volatileStorage moveLogsToStorage:self.storage];
+
+  // Moved logs, like the logs saved before, may be grouped in a transaction that would be lost with the process.
+  [self.storage commitPendingLogs];
+}
+
+- (void)setLogTimeToLive:(NSTimeInterval)timeToLive forGroupId:(nullable NSString *)groupId flags:(MSACFlags)flags {
+  [self.storage setTimeToLive:timeToLive forGroupId:groupId flags:flags];
+}
+
+- (void)setFlushIntervalBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum {
+  dispatch_async(self.logsDispatchQueue, ^{
+    if (![self.flushScheduler setFlushIntervalBoundsWithMinimum:minimum maximum:maximum]) {
+      MSACLogWarning([MSACAppCenter logTag], @"Invalid flush interval bounds [%tu, %tu], keeping the current ones.", minimum, maximum);
+    }
+  });
+}
+
+- (void)setMaxPendingBatchesPerChannel:(NSUInteger)perChannelLimit totalLimit:(NSUInteger)totalLimit {
+  if (perChannelLimit == 0 || totalLimit < perChannelLimit) {
+    MSACLogWarning([MSACAppCenter logTag], @"Invalid pending batches limits %tu per channel and %tu in total, keeping the current ones.",
+                   perChannelLimit, totalLimit);
+    return;
+  }
+  dispatch_async(self.logsDispatchQueue, ^{
+    self.maxPendingBatchesPerChannel = perChannelLimit;
+    self.uploadBudget.limit = totalLimit;
+    for (MSACChannelUnitDefault *channel in self.channels) {
+      channel.uploadWindow.maxSize = MAX(perChannelLimit, channel.configuration.pendingBatchesLimit);
+    }
+  });
+}
+
+- (void)setBackpressurePolicy:(MSACBackpressurePolicy)backpressurePolicy {
+
+  // The policy is read by the threads enqueuing logs, it is not set on the logs dispatch queue.
+  self.enqueueRing.backpressurePolicy = backpressurePolicy;
+}
+
+- (void)setBatchSizeBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum {
+  dispatch_async(self.logsDispatchQueue, ^{
+    if (![self.flushScheduler setBatchSizeBoundsWithMinimum:minimum maximum:maximum]) {
+      MSACLogWarning([MSACAppCenter logTag], @"Invalid batch size bounds [%tu, %tu], keeping the current ones.", minimum, maximum);
+    }
+  });
+}
+
+- (NSUInteger)expiredLogsCount {
+  @synchronized(self) {
+    return _expiredLogsCount;
+  }
+}
+
+- (void)scheduleExpiredLogsPruningAfterDelay:(NSTimeInterval)delay {
+
+  // Wait on a global queue so that the logs queue is not retained, pruning stops once the channel group is released.
+  __weak typeof(self) weakSelf = self;
+  dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+    typeof(self) strongSelf = weakSelf;
+    if (!strongSelf) {
+      return;
+    }
+    dispatch_async(strongSelf.logsDispatchQueue, ^{
+      [weakSelf pruneExpiredLogs];
+    });
+  });
+}
+
+- (void)pruneExpiredLogs {
+  NSDictionary<NSString *, NSNumber *> *expiredLogsCounts = [self.storage deleteExpiredLogsWithLimit:kMSACExpiredLogsPruningChunkSize];
+  NSUInteger count = 0;
+  for (NSString *groupId in expiredLogsCounts) {
+    count += expiredLogsCounts[groupId].unsignedIntegerValue;
+  }
+  if (count > 0) {
+    MSACLogDebug([MSACAppCenter logTag], @"%tu expired log(s) deleted from the storage.", count);
+    @synchronized(self) {
+      _expiredLogsCount += count;
+    }
+    [self discountDeletedLogs:expiredLogsCounts];
+  }
+
+  // A full chunk means more logs may have expired, keep pruning without holding the logs queue between chunks.
+  if (count >= kMSACExpiredLogsPruningChunkSize) {
+    __weak typeof(self) weakSelf = self;
+    dispatch_async(self.logsDispatchQueue, ^{
+      [weakSelf pruneExpiredLogs];
+    });
+  } else {
+    [self scheduleExpiredLogsPruningAfterDelay:kMSACExpiredLogsPruningInterval];
+  }
+}
+
 #pragma mark - Delegate
 
 - (void)addDelegate:(id<MSACChannelDelegate>)delegate {
   @synchronized(self) {
     [self.delegates addObject:delegate];
+    [self replaceDelegateTable];
   }
 }
 
 - (void)removeDelegate:(id<MSACChannelDelegate>)delegate {
   @synchronized(self) {
     [self.delegates removeObject:delegate];
+    [self replaceDelegateTable];
   }
 }
 
 - (void)enumerateDelegatesForSelector:(SEL)selector withBlock:(void (^)(id<MSACChannelDelegate> delegate))block {
-  NSArray *synchronizedDelegates;
-  @synchronized(self) {
 
-    // Don't execute the block while locking; it might be locking too and deadlock ourselves.
-    synchronizedDelegates = [self.delegates allObjects];
-  }
-  for (id<MSACChannelDelegate> delegate in synchronizedDelegates) {
-    if ([delegate respondsToSelector:selector]) {
-      block(delegate);
-    }
+  // The table is replaced, not modified, when delegates change. Blocks are called without locking, they might be locking too.
+  [self.delegateTable enumerateDelegatesForSelector:selector withBlock:block];
+}
+
+- (MSACChannelDelegateTable *)delegateTable {
+  return (__bridge MSACChannelDelegateTable *)__atomic_load_n(&_delegateTablePointer, __ATOMIC_ACQUIRE);
+}
+
+- (void)replaceDelegateTable {
+
+  // The table replaced is retained by the new one, it stays valid for the notifications that loaded it.
+  MSACChannelDelegateTable *delegateTable = [[MSACChannelDelegateTable alloc] initWithDelegates:[self.delegates allObjects]
+                                                                                  previousTable:self.delegateTable];
+  void *previousTable = __atomic_exchange_n(&_delegateTablePointer, (__bridge_retained void *)delegateTable, __ATOMIC_ACQ_REL);
+  if (previousTable) {
+    CFRelease(previousTable);
   }
 }
 
@@ -177,6 +467,14 @@ static char *const kMSACLogsDispatchQueue = "com.microsoft.appcenter.ChannelGrou
 #pragma mark - Enable / Disable
 
 - (void)setEnabled:(BOOL)isEnabled andDeleteDataOnDisabled:(BOOL)deleteData {
+  if (isEnabled) {
+    [MSAC_NOTIFICATION_CENTER addObserver:self
+                                 selector:@selector(networkStateChanged:)
+                                     name:kMSACReachabilityChangedNotification
+                                   object:nil];
+  } else {
+    [MSAC_NOTIFICATION_CENTER removeObserver:self name:kMSACReachabilityChangedNotification object:nil];
+  }
 
 #if !TARGET_OS_OSX
   if (isEnabled) {
@@ -184,6 +482,10 @@ static char *const kMSACLogsDispatchQueue = "com.microsoft.appcenter.ChannelGrou
                                  selector:@selector(applicationWillTerminate:)
                                      name:UIApplicationWillTerminateNotification
                                    object:nil];
+    [MSAC_NOTIFICATION_CENTER addObserver:self
+                                 selector:@selector(applicationDidEnterBackground:)
+                                     name:UIApplicationDidEnterBackgroundNotification
+                                   object:nil];
   } else {
     [MSAC_NOTIFICATION_CENTER removeObserver:self];
   }
@@ -203,25 +505,67 @@ static char *const kMSACLogsDispatchQueue = "com.microsoft.appcenter.ChannelGrou
                               [delegate channel:self didSetEnabled:isEnabled andDeleteDataOnDisabled:deleteData];
                             }];
 
-  /**
-   * TODO: There should be some concept of logs on disk expiring to avoid leaks when a channel is disabled with lingering logs but never
-   * enabled again.
-   *
-   * Note that this is an unlikely scenario. Solving this issue is more of a proactive measure.
+  /*
+   * Logs lingering on disk for a channel disabled without deleting its data and never enabled again only expire when a log time to live is
+   * configured, they are kept until the channel is enabled again otherwise.
    */
 }
 
 #if !TARGET_OS_OSX
 - (void)applicationWillTerminate:(__unused UIApplication *)application {
 
-  // Block logs queue so that it isn't killed before app termination.
+  // Block logs queue so that it isn't killed before app termination, volatile and pending logs are written to disk.
   [MSACDispatcherUtil dispatchSyncWithTimeout:1
                                       onQueue:self.logsDispatchQueue
                                     withBlock:^{
+                                      [self persistVolatileLogs];
                                     }];
 }
+
+- (void)applicationDidEnterBackground:(__unused UIApplication *)application {
+
+  /*
+   * The application may be suspended or killed while in background, volatile and pending logs are written to disk before. The main thread
+   * isn't blocked, a background task keeps the application running until they are written.
+   */
+  UIApplication *sharedApp = MSAC_IS_APP_EXTENSION ? nil : [MSACUtility sharedApp];
+  __block UIBackgroundTaskIdentifier backgroundTask = UIBackgroundTaskInvalid;
+
+  // The task is ended on the main thread, where its expiration handler is called.
+  void (^endBackgroundTask)(void) = ^{
+    if (backgroundTask != UIBackgroundTaskInvalid) {
+      [sharedApp endBackgroundTask:backgroundTask];
+      backgroundTask = UIBackgroundTaskInvalid;
+    }
+  };
+  backgroundTask = [sharedApp beginBackgroundTaskWithExpirationHandler:endBackgroundTask];
+  dispatch_async(self.logsDispatchQueue, ^{
+    [self persistVolatileLogs];
+    dispatch_async(dispatch_get_main_queue(), endBackgroundTask);
+  });
+}
 #endif
 
+#pragma mark - Network
+
+- (void)networkStateChanged:(NSNotification *)notification {
+  if (![notification.object isKindOfClass:[MSAC_Reachability class]]) {
+    return;
+  }
+  NetworkStatus networkStatus = [(MSAC_Reachability *)notification.object currentReachabilityStatus];
+  dispatch_async(self.logsDispatchQueue, ^{
+    if (self.flushScheduler.networkStatus == networkStatus) {
+      return;
+    }
+    self.flushScheduler.networkStatus = networkStatus;
+
+    // Pending logs are scheduled again with the delay matching the new network.
+    for (id<MSACChannelUnitProtocol> channel in self.channels) {
+      [channel checkPendingLogs];
+    }
+  });
+}
+
 #pragma mark - Pause / Resume
 
 - (void)pauseWithIdentifyingObject:(id<NSObject>)identifyingObject {
@@ -270,4 +614,10 @@ static char *const kMSACLogsDispatchQueue = "com.microsoft.appcenter.ChannelGrou
   });
 }
 
+- (void)setStorageDurability:(MSACStorageDurability)durability {
+  dispatch_async(self.logsDispatchQueue, ^{
+    [self.storage setDurability:durability];
+  });
+}
+
 @end
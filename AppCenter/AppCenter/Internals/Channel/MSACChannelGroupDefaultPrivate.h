@@ -6,6 +6,12 @@
 NS_ASSUME_NONNULL_BEGIN
 
 @class MSACAppCenterIngestion;
+@class MSACChannelDelegateTable;
+@class MSACEnqueueRing;
+@class MSACFlushScheduler;
+@class MSACTimerWheel;
+@class MSACUploadBudget;
+@class MSACLogVolatileStorage;
 @class UIApplication;
 
 @interface MSACChannelGroupDefault () <MSACChannelDelegate>
@@ -19,6 +25,93 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (instancetype)initWithIngestion:(nullable MSACAppCenterIngestion *)ingestion;
 
+/**
+ * Initializes a new `MSACChannelGroupDefault` instance.
+ *
+ * @param ingestion An HTTP ingestion instance that is used to send batches of log items to the backend.
+ * @param storageBackend The backend storing the logs.
+ *
+ * @return A new `MSACChannelGroupDefault` instance.
+ */
+- (instancetype)initWithIngestion:(nullable MSACAppCenterIngestion *)ingestion storageBackend:(MSACStorageBackend)storageBackend;
+
+/**
+ * Called when logs have been evicted from the storage to make room for a new log.
+ *
+ * @param evictedLogsCounts The number of evicted logs by group Id.
+ */
+- (void)storageDidEvictLogs:(NSDictionary<NSString *, NSNumber *> *)evictedLogsCounts;
+
+/**
+ * Called when logs already saved have been lost because the storage failed to commit them.
+ *
+ * @param lostLogsCounts The number of lost logs by group Id.
+ */
+- (void)storageDidLoseLogs:(NSDictionary<NSString *, NSNumber *> *)lostLogsCounts;
+
+/**
+ * Storage keeping the logs enqueued with `MSACFlagsVolatile` in memory, shared by the channels.
+ */
+@property(nonatomic, readonly) MSACLogVolatileStorage *volatileStorage;
+
+/**
+ * Policy picking when and how many logs are sent, shared by the channels.
+ */
+@property(nonatomic, readonly) MSACFlushScheduler *flushScheduler;
+
+/**
+ * Snapshot of the delegates notified of logs, replaced when a delegate is added or removed. It is loaded without locking.
+ */
+@property(nonatomic, readonly) MSACChannelDelegateTable *delegateTable;
+
+/**
+ * Ring of the logs being enqueued, shared by the channels.
+ */
+@property(nonatomic, readonly) MSACEnqueueRing *enqueueRing;
+
+/**
+ * Timer flushing the queues of the channels.
+ */
+@property(nonatomic, readonly) MSACTimerWheel *timerWheel;
+
+/**
+ * Budget of the batches sent at the same time, shared by the channels.
+ */
+@property(nonatomic, readonly) MSACUploadBudget *uploadBudget;
+
+/**
+ * Maximum number of batches each channel sends at the same time.
+ */
+@property(nonatomic) NSUInteger maxPendingBatchesPerChannel;
+
+/**
+ * Called when the reachability of the network changed.
+ *
+ * @param notification The reachability notification.
+ */
+- (void)networkStateChanged:(NSNotification *)notification;
+
+/**
+ * Source notifying that memory runs low, volatile logs are then written to disk.
+ */
+@property(nonatomic, readonly, nullable) dispatch_source_t memoryPressureSource;
+
+/**
+ * Move the volatile logs that are not being sent to the storage, and commit the logs pending in the storage.
+ */
+- (void)persistVolatileLogs;
+
+/**
+ * Number of logs deleted from the disk because they expired.
+ */
+@property(nonatomic) NSUInteger expiredLogsCount;
+
+/**
+ * Delete a chunk of expired logs from the storage. Pruning continues right away if there might be more expired logs, otherwise it is
+ * scheduled after a while.
+ */
+- (void)pruneExpiredLogs;
+
 #if !TARGET_OS_OSX
 
 /**
@@ -26,6 +119,11 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)applicationWillTerminate:(UIApplication *)application;
 
+/**
+ * Called when application did enter background.
+ */
+- (void)applicationDidEnterBackground:(UIApplication *)application;
+
 #endif
 
 @end
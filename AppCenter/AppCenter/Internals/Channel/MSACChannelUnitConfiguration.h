@@ -28,6 +28,12 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property(nonatomic, readonly) NSUInteger batchSizeLimit;
 
+/**
+ * Maximum total size, in bytes, of the stored logs of a batch, 0 if batches are only limited by their number of logs. A log bigger than
+ * that is sent in a batch of its own.
+ */
+@property(nonatomic, readonly) NSUInteger batchSizeInBytesLimit;
+
 /**
  * Maximum number of batches forwarded to the ingestion at the same time.
  */
@@ -55,6 +61,26 @@ NS_ASSUME_NONNULL_BEGIN
                  batchSizeLimit:(NSUInteger)batchSizeLimit
             pendingBatchesLimit:(NSUInteger)pendingBatchesLimit;
 
+/**
+ * Initializes a new instance based on given settings.
+ *
+ * @param groupId The id used by the channel to determine a group of logs.
+ * @param priority The priority of logs being sent by the channel.
+ * @param flushInterval The interval in seconds after which a new batch will be finished. Must be between 3 and 86400 (1 day).
+ * @param batchSizeLimit The maximum number of logs after which a new batch will be finished.
+ * @param batchSizeInBytesLimit The maximum total size, in bytes, of the stored logs after which a new batch will be finished. 0 to only
+ * limit batches by their number of logs.
+ * @param pendingBatchesLimit The maximum number of batches that have currently been forwarded to another component.
+ *
+ * @return a fully configured `MSACChannelUnitConfiguration` instance.
+ */
+- (instancetype)initWithGroupId:(NSString *)groupId
+                       priority:(MSACPriority)priority
+                  flushInterval:(NSUInteger)flushInterval
+                 batchSizeLimit:(NSUInteger)batchSizeLimit
+          batchSizeInBytesLimit:(NSUInteger)batchSizeInBytesLimit
+            pendingBatchesLimit:(NSUInteger)pendingBatchesLimit;
+
 /**
  * Initializes a new instance with default settings.
  *
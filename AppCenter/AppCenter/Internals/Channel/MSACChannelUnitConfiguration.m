@@ -10,18 +10,38 @@
                   flushInterval:(NSUInteger)flushInterval
                  batchSizeLimit:(NSUInteger)batchSizeLimit
             pendingBatchesLimit:(NSUInteger)pendingBatchesLimit {
+  return [self initWithGroupId:groupId
+                      priority:priority
+                 flushInterval:flushInterval
+                batchSizeLimit:batchSizeLimit
+         batchSizeInBytesLimit:0
+           pendingBatchesLimit:pendingBatchesLimit];
+}
+
+- (instancetype)initWithGroupId:(NSString *)groupId
+                       priority:(MSACPriority)priority
+                  flushInterval:(NSUInteger)flushInterval
+                 batchSizeLimit:(NSUInteger)batchSizeLimit
+          batchSizeInBytesLimit:(NSUInteger)batchSizeInBytesLimit
+            pendingBatchesLimit:(NSUInteger)pendingBatchesLimit {
   if ((self = [super init])) {
     _groupId = groupId;
     _priority = priority;
     _flushInterval = flushInterval;
     _batchSizeLimit = batchSizeLimit;
+    _batchSizeInBytesLimit = batchSizeInBytesLimit;
     _pendingBatchesLimit = pendingBatchesLimit;
   }
   return self;
 }
 
 - (instancetype)initDefaultConfigurationWithGroupId:(NSString *)groupId flushInterval:(NSUInteger)flushInterval {
-  return [self initWithGroupId:groupId priority:MSACPriorityDefault flushInterval:flushInterval batchSizeLimit:50 pendingBatchesLimit:3];
+  return [self initWithGroupId:groupId
+                      priority:MSACPriorityDefault
+                 flushInterval:flushInterval
+                batchSizeLimit:kMSACBatchSizeLimitDefault
+         batchSizeInBytesLimit:kMSACBatchSizeInBytesLimitDefault
+           pendingBatchesLimit:3];
 }
 
 - (instancetype)initDefaultConfigurationWithGroupId:(NSString *)groupId {
@@ -8,6 +8,11 @@
 NS_ASSUME_NONNULL_BEGIN
 
 @class MSACChannelUnitConfiguration;
+@class MSACEnqueueRing;
+@class MSACFlushScheduler;
+@class MSACTimerWheel;
+@class MSACUploadBudget;
+@class MSACUploadWindow;
 
 @protocol MSACIngestionProtocol;
 @protocol MSACStorage;
@@ -45,11 +50,51 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property(nonatomic) id<MSACStorage> storage;
 
+/**
+ * A storage instance keeping the log items enqueued with `MSACFlagsVolatile` in memory. Those items are stored in `storage` with normal
+ * persistence when it is not set.
+ */
+@property(nonatomic, nullable) id<MSACStorage> volatileStorage;
+
+/**
+ * Policy adapting the delay before sending logs and the size of the batches to the backlog and the network. The configured flush interval
+ * and batch size limit are used as is when it is not set.
+ */
+@property(nonatomic, nullable) MSACFlushScheduler *flushScheduler;
+
+/**
+ * Window of the batches sent at the same time, growing while batches are sent quickly. The configured pending batches limit is used when it
+ * is not set.
+ */
+@property(nonatomic, nullable) MSACUploadWindow *uploadWindow;
+
+/**
+ * Budget of the batches sent at the same time shared with the other channels of the group.
+ */
+@property(nonatomic, nullable) MSACUploadBudget *uploadBudget;
+
+/**
+ * Ring shared with the other channels of the group that enqueued logs are pushed into, they are taken out in batches on the logs dispatch
+ * queue. Each log is dispatched to the queue on its own when it is not set.
+ */
+@property(nonatomic, nullable) MSACEnqueueRing *enqueueRing;
+
+/**
+ * Timer shared with the other channels of the group to flush the queue after a certain amount of time, their wakeups line up. The channel
+ * uses a timer source of its own when it is not set.
+ */
+@property(nonatomic, nullable) MSACTimerWheel *timerWheel;
+
 /**
  * A timer source which is used to flush the queue after a certain amount of time.
  */
 @property(nonatomic) dispatch_source_t timerSource;
 
+/**
+ * Date the timer flushes the queue at, `nil` if the timer is not running.
+ */
+@property(nonatomic, nullable) NSDate *timerFireDate;
+
 /**
  * A counter that keeps tracks of the number of logs added to the queue.
  */
@@ -70,6 +115,11 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property(nonatomic) BOOL pendingBatchQueueFull;
 
+/**
+ * Number of batches claimed from the storage whose logs are still being loaded.
+ */
+@property(nonatomic) NSUInteger loadingBatchesCount;
+
 /**
  * A boolean value set to YES if the channel is enabled or NO otherwise.
  * Enable/disable does resume/pause the channel as needed under the hood. When a channel is disabled with data deletion it deletes persisted
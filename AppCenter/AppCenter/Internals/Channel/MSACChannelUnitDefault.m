@@ -6,10 +6,16 @@
 #import "MSACAppCenterErrors.h"
 #import "MSACAppCenterIngestion.h"
 #import "MSACAppCenterInternal.h"
+#import "MSACChannelDelegateTable.h"
 #import "MSACChannelUnitConfiguration.h"
 #import "MSACChannelUnitDefaultPrivate.h"
 #import "MSACDeviceTracker.h"
+#import "MSACEnqueueRing.h"
+#import "MSACFlushScheduler.h"
 #import "MSACStorage.h"
+#import "MSACTimerWheel.h"
+#import "MSACUploadBudget.h"
+#import "MSACUploadWindow.h"
 #import "MSACUtility+StringFormatting.h"
 
 /**
@@ -17,6 +23,16 @@
  */
 static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
 
+@interface MSACChannelUnitDefault () {
+
+  /**
+   * The delegate table, retained. It is published and loaded with atomic operations.
+   */
+  void *_delegateTablePointer;
+}
+
+@end
+
 @implementation MSACChannelUnitDefault
 
 @synthesize configuration = _configuration;
@@ -30,12 +46,15 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
     _pendingBatchIds = [NSMutableArray new];
     _pendingBatchQueueFull = NO;
     _availableBatchFromStorage = NO;
+    _loadingBatchesCount = 0;
     _enabled = YES;
     _paused = NO;
     _discardLogs = NO;
     _delegates = [NSHashTable weakObjectsHashTable];
+    _delegateTablePointer = (__bridge_retained void *)[[MSACChannelDelegateTable alloc] initWithDelegates:@[]];
     _pausedIdentifyingObjects = [NSHashTable weakObjectsHashTable];
     _pausedTargetKeys = [NSMutableSet new];
+    _volatileBatchIds = [NSMutableSet new];
   }
   return self;
 }
@@ -49,16 +68,26 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
     _storage = storage;
     _configuration = configuration;
     _logsDispatchQueue = logsDispatchQueue;
+    if (configuration.batchSizeInBytesLimit > 0) {
+      [storage setBatchSizeInBytesLimit:configuration.batchSizeInBytesLimit forGroupId:configuration.groupId];
+    }
   }
   return self;
 }
 
+- (void)dealloc {
+  if (_delegateTablePointer) {
+    CFRelease(_delegateTablePointer);
+  }
+}
+
 #pragma mark - MSACChannelDelegate
 
 - (void)addDelegate:(id<MSACChannelDelegate>)delegate {
   dispatch_async(self.logsDispatchQueue, ^{
     @synchronized(self.delegates) {
       [self.delegates addObject:delegate];
+      [self replaceDelegateTable];
     }
   });
 }
@@ -67,6 +96,7 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
   dispatch_async(self.logsDispatchQueue, ^{
     @synchronized(self.delegates) {
       [self.delegates removeObject:delegate];
+      [self replaceDelegateTable];
     }
   });
 }
@@ -109,72 +139,97 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
                               }];
   }
 
+  // Logs are pushed into the ring of the group, a single block takes them out on the logs dispatch queue.
+  if (self.enqueueRing) {
+    if (![self.enqueueRing pushLog:item internalId:internalLogId flags:flags target:self]) {
+      MSACLogDebug([MSACAppCenter logTag], @"Too many logs are being enqueued; discarding the log of type '%@'.", item.type);
+      NSError *error = [NSError errorWithDomain:kMSACACErrorDomain
+                                           code:MSACACLogDroppedErrorCode
+                                       userInfo:@{NSLocalizedDescriptionKey : kMSACACLogDroppedErrorDesc}];
+      [self notifyFailureBeforeSendingForItem:item withError:error];
+      [self enumerateDelegatesForSelector:@selector(channel:didCompleteEnqueueingLog:internalId:)
+                                withBlock:^(id<MSACChannelDelegate> delegate) {
+                                  [delegate channel:self didCompleteEnqueueingLog:item internalId:internalLogId];
+                                }];
+    }
+    return;
+  }
+
   // Return fast in case our item is empty or we are discarding logs right now.
   dispatch_async(self.logsDispatchQueue, ^{
     // Use separate autorelease pool for enqueuing logs.
     @autoreleasepool {
+      [self enqueuePreparedItem:item internalId:internalLogId flags:flags];
+    }
+  });
+}
 
-      // Check if the log should be filtered out. If so, don't enqueue it.
-      __block BOOL shouldFilter = NO;
-      [self enumerateDelegatesForSelector:@selector(channelUnit:shouldFilterLog:)
-                                withBlock:^(id<MSACChannelDelegate> delegate) {
-                                  shouldFilter = shouldFilter || [delegate channelUnit:self shouldFilterLog:item];
-                                }];
-      if (shouldFilter) {
-        MSACLogDebug([MSACAppCenter logTag], @"Log of type '%@' was filtered out by delegate(s)", item.type);
-        [self enumerateDelegatesForSelector:@selector(channel:didCompleteEnqueueingLog:internalId:)
-                                  withBlock:^(id<MSACChannelDelegate> delegate) {
-                                    [delegate channel:self didCompleteEnqueueingLog:item internalId:internalLogId];
-                                  }];
-        return;
-      }
-      if (!self.ingestion.isReadyToSend) {
-        MSACLogDebug([MSACAppCenter logTag], @"Log of type '%@' was not filtered out by delegate(s) but ingestion is not ready to send it.",
-                     item.type);
-        [self enumerateDelegatesForSelector:@selector(channel:didCompleteEnqueueingLog:internalId:)
-                                  withBlock:^(id<MSACChannelDelegate> delegate) {
-                                    [delegate channel:self didCompleteEnqueueingLog:item internalId:internalLogId];
-                                  }];
-        return;
-      }
-      if (self.discardLogs) {
-        MSACLogWarning([MSACAppCenter logTag], @"Channel %@ disabled in log discarding mode, discard this log.",
-                       self.configuration.groupId);
-        NSError *error = [NSError errorWithDomain:kMSACACErrorDomain
-                                             code:MSACACConnectionPausedErrorCode
-                                         userInfo:@{NSLocalizedDescriptionKey : kMSACACConnectionPausedErrorDesc}];
-        [self notifyFailureBeforeSendingForItem:item withError:error];
-        [self enumerateDelegatesForSelector:@selector(channel:didCompleteEnqueueingLog:internalId:)
-                                  withBlock:^(id<MSACChannelDelegate> delegate) {
-                                    [delegate channel:self didCompleteEnqueueingLog:item internalId:internalLogId];
-                                  }];
-        return;
-      }
+- (void)enqueuePreparedItem:(id<MSACLog>)item internalId:(NSString *)internalLogId flags:(MSACFlags)flags {
+
+  // Check if the log should be filtered out. If so, don't enqueue it.
+  __block BOOL shouldFilter = NO;
+  [self enumerateDelegatesForSelector:@selector(channelUnit:shouldFilterLog:)
+                            withBlock:^(id<MSACChannelDelegate> delegate) {
+                              shouldFilter = shouldFilter || [delegate channelUnit:self shouldFilterLog:item];
+                            }];
+  if (shouldFilter) {
+    MSACLogDebug([MSACAppCenter logTag], @"Log of type '%@' was filtered out by delegate(s)", item.type);
+    [self enumerateDelegatesForSelector:@selector(channel:didCompleteEnqueueingLog:internalId:)
+                              withBlock:^(id<MSACChannelDelegate> delegate) {
+                                [delegate channel:self didCompleteEnqueueingLog:item internalId:internalLogId];
+                              }];
+    return;
+  }
+  if (!self.ingestion.isReadyToSend) {
+    MSACLogDebug([MSACAppCenter logTag], @"Log of type '%@' was not filtered out by delegate(s) but ingestion is not ready to send it.",
+                 item.type);
+    [self enumerateDelegatesForSelector:@selector(channel:didCompleteEnqueueingLog:internalId:)
+                              withBlock:^(id<MSACChannelDelegate> delegate) {
+                                [delegate channel:self didCompleteEnqueueingLog:item internalId:internalLogId];
+                              }];
+    return;
+  }
+  if (self.discardLogs) {
+    MSACLogWarning([MSACAppCenter logTag], @"Channel %@ disabled in log discarding mode, discard this log.", self.configuration.groupId);
+    NSError *error = [NSError errorWithDomain:kMSACACErrorDomain
+                                         code:MSACACConnectionPausedErrorCode
+                                     userInfo:@{NSLocalizedDescriptionKey : kMSACACConnectionPausedErrorDesc}];
+    [self notifyFailureBeforeSendingForItem:item withError:error];
+    [self enumerateDelegatesForSelector:@selector(channel:didCompleteEnqueueingLog:internalId:)
+                              withBlock:^(id<MSACChannelDelegate> delegate) {
+                                [delegate channel:self didCompleteEnqueueingLog:item internalId:internalLogId];
+                              }];
+    return;
+  }
 
-      // Save the log first.
-      MSACLogDebug([MSACAppCenter logTag], @"Saving log, type: %@, flags: %u.", item.type, (unsigned int)flags);
-      bool success = [self.storage saveLog:item withGroupId:self.configuration.groupId flags:flags];
+  // Save the log first, volatile logs are kept in memory.
+  MSACLogDebug([MSACAppCenter logTag], @"Saving log, type: %@, flags: %u.", item.type, (unsigned int)flags);
+  bool success;
+  if (flags & MSACFlagsVolatile) {
+    success = self.volatileStorage ? [self.volatileStorage saveLog:item withGroupId:self.configuration.groupId flags:flags]
+                                   : [self.storage saveLog:item withGroupId:self.configuration.groupId flags:MSACFlagsNormal];
+  } else {
+    success = [self.storage saveLog:item withGroupId:self.configuration.groupId flags:flags];
+  }
 
-      // Notify delegates of completion (whatever the result is).
-      [self enumerateDelegatesForSelector:@selector(channel:didCompleteEnqueueingLog:internalId:)
-                                withBlock:^(id<MSACChannelDelegate> delegate) {
-                                  [delegate channel:self didCompleteEnqueueingLog:item internalId:internalLogId];
-                                }];
+  // Notify delegates of completion (whatever the result is).
+  [self enumerateDelegatesForSelector:@selector(channel:didCompleteEnqueueingLog:internalId:)
+                            withBlock:^(id<MSACChannelDelegate> delegate) {
+                              [delegate channel:self didCompleteEnqueueingLog:item internalId:internalLogId];
+                            }];
 
-      // If successful, check if logs can be sent now.
-      if (success) {
-        self.itemsCount += 1;
-        [self checkPendingLogs];
-      }
-    }
-  });
+  // If successful, check if logs can be sent now.
+  if (success) {
+    self.itemsCount += 1;
+    [self checkPendingLogs];
+  }
 }
 
 - (void)sendLogContainer:(MSACLogContainer *__nonnull)container {
 
   // Add to pending batches.
   [self.pendingBatchIds addObject:container.batchId];
-  if (self.pendingBatchIds.count >= self.configuration.pendingBatchesLimit) {
+  if (self.pendingBatchIds.count >= [self resolvePendingBatchesLimit]) {
 
     // The maximum number of batches forwarded to the ingestion at the same time has been reached.
     self.pendingBatchQueueFull = YES;
@@ -200,6 +255,7 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
                             }];
 
   // Forward logs to the ingestion.
+  NSDate *sendDate = [NSDate date];
   [self.ingestion sendAsync:container
           completionHandler:^(NSString *ingestionBatchId, NSHTTPURLResponse *response, __unused NSData *data, NSError *error) {
             dispatch_async(self.logsDispatchQueue, ^{
@@ -208,6 +264,15 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
                 return;
               }
               BOOL succeeded = [MSACHttpUtil isSuccessStatusCode:response.statusCode];
+
+              // Durations include the retries of the HTTP client, they tell how long logs take to be sent.
+              NSTimeInterval duration = -[sendDate timeIntervalSinceNow];
+              [self.flushScheduler recordRequestWithDuration:duration succeeded:succeeded];
+              if (succeeded) {
+                [self.uploadWindow batchDidSucceedWithDuration:duration];
+              } else {
+                [self.uploadWindow batchDidFail];
+              }
               if (succeeded) {
                 MSACLogDebug([MSACAppCenter logTag], @"Log(s) sent with success, batch Id:%@.", ingestionBatchId);
 
@@ -220,7 +285,7 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
                                           }];
 
                 // Remove the logs from storage.
-                [self.storage deleteLogsWithBatchId:ingestionBatchId groupId:self.configuration.groupId];
+                [[self storageOfBatchId:ingestionBatchId] deleteLogsWithBatchId:ingestionBatchId groupId:self.configuration.groupId];
               }
 
               // Failure.
@@ -243,19 +308,31 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
                   [self setEnabled:NO andDeleteDataOnDisabled:YES];
                   return;
                 }
+
+                // Make the logs available to be sent again later.
+                [[self storageOfBatchId:ingestionBatchId] releaseLogsWithBatchId:ingestionBatchId groupId:self.configuration.groupId];
               }
 
               // Remove from pending batches.
               [self.pendingBatchIds removeObject:ingestionBatchId];
+              [self.volatileBatchIds removeObject:ingestionBatchId];
 
               // Update pending batch queue state.
-              if (self.pendingBatchQueueFull && self.pendingBatchIds.count < self.configuration.pendingBatchesLimit) {
+              if (self.pendingBatchQueueFull && self.pendingBatchIds.count < [self resolvePendingBatchesLimit]) {
                 self.pendingBatchQueueFull = NO;
 
-                if (succeeded && self.availableBatchFromStorage) {
+                if (succeeded && (self.availableBatchFromStorage || [self hasVolatileLogs])) {
                   [self flushQueue];
                 }
               }
+
+              // Keep the window full while there are batches to send, it may have grown.
+              else if (self.uploadWindow && succeeded && self.availableBatchFromStorage && [self canLoadBatch]) {
+                [self flushQueue];
+              }
+
+              // Let the channels waiting for the shared budget send their batches.
+              [self.uploadBudget batchDidComplete];
             });
           }];
 }
@@ -281,8 +358,8 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
   // Cancel any timer.
   [self resetTimer];
 
-  // Don't flush while paused or if pending bach queue is full.
-  if (self.paused || self.pendingBatchQueueFull) {
+  // Don't flush while paused, if pending bach queue is full or if the channels of the group already send as many batches as they can.
+  if (self.paused || self.pendingBatchQueueFull || ![self hasUploadBudget]) {
 
     // Still close the current batch it will be flushed later.
     if (self.itemsCount >= self.configuration.batchSizeLimit) {
@@ -297,30 +374,95 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
   // Reset item count and load data from the storage.
   self.itemsCount = 0;
 
-  // NOTE: It isn't async operation, completion handler will be called immediately.
+  /*
+   * The completion handler is called right away, or later on the logs dispatch queue when the storage loads the batch on its read-only
+   * connection. Batches being loaded count as pending ones.
+   */
+  __block BOOL loadCompleted = NO;
+  self.loadingBatchesCount += 1;
   self.availableBatchFromStorage = [self.storage loadLogsWithGroupId:self.configuration.groupId
-                                                               limit:self.configuration.batchSizeLimit
+                                                               limit:[self resolveBatchSizeLimit]
                                                   excludedTargetKeys:[self.pausedTargetKeys allObjects]
                                                    completionHandler:^(NSArray<id<MSACLog>> *_Nonnull logArray, NSString *batchId) {
-                                                     // Check if there is data to send. Logs may be deleted from storage before this flush.
-                                                     if (logArray.count > 0) {
-                                                       MSACLogContainer *container = [[MSACLogContainer alloc] initWithBatchId:batchId
-                                                                                                                       andLogs:logArray];
-                                                       [self sendLogContainer:container];
-                                                     }
+                                                     [self didLoadLogs:logArray batchId:batchId synchronously:!loadCompleted];
                                                    }];
+  loadCompleted = YES;
 
-  // Flush again if there is another batch to send.
-  if (self.availableBatchFromStorage && !self.pendingBatchQueueFull) {
+  // Flush again if there is another batch to send, volatile logs are sent once the batches of the storage are loaded.
+  if (self.availableBatchFromStorage && [self canLoadBatch]) {
     [self flushQueue];
+  } else {
+    [self flushVolatileLogs];
   }
 }
 
+- (void)flushVolatileLogs {
+  BOOL moreLogsAvailable = YES;
+  while (self.volatileStorage && moreLogsAvailable && [self canLoadBatch]) {
+    __block NSArray<id<MSACLog>> *logs;
+    __block NSString *loadedBatchId;
+    moreLogsAvailable = [self.volatileStorage loadLogsWithGroupId:self.configuration.groupId
+                                                            limit:[self resolveBatchSizeLimit]
+                                               excludedTargetKeys:[self.pausedTargetKeys allObjects]
+                                                completionHandler:^(NSArray<id<MSACLog>> *_Nonnull logArray, NSString *batchId) {
+                                                  logs = logArray;
+                                                  loadedBatchId = batchId;
+                                                }];
+    if (!loadedBatchId) {
+      return;
+    }
+    [self.volatileBatchIds addObject:(NSString *)loadedBatchId];
+    [self sendLogContainer:[[MSACLogContainer alloc] initWithBatchId:(NSString *)loadedBatchId andLogs:logs]];
+  }
+}
+
+- (BOOL)hasVolatileLogs {
+  return [self.volatileStorage countLogsWithGroupId:self.configuration.groupId excludedTargetKeys:[self.pausedTargetKeys allObjects]] > 0;
+}
+
+- (id<MSACStorage>)storageOfBatchId:(NSString *)batchId {
+  return self.volatileStorage && [self.volatileBatchIds containsObject:batchId] ? (id<MSACStorage>)self.volatileStorage : self.storage;
+}
+
+- (void)didLoadLogs:(NSArray<id<MSACLog>> *)logArray batchId:(nullable NSString *)batchId synchronously:(BOOL)synchronously {
+  self.loadingBatchesCount -= 1;
+
+  // Check if there is data to send. Logs may be deleted from storage before this flush.
+  if (logArray.count == 0 || !batchId) {
+    if (!synchronously && self.availableBatchFromStorage && [self canLoadBatch]) {
+      [self flushQueue];
+    }
+    return;
+  }
+
+  // Logs loaded asynchronously are released if the channel has been disabled or paused in the meantime, they are sent later.
+  if (!synchronously && (!self.enabled || self.paused)) {
+    [self.storage releaseLogsWithBatchId:(NSString *)batchId groupId:self.configuration.groupId];
+    self.availableBatchFromStorage = YES;
+    return;
+  }
+  MSACLogContainer *container = [[MSACLogContainer alloc] initWithBatchId:(NSString *)batchId andLogs:logArray];
+  [self sendLogContainer:container];
+}
+
+- (BOOL)canLoadBatch {
+  return !self.pendingBatchQueueFull && self.pendingBatchIds.count + self.loadingBatchesCount < [self resolvePendingBatchesLimit] &&
+         [self hasUploadBudget];
+}
+
+- (NSUInteger)resolvePendingBatchesLimit {
+  return self.uploadWindow ? self.uploadWindow.size : self.configuration.pendingBatchesLimit;
+}
+
+- (BOOL)hasUploadBudget {
+  return !self.uploadBudget || [self.uploadBudget canSendBatchOfChannel:self];
+}
+
 - (void)checkPendingLogs {
 
-  // If the interval is default and we reached batchSizeLimit flush logs now.
+  // If the interval is default and we reached the flush threshold or batchSizeInBytesLimit flush logs now.
   if (!self.paused && self.configuration.flushInterval == kMSACFlushIntervalDefault &&
-      self.itemsCount >= self.configuration.batchSizeLimit) {
+      (self.itemsCount >= [self resolveFlushThreshold] || [self hasFullBatchInBytes])) {
     [self flushQueue];
   } else if (self.itemsCount > 0) {
     NSUInteger flushInterval = [self resolveFlushInterval];
@@ -335,13 +477,20 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
       [self flushQueue];
     }
 
-    // Postpone sending logs.
-    else {
+    // Postpone sending logs. Delays picked by the flush scheduler are not pushed back by new logs, they would never be sent otherwise.
+    else if (!self.flushScheduler || !self.timerFireDate || [self.timerFireDate timeIntervalSinceNow] > flushInterval) {
       [self startTimer:flushInterval];
     }
   }
 }
 
+- (BOOL)hasFullBatchInBytes {
+
+  // Sizes are tracked by counters, logs already claimed by pending batches can't fill another batch.
+  return self.configuration.batchSizeInBytesLimit > 0 && self.itemsCount > 0 &&
+         [self.storage sizeOfUnbatchedLogsWithGroupId:self.configuration.groupId] >= (long long)self.configuration.batchSizeInBytesLimit;
+}
+
 #pragma mark - Timer
 
 - (void)startTimer:(NSUInteger)flushInterval {
@@ -353,18 +502,8 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
 
   // Cancel any timer.
   [self resetTimer];
-
-  // Create new timer.
-  self.timerSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.logsDispatchQueue);
-
-  /**
-   * Cast (NSEC_PER_SEC * flushInterval) to (int64_t) silence warning. The compiler otherwise complains that we're using
-   * a float param (flushInterval) and implicitly downcast to int64_t.
-   */
-  dispatch_source_set_timer(self.timerSource, dispatch_walltime(NULL, (int64_t)(NSEC_PER_SEC * flushInterval)), 1ull * NSEC_PER_SEC,
-                            1ull * NSEC_PER_SEC);
   __weak typeof(self) weakSelf = self;
-  dispatch_source_set_event_handler(self.timerSource, ^{
+  dispatch_block_t handler = ^{
     typeof(self) strongSelf = weakSelf;
 
     // Flush the queue as needed.
@@ -377,13 +516,47 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
       // Remove the current timestamp. All pending logs will be sent in flushQueue call.
       [MSAC_APP_CENTER_USER_DEFAULTS removeObjectForKey:[strongSelf oldestPendingLogTimestampKey]];
     }
-  });
-  dispatch_resume(self.timerSource);
+  };
+
+  // The shared timer may fire a little later than asked, along with the timers of the other channels.
+  if (self.timerWheel) {
+    [self.timerWheel scheduleDeadlineForOwner:self
+                                   afterDelay:flushInterval
+                                       leeway:[self resolveTimerLeeway:flushInterval]
+                                      handler:handler];
+  } else {
+
+    // Create new timer.
+    self.timerSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.logsDispatchQueue);
+
+    /**
+     * Cast (NSEC_PER_SEC * flushInterval) to (int64_t) silence warning. The compiler otherwise complains that we're using
+     * a float param (flushInterval) and implicitly downcast to int64_t.
+     */
+    dispatch_source_set_timer(self.timerSource, dispatch_walltime(NULL, (int64_t)(NSEC_PER_SEC * flushInterval)), 1ull * NSEC_PER_SEC,
+                              1ull * NSEC_PER_SEC);
+    dispatch_source_set_event_handler(self.timerSource, handler);
+    dispatch_resume(self.timerSource);
+  }
+
+  // The requested date is kept, new logs would push back a later one.
+  self.timerFireDate = [NSDate dateWithTimeIntervalSinceNow:flushInterval];
+}
+
+- (NSTimeInterval)resolveTimerLeeway:(NSUInteger)flushInterval {
+
+  // Long intervals are less sensitive to a delay, their logs are rather sent along with the logs of other channels.
+  return MAX(kMSACFlushTimerMinLeeway, flushInterval * kMSACFlushTimerLeewayRatio);
 }
 
 - (NSUInteger)resolveFlushInterval {
   NSUInteger flushInterval = self.configuration.flushInterval;
 
+  // The delay of the default interval adapts to the backlog and the network, a custom interval is kept as is.
+  if (flushInterval == kMSACFlushIntervalDefault && self.flushScheduler) {
+    return [self.flushScheduler flushIntervalWithBacklog:[self countBacklog] batchSizeLimit:self.configuration.batchSizeLimit];
+  }
+
   // If the interval is custom.
   if (flushInterval > kMSACFlushIntervalDefault) {
     NSDate *now = [NSDate date];
@@ -408,6 +581,35 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
   return flushInterval;
 }
 
+- (NSUInteger)resolveBatchSizeLimit {
+  if (![self adaptsBatchSize]) {
+    return self.configuration.batchSizeLimit;
+  }
+  return [self.flushScheduler batchSizeLimitWithBacklog:[self countBacklog] batchSizeLimit:self.configuration.batchSizeLimit];
+}
+
+- (NSUInteger)resolveFlushThreshold {
+  if (![self adaptsBatchSize]) {
+    return self.configuration.batchSizeLimit;
+  }
+  return [self.flushScheduler flushThresholdWithBatchSizeLimit:self.configuration.batchSizeLimit];
+}
+
+- (BOOL)adaptsBatchSize {
+
+  // Only channels on the default configuration adapt their batch size, a custom flush interval or batch size limit is kept as is.
+  return self.flushScheduler && self.configuration.flushInterval == kMSACFlushIntervalDefault &&
+         self.configuration.batchSizeLimit == kMSACBatchSizeLimitDefault;
+}
+
+- (NSUInteger)countBacklog {
+
+  // Stored logs are tracked by counters, logs of the pending batches are still counted until they are deleted.
+  NSArray<NSString *> *excludedTargetKeys = [self.pausedTargetKeys allObjects];
+  return [self.storage countLogsWithGroupId:self.configuration.groupId excludedTargetKeys:excludedTargetKeys] +
+         [self.volatileStorage countLogsWithGroupId:self.configuration.groupId excludedTargetKeys:excludedTargetKeys];
+}
+
 - (NSString *)oldestPendingLogTimestampKey {
   return [NSString stringWithFormat:@"%@:%@", kMSACStartTimestampPrefix, self.configuration.groupId];
 }
@@ -416,6 +618,8 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
   if (self.timerSource) {
     dispatch_source_cancel(self.timerSource);
   }
+  [self.timerWheel cancelDeadlineForOwner:self];
+  self.timerFireDate = nil;
 }
 
 #pragma mark - Life cycle
@@ -517,10 +721,11 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
     MSACLogDebug([MSACAppCenter logTag], @"Resume channel for target key %@.", targetKey);
     [self.pausedTargetKeys removeObject:targetKey];
 
-    // Update item count and check logs if it meets the conditions to send logs.
-    // This solution is not ideal since it might create a batch with fewer logs than expected as the log count contains logs with paused
-    // keys, this would be an optimization that doesn't seem necessary for now. Aligned with Android implementation.
-    self.itemsCount = [self.storage countLogs];
+    // Update item count from the storage counters, logs with keys still paused are not counted, and check logs if it meets the conditions
+    // to send logs.
+    NSArray<NSString *> *excludedTargetKeys = [self.pausedTargetKeys allObjects];
+    self.itemsCount = [self.storage countLogsWithGroupId:self.configuration.groupId excludedTargetKeys:excludedTargetKeys] +
+                      [self.volatileStorage countLogsWithGroupId:self.configuration.groupId excludedTargetKeys:excludedTargetKeys];
     [self checkPendingLogs];
   });
 }
@@ -538,12 +743,16 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
 
   // Delete pending batches first.
   for (NSString *batchId in self.pendingBatchIds) {
-    [self.storage deleteLogsWithBatchId:batchId groupId:self.configuration.groupId];
+    [[self storageOfBatchId:batchId] deleteLogsWithBatchId:batchId groupId:self.configuration.groupId];
   }
   [self.pendingBatchIds removeAllObjects];
+  [self.volatileBatchIds removeAllObjects];
 
   // Delete remaining logs.
   deletedLogs = [self.storage deleteLogsWithGroupId:self.configuration.groupId];
+  if (self.volatileStorage) {
+    deletedLogs = [deletedLogs arrayByAddingObjectsFromArray:[self.volatileStorage deleteLogsWithGroupId:self.configuration.groupId]];
+  }
 
   // Notify failure of remaining logs.
   for (id<MSACLog> log in deletedLogs) {
@@ -554,38 +763,40 @@ static NSString *const kMSACStartTimestampPrefix = @"ChannelStartTimer";
 #pragma mark - Helper
 
 - (void)enumerateDelegatesForSelector:(SEL)selector withBlock:(void (^)(id<MSACChannelDelegate> delegate))block {
-  NSArray *synchronizedDelegates;
-  @synchronized(self.delegates) {
 
-    // Don't execute the block while locking; it might be locking too and deadlock ourselves.
-    synchronizedDelegates = [self.delegates allObjects];
-  }
-  for (id<MSACChannelDelegate> delegate in synchronizedDelegates) {
-    if ([delegate respondsToSelector:selector]) {
-      block(delegate);
-    }
-  }
+  // The table is replaced, not modified, when delegates change. Blocks are called without locking, they might be locking too.
+  [self.delegateTable enumerateDelegatesForSelector:selector withBlock:block];
 }
 
-- (void)notifyFailureBeforeSendingForItem:(id<MSACLog>)item withError:(nullable NSError *)error {
-  NSArray *synchronizedDelegates;
-  @synchronized(self.delegates) {
-
-    // Don't execute the block while locking; it might be locking too and deadlock ourselves.
-    synchronizedDelegates = [self.delegates allObjects];
-  }
-  for (id<MSACChannelDelegate> delegate in synchronizedDelegates) {
+- (MSACChannelDelegateTable *)delegateTable {
+  return (__bridge MSACChannelDelegateTable *)__atomic_load_n(&_delegateTablePointer, __ATOMIC_ACQUIRE);
+}
 
-    // Call willSendLog before didFailSendingLog
-    if ([delegate respondsToSelector:@selector(channel:willSendLog:)]) {
-      [delegate channel:self willSendLog:item];
-    }
+- (void)replaceDelegateTable {
 
-    // Call didFailSendingLog
-    if ([delegate respondsToSelector:@selector(channel:didFailSendingLog:withError:)]) {
-      [delegate channel:self didFailSendingLog:item withError:error];
-    }
+  // The table replaced is retained by the new one, it stays valid for the notifications that loaded it.
+  MSACChannelDelegateTable *delegateTable = [[MSACChannelDelegateTable alloc] initWithDelegates:[self.delegates allObjects]
+                                                                                  previousTable:self.delegateTable];
+  void *previousTable = __atomic_exchange_n(&_delegateTablePointer, (__bridge_retained void *)delegateTable, __ATOMIC_ACQ_REL);
+  if (previousTable) {
+    CFRelease(previousTable);
   }
 }
 
+- (void)notifyFailureBeforeSendingForItem:(id<MSACLog>)item withError:(nullable NSError *)error {
+  MSACChannelDelegateTable *delegateTable = self.delegateTable;
+
+  // Call willSendLog before didFailSendingLog
+  [delegateTable enumerateDelegatesForSelector:@selector(channel:willSendLog:)
+                                     withBlock:^(id<MSACChannelDelegate> delegate) {
+                                       [delegate channel:self willSendLog:item];
+                                     }];
+
+  // Call didFailSendingLog
+  [delegateTable enumerateDelegatesForSelector:@selector(channel:didFailSendingLog:withError:)
+                                     withBlock:^(id<MSACChannelDelegate> delegate) {
+                                       [delegate channel:self didFailSendingLog:item withError:error];
+                                     }];
+}
+
 @end
@@ -5,17 +5,61 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class MSACChannelDelegateTable;
+
 @interface MSACChannelUnitDefault ()
 
 @property(nonatomic) NSHashTable *pausedIdentifyingObjects;
 
 @property(nonatomic) NSMutableSet<NSString *> *pausedTargetKeys;
 
+/**
+ * Ids of the pending batches loaded from the volatile storage.
+ */
+@property(nonatomic) NSMutableSet<NSString *> *volatileBatchIds;
+
+/**
+ * Snapshot of the delegates notified of logs, replaced when a delegate is added or removed. It is loaded without locking.
+ */
+@property(nonatomic, readonly) MSACChannelDelegateTable *delegateTable;
+
+/**
+ * Store a log prepared by the delegates and check if logs can be sent. Called on the logs dispatch queue.
+ *
+ * @param item The log.
+ * @param internalLogId The internal Id of the log.
+ * @param flags The flags of the log.
+ */
+- (void)enqueuePreparedItem:(id<MSACLog>)item internalId:(NSString *)internalLogId flags:(MSACFlags)flags;
+
 /**
  * Flush pending logs.
  */
 - (void)flushQueue;
 
+/**
+ * Send the logs of the volatile storage by batches, as long as the number of pending batches allows it.
+ */
+- (void)flushVolatileLogs;
+
+/**
+ * Get the storage a pending batch has been loaded from.
+ *
+ * @param batchId The batch Id.
+ *
+ * @return The volatile storage or the storage.
+ */
+- (id<MSACStorage>)storageOfBatchId:(NSString *)batchId;
+
+/**
+ * Send the logs of a batch loaded from the storage.
+ *
+ * @param logArray The loaded logs.
+ * @param batchId The batch Id, `nil` if the batch is empty.
+ * @param synchronously Whether the batch has been loaded before the storage returned from the load call.
+ */
+- (void)didLoadLogs:(NSArray<id<MSACLog>> *)logArray batchId:(nullable NSString *)batchId synchronously:(BOOL)synchronously;
+
 /**
  * Synchronously pause operations, logs will be stored but not sent.
  *
@@ -47,6 +91,27 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (NSUInteger)resolveFlushInterval;
 
+/**
+ * Get the number of logs sent in the next batch, adapted by the flush scheduler to the backlog and the network.
+ *
+ * @return The number of logs.
+ */
+- (NSUInteger)resolveBatchSizeLimit;
+
+/**
+ * Get the number of new logs after which they are sent right away, when the flush interval is the default one.
+ *
+ * @return The number of logs.
+ */
+- (NSUInteger)resolveFlushThreshold;
+
+/**
+ * Get the maximum number of batches sent at the same time, from the upload window when it is set.
+ *
+ * @return The number of batches.
+ */
+- (NSUInteger)resolvePendingBatchesLimit;
+
 /**
  * Get a key for NSUserDefaults where the oldest pending log timestamp is stored for the channel.
  *
@@ -61,6 +126,15 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)startTimer:(NSUInteger)flushInterval;
 
+/**
+ * Get the duration the timer can fire late by to share a wakeup with the timers of other channels.
+ *
+ * @param flushInterval Delay in seconds.
+ *
+ * @return The leeway in seconds.
+ */
+- (NSTimeInterval)resolveTimerLeeway:(NSUInteger)flushInterval;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -0,0 +1,81 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+#import "MSACConstants+Flags.h"
+#import "MSACConstants.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@protocol MSACLog;
+
+/**
+ * Block called on the queue of the ring for each log taken out of it.
+ *
+ * @param log The log.
+ * @param internalId The internal Id of the log.
+ * @param flags The flags of the log.
+ * @param target The object the log has been pushed for.
+ */
+typedef void (^MSACEnqueueRingHandler)(id<MSACLog> log, NSString *internalId, MSACFlags flags, id target);
+
+/**
+ * Bounded ring of the logs being enqueued. Any thread pushes logs into it without locks, logs are taken out in batches on a serial queue.
+ *
+ * @discussion A single block is dispatched to the queue for all the logs pushed while the previous ones have not been taken out yet. When
+ * the ring is full, logs are dropped or the thread pushing them waits depending on the backpressure policy.
+ */
+@interface MSACEnqueueRing : NSObject
+
+/**
+ * Initializes a new `MSACEnqueueRing` instance.
+ *
+ * @param capacity Maximum number of logs in the ring, rounded up to a power of two.
+ * @param queue Serial queue the logs are taken out on. Logs pushed from this queue when the ring is full are taken out right away.
+ * @param handler Block called on the queue for each log taken out of the ring.
+ *
+ * @return A new `MSACEnqueueRing` instance.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity queue:(dispatch_queue_t)queue handler:(MSACEnqueueRingHandler)handler;
+
+/**
+ * Maximum number of logs in the ring.
+ */
+@property(nonatomic, readonly) NSUInteger capacity;
+
+/**
+ * What happens to a log pushed when the ring is full. Logs are dropped by default, threads never wait.
+ */
+@property(atomic) MSACBackpressurePolicy backpressurePolicy;
+
+/**
+ * Number of logs dropped because the ring was full.
+ */
+@property(nonatomic, readonly) NSUInteger droppedLogsCount;
+
+/**
+ * Number of times logs have been taken out of the ring.
+ */
+@property(nonatomic, readonly) NSUInteger drainsCount;
+
+/**
+ * Push a log into the ring.
+ *
+ * @param log The log.
+ * @param internalId The internal Id of the log.
+ * @param flags The flags of the log.
+ * @param target The object the log is pushed for, retained until the log is taken out.
+ *
+ * @return `YES` if the log has been pushed, `NO` if it has been dropped.
+ */
+- (BOOL)pushLog:(id<MSACLog>)log internalId:(NSString *)internalId flags:(MSACFlags)flags target:(id)target;
+
+/**
+ * Take the logs out of the ring. Must be called on the queue of the ring.
+ */
+- (void)drain;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,207 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <stdatomic.h>
+
+#import "MSACEnqueueRing.h"
+#import "MSACLog.h"
+
+/**
+ * Time, in nanoseconds, a thread waiting for room checks the ring again after, in case it missed the signal of the queue.
+ */
+static const int64_t kMSACEnqueueRingWaitInterval = 10 * NSEC_PER_MSEC;
+
+/**
+ * Key of the ring on its queue.
+ */
+static char kMSACEnqueueRingQueueKey;
+
+/**
+ * Slot of the ring. Objects are retained while they are in the ring.
+ *
+ * @discussion The sequence tells producers and the consumer whose turn it is: a slot at a position is free when its sequence is the
+ * position, and holds a log when its sequence is the position plus one.
+ */
+typedef struct {
+  _Atomic(uint64_t) sequence;
+  void *log;
+  void *internalId;
+  void *target;
+  MSACFlags flags;
+} MSACEnqueueRingSlot;
+
+@interface MSACEnqueueRing () {
+  MSACEnqueueRingSlot *_slots;
+  uint64_t _mask;
+  _Atomic(uint64_t) _enqueuePosition;
+  uint64_t _dequeuePosition;
+  atomic_bool _drainScheduled;
+  _Atomic(NSUInteger) _droppedLogsCount;
+  _Atomic(long) _waitingThreadsCount;
+}
+
+@property(nonatomic, readonly) dispatch_queue_t queue;
+
+@property(nonatomic, readonly) MSACEnqueueRingHandler handler;
+
+/**
+ * Signaled when room has been made in the ring.
+ */
+@property(nonatomic, readonly) dispatch_semaphore_t roomSemaphore;
+
+@property(nonatomic) NSUInteger drainsCount;
+
+@end
+
+@implementation MSACEnqueueRing
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity queue:(dispatch_queue_t)queue handler:(MSACEnqueueRingHandler)handler {
+  if ((self = [super init])) {
+    NSUInteger roundedCapacity = 2;
+    while (roundedCapacity < capacity) {
+      roundedCapacity <<= 1;
+    }
+    _capacity = roundedCapacity;
+    _mask = roundedCapacity - 1;
+    _slots = calloc(roundedCapacity, sizeof(MSACEnqueueRingSlot));
+    for (NSUInteger i = 0; i < roundedCapacity; i++) {
+      atomic_init(&_slots[i].sequence, i);
+    }
+    atomic_init(&_enqueuePosition, 0);
+    atomic_init(&_drainScheduled, false);
+    atomic_init(&_droppedLogsCount, 0);
+    atomic_init(&_waitingThreadsCount, 0);
+    _queue = queue;
+    _handler = handler;
+    _roomSemaphore = dispatch_semaphore_create(0);
+    _backpressurePolicy = MSACBackpressurePolicyDropNewest;
+    dispatch_queue_set_specific(queue, &kMSACEnqueueRingQueueKey, (__bridge void *)self, NULL);
+  }
+  return self;
+}
+
+- (void)dealloc {
+
+  // Release the objects of the logs that have not been taken out.
+  while ([self takeLogWithBlock:nil]) {
+  }
+  free(_slots);
+  dispatch_queue_set_specific(_queue, &kMSACEnqueueRingQueueKey, NULL, NULL);
+}
+
+#pragma mark - Producers
+
+- (BOOL)pushLog:(id<MSACLog>)log internalId:(NSString *)internalId flags:(MSACFlags)flags target:(id)target {
+  while (![self tryPushLog:log internalId:internalId flags:flags target:target]) {
+    MSACBackpressurePolicy policy = self.backpressurePolicy;
+    BOOL waits =
+        policy == MSACBackpressurePolicyBlock || (policy == MSACBackpressurePolicyDropNewestUnlessCritical && (flags & MSACFlagsCritical));
+    if (!waits) {
+      atomic_fetch_add_explicit(&_droppedLogsCount, 1, memory_order_relaxed);
+      return NO;
+    }
+
+    // The queue would wait for itself, it makes room right away instead.
+    if (dispatch_get_specific(&kMSACEnqueueRingQueueKey) == (__bridge void *)self) {
+      [self drain];
+      continue;
+    }
+    [self scheduleDrain];
+    atomic_fetch_add_explicit(&_waitingThreadsCount, 1, memory_order_relaxed);
+    dispatch_semaphore_wait(self.roomSemaphore, dispatch_time(DISPATCH_TIME_NOW, kMSACEnqueueRingWaitInterval));
+    atomic_fetch_sub_explicit(&_waitingThreadsCount, 1, memory_order_relaxed);
+  }
+  [self scheduleDrain];
+  return YES;
+}
+
+- (BOOL)tryPushLog:(id<MSACLog>)log internalId:(NSString *)internalId flags:(MSACFlags)flags target:(id)target {
+  MSACEnqueueRingSlot *slot;
+  uint64_t position = atomic_load_explicit(&_enqueuePosition, memory_order_relaxed);
+  for (;;) {
+    slot = &_slots[position & _mask];
+    uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    int64_t difference = (int64_t)(sequence - position);
+    if (difference == 0) {
+
+      // The slot is free, claim it unless another producer did first.
+      if (atomic_compare_exchange_weak_explicit(&_enqueuePosition, &position, position + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+
+      // The slot still holds the log pushed a lap earlier, the ring is full.
+      return NO;
+    } else {
+      position = atomic_load_explicit(&_enqueuePosition, memory_order_relaxed);
+    }
+  }
+  slot->log = (void *)CFBridgingRetain(log);
+  slot->internalId = (void *)CFBridgingRetain(internalId);
+  slot->target = (void *)CFBridgingRetain(target);
+  slot->flags = flags;
+  atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+  return YES;
+}
+
+- (void)scheduleDrain {
+  if (!atomic_exchange_explicit(&_drainScheduled, true, memory_order_acq_rel)) {
+    dispatch_async(self.queue, ^{
+      [self drain];
+    });
+  }
+}
+
+- (NSUInteger)droppedLogsCount {
+  return atomic_load_explicit(&_droppedLogsCount, memory_order_relaxed);
+}
+
+#pragma mark - Consumer
+
+- (void)drain {
+
+  // Logs pushed from now on schedule another drain.
+  atomic_store_explicit(&_drainScheduled, false, memory_order_release);
+  self.drainsCount += 1;
+
+  // Take out at most a lap of logs so that other blocks of the queue are not delayed by producers that keep pushing logs.
+  NSUInteger count = 0;
+  @autoreleasepool {
+    while (count < self.capacity && [self takeLogWithBlock:self.handler]) {
+      count++;
+    }
+  }
+  long waitingThreadsCount = atomic_load_explicit(&_waitingThreadsCount, memory_order_relaxed);
+  for (long i = 0; i < waitingThreadsCount; i++) {
+    dispatch_semaphore_signal(self.roomSemaphore);
+  }
+  if (count == self.capacity) {
+    [self scheduleDrain];
+  }
+}
+
+- (BOOL)takeLogWithBlock:(nullable MSACEnqueueRingHandler)block {
+  MSACEnqueueRingSlot *slot = &_slots[_dequeuePosition & _mask];
+  uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+  // The slot is empty, or a producer claimed it and is still writing the log. It schedules a drain once written.
+  if (sequence != _dequeuePosition + 1) {
+    return NO;
+  }
+  id<MSACLog> log = CFBridgingRelease(slot->log);
+  NSString *internalId = CFBridgingRelease(slot->internalId);
+  id target = CFBridgingRelease(slot->target);
+  MSACFlags flags = slot->flags;
+  slot->log = slot->internalId = slot->target = NULL;
+
+  // The slot is freed before the block is called, it may push logs.
+  atomic_store_explicit(&slot->sequence, _dequeuePosition + _mask + 1, memory_order_release);
+  _dequeuePosition += 1;
+  if (block) {
+    block(log, internalId, flags, target);
+  }
+  return YES;
+}
+
+@end
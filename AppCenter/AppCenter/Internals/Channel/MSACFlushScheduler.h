@@ -0,0 +1,141 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+#import "MSAC_Reachability.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Policy picking when and how many logs of a channel are sent, from the logs waiting to be sent and the quality of the network.
+ *
+ * @discussion Backlogs are drained quickly with bigger batches on a good network, logs are grouped in fewer requests on a poor one. The
+ * policy has no timer nor clock of its own, the same inputs always lead to the same decisions. It is used from the logs dispatch queue.
+ */
+@interface MSACFlushScheduler : NSObject
+
+/**
+ * Initializes a new `MSACFlushScheduler` instance.
+ *
+ * @param minFlushInterval Minimum delay, in seconds, before sending logs.
+ * @param maxFlushInterval Maximum delay, in seconds, before sending logs.
+ * @param minBatchSizeLimit Minimum number of logs sent in a single batch.
+ * @param maxBatchSizeLimit Maximum number of logs sent in a single batch.
+ *
+ * @return A new `MSACFlushScheduler` instance.
+ */
+- (instancetype)initWithMinFlushInterval:(NSUInteger)minFlushInterval
+                        maxFlushInterval:(NSUInteger)maxFlushInterval
+                       minBatchSizeLimit:(NSUInteger)minBatchSizeLimit
+                       maxBatchSizeLimit:(NSUInteger)maxBatchSizeLimit;
+
+/**
+ * Minimum delay, in seconds, before sending logs.
+ */
+@property(nonatomic, readonly) NSUInteger minFlushInterval;
+
+/**
+ * Maximum delay, in seconds, before sending logs.
+ */
+@property(nonatomic, readonly) NSUInteger maxFlushInterval;
+
+/**
+ * Minimum number of logs sent in a single batch.
+ */
+@property(nonatomic, readonly) NSUInteger minBatchSizeLimit;
+
+/**
+ * Maximum number of logs sent in a single batch.
+ */
+@property(nonatomic, readonly) NSUInteger maxBatchSizeLimit;
+
+/**
+ * Current reachability of the network, assumed reachable via Wi-Fi until it is known.
+ */
+@property(nonatomic) NetworkStatus networkStatus;
+
+/**
+ * Moving average of the duration, in seconds, of the recent requests. 0 until a request is recorded.
+ */
+@property(nonatomic, readonly) NSTimeInterval averageRequestDuration;
+
+/**
+ * Moving average of the success of the recent requests, from 0 to 1.
+ */
+@property(nonatomic, readonly) double successRate;
+
+/**
+ * Set the bounds of the delay before sending logs. Bounds are ignored if the minimum is greater than the maximum.
+ *
+ * @param minimum Minimum delay in seconds.
+ * @param maximum Maximum delay in seconds.
+ *
+ * @return `YES` if the bounds have been set, `NO` otherwise.
+ */
+- (BOOL)setFlushIntervalBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum;
+
+/**
+ * Set the bounds of the number of logs sent in a single batch. Bounds are ignored if the minimum is 0 or greater than the maximum.
+ *
+ * @param minimum Minimum number of logs.
+ * @param maximum Maximum number of logs.
+ *
+ * @return `YES` if the bounds have been set, `NO` otherwise.
+ */
+- (BOOL)setBatchSizeBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum;
+
+/**
+ * Record the outcome of a request sending a batch.
+ *
+ * @param duration Time, in seconds, between the sending of the batch and its completion, retries included.
+ * @param succeeded Whether the batch has been sent successfully.
+ */
+- (void)recordRequestWithDuration:(NSTimeInterval)duration succeeded:(BOOL)succeeded;
+
+/**
+ * Quality of the network, from 0 when it is not reachable to 1 for a fast and reliable one.
+ *
+ * @return The quality of the network.
+ */
+- (double)linkQuality;
+
+/**
+ * Whether the network is poor enough for logs to be grouped in fewer requests.
+ *
+ * @return `YES` if logs are grouped, `NO` otherwise.
+ */
+- (BOOL)isCoalescing;
+
+/**
+ * Get the delay before sending the logs of a channel with the default flush interval.
+ *
+ * @param backlog Number of logs of the channel waiting to be sent.
+ * @param batchSizeLimit Number of logs sent in a single batch configured for the channel.
+ *
+ * @return The delay in seconds.
+ */
+- (NSUInteger)flushIntervalWithBacklog:(NSUInteger)backlog batchSizeLimit:(NSUInteger)batchSizeLimit;
+
+/**
+ * Get the number of new logs of a channel with the default flush interval after which they are sent right away.
+ *
+ * @param batchSizeLimit Number of logs sent in a single batch configured for the channel.
+ *
+ * @return The number of logs.
+ */
+- (NSUInteger)flushThresholdWithBatchSizeLimit:(NSUInteger)batchSizeLimit;
+
+/**
+ * Get the number of logs of a channel sent in the next batch.
+ *
+ * @param backlog Number of logs of the channel waiting to be sent.
+ * @param batchSizeLimit Number of logs sent in a single batch configured for the channel.
+ *
+ * @return The number of logs.
+ */
+- (NSUInteger)batchSizeLimitWithBacklog:(NSUInteger)backlog batchSizeLimit:(NSUInteger)batchSizeLimit;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,185 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACFlushScheduler.h"
+#import "MSACConstants+Internal.h"
+
+/**
+ * Weight of the latest request in the moving averages.
+ */
+static const double kMSACRequestSmoothingFactor = 0.3;
+
+/**
+ * Request duration, in seconds, up to which the network is considered fast.
+ */
+static const NSTimeInterval kMSACFastRequestDuration = 1;
+
+/**
+ * Request duration, in seconds, from which the network is considered slow.
+ */
+static const NSTimeInterval kMSACSlowRequestDuration = 10;
+
+/**
+ * Quality of a slow network, when requests are reliable.
+ */
+static const double kMSACSlowLinkQuality = 0.1;
+
+/**
+ * Quality of a cellular network, when requests are fast and reliable.
+ */
+static const double kMSACCellularLinkQuality = 0.7;
+
+/**
+ * Quality from which backlogs are drained with the shortest delay and the biggest batches.
+ */
+static const double kMSACDrainingLinkQuality = 0.75;
+
+/**
+ * Quality below which logs are grouped in fewer requests.
+ */
+static const double kMSACCoalescingLinkQuality = 0.35;
+
+/**
+ * Success rate below which batches are made smaller, they are then more likely to be sent before a failure.
+ */
+static const double kMSACFailingSuccessRate = 0.5;
+
+@interface MSACFlushScheduler ()
+
+@property(nonatomic) NSUInteger minFlushInterval;
+
+@property(nonatomic) NSUInteger maxFlushInterval;
+
+@property(nonatomic) NSUInteger minBatchSizeLimit;
+
+@property(nonatomic) NSUInteger maxBatchSizeLimit;
+
+@property(nonatomic) NSTimeInterval averageRequestDuration;
+
+@property(nonatomic) double successRate;
+
+/**
+ * Number of requests recorded.
+ */
+@property(nonatomic) NSUInteger requestsCount;
+
+@end
+
+@implementation MSACFlushScheduler
+
+- (instancetype)init {
+  return [self initWithMinFlushInterval:kMSACMinFlushIntervalDefault
+                       maxFlushInterval:kMSACMaxFlushIntervalDefault
+                      minBatchSizeLimit:kMSACMinBatchSizeLimitDefault
+                      maxBatchSizeLimit:kMSACMaxBatchSizeLimitDefault];
+}
+
+- (instancetype)initWithMinFlushInterval:(NSUInteger)minFlushInterval
+                        maxFlushInterval:(NSUInteger)maxFlushInterval
+                       minBatchSizeLimit:(NSUInteger)minBatchSizeLimit
+                       maxBatchSizeLimit:(NSUInteger)maxBatchSizeLimit {
+  if ((self = [super init])) {
+    _minFlushInterval = minFlushInterval;
+    _maxFlushInterval = MAX(maxFlushInterval, minFlushInterval);
+    _minBatchSizeLimit = MAX(minBatchSizeLimit, 1);
+    _maxBatchSizeLimit = MAX(maxBatchSizeLimit, _minBatchSizeLimit);
+    _networkStatus = ReachableViaWiFi;
+    _successRate = 1;
+  }
+  return self;
+}
+
+#pragma mark - Settings
+
+- (BOOL)setFlushIntervalBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum {
+  if (minimum > maximum) {
+    return NO;
+  }
+  self.minFlushInterval = minimum;
+  self.maxFlushInterval = maximum;
+  return YES;
+}
+
+- (BOOL)setBatchSizeBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum {
+  if (minimum == 0 || minimum > maximum) {
+    return NO;
+  }
+  self.minBatchSizeLimit = minimum;
+  self.maxBatchSizeLimit = maximum;
+  return YES;
+}
+
+#pragma mark - Network
+
+- (void)recordRequestWithDuration:(NSTimeInterval)duration succeeded:(BOOL)succeeded {
+  duration = MAX(duration, 0);
+  self.averageRequestDuration = self.requestsCount == 0
+                                    ? duration
+                                    : self.averageRequestDuration + kMSACRequestSmoothingFactor * (duration - self.averageRequestDuration);
+  self.successRate += kMSACRequestSmoothingFactor * ((succeeded ? 1 : 0) - self.successRate);
+  self.requestsCount += 1;
+}
+
+- (double)linkQuality {
+  if (self.networkStatus == NotReachable) {
+    return 0;
+  }
+  double quality = self.networkStatus == ReachableViaWWAN ? kMSACCellularLinkQuality : 1;
+
+  // Quality decreases linearly between fast and slow requests.
+  if (self.averageRequestDuration > kMSACFastRequestDuration) {
+    double slowness =
+        MIN((self.averageRequestDuration - kMSACFastRequestDuration) / (kMSACSlowRequestDuration - kMSACFastRequestDuration), 1);
+    quality *= 1 - slowness * (1 - kMSACSlowLinkQuality);
+  }
+  return quality * self.successRate;
+}
+
+- (BOOL)isCoalescing {
+  return [self linkQuality] < kMSACCoalescingLinkQuality;
+}
+
+#pragma mark - Decisions
+
+- (NSUInteger)flushIntervalWithBacklog:(NSUInteger)backlog batchSizeLimit:(NSUInteger)batchSizeLimit {
+  double quality = [self linkQuality];
+  double flushInterval;
+  if (quality >= kMSACDrainingLinkQuality && backlog >= [self clampBatchSizeLimit:batchSizeLimit]) {
+
+    // Drain the backlog right away.
+    flushInterval = self.minFlushInterval;
+  } else if (quality > 0) {
+
+    // The default delay on a good network, growing quickly as the network gets worse.
+    flushInterval = ceil(kMSACFlushIntervalDefault / (quality * quality));
+  } else {
+    flushInterval = self.maxFlushInterval;
+  }
+  return (NSUInteger)MIN(MAX(flushInterval, self.minFlushInterval), self.maxFlushInterval);
+}
+
+- (NSUInteger)flushThresholdWithBatchSizeLimit:(NSUInteger)batchSizeLimit {
+
+  // Logs are only sent with the timer on a poor network, unless they already fill the biggest batch.
+  return [self isCoalescing] ? self.maxBatchSizeLimit : batchSizeLimit;
+}
+
+- (NSUInteger)batchSizeLimitWithBacklog:(NSUInteger)backlog batchSizeLimit:(NSUInteger)batchSizeLimit {
+  NSUInteger limit = [self clampBatchSizeLimit:batchSizeLimit];
+  if (self.successRate < kMSACFailingSuccessRate) {
+    return MAX(limit / 2, self.minBatchSizeLimit);
+  }
+
+  // Send the backlog in as few requests as possible when draining it or grouping logs.
+  double quality = [self linkQuality];
+  if (quality >= kMSACDrainingLinkQuality || quality < kMSACCoalescingLinkQuality) {
+    return MIN(MAX(backlog, limit), self.maxBatchSizeLimit);
+  }
+  return limit;
+}
+
+- (NSUInteger)clampBatchSizeLimit:(NSUInteger)batchSizeLimit {
+  return MIN(MAX(batchSizeLimit, self.minBatchSizeLimit), self.maxBatchSizeLimit);
+}
+
+@end
@@ -0,0 +1,73 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Single timer firing the deadlines of several owners, typically the channels of a group, so that their wakeups line up.
+ *
+ * @discussion Time is divided in ticks as long as the tolerance, a deadline fires at the end of the tick it falls in. Deadlines falling
+ * in the same tick share the same wakeup, and a deadline with some leeway joins a later wakeup already scheduled within its leeway.
+ * The wheel is used from the queue it has been created with, deadlines fire on that queue.
+ */
+@interface MSACTimerWheel : NSObject
+
+/**
+ * Initializes a new `MSACTimerWheel` instance.
+ *
+ * @param queue Serial queue the wheel is used from and deadlines fire on.
+ * @param tolerance Duration, in seconds, of a tick. Deadlines fire up to this duration late.
+ *
+ * @return A new `MSACTimerWheel` instance.
+ */
+- (instancetype)initWithQueue:(dispatch_queue_t)queue tolerance:(NSTimeInterval)tolerance;
+
+/**
+ * Duration, in seconds, of a tick.
+ */
+@property(nonatomic, readonly) NSTimeInterval tolerance;
+
+/**
+ * Number of times the wheel woke up to fire deadlines.
+ */
+@property(nonatomic, readonly) NSUInteger wakeupsCount;
+
+/**
+ * Schedule the deadline of an owner, replacing the deadline it already had.
+ *
+ * @param owner Owner of the deadline, it is not retained.
+ * @param delay Delay, in seconds, before the deadline.
+ * @param leeway Duration, in seconds, the deadline can be fired late to share a wakeup.
+ * @param handler Block called when the deadline fires.
+ */
+- (void)scheduleDeadlineForOwner:(id)owner
+                      afterDelay:(NSTimeInterval)delay
+                          leeway:(NSTimeInterval)leeway
+                         handler:(dispatch_block_t)handler;
+
+/**
+ * Cancel the deadline of an owner, if any.
+ *
+ * @param owner Owner of the deadline.
+ */
+- (void)cancelDeadlineForOwner:(id)owner;
+
+/**
+ * Get the date the deadline of an owner fires at.
+ *
+ * @param owner Owner of the deadline.
+ *
+ * @return The date, or `nil` if the owner has no deadline.
+ */
+- (nullable NSDate *)fireDateForOwner:(id)owner;
+
+/**
+ * Date of the next wakeup, `nil` if there is no deadline.
+ */
+@property(nonatomic, readonly, nullable) NSDate *nextFireDate;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,174 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACTimerWheel.h"
+#import "MSACTimerWheelPrivate.h"
+
+/**
+ * Part of a tick the system can delay a wakeup by, to line it up with the wakeups of other processes.
+ */
+static const double kMSACSystemLeewayRatio = 0.1;
+
+/**
+ * Deadline of an owner.
+ */
+@interface MSACTimerWheelDeadline : NSObject
+
+/**
+ * Tick at the end of which the deadline fires.
+ */
+@property(nonatomic) long long tick;
+
+@property(nonatomic, copy) dispatch_block_t handler;
+
+@end
+
+@implementation MSACTimerWheelDeadline
+@end
+
+@interface MSACTimerWheel ()
+
+@property(nonatomic, readonly) dispatch_queue_t queue;
+
+@property(nonatomic, readonly) NSMapTable<id, MSACTimerWheelDeadline *> *deadlines;
+
+/**
+ * Tick the timer is set to wake up at, `LLONG_MAX` if it is not set.
+ */
+@property(nonatomic) long long armedTick;
+
+@property(nonatomic) NSUInteger wakeupsCount;
+
+@end
+
+@implementation MSACTimerWheel
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue tolerance:(NSTimeInterval)tolerance {
+  if ((self = [super init])) {
+    _queue = queue;
+    _tolerance = tolerance > 0 ? tolerance : 1;
+    _deadlines = [NSMapTable weakToStrongObjectsMapTable];
+    _armedTick = LLONG_MAX;
+  }
+  return self;
+}
+
+- (void)dealloc {
+  if (_timerSource) {
+    dispatch_source_cancel(_timerSource);
+  }
+}
+
+#pragma mark - Deadlines
+
+- (void)scheduleDeadlineForOwner:(id)owner
+                      afterDelay:(NSTimeInterval)delay
+                          leeway:(NSTimeInterval)leeway
+                         handler:(dispatch_block_t)handler {
+  [self.deadlines removeObjectForKey:owner];
+  NSTimeInterval deadlineTime = [self currentTime] + MAX(delay, 0);
+  long long tick = (long long)ceil(deadlineTime / self.tolerance);
+  long long latestTick = (long long)floor((deadlineTime + MAX(leeway, 0)) / self.tolerance);
+
+  // Join the earliest wakeup already scheduled within the leeway, if there is none at the tick of the deadline.
+  long long joinedTick = LLONG_MAX;
+  for (MSACTimerWheelDeadline *deadline in [self.deadlines objectEnumerator]) {
+    if (deadline.tick >= tick && deadline.tick <= latestTick && deadline.tick < joinedTick) {
+      joinedTick = deadline.tick;
+    }
+  }
+  MSACTimerWheelDeadline *deadline = [MSACTimerWheelDeadline new];
+  deadline.tick = joinedTick != LLONG_MAX ? joinedTick : tick;
+  deadline.handler = handler;
+  [self.deadlines setObject:deadline forKey:owner];
+  [self armTimer];
+}
+
+- (void)cancelDeadlineForOwner:(id)owner {
+  if ([self.deadlines objectForKey:owner]) {
+    [self.deadlines removeObjectForKey:owner];
+    [self armTimer];
+  }
+}
+
+- (nullable NSDate *)fireDateForOwner:(id)owner {
+  MSACTimerWheelDeadline *deadline = [self.deadlines objectForKey:owner];
+  return deadline ? [NSDate dateWithTimeIntervalSinceReferenceDate:deadline.tick * self.tolerance] : nil;
+}
+
+- (nullable NSDate *)nextFireDate {
+  long long nextTick = [self nextTick];
+  return nextTick != LLONG_MAX ? [NSDate dateWithTimeIntervalSinceReferenceDate:nextTick * self.tolerance] : nil;
+}
+
+- (void)fireDueDeadlines {
+  long long currentTick = (long long)floor([self currentTime] / self.tolerance);
+  NSMutableArray<MSACTimerWheelDeadline *> *dueDeadlines = [NSMutableArray new];
+  NSMutableArray *dueOwners = [NSMutableArray new];
+  for (id owner in self.deadlines) {
+    MSACTimerWheelDeadline *deadline = [self.deadlines objectForKey:owner];
+    if (deadline.tick <= currentTick) {
+      [dueDeadlines addObject:deadline];
+      [dueOwners addObject:owner];
+    }
+  }
+  if (dueDeadlines.count > 0) {
+    self.wakeupsCount += 1;
+
+    // Handlers may schedule new deadlines for their owners, the fired ones are removed first.
+    for (id owner in dueOwners) {
+      [self.deadlines removeObjectForKey:owner];
+    }
+    [dueDeadlines sortUsingComparator:^NSComparisonResult(MSACTimerWheelDeadline *deadline1, MSACTimerWheelDeadline *deadline2) {
+      return deadline1.tick < deadline2.tick ? NSOrderedAscending : deadline1.tick > deadline2.tick ? NSOrderedDescending : NSOrderedSame;
+    }];
+    for (MSACTimerWheelDeadline *deadline in dueDeadlines) {
+      deadline.handler();
+    }
+  }
+  self.armedTick = LLONG_MAX;
+  [self armTimer];
+}
+
+#pragma mark - Timer
+
+- (void)armTimer {
+  long long nextTick = [self nextTick];
+  if (nextTick == self.armedTick) {
+    return;
+  }
+  self.armedTick = nextTick;
+  if (!self.timerSource) {
+    if (nextTick == LLONG_MAX) {
+      return;
+    }
+    _timerSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.queue);
+    __weak typeof(self) weakSelf = self;
+    dispatch_source_set_event_handler(self.timerSource, ^{
+      typeof(self) strongSelf = weakSelf;
+      [strongSelf fireDueDeadlines];
+    });
+    dispatch_resume(self.timerSource);
+  }
+  if (nextTick == LLONG_MAX) {
+    dispatch_source_set_timer(self.timerSource, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+    return;
+  }
+  NSTimeInterval delay = MAX(nextTick * self.tolerance - [self currentTime], 0);
+  dispatch_source_set_timer(self.timerSource, dispatch_walltime(NULL, (int64_t)(NSEC_PER_SEC * delay)), DISPATCH_TIME_FOREVER,
+                            (uint64_t)(NSEC_PER_SEC * self.tolerance * kMSACSystemLeewayRatio));
+}
+
+- (long long)nextTick {
+  long long nextTick = LLONG_MAX;
+  for (MSACTimerWheelDeadline *deadline in [self.deadlines objectEnumerator]) {
+    nextTick = MIN(nextTick, deadline.tick);
+  }
+  return nextTick;
+}
+
+- (NSTimeInterval)currentTime {
+  return [NSDate date].timeIntervalSinceReferenceDate;
+}
+
+@end
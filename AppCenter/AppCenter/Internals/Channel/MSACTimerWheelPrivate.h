@@ -0,0 +1,34 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACTimerWheel.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface MSACTimerWheel ()
+
+/**
+ * Timer waking the wheel up at the end of the next tick with a deadline.
+ */
+@property(nonatomic, readonly, nullable) dispatch_source_t timerSource;
+
+/**
+ * Get the current time.
+ *
+ * @return The number of seconds since the reference date.
+ */
+- (NSTimeInterval)currentTime;
+
+/**
+ * Fire the deadlines of the ticks that are over and schedule the next wakeup.
+ */
+- (void)fireDueDeadlines;
+
+/**
+ * Set the timer to wake the wheel up at the end of the next tick with a deadline.
+ */
+- (void)armTimer;
+
+@end
+
+NS_ASSUME_NONNULL_END
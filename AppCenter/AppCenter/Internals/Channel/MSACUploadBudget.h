@@ -0,0 +1,62 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class MSACChannelUnitDefault;
+
+/**
+ * Number of batches the channels of a group send at the same time, they share the connections to the ingestion.
+ *
+ * @discussion Batches are counted from the state of the channels, a batch is taken from the budget as soon as it is claimed from the
+ * storage and given back when its request completes. The budget is used from the logs dispatch queue.
+ */
+@interface MSACUploadBudget : NSObject
+
+/**
+ * Initializes a new `MSACUploadBudget` instance.
+ *
+ * @param limit Maximum number of batches sent at the same time.
+ *
+ * @return A new `MSACUploadBudget` instance.
+ */
+- (instancetype)initWithLimit:(NSUInteger)limit;
+
+/**
+ * Maximum number of batches sent at the same time.
+ */
+@property(nonatomic) NSUInteger limit;
+
+/**
+ * Add a channel sharing the budget. Channels are not retained.
+ *
+ * @param channel The channel.
+ */
+- (void)addChannel:(MSACChannelUnitDefault *)channel;
+
+/**
+ * Get the number of batches of all the channels being loaded or sent.
+ *
+ * @return The number of batches.
+ */
+- (NSUInteger)pendingBatchesCount;
+
+/**
+ * Check whether another batch can be sent. The channel flushes its queue once a batch completes if it can't.
+ *
+ * @param channel The channel about to send a batch.
+ *
+ * @return `YES` if the batch can be sent, `NO` otherwise.
+ */
+- (BOOL)canSendBatchOfChannel:(MSACChannelUnitDefault *)channel;
+
+/**
+ * Called when the request of a batch completed, the channels waiting for the budget flush their queue.
+ */
+- (void)batchDidComplete;
+
+@end
+
+NS_ASSUME_NONNULL_END
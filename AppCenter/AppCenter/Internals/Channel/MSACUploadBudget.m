@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACUploadBudget.h"
+#import "MSACChannelUnitDefaultPrivate.h"
+
+@interface MSACUploadBudget ()
+
+@property(nonatomic, readonly) NSHashTable<MSACChannelUnitDefault *> *channels;
+
+/**
+ * Channels that had a batch to send while the budget was exhausted.
+ */
+@property(nonatomic, readonly) NSHashTable<MSACChannelUnitDefault *> *waitingChannels;
+
+@end
+
+@implementation MSACUploadBudget
+
+- (instancetype)initWithLimit:(NSUInteger)limit {
+  if ((self = [super init])) {
+    _limit = MAX(limit, 1);
+    _channels = [NSHashTable weakObjectsHashTable];
+    _waitingChannels = [NSHashTable weakObjectsHashTable];
+  }
+  return self;
+}
+
+- (void)setLimit:(NSUInteger)limit {
+  _limit = MAX(limit, 1);
+}
+
+- (void)addChannel:(MSACChannelUnitDefault *)channel {
+  [self.channels addObject:channel];
+}
+
+- (NSUInteger)pendingBatchesCount {
+
+  // Counted from the channels, batches dropped by a channel can't be left over in the budget.
+  NSUInteger count = 0;
+  for (MSACChannelUnitDefault *channel in self.channels) {
+    count += channel.pendingBatchIds.count + channel.loadingBatchesCount;
+  }
+  return count;
+}
+
+- (BOOL)canSendBatchOfChannel:(MSACChannelUnitDefault *)channel {
+  if ([self pendingBatchesCount] < self.limit) {
+    return YES;
+  }
+  [self.waitingChannels addObject:channel];
+  return NO;
+}
+
+- (void)batchDidComplete {
+  if (self.waitingChannels.count == 0 || [self pendingBatchesCount] >= self.limit) {
+    return;
+  }
+  NSArray<MSACChannelUnitDefault *> *waitingChannels = self.waitingChannels.allObjects;
+  [self.waitingChannels removeAllObjects];
+  for (MSACChannelUnitDefault *channel in waitingChannels) {
+    [channel flushQueue];
+  }
+}
+
+@end
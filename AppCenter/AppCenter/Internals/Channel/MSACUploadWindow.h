@@ -0,0 +1,50 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Number of batches of a channel sent at the same time. Like a congestion window, it grows while batches are sent quickly and shrinks
+ * when requests fail or slow down.
+ *
+ * @discussion The window is used from the logs dispatch queue.
+ */
+@interface MSACUploadWindow : NSObject
+
+/**
+ * Initializes a new `MSACUploadWindow` instance.
+ *
+ * @param size Initial number of batches sent at the same time.
+ * @param maxSize Maximum number of batches sent at the same time.
+ *
+ * @return A new `MSACUploadWindow` instance.
+ */
+- (instancetype)initWithSize:(NSUInteger)size maxSize:(NSUInteger)maxSize;
+
+/**
+ * Number of batches sent at the same time, between 1 and `maxSize`.
+ */
+@property(nonatomic, readonly) NSUInteger size;
+
+/**
+ * Maximum number of batches sent at the same time. The size is reduced if it is bigger.
+ */
+@property(nonatomic) NSUInteger maxSize;
+
+/**
+ * Called when a batch has been sent successfully.
+ *
+ * @param duration Time, in seconds, between the sending of the batch and its completion.
+ */
+- (void)batchDidSucceedWithDuration:(NSTimeInterval)duration;
+
+/**
+ * Called when a batch failed to be sent.
+ */
+- (void)batchDidFail;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,64 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACUploadWindow.h"
+
+/**
+ * Duration, in seconds, up to which a batch is considered sent quickly.
+ */
+static const NSTimeInterval kMSACFastBatchDuration = 2;
+
+/**
+ * Duration, in seconds, from which a batch is considered sent slowly, the ingestion or the network can't keep up.
+ */
+static const NSTimeInterval kMSACSlowBatchDuration = 10;
+
+@interface MSACUploadWindow ()
+
+@property(nonatomic) NSUInteger size;
+
+/**
+ * Number of batches sent quickly since the size last changed.
+ */
+@property(nonatomic) NSUInteger fastBatchesCount;
+
+@end
+
+@implementation MSACUploadWindow
+
+- (instancetype)initWithSize:(NSUInteger)size maxSize:(NSUInteger)maxSize {
+  if ((self = [super init])) {
+    _maxSize = MAX(maxSize, 1);
+    _size = MIN(MAX(size, 1), _maxSize);
+  }
+  return self;
+}
+
+- (void)setMaxSize:(NSUInteger)maxSize {
+  _maxSize = MAX(maxSize, 1);
+  self.size = MIN(self.size, _maxSize);
+}
+
+- (void)batchDidSucceedWithDuration:(NSTimeInterval)duration {
+  if (duration >= kMSACSlowBatchDuration) {
+    [self resizeTo:self.size - 1];
+  } else if (duration <= kMSACFastBatchDuration) {
+
+    // Grow by one batch once a whole window has been sent quickly.
+    self.fastBatchesCount += 1;
+    if (self.fastBatchesCount >= self.size) {
+      [self resizeTo:self.size + 1];
+    }
+  }
+}
+
+- (void)batchDidFail {
+  [self resizeTo:self.size / 2];
+}
+
+- (void)resizeTo:(NSUInteger)size {
+  self.size = MIN(MAX(size, 1), self.maxSize);
+  self.fastBatchesCount = 0;
+}
+
+@end
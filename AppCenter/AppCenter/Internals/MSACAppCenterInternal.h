@@ -53,6 +53,41 @@ static NSString *const kMSACTrueEnvironmentString = @"1";
 
 @property(nonatomic) NSNumber *requestedMaxStorageSizeInBytes;
 
+/**
+ * Durability level of the storage, applied to the channel group when it is created.
+ */
+@property(nonatomic) MSACStorageDurability requestedStorageDurability;
+
+/**
+ * Backend of the storage, used when the channel group is created.
+ */
+@property(nonatomic) MSACStorageBackend requestedStorageBackend;
+
+/**
+ * Maximum age of the logs with normal persistence, applied to the channel group when it is created.
+ */
+@property(nonatomic) NSTimeInterval requestedLogTimeToLive;
+
+/**
+ * Minimum and maximum delay, in seconds, before sending logs, applied to the channel group when it is created.
+ */
+@property(nonatomic) NSArray<NSNumber *> *requestedFlushIntervalBounds;
+
+/**
+ * Minimum and maximum number of logs sent in a single batch, applied to the channel group when it is created.
+ */
+@property(nonatomic) NSArray<NSNumber *> *requestedBatchSizeBounds;
+
+/**
+ * Maximum number of batches sent at the same time per channel and in total, applied to the channel group when it is created.
+ */
+@property(nonatomic) NSArray<NSNumber *> *requestedPendingBatchesLimits;
+
+/**
+ * Policy applied to the logs enqueued while too many logs are waiting to be stored, applied to the channel group when it is created.
+ */
+@property(nonatomic) MSACBackpressurePolicy requestedBackpressurePolicy;
+
 /**
  * Flag indicating if the SDK is enabled or not as a whole.
  */
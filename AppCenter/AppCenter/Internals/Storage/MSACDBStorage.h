@@ -1,7 +1,9 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
+#import "MSACConstants.h"
 #import "MSACStorageBindableArray.h"
+#import "MSACStorageCursor.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -22,9 +24,15 @@ NS_ASSUME_NONNULL_BEGIN
 typedef NSArray<NSDictionary<NSString *, NSArray<NSString *> *> *> MSACDBColumnsSchema;
 typedef NSDictionary<NSString *, MSACDBColumnsSchema *> MSACDBSchema;
 
+/**
+ * Block called with each row of a selection query. Set `stop` to `YES` to stop reading rows.
+ */
+typedef void (^MSACDBStorageRowBlock)(MSACStorageCursor *cursor, BOOL *stop);
+
 // SQLite types
 static NSString *const kMSACSQLiteTypeText = @"TEXT";
 static NSString *const kMSACSQLiteTypeInteger = @"INTEGER";
+static NSString *const kMSACSQLiteTypeBlob = @"BLOB";
 
 // SQLite column constraints.
 static NSString *const kMSACSQLiteConstraintNotNull = @"NOT NULL";
@@ -33,6 +41,11 @@ static NSString *const kMSACSQLiteConstraintAutoincrement = @"AUTOINCREMENT";
 
 @interface MSACDBStorage : NSObject
 
+/**
+ * Durability level of the database. Changing it applies to the opened connection right away.
+ */
+@property(nonatomic) MSACStorageDurability durability;
+
 /**
  * Initialize this database with a schema and a filename for its creation.
  *
@@ -95,6 +108,19 @@ static NSString *const kMSACSQLiteConstraintAutoincrement = @"AUTOINCREMENT";
  */
 - (NSArray<NSArray *> *)executeSelectionQuery:(NSString *)query withValues:(nullable MSACStorageBindableArray *)values;
 
+/**
+ * Execute a "SELECT" SQLite query on the database and read the rows one by one, without materializing them.
+ *
+ * @param query A SQLite "SELECT" query to execute.
+ * @param values An array of query parameters to be substituted using `sqlite3_bind`.
+ * @param block Block called with a cursor on each row.
+ *
+ * @return A result code for the query execution.
+ */
+- (int)enumerateRowsOfQuery:(NSString *)query
+                 withValues:(nullable MSACStorageBindableArray *)values
+                 usingBlock:(MSACDBStorageRowBlock)block;
+
 /**
  * Get columns indexes from schema.
  *
@@ -104,6 +130,90 @@ static NSString *const kMSACSQLiteConstraintAutoincrement = @"AUTOINCREMENT";
  */
 + (NSDictionary *)columnsIndexes:(MSACDBSchema *)schema;
 
+/**
+ * Group changes in a single transaction committed once it reaches a number of changes or a time window has elapsed since it began.
+ *
+ * @param maxChangesCount Maximum number of changes grouped in a transaction. A value of 1 or less disables grouping.
+ * @param window Maximum time, in seconds, a change is kept uncommitted.
+ * @param queue Serial queue the database is accessed from, the pending transaction is committed on it once the window has elapsed.
+ *
+ * @discussion Uncommitted changes are lost if the app crashes. Changes are not grouped with the `MSACStorageDurabilityFull` level.
+ */
+- (void)enableGroupCommitWithMaxChangesCount:(NSUInteger)maxChangesCount window:(NSTimeInterval)window queue:(dispatch_queue_t)queue;
+
+/**
+ * Free unused pages of the database file in the background, once the database has not been changed for a while.
+ *
+ * @param maxPagesCount Maximum number of pages freed at once.
+ * @param idleDelay Time, in seconds, without deletion after which unused pages are freed.
+ * @param queue Serial queue the database is accessed from, pages are freed on it.
+ *
+ * @discussion A database created without auto vacuum is converted on the same queue, after the idle delay, rather than on initialization.
+ */
+- (void)enableIncrementalVacuumWithMaxPagesCount:(NSUInteger)maxPagesCount
+                                       idleDelay:(NSTimeInterval)idleDelay
+                                           queue:(dispatch_queue_t)queue;
+
+/**
+ * Read the database from a read-only connection, on a queue of its own, so that reads don't wait for the changes made from the queue the
+ * database is accessed from, and vice versa.
+ *
+ * @param readerQueue Serial queue the read-only connection is used from.
+ * @param queue Serial queue the database is accessed from, the results of the reads are delivered on it.
+ *
+ * @discussion The read-only connection requires a write-ahead log. With the `MSACStorageDurabilityFull` level, reads are made on the main
+ * connection.
+ */
+- (void)enableReaderConnectionWithReaderQueue:(dispatch_queue_t)readerQueue queue:(dispatch_queue_t)queue;
+
+/**
+ * Free unused pages of the database file after the idle delay. Does nothing if incremental vacuum is not enabled.
+ */
+- (void)scheduleIncrementalVacuum;
+
+/**
+ * Free a bounded number of unused pages of the database file, or convert the database to incremental vacuum if it's not yet.
+ *
+ * @return The number of freed pages.
+ */
+- (long)vacuumIncrementally;
+
+/**
+ * Migrate the rows of tables staged by `migrateDatabase:fromVersion:` in chunks on the given queue, one chunk at a time, so that the
+ * storage stays usable during the migration.
+ *
+ * @param chunkSize Maximum number of rows migrated in a single transaction.
+ * @param queue Serial queue the database is accessed from.
+ *
+ * @discussion The progress is saved with each chunk, a migration interrupted by the app being killed resumes on next launch. A chunk that
+ * doesn't fit in the storage is rolled back and migrated again once room is made.
+ */
+- (void)enableIncrementalMigrationWithChunkSize:(NSUInteger)chunkSize queue:(dispatch_queue_t)queue;
+
+/**
+ * Migrate the rows left in staged tables, chunk after chunk. Does nothing if incremental migration is not enabled.
+ */
+- (void)scheduleIncrementalMigration;
+
+/**
+ * Resume an incremental migration stopped because the storage was full. Call it once rows have been deleted.
+ */
+- (void)resumeIncrementalMigration;
+
+/**
+ * Migrate a single chunk of rows of a staged table, or drop the staged table once all its rows are migrated.
+ *
+ * @return `YES` if rows may be left to migrate, `NO` otherwise.
+ */
+- (BOOL)migrateIncrementally;
+
+/**
+ * Commit the pending transaction of grouped changes, if any.
+ *
+ * @return `SQLITE_OK` if there is nothing to commit or the commit succeeded, otherwise an error code.
+ */
+- (int)commitPendingTransaction;
+
 /**
  * Deletes database.
  *
@@ -5,12 +5,18 @@
 
 #import "MSACAppCenterInternal.h"
 #import "MSACDBStoragePrivate.h"
+#import "MSACDBStorageProfile.h"
 #import "MSACStorageBindableArray.h"
 #import "MSACUtility+File.h"
 
 static dispatch_once_t sqliteConfigurationResultOnceToken;
 static int sqliteConfigurationResult = SQLITE_ERROR;
 
+/**
+ * Maximum number of prepared statements kept in cache for a connection. Queries above that limit are prepared and finalized on each call.
+ */
+static const NSUInteger kMSACMaxCachedStatementsCount = 32;
+
 @implementation MSACDBStorage
 
 + (void)load {
@@ -40,6 +46,10 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
     }
   });
   if ((self = [super init])) {
+    _cachedStatements = [NSMutableDictionary<NSString *, NSValue *> new];
+    _readerCachedStatements = [NSMutableDictionary<NSString *, NSValue *> new];
+    _groupCommitMaxChangesCount = 1;
+    _profile = [MSACDBStorageProfile defaultProfile];
     int result = [self configureDatabaseWithSchema:schema version:version filename:filename];
     if (result == SQLITE_CORRUPT || result == SQLITE_NOTADB) {
       [self dropDatabase];
@@ -56,15 +66,30 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
   return [self initWithSchema:nil version:version filename:filename];
 }
 
+- (void)dealloc {
+  [self resetIncrementalVacuumTimer];
+
+  // Nothing can be reading anymore, the read-only connection is closed from the current queue.
+  self.readerQueue = nil;
+  [self closeConnection];
+}
+
 - (int)configureDatabaseWithSchema:(MSACDBSchema *)schema version:(NSUInteger)version filename:(NSString *)filename {
   BOOL newDatabase = ![MSACUtility fileExistsForPathComponent:filename];
   self.dbFileURL = [MSACUtility createFileAtPathComponent:filename withData:nil atomically:NO forceOverwrite:NO];
   self.maxSizeInBytes = kMSACDefaultDatabaseSizeInBytes;
   int result;
-  sqlite3 *db = [MSACDBStorage openDatabaseAtFileURL:self.dbFileURL withResult:&result];
+  sqlite3 *db = [self openDatabaseWithFlags:SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE cacheSizeInKiB:0 result:&result];
   if (result != SQLITE_OK) {
+    MSACLogError([MSACAppCenter logTag], @"Failed to open database with result: %d.", result);
     return result;
   }
+
+  // Page size can only be changed before the first table is created.
+  if (newDatabase && self.profile.pageSize > 0) {
+    NSString *query = [NSString stringWithFormat:@"PRAGMA page_size = %ld", self.profile.pageSize];
+    [MSACDBStorage executeNonSelectionQuery:query inOpenedDatabase:db];
+  }
   self.pageSize = [MSACDBStorage getPageSizeInOpenedDatabase:db];
   if (self.pageSize == 0) {
     MSACLogError([MSACAppCenter logTag], @"Failed to get storage page size.");
@@ -77,6 +102,9 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
     return result;
   }
 
+  // Auto vacuum is set for free as long as no table has been created yet.
+  self.needsVacuum = [MSACDBStorage enableIncrementalVacuumInOpenedDatabase:db];
+
   // Create table.
   if (schema) {
     result = [MSACDBStorage createTablesWithSchema:schema inOpenedDatabase:db];
@@ -93,8 +121,10 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
     MSACLogInfo([MSACAppCenter logTag], @"Migrating \"%@\" database from version %lu to %lu.", filename, (unsigned long)databaseVersion,
                 (unsigned long)version);
     [self migrateDatabase:db fromVersion:databaseVersion];
+
+    // Migration may have altered the schema, don't keep statements prepared against the previous one.
+    [self closeConnection];
   }
-  [MSACDBStorage enableAutoVacuumInOpenedDatabase:db];
   [MSACDBStorage setVersion:version inOpenedDatabase:db];
   sqlite3_close(db);
   return result;
@@ -102,45 +132,578 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
 
 - (int)executeQueryUsingBlock:(MSACDBStorageQueryBlock)callback {
   int result;
-  sqlite3 *db = [MSACDBStorage openDatabaseAtFileURL:self.dbFileURL withResult:&result];
+  sqlite3 *db = [self openConnectionWithResult:&result];
   if (!db) {
     return result;
   }
+  result = callback(db);
+  [self checkpointIfNeededInOpenedDatabase:db];
+  return result;
+}
+
+- (int)executeSynchronousQueryUsingBlock:(MSACDBStorageQueryBlock)block {
+  return [self executeQueryUsingBlock:^int(void *db) {
+    [self commitPendingTransactionInOpenedDatabase:db];
+    if (!self.walEnabled) {
+      return block(db);
+    }
+
+    // The write-ahead log is synced on commit only while synchronous mode is "FULL".
+    [self executeCachedNonSelectionQuery:@"PRAGMA synchronous = FULL" inOpenedDatabase:db withValues:nil];
+    int result = block(db);
+    [self executeCachedNonSelectionQuery:@"PRAGMA synchronous = NORMAL" inOpenedDatabase:db withValues:nil];
+    return result;
+  }];
+}
+
+- (int)executeGroupedQueryUsingBlock:(MSACDBStorageQueryBlock)block {
+  if (self.groupCommitMaxChangesCount <= 1 || !self.groupCommitQueue || self.durability == MSACStorageDurabilityFull) {
+    return [self executeQueryUsingBlock:block];
+  }
+  return [self executeQueryUsingBlock:^int(void *db) {
+    if (sqlite3_get_autocommit(db)) {
+      int result = [self executeCachedNonSelectionQuery:@"BEGIN IMMEDIATE" inOpenedDatabase:db withValues:nil];
+      if (result != SQLITE_OK) {
+        MSACLogWarning([MSACAppCenter logTag], @"Failed to begin a transaction, the change will be committed on its own.");
+        return block(db);
+      }
+      self.pendingTransactionChangesCount = 0;
+      [self startGroupCommitTimer];
+    }
+    int result = block(db);
+
+    // Some errors roll back the whole transaction rather than the failing statement only.
+    if (sqlite3_get_autocommit(db)) {
+      MSACLogError([MSACAppCenter logTag], @"The pending transaction has been rolled back, %tu change(s) lost.",
+                   self.pendingTransactionChangesCount);
+      [self resetGroupCommitTimer];
+      self.pendingTransactionChangesCount = 0;
+      [self transactionDidRollBack];
+      return result;
+    }
+    if (result == SQLITE_OK) {
+      self.pendingTransactionChangesCount += 1;
+      if (self.pendingTransactionChangesCount >= self.groupCommitMaxChangesCount) {
+        result = [self commitPendingTransactionInOpenedDatabase:db];
+      }
+    }
+    return result;
+  }];
+}
+
+- (void)enableGroupCommitWithMaxChangesCount:(NSUInteger)maxChangesCount window:(NSTimeInterval)window queue:(dispatch_queue_t)queue {
+  self.groupCommitMaxChangesCount = maxChangesCount;
+  self.groupCommitWindow = window;
+  self.groupCommitQueue = queue;
+}
+
+- (void)enableReaderConnectionWithReaderQueue:(dispatch_queue_t)readerQueue queue:(dispatch_queue_t)queue {
+  self.readerQueue = readerQueue;
+  self.readerCompletionQueue = queue;
+}
+
+- (BOOL)canReadConcurrently {
+  return self.readerQueue && self.readerCompletionQueue && self.walEnabled;
+}
+
+- (void)executeReadQueryUsingBlock:(MSACDBStorageQueryBlock)block completionHandler:(void (^)(int result))completionHandler {
+  if (![self canReadConcurrently]) {
+    completionHandler([self executeQueryUsingBlock:block]);
+    return;
+  }
+  [self commitPendingTransaction];
+  dispatch_queue_t completionQueue = (dispatch_queue_t _Nonnull)self.readerCompletionQueue;
+  dispatch_async((dispatch_queue_t _Nonnull)self.readerQueue, ^{
+    int result;
+    sqlite3 *db = [self openReaderConnectionWithResult:&result];
+    if (db) {
+      result = block(db);
+    }
+    dispatch_async(completionQueue, ^{
+      completionHandler(result);
+    });
+  });
+}
+
+- (sqlite3 *)openReaderConnectionWithResult:(int *)result {
+  if (self.readerConnection) {
+    *result = SQLITE_OK;
+    return self.readerConnection;
+  }
+
+  // The write-ahead log lets the read-only connection read the last committed changes while the long-lived connection writes.
+  sqlite3 *db = [self openDatabaseWithFlags:SQLITE_OPEN_READONLY cacheSizeInKiB:self.profile.readerCacheSizeInKiB result:result];
+  if (!db) {
+    MSACLogError([MSACAppCenter logTag], @"Failed to open read-only database with result: %d.", *result);
+    return NULL;
+  }
+  self.readerConnection = db;
+  return db;
+}
+
+- (void)closeReaderConnection {
+  void (^closeBlock)(void) = ^{
+    [MSACDBStorage finalizeStatements:self.readerCachedStatements];
+    if (self.readerConnection) {
+      sqlite3_close(self.readerConnection);
+      self.readerConnection = NULL;
+    }
+  };
+
+  // Wait for the reads in progress.
+  if (self.readerQueue) {
+    dispatch_sync((dispatch_queue_t _Nonnull)self.readerQueue, closeBlock);
+  } else {
+    closeBlock();
+  }
+}
+
+- (void)enableIncrementalVacuumWithMaxPagesCount:(NSUInteger)maxPagesCount
+                                       idleDelay:(NSTimeInterval)idleDelay
+                                           queue:(dispatch_queue_t)queue {
+  self.incrementalVacuumMaxPagesCount = maxPagesCount;
+  self.incrementalVacuumIdleDelay = idleDelay;
+  self.incrementalVacuumQueue = queue;
+
+  // Rewriting the whole file is kept out of the launch path.
+  if (self.needsVacuum) {
+    [self scheduleIncrementalVacuum];
+  }
+}
+
+- (void)scheduleIncrementalVacuum {
+  if (!self.incrementalVacuumQueue || self.incrementalVacuumMaxPagesCount == 0) {
+    return;
+  }
+  [self resetIncrementalVacuumTimer];
+  self.incrementalVacuumTimerSource =
+      dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, (dispatch_queue_t _Nonnull)self.incrementalVacuumQueue);
+  dispatch_time_t start = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(NSEC_PER_SEC * self.incrementalVacuumIdleDelay));
+  dispatch_source_set_timer(self.incrementalVacuumTimerSource, start, DISPATCH_TIME_FOREVER, NSEC_PER_SEC);
+  __weak typeof(self) weakSelf = self;
+  dispatch_source_set_event_handler(self.incrementalVacuumTimerSource, ^{
+    typeof(self) strongSelf = weakSelf;
+    [strongSelf vacuumIncrementally];
+  });
+  dispatch_resume(self.incrementalVacuumTimerSource);
+}
+
+- (void)resetIncrementalVacuumTimer {
+  if (self.incrementalVacuumTimerSource) {
+    dispatch_source_cancel(self.incrementalVacuumTimerSource);
+    self.incrementalVacuumTimerSource = nil;
+  }
+}
+
+- (long)vacuumIncrementally {
+  [self resetIncrementalVacuumTimer];
+  __block long freedPageCount = 0;
+  __block long freePageCount = 0;
+  [self executeQueryUsingBlock:^int(void *db) {
+    if (self.needsVacuum) {
+
+      // The setting is not persisted until the database is vacuumed, it must be set again on this connection.
+      MSACLogDebug([MSACAppCenter logTag], @"Vacuuming database to enable incremental vacuum.");
+      [self commitPendingTransactionInOpenedDatabase:db];
+      [MSACDBStorage executeSelectionQuery:@"PRAGMA auto_vacuum = INCREMENTAL;" inOpenedDatabase:db withValues:nil];
+      int result = [MSACDBStorage executeNonSelectionQuery:@"VACUUM" inOpenedDatabase:db];
+      if (result == SQLITE_OK) {
+        self.needsVacuum = NO;
+      } else {
+        MSACLogWarning([MSACAppCenter logTag], @"Failed to vacuum database, result=%d.", result);
+      }
+      return result;
+    }
+
+    // The pragma returns a row for each freed page.
+    long initialFreePageCount = [MSACDBStorage getFreePageCountInOpenedDatabase:db];
+    if (initialFreePageCount == 0) {
+      return SQLITE_OK;
+    }
+    NSString *query = [NSString stringWithFormat:@"PRAGMA incremental_vacuum(%tu);", self.incrementalVacuumMaxPagesCount];
+    [MSACDBStorage executeSelectionQuery:query inOpenedDatabase:db withValues:nil];
+    freePageCount = [MSACDBStorage getFreePageCountInOpenedDatabase:db];
+    freedPageCount = initialFreePageCount - freePageCount;
+    MSACLogVerbose([MSACAppCenter logTag], @"Freed %ld unused page(s), %ld unused page(s) left out of %ld page(s).", freedPageCount,
+                   freePageCount, [MSACDBStorage getPageCountInOpenedDatabase:db]);
+    return SQLITE_OK;
+  }];
+
+  // Keep freeing pages while idle, as long as it makes progress.
+  if (freedPageCount > 0 && freePageCount > 0) {
+    [self scheduleIncrementalVacuum];
+  }
+  return freedPageCount;
+}
+
+- (void)enableIncrementalMigrationWithChunkSize:(NSUInteger)chunkSize queue:(dispatch_queue_t)queue {
+  self.incrementalMigrationChunkSize = chunkSize;
+  self.incrementalMigrationQueue = queue;
+  [self scheduleIncrementalMigration];
+}
+
+- (void)scheduleIncrementalMigration {
+  if (!self.incrementalMigrationQueue || self.incrementalMigrationChunkSize == 0) {
+    return;
+  }
+
+  // Each chunk is migrated on its own, the work queued in between isn't delayed by the whole migration.
+  __weak typeof(self) weakSelf = self;
+  dispatch_async((dispatch_queue_t _Nonnull)self.incrementalMigrationQueue, ^{
+    typeof(self) strongSelf = weakSelf;
+    if ([strongSelf migrateIncrementally]) {
+      [strongSelf scheduleIncrementalMigration];
+    }
+  });
+}
+
+- (void)resumeIncrementalMigration {
+  if (!self.incrementalMigrationWaitingForRoom) {
+    return;
+  }
+  self.incrementalMigrationWaitingForRoom = NO;
+  [self scheduleIncrementalMigration];
+}
+
+- (BOOL)migrateIncrementally {
+  __block BOOL rowsLeft = NO;
+  NSUInteger chunkSize = MAX(self.incrementalMigrationChunkSize, 1);
+  [self executeQueryUsingBlock:^int(void *db) {
+    if (![MSACDBStorage tableExists:kMSACMigrationsTableName inOpenedDatabase:db]) {
+      return SQLITE_OK;
+    }
+    NSString *migrationQuery = [NSString stringWithFormat:@"SELECT \"%@\", \"%@\", \"%@\", \"%@\" FROM \"%@\" LIMIT 1",
+                                                          kMSACMigrationTableColumnName, kMSACMigrationStagedTableColumnName,
+                                                          kMSACMigrationVersionColumnName, kMSACMigrationLastRowIdColumnName,
+                                                          kMSACMigrationsTableName];
+    NSArray<NSArray *> *migrations = [MSACDBStorage executeSelectionQuery:migrationQuery inOpenedDatabase:db withValues:nil];
+    if (migrations.count == 0) {
+      return SQLITE_OK;
+    }
+    NSString *tableName = migrations[0][0];
+    NSString *stagedTableName = migrations[0][1];
+    NSUInteger version = [(NSNumber *)migrations[0][2] unsignedIntegerValue];
+    int64_t lastRowId = [(NSNumber *)migrations[0][3] longLongValue];
+
+    // The chunk and the progress are committed together, a migration killed in the middle resumes from the last committed chunk.
+    [self commitPendingTransactionInOpenedDatabase:db];
+    int result = [self executeCachedNonSelectionQuery:@"BEGIN IMMEDIATE" inOpenedDatabase:db withValues:nil];
+    if (result != SQLITE_OK) {
+      MSACLogWarning([MSACAppCenter logTag], @"Failed to begin the migration of table \"%@\", result=%d.", tableName, result);
+      return result;
+    }
+    NSString *chunkQuery = [NSString
+        stringWithFormat:@"SELECT MAX(\"rowid\") FROM (SELECT \"rowid\" FROM \"%@\" WHERE \"rowid\" > ? ORDER BY \"rowid\" LIMIT ?)",
+                         stagedTableName];
+    MSACStorageBindableArray *chunkValues = [MSACStorageBindableArray new];
+    [chunkValues addNumber:@(lastRowId)];
+    [chunkValues addNumber:@(chunkSize)];
+    NSArray<NSArray *> *chunkRows = [MSACDBStorage executeSelectionQuery:chunkQuery inOpenedDatabase:db withValues:chunkValues];
+    id chunkLastRowId = chunkRows.count > 0 && chunkRows[0].count > 0 ? chunkRows[0][0] : [NSNull null];
+    if ([chunkLastRowId isKindOfClass:[NSNumber class]]) {
+      result = [self migrateRowsOfStagedTable:stagedTableName
+                                      toTable:tableName
+                                  fromVersion:version
+                                    fromRowId:lastRowId + 1
+                                      toRowId:[(NSNumber *)chunkLastRowId longLongValue]
+                             inOpenedDatabase:db];
+      if (result == SQLITE_OK) {
+        result = [self recordMigrationOfTable:tableName
+                                  stagedTable:stagedTableName
+                                    lastRowId:[(NSNumber *)chunkLastRowId longLongValue]
+                             inOpenedDatabase:db];
+        rowsLeft = YES;
+      }
+    } else {
+      result = [self completeMigrationOfTable:tableName stagedTable:stagedTableName inOpenedDatabase:db];
+    }
+    if (result == SQLITE_OK) {
+      result = [self executeCachedNonSelectionQuery:@"COMMIT" inOpenedDatabase:db withValues:nil];
+    }
+    if (result == SQLITE_OK) {
+      if (!rowsLeft) {
+        MSACLogInfo([MSACAppCenter logTag], @"Migrated table \"%@\" from version %tu.", tableName, version);
+      }
+      return result;
+    }
+    rowsLeft = NO;
+    if (!sqlite3_get_autocommit(db)) {
+      [MSACDBStorage executeNonSelectionQuery:@"ROLLBACK" inOpenedDatabase:db];
+    }
+    [self transactionDidRollBack];
+
+    // The chunk is kept in the staged table, it is migrated again once logs have been deleted.
+    if (result == SQLITE_FULL) {
+      MSACLogWarning([MSACAppCenter logTag], @"Storage is full; migration of table \"%@\" resumes once room is made.", tableName);
+      self.incrementalMigrationWaitingForRoom = YES;
+    } else {
+      MSACLogError([MSACAppCenter logTag], @"Failed to migrate table \"%@\", result=%d.", tableName, result);
+    }
+    return result;
+  }];
+  return rowsLeft;
+}
+
+- (int)recordMigrationOfTable:(NSString *)tableName
+                  stagedTable:(NSString *)stagedTableName
+                    lastRowId:(int64_t)lastRowId
+             inOpenedDatabase:(void *)db {
+
+  // Migrated rows are deleted right away so that their pages can be reused by the rows of the next chunks.
+  NSString *deleteQuery = [NSString stringWithFormat:@"DELETE FROM \"%@\" WHERE \"rowid\" <= ?", stagedTableName];
+  MSACStorageBindableArray *deleteValues = [MSACStorageBindableArray new];
+  [deleteValues addNumber:@(lastRowId)];
+  int result = [MSACDBStorage executeNonSelectionQuery:deleteQuery inOpenedDatabase:db withValues:deleteValues];
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  NSString *progressQuery = [NSString stringWithFormat:@"UPDATE \"%@\" SET \"%@\" = ? WHERE \"%@\" = ?", kMSACMigrationsTableName,
+                                                       kMSACMigrationLastRowIdColumnName, kMSACMigrationTableColumnName];
+  MSACStorageBindableArray *progressValues = [MSACStorageBindableArray new];
+  [progressValues addNumber:@(lastRowId)];
+  [progressValues addString:tableName];
+  return [MSACDBStorage executeNonSelectionQuery:progressQuery inOpenedDatabase:db withValues:progressValues];
+}
+
+- (int)completeMigrationOfTable:(NSString *)tableName stagedTable:(NSString *)stagedTableName inOpenedDatabase:(void *)db {
+  NSString *dropQuery = [NSString stringWithFormat:@"DROP TABLE IF EXISTS \"%@\"", stagedTableName];
+  int result = [MSACDBStorage executeNonSelectionQuery:dropQuery inOpenedDatabase:db];
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  NSString *deleteQuery =
+      [NSString stringWithFormat:@"DELETE FROM \"%@\" WHERE \"%@\" = ?", kMSACMigrationsTableName, kMSACMigrationTableColumnName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addString:tableName];
+  return [MSACDBStorage executeNonSelectionQuery:deleteQuery inOpenedDatabase:db withValues:values];
+}
+
+- (int)migrateRowsOfStagedTable:(NSString *)stagedTableName
+                        toTable:(NSString *)tableName
+                    fromVersion:(__unused NSUInteger)version
+                      fromRowId:(int64_t)firstRowId
+                        toRowId:(int64_t)lastRowId
+               inOpenedDatabase:(void *)db {
+
+  // Copy the columns both schemas have in common.
+  NSArray<NSString *> *stagedColumnNames = [MSACDBStorage columnNamesOfTable:stagedTableName inOpenedDatabase:db];
+  NSMutableArray<NSString *> *columnNames = [NSMutableArray new];
+  for (NSString *columnName in [MSACDBStorage columnNamesOfTable:tableName inOpenedDatabase:db]) {
+    if ([stagedColumnNames containsObject:columnName]) {
+      [columnNames addObject:[NSString stringWithFormat:@"\"%@\"", columnName]];
+    }
+  }
+  NSString *columns = [columnNames componentsJoinedByString:@", "];
+  NSString *query =
+      [NSString stringWithFormat:@"INSERT INTO \"%@\" (%@) SELECT %@ FROM \"%@\" WHERE \"rowid\" BETWEEN ? AND ? ORDER BY \"rowid\"",
+                                 tableName, columns, columns, stagedTableName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addNumber:@(firstRowId)];
+  [values addNumber:@(lastRowId)];
+  return [MSACDBStorage executeNonSelectionQuery:query inOpenedDatabase:db withValues:values];
+}
+
+- (int)commitPendingTransaction {
+  if (!self.connection) {
+    return SQLITE_OK;
+  }
+  return [self commitPendingTransactionInOpenedDatabase:self.connection];
+}
+
+- (int)commitPendingTransactionInOpenedDatabase:(void *)db {
+  [self resetGroupCommitTimer];
+  NSUInteger changesCount = self.pendingTransactionChangesCount;
+  self.pendingTransactionChangesCount = 0;
+  if (sqlite3_get_autocommit(db)) {
+    return SQLITE_OK;
+  }
+  int result = [self executeCachedNonSelectionQuery:@"COMMIT" inOpenedDatabase:db withValues:nil];
+  if (result == SQLITE_OK) {
+    MSACLogVerbose([MSACAppCenter logTag], @"Committed %tu grouped change(s).", changesCount);
+    [self transactionDidCommit];
+  } else {
+    MSACLogError([MSACAppCenter logTag], @"Failed to commit %tu grouped change(s), result=%d.", changesCount, result);
+    if (!sqlite3_get_autocommit(db)) {
+      [MSACDBStorage executeNonSelectionQuery:@"ROLLBACK" inOpenedDatabase:db];
+    }
+    [self transactionDidRollBack];
+  }
+  return result;
+}
+
+- (void)startGroupCommitTimer {
+  [self resetGroupCommitTimer];
+  self.groupCommitTimerSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, (dispatch_queue_t _Nonnull)self.groupCommitQueue);
+  dispatch_source_set_timer(self.groupCommitTimerSource, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(NSEC_PER_SEC * self.groupCommitWindow)),
+                            DISPATCH_TIME_FOREVER, NSEC_PER_MSEC);
+  __weak typeof(self) weakSelf = self;
+  dispatch_source_set_event_handler(self.groupCommitTimerSource, ^{
+    typeof(self) strongSelf = weakSelf;
+    [strongSelf commitPendingTransaction];
+  });
+  dispatch_resume(self.groupCommitTimerSource);
+}
+
+- (void)resetGroupCommitTimer {
+  if (self.groupCommitTimerSource) {
+    dispatch_source_cancel(self.groupCommitTimerSource);
+    self.groupCommitTimerSource = nil;
+  }
+}
+
+- (sqlite3 *)openConnectionWithResult:(int *)result {
+  if (self.connection) {
+    *result = SQLITE_OK;
+    return self.connection;
+  }
+  sqlite3 *db = [self openDatabaseWithFlags:SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE
+                             cacheSizeInKiB:self.profile.cacheSizeInKiB
+                                     result:result];
+  if (!db) {
+    MSACLogError([MSACAppCenter logTag], @"Failed to open database with result: %d.", *result);
+    return NULL;
+  }
   if (self.pageSize == 0) {
     MSACLogError([MSACAppCenter logTag], @"The database was not configured correctly. The page size is expected to be non zero.");
     sqlite3_close(db);
-    return SQLITE_ERROR;
+    *result = SQLITE_ERROR;
+    return NULL;
   }
-    
-  // The value is stored as part of the database connection and must be reset every time the database is opened.
+
+  // The value is stored as part of the database connection, it's applied once for the lifetime of the connection.
   long maxPageCount = self.maxSizeInBytes / self.pageSize;
-  result = [MSACDBStorage setMaxPageCount:maxPageCount inOpenedDatabase:db];
+  *result = [MSACDBStorage setMaxPageCount:maxPageCount inOpenedDatabase:db];
 
-  // Do not proceed with the query if the database is corrupted.
-  if (result == SQLITE_CORRUPT || result == SQLITE_NOTADB) {
+  // Do not keep the connection if the database is corrupted.
+  if (*result == SQLITE_CORRUPT || *result == SQLITE_NOTADB) {
     sqlite3_close(db);
-    return result;
+    return NULL;
   }
 
   // Log a warning if max page count can't be set.
-  if (result != SQLITE_OK) {
+  if (*result != SQLITE_OK) {
     MSACLogError([MSACAppCenter logTag], @"Failed to open database with specified maximum size constraint.");
+    *result = SQLITE_OK;
+  }
+  self.connection = db;
+  [self applyDurabilityInOpenedDatabase:db];
+  return db;
+}
+
+- (void)setDurability:(MSACStorageDurability)durability {
+  _durability = durability;
+  if (self.connection) {
+    [self commitPendingTransaction];
+
+    // Leaving the write-ahead log requires the long-lived connection to be the only one.
+    [self closeReaderConnection];
+    [self applyDurabilityInOpenedDatabase:self.connection];
+  }
+}
+
+- (void)applyDurabilityInOpenedDatabase:(void *)db {
+  BOOL enableWAL = self.durability == MSACStorageDurabilityDefault;
+
+  // Journal mode is persisted in the database file, it can only be switched while no transaction is pending.
+  NSString *query = [NSString stringWithFormat:@"PRAGMA journal_mode = %@", enableWAL ? @"WAL" : @"DELETE"];
+  NSArray<NSArray *> *rows = [MSACDBStorage executeSelectionQuery:query inOpenedDatabase:db withValues:nil];
+  NSString *journalMode = rows.count > 0 && rows[0].count > 0 ? rows[0][0] : nil;
+  self.walEnabled = [journalMode isKindOfClass:[NSString class]] && [journalMode caseInsensitiveCompare:@"wal"] == NSOrderedSame;
+  if (self.walEnabled != enableWAL) {
+    MSACLogWarning([MSACAppCenter logTag], @"Failed to change database journal mode, current mode is \"%@\".", journalMode);
+  }
+  if (self.walEnabled) {
+
+    /*
+     * Normal logs are synced to disk along with checkpoints, a commit can only be lost on power loss, not on app crash.
+     * The write-ahead log is checkpointed when it reaches the given size and truncated back to that size after checkpoints.
+     */
+    [MSACDBStorage executeNonSelectionQuery:@"PRAGMA synchronous = NORMAL" inOpenedDatabase:db];
+    sqlite3_wal_autocheckpoint(db, kMSACWALAutoCheckpointPageCount);
+    query = [NSString stringWithFormat:@"PRAGMA journal_size_limit = %ld", kMSACWALAutoCheckpointPageCount * self.pageSize];
+    [MSACDBStorage executeSelectionQuery:query inOpenedDatabase:db withValues:nil];
+    self.lastCheckpointTime = [[NSDate date] timeIntervalSince1970];
+    self.changesAtLastCheckpoint = sqlite3_total_changes(db);
+  } else {
+    [MSACDBStorage executeNonSelectionQuery:@"PRAGMA synchronous = FULL" inOpenedDatabase:db];
+  }
+}
+
+- (void)checkpointIfNeededInOpenedDatabase:(void *)db {
+  if (!self.walEnabled || db != self.connection || !sqlite3_get_autocommit(db)) {
+    return;
+  }
+  int changes = sqlite3_total_changes(db);
+  NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+  if (changes == self.changesAtLastCheckpoint || now - self.lastCheckpointTime < kMSACWALCheckpointInterval) {
+    return;
+  }
+  [MSACDBStorage checkpointWithMode:SQLITE_CHECKPOINT_PASSIVE inOpenedDatabase:db];
+  self.lastCheckpointTime = now;
+  self.changesAtLastCheckpoint = changes;
+}
+
++ (int)checkpointWithMode:(int)mode inOpenedDatabase:(void *)db {
+  int logPageCount = 0;
+  int checkpointedPageCount = 0;
+  int result = sqlite3_wal_checkpoint_v2(db, NULL, mode, &logPageCount, &checkpointedPageCount);
+  if (result == SQLITE_OK) {
+    MSACLogVerbose([MSACAppCenter logTag], @"Checkpointed %d out of %d page(s) of the write-ahead log.", checkpointedPageCount,
+                   logPageCount);
+  } else {
+    MSACLogWarning([MSACAppCenter logTag], @"Failed to checkpoint the write-ahead log, result=%d.", result);
   }
-  result = callback(db);
-  sqlite3_close(db);
   return result;
 }
 
+- (void)closeConnection {
+  [self closeReaderConnection];
+  [self commitPendingTransaction];
+  [self finalizeCachedStatements];
+  if (self.connection) {
+    int result = sqlite3_close(self.connection);
+    if (result != SQLITE_OK) {
+      MSACLogError([MSACAppCenter logTag], @"Failed to close database with result: %d.", result);
+    }
+    self.connection = NULL;
+    self.walEnabled = NO;
+  }
+}
+
+- (void)finalizeCachedStatements {
+  [MSACDBStorage finalizeStatements:self.cachedStatements];
+}
+
++ (void)finalizeStatements:(NSMutableDictionary<NSString *, NSValue *> *)statements {
+  for (NSValue *statement in [statements allValues]) {
+    sqlite3_finalize([statement pointerValue]);
+  }
+  [statements removeAllObjects];
+}
+
 - (void)dropDatabase {
+  [self closeConnection];
   BOOL result = [MSACUtility deleteFileAtURL:self.dbFileURL];
   if (result) {
     MSACLogVerbose([MSACAppCenter logTag], @"Database %@ has been deleted.", (NSString * _Nonnull) self.dbFileURL.absoluteString);
   } else {
     MSACLogError([MSACAppCenter logTag], @"Failed to delete database.");
   }
+
+  // Remove the write-ahead log and its index if they were left over.
+  NSURL *directoryURL = [self.dbFileURL URLByDeletingLastPathComponent];
+  for (NSString *suffix in @[ @"-wal", @"-shm" ]) {
+    NSURL *fileURL = [directoryURL URLByAppendingPathComponent:[self.dbFileURL.lastPathComponent stringByAppendingString:suffix]];
+    if ([[NSFileManager defaultManager] fileExistsAtPath:(NSString * _Nonnull) fileURL.path]) {
+      [MSACUtility deleteFileAtURL:fileURL];
+    }
+  }
 }
 
 - (BOOL)dropTable:(NSString *)tableName {
+
+  // Statements prepared against the table would prevent it from being dropped.
+  [self finalizeCachedStatements];
   return [self executeQueryUsingBlock:^int(void *db) {
            if ([MSACDBStorage tableExists:tableName inOpenedDatabase:db]) {
              NSString *deleteQuery = [NSString stringWithFormat:@"DROP TABLE \"%@\";", tableName];
@@ -224,6 +787,36 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
   return result;
 }
 
++ (int)addMissingColumnsToTable:(NSString *)tableName columnsSchema:(MSACDBColumnsSchema *)columnsSchema inOpenedDatabase:(void *)db {
+  int result = SQLITE_OK;
+  NSString *tableInfoQuery = [NSString stringWithFormat:@"PRAGMA table_info(\"%@\")", tableName];
+  NSArray<NSArray *> *columns = [self executeSelectionQuery:tableInfoQuery inOpenedDatabase:db result:&result withValues:nil];
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  // The column name is the second column of the table info.
+  NSMutableSet<NSString *> *existingColumnNames = [NSMutableSet new];
+  for (NSArray *column in columns) {
+    [existingColumnNames addObject:column[1]];
+  }
+  for (NSDictionary<NSString *, NSArray<NSString *> *> *column in columnsSchema) {
+    NSString *columnName = column.allKeys[0];
+    if ([existingColumnNames containsObject:columnName]) {
+      continue;
+    }
+    NSString *alterQuery = [NSString stringWithFormat:@"ALTER TABLE \"%@\" ADD COLUMN \"%@\" %@", tableName, columnName,
+                                                      [column[columnName] componentsJoinedByString:@" "]];
+    result = [self executeNonSelectionQuery:alterQuery inOpenedDatabase:db];
+    if (result != SQLITE_OK) {
+      MSACLogError([MSACAppCenter logTag], @"Failed to add column %@ to table %@", columnName, tableName);
+      return result;
+    }
+    MSACLogVerbose([MSACAppCenter logTag], @"Column %@ has been added to table %@", columnName, tableName);
+  }
+  return result;
+}
+
 + (NSDictionary *)columnsIndexes:(MSACDBSchema *)schema {
   NSMutableDictionary *dbColumnsIndexes = [NSMutableDictionary new];
   for (NSString *tableName in schema) {
@@ -238,6 +831,79 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
   return dbColumnsIndexes;
 }
 
++ (int)stageTable:(NSString *)tableName forMigrationFromVersion:(NSUInteger)version inOpenedDatabase:(void *)db {
+  NSString *stagedTableName = [self stagedTableNameForTable:tableName fromVersion:version];
+
+  // The table has already been staged by a process killed before the database version was updated.
+  if ([MSACDBStorage tableExists:stagedTableName inOpenedDatabase:db]) {
+    return SQLITE_OK;
+  }
+  NSString *createQuery = [NSString
+      stringWithFormat:@"CREATE TABLE IF NOT EXISTS \"%@\" (\"%@\" TEXT PRIMARY KEY, \"%@\" TEXT NOT NULL, \"%@\" INTEGER NOT NULL, "
+                       @"\"%@\" INTEGER NOT NULL)",
+                       kMSACMigrationsTableName, kMSACMigrationTableColumnName, kMSACMigrationStagedTableColumnName,
+                       kMSACMigrationVersionColumnName, kMSACMigrationLastRowIdColumnName];
+  NSString *renameQuery = [NSString stringWithFormat:@"ALTER TABLE \"%@\" RENAME TO \"%@\"", tableName, stagedTableName];
+  NSString *recordQuery =
+      [NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\", \"%@\", \"%@\") VALUES (?, ?, ?, 0)", kMSACMigrationsTableName,
+                                 kMSACMigrationTableColumnName, kMSACMigrationStagedTableColumnName, kMSACMigrationVersionColumnName,
+                                 kMSACMigrationLastRowIdColumnName];
+  MSACStorageBindableArray *recordValues = [MSACStorageBindableArray new];
+  [recordValues addString:tableName];
+  [recordValues addString:stagedTableName];
+  [recordValues addNumber:@(version)];
+
+  // Renaming doesn't depend on the number of rows, the rows are migrated later on.
+  int result = [MSACDBStorage executeNonSelectionQuery:@"BEGIN IMMEDIATE" inOpenedDatabase:db];
+  if (result == SQLITE_OK) {
+    result = [MSACDBStorage executeNonSelectionQuery:createQuery inOpenedDatabase:db];
+  }
+
+  // Indexes and triggers follow the renamed table, they would prevent the new table from getting its own under the same names.
+  if (result == SQLITE_OK) {
+    NSString *dependentsQuery = @"SELECT \"type\", \"name\" FROM \"sqlite_master\" WHERE \"tbl_name\" = ? AND \"type\" IN ('index', "
+                                @"'trigger') AND \"sql\" IS NOT NULL";
+    MSACStorageBindableArray *dependentsValues = [MSACStorageBindableArray new];
+    [dependentsValues addString:tableName];
+    for (NSArray *row in [MSACDBStorage executeSelectionQuery:dependentsQuery inOpenedDatabase:db withValues:dependentsValues]) {
+      NSString *dropQuery = [NSString stringWithFormat:@"DROP %@ IF EXISTS \"%@\"", [row[0] uppercaseString], row[1]];
+      result = [MSACDBStorage executeNonSelectionQuery:dropQuery inOpenedDatabase:db];
+      if (result != SQLITE_OK) {
+        break;
+      }
+    }
+  }
+  if (result == SQLITE_OK) {
+    result = [MSACDBStorage executeNonSelectionQuery:renameQuery inOpenedDatabase:db];
+  }
+  if (result == SQLITE_OK) {
+    result = [MSACDBStorage executeNonSelectionQuery:recordQuery inOpenedDatabase:db withValues:recordValues];
+  }
+  if (result == SQLITE_OK) {
+    result = [MSACDBStorage executeNonSelectionQuery:@"COMMIT" inOpenedDatabase:db];
+  }
+  if (result != SQLITE_OK) {
+    MSACLogError([MSACAppCenter logTag], @"Failed to stage table \"%@\" for migration, result=%d.", tableName, result);
+    if (!sqlite3_get_autocommit(db)) {
+      [MSACDBStorage executeNonSelectionQuery:@"ROLLBACK" inOpenedDatabase:db];
+    }
+  }
+  return result;
+}
+
++ (NSString *)stagedTableNameForTable:(NSString *)tableName fromVersion:(NSUInteger)version {
+  return [NSString stringWithFormat:@"%@_v%tu", tableName, version];
+}
+
++ (NSArray<NSString *> *)columnNamesOfTable:(NSString *)tableName inOpenedDatabase:(void *)db {
+  NSString *query = [NSString stringWithFormat:@"PRAGMA table_info(\"%@\")", tableName];
+  NSMutableArray<NSString *> *columnNames = [NSMutableArray new];
+  for (NSArray *row in [MSACDBStorage executeSelectionQuery:query inOpenedDatabase:db withValues:nil]) {
+    [columnNames addObject:row[1]];
+  }
+  return columnNames;
+}
+
 + (BOOL)tableExists:(NSString *)tableName inOpenedDatabase:(void *)db {
   return [MSACDBStorage tableExists:tableName inOpenedDatabase:db result:nil];
 }
@@ -265,26 +931,18 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
   [MSACDBStorage executeSelectionQuery:query inOpenedDatabase:db withValues:nil];
 }
 
-+ (void)enableAutoVacuumInOpenedDatabase:(void *)db {
-  NSArray<NSArray *> *result = [MSACDBStorage executeSelectionQuery:@"PRAGMA auto_vacuum" inOpenedDatabase:db withValues:nil];
-  int vacuumMode = 0;
-  if (result.count > 0 && result[0].count > 0) {
-    vacuumMode = [(NSNumber *)result[0][0] intValue];
++ (BOOL)enableIncrementalVacuumInOpenedDatabase:(void *)db {
+  if ([MSACDBStorage querySingleValue:@"PRAGMA auto_vacuum;" inOpenedDatabase:db] == kMSACAutoVacuumIncremental) {
+    return NO;
   }
-  BOOL autoVacuumDisabled = vacuumMode != 1;
 
   /*
-   * If `auto_vacuum` is disabled, change it to `FULL` and then manually `VACUUM` the database. Per the SQLite docs, changing the state of
-   * `auto_vacuum` must be followed by a manual `VACUUM` before the change can take effect (for more information,
-   * see https://www.sqlite.org/pragma.html#pragma_auto_vacuum).
+   * Switching from `FULL` to `INCREMENTAL` takes effect right away, as does enabling auto vacuum before any table is created. Otherwise
+   * the change only takes effect after a manual `VACUUM` of the database (for more information,
+   * see https://www.sqlite.org/pragma.html#pragma_auto_vacuum). We use a selection query here because pragma set returns a value.
    */
-  if (autoVacuumDisabled) {
-    MSACLogDebug([MSACAppCenter logTag], @"Vacuuming database and enabling auto_vacuum");
-
-    // We use a selection query here because pragma set returns a value.
-    [MSACDBStorage executeSelectionQuery:@"PRAGMA auto_vacuum = FULL;" inOpenedDatabase:db withValues:nil];
-    [MSACDBStorage executeSelectionQuery:@"VACUUM;" inOpenedDatabase:db withValues:nil];
-  }
+  [MSACDBStorage executeSelectionQuery:@"PRAGMA auto_vacuum = INCREMENTAL;" inOpenedDatabase:db withValues:nil];
+  return [MSACDBStorage querySingleValue:@"PRAGMA auto_vacuum;" inOpenedDatabase:db] != kMSACAutoVacuumIncremental;
 }
 
 - (NSUInteger)countEntriesForTable:(NSString *)tableName
@@ -294,7 +952,11 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
   if (condition.length > 0) {
     [countLogQuery appendFormat:@"WHERE %@", condition];
   }
-  NSArray<NSArray<NSNumber *> *> *result = [self executeSelectionQuery:countLogQuery withValues:values];
+  __block NSArray<NSArray<NSNumber *> *> *result = nil;
+  [self executeQueryUsingBlock:^int(void *db) {
+    result = [self executeCachedSelectionQuery:countLogQuery inOpenedDatabase:db withValues:values];
+    return SQLITE_OK;
+  }];
   return (result.count > 0) ? result[0][0].unsignedIntegerValue : 0;
 }
 
@@ -313,25 +975,37 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
 }
 
 + (int)executeNonSelectionQuery:(NSString *)query inOpenedDatabase:(void *)db withValues:(nullable MSACStorageBindableArray *)values {
-  return [MSACDBStorage
-          executeQuery:query
-      inOpenedDatabase:db
-            withValues:values
-            usingBlock:^(void *statement) {
-              int stepResult = sqlite3_step(statement);
-              if (stepResult == SQLITE_DONE) {
-                return SQLITE_OK;
-              }
-              NSString *errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg(db)];
-              if (stepResult == SQLITE_CORRUPT || stepResult == SQLITE_NOTADB) {
-                MSACLogError([MSACAppCenter logTag], @"A database file is corrupted, result=%d\n\t%@", stepResult, errorMessage);
-              } else if (stepResult == SQLITE_FULL) {
-                MSACLogDebug([MSACAppCenter logTag], @"Query failed with error: %d\n\t%@", stepResult, errorMessage);
-              } else {
-                MSACLogError([MSACAppCenter logTag], @"Could not execute the statement, result=%d\n\t%@", stepResult, errorMessage);
-              }
-              return stepResult;
-            }];
+  return [MSACDBStorage executeQuery:query
+                    inOpenedDatabase:db
+                          withValues:values
+                          usingBlock:^(void *statement) {
+                            return [MSACDBStorage stepNonSelectionStatement:statement inOpenedDatabase:db];
+                          }];
+}
+
+- (int)executeCachedNonSelectionQuery:(NSString *)query inOpenedDatabase:(void *)db withValues:(nullable MSACStorageBindableArray *)values {
+  return [self executeCachedQuery:query
+                 inOpenedDatabase:db
+                       withValues:values
+                       usingBlock:^(void *statement) {
+                         return [MSACDBStorage stepNonSelectionStatement:statement inOpenedDatabase:db];
+                       }];
+}
+
++ (int)stepNonSelectionStatement:(void *)statement inOpenedDatabase:(void *)db {
+  int stepResult = sqlite3_step(statement);
+  if (stepResult == SQLITE_DONE) {
+    return SQLITE_OK;
+  }
+  NSString *errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg(db)];
+  if (stepResult == SQLITE_CORRUPT || stepResult == SQLITE_NOTADB) {
+    MSACLogError([MSACAppCenter logTag], @"A database file is corrupted, result=%d\n\t%@", stepResult, errorMessage);
+  } else if (stepResult == SQLITE_FULL) {
+    MSACLogDebug([MSACAppCenter logTag], @"Query failed with error: %d\n\t%@", stepResult, errorMessage);
+  } else {
+    MSACLogError([MSACAppCenter logTag], @"Could not execute the statement, result=%d\n\t%@", stepResult, errorMessage);
+  }
+  return stepResult;
 }
 
 + (int)executeQuery:(NSString *)query
@@ -357,6 +1031,44 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
   return result;
 }
 
+- (int)executeCachedQuery:(NSString *)query
+         inOpenedDatabase:(void *)db
+               withValues:(nullable MSACStorageBindableArray *)values
+               usingBlock:(MSACDBStorageQueryBlock)block {
+
+  // Statements are bound to a connection, only the long-lived and the read-only ones have a cache.
+  NSMutableDictionary<NSString *, NSValue *> *cachedStatements = nil;
+  if (db == self.connection) {
+    cachedStatements = self.cachedStatements;
+  } else if (db == self.readerConnection) {
+    cachedStatements = self.readerCachedStatements;
+  } else {
+    return [MSACDBStorage executeQuery:query inOpenedDatabase:db withValues:values usingBlock:block];
+  }
+  sqlite3_stmt *statement = [cachedStatements[query] pointerValue];
+  if (!statement) {
+    if (cachedStatements.count >= kMSACMaxCachedStatementsCount) {
+      return [MSACDBStorage executeQuery:query inOpenedDatabase:db withValues:values usingBlock:block];
+    }
+    int result = sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+    if (result != SQLITE_OK) {
+      NSString *errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg(db)];
+      MSACLogError([MSACAppCenter logTag], @"Failed to prepare SQLite statement, result=%d\n\t%@", result, errorMessage);
+      return result;
+    }
+    cachedStatements[query] = [NSValue valueWithPointer:statement];
+  }
+  int result = [values bindAllValuesWithStatement:statement inOpenedDatabase:db];
+  if (result == SQLITE_OK) {
+    result = block(statement);
+  }
+
+  // Make the statement ready for the next execution, the step result has already been reported by the block.
+  sqlite3_reset(statement);
+  sqlite3_clear_bindings(statement);
+  return result;
+}
+
 - (NSArray<NSArray *> *)executeSelectionQuery:(NSString *)query withValues:(nullable MSACStorageBindableArray *)values {
   __block NSArray<NSArray *> *entries = nil;
   [self executeQueryUsingBlock:^int(void *db) {
@@ -377,37 +1089,113 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
                                        result:(int *)result
                                    withValues:(nullable MSACStorageBindableArray *)values {
   NSMutableArray<NSMutableArray *> *entries = [NSMutableArray<NSMutableArray *> new];
-  int queryResult =
-      [MSACDBStorage executeQuery:query
+  int queryResult = [MSACDBStorage executeQuery:query
+                               inOpenedDatabase:db
+                                     withValues:values
+                                     usingBlock:^(void *statement) {
+                                       return [MSACDBStorage stepSelectionStatement:statement inOpenedDatabase:db entries:entries];
+                                     }];
+  if (result) {
+    *result = queryResult;
+  }
+  return entries;
+}
+
+- (NSArray<NSArray *> *)executeCachedSelectionQuery:(NSString *)query
+                                   inOpenedDatabase:(void *)db
+                                         withValues:(nullable MSACStorageBindableArray *)values {
+  NSMutableArray<NSMutableArray *> *entries = [NSMutableArray<NSMutableArray *> new];
+  [self executeCachedQuery:query
+          inOpenedDatabase:db
+                withValues:values
+                usingBlock:^(void *statement) {
+                  return [MSACDBStorage stepSelectionStatement:statement inOpenedDatabase:db entries:entries];
+                }];
+  return entries;
+}
+
+- (int)enumerateRowsOfQuery:(NSString *)query
+                 withValues:(nullable MSACStorageBindableArray *)values
+                 usingBlock:(MSACDBStorageRowBlock)block {
+  return [self executeQueryUsingBlock:^int(void *db) {
+    return [MSACDBStorage enumerateRowsOfQuery:query inOpenedDatabase:db withValues:values usingBlock:block];
+  }];
+}
+
++ (int)enumerateRowsOfQuery:(NSString *)query
+           inOpenedDatabase:(void *)db
+                 withValues:(nullable MSACStorageBindableArray *)values
+                 usingBlock:(MSACDBStorageRowBlock)block {
+  return [MSACDBStorage executeQuery:query
+                    inOpenedDatabase:db
+                          withValues:values
+                          usingBlock:^(void *statement) {
+                            return [MSACDBStorage stepSelectionStatement:statement inOpenedDatabase:db usingBlock:block];
+                          }];
+}
+
+- (int)enumerateRowsOfCachedQuery:(NSString *)query
+                 inOpenedDatabase:(void *)db
+                       withValues:(nullable MSACStorageBindableArray *)values
+                       usingBlock:(MSACDBStorageRowBlock)block {
+  return [self executeCachedQuery:query
                  inOpenedDatabase:db
                        withValues:values
                        usingBlock:^(void *statement) {
-                         int stepResult;
-
-                         // Loop on rows.
-                         while ((stepResult = sqlite3_step(statement)) == SQLITE_ROW) {
-                           NSMutableArray *entry = [NSMutableArray new];
-
-                           // Loop on columns.
-                           for (int i = 0; i < sqlite3_column_count(statement); i++) {
-                             NSObject *value = [MSACDBStorage columnValueFromStatement:statement atIndex:i];
-                             [entry addObject:value];
-                           }
-                           if (entry.count > 0) {
-                             [entries addObject:entry];
-                           }
-                         }
-                         if (stepResult != SQLITE_DONE) {
-                           NSString *errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg(db)];
-                           MSACLogError([MSACAppCenter logTag], @"Query failed with error: %d\n\t%@", stepResult, errorMessage);
-                           return stepResult;
-                         }
-                         return SQLITE_OK;
+                         return [MSACDBStorage stepSelectionStatement:statement inOpenedDatabase:db usingBlock:block];
                        }];
-  if (result) {
-    *result = queryResult;
+}
+
+- (int)enumerateRowsOfQuery:(NSString *)query
+           inOpenedDatabase:(void *)db
+                 withValues:(nullable MSACStorageBindableArray *)values
+                     cached:(BOOL)cached
+                 usingBlock:(MSACDBStorageRowBlock)block {
+  if (cached) {
+    return [self enumerateRowsOfCachedQuery:query inOpenedDatabase:db withValues:values usingBlock:block];
   }
-  return entries;
+  return [MSACDBStorage enumerateRowsOfQuery:query inOpenedDatabase:db withValues:values usingBlock:block];
+}
+
++ (int)stepSelectionStatement:(void *)statement inOpenedDatabase:(void *)db usingBlock:(MSACDBStorageRowBlock)block {
+  int stepResult = SQLITE_DONE;
+  BOOL stop = NO;
+
+  // A single cursor reads all the rows.
+  MSACStorageCursor *cursor = [[MSACStorageCursor alloc] initWithStatement:statement];
+  while (!stop && (stepResult = sqlite3_step(statement)) == SQLITE_ROW) {
+    block(cursor, &stop);
+  }
+  if (!stop && stepResult != SQLITE_DONE) {
+    NSString *errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg(db)];
+    MSACLogError([MSACAppCenter logTag], @"Query failed with error: %d\n\t%@", stepResult, errorMessage);
+    return stepResult;
+  }
+  return SQLITE_OK;
+}
+
++ (int)stepSelectionStatement:(void *)statement inOpenedDatabase:(void *)db entries:(NSMutableArray<NSMutableArray *> *)entries {
+  int stepResult;
+
+  // Loop on rows.
+  while ((stepResult = sqlite3_step(statement)) == SQLITE_ROW) {
+    NSMutableArray *entry = [NSMutableArray new];
+
+    // Loop on columns.
+    for (int i = 0; i < sqlite3_column_count(statement); i++) {
+      NSObject *value = [MSACDBStorage columnValueFromStatement:statement atIndex:i];
+      [entry addObject:value];
+    }
+    if (entry.count > 0) {
+      [entries addObject:entry];
+    }
+  }
+  if (stepResult != SQLITE_DONE) {
+    NSString *errorMessage = [NSString stringWithUTF8String:sqlite3_errmsg(db)];
+    MSACLogError([MSACAppCenter logTag], @"Query failed with error: %d\n\t%@", stepResult, errorMessage);
+    return stepResult;
+  }
+  return SQLITE_OK;
 }
 
 + (NSObject *)columnValueFromStatement:(sqlite3_stmt *)statement atIndex:(int)index {
@@ -418,9 +1206,13 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
   int columnType = sqlite3_column_type(statement, index);
   switch (columnType) {
   case SQLITE_INTEGER:
-    return @(sqlite3_column_int(statement, index));
+    return @(sqlite3_column_int64(statement, index));
+  case SQLITE_FLOAT:
+    return @(sqlite3_column_double(statement, index));
   case SQLITE_TEXT:
     return [NSString stringWithUTF8String:(const char *)sqlite3_column_text(statement, index)];
+  case SQLITE_BLOB:
+    return [NSData dataWithBytes:sqlite3_column_blob(statement, index) length:(NSUInteger)sqlite3_column_bytes(statement, index)];
   case SQLITE_NULL:
     return [NSNull null];
   default:
@@ -436,21 +1228,26 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
 - (void)migrateDatabase:(void *)__unused db fromVersion:(NSUInteger)__unused version {
 }
 
+- (void)transactionDidRollBack {
+}
+
+- (void)transactionDidCommit {
+}
+
 - (void)setMaxStorageSize:(long)sizeInBytes completionHandler:(nullable void (^)(BOOL))completionHandler {
   int result;
   BOOL success;
-  sqlite3 *db = [MSACDBStorage openDatabaseAtFileURL:self.dbFileURL withResult:&result];
-  if (!db) {
-    return;
-  }
   if (self.pageSize == 0) {
     MSACLogError([MSACAppCenter logTag], @"The database was not configured correctly. The page size is expected to be non zero.");
-    sqlite3_close(db);
     if (completionHandler) {
       completionHandler(NO);
     }
     return;
   }
+  sqlite3 *db = [self openConnectionWithResult:&result];
+  if (!db) {
+    return;
+  }
 
   // Check the current number of pages in the database to determine whether the requested size will shrink the database.
   long currentPageCount = [MSACDBStorage getPageCountInOpenedDatabase:db];
@@ -485,22 +1282,43 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
         }
         self.maxSizeInBytes = actualMaxSize;
         success = YES;
+        [self resumeIncrementalMigration];
       }
     }
   }
-  sqlite3_close(db);
+
+  // The connection is kept open, restore the previous limit if it wasn't changed.
+  if (!success) {
+    [MSACDBStorage setMaxPageCount:self.maxSizeInBytes / self.pageSize inOpenedDatabase:db];
+  }
   if (completionHandler) {
     completionHandler(success);
   }
 }
 
-+ (sqlite3 *)openDatabaseAtFileURL:(NSURL *)fileURL withResult:(int *)result {
+- (sqlite3 *)openDatabaseWithFlags:(int)flags cacheSizeInKiB:(long)cacheSizeInKiB result:(int *)result {
+  MSACDBStorageProfile *profile = self.profile;
+  flags |= SQLITE_OPEN_URI | SQLITE_OPEN_PRIVATECACHE;
+
+  // Each connection is only used from one queue at a time, there is no need for SQLite to serialize the calls.
+  if (!profile.connectionMutexEnabled) {
+    flags |= SQLITE_OPEN_NOMUTEX;
+  }
   sqlite3 *db = NULL;
-  *result = sqlite3_open_v2([[fileURL absoluteString] UTF8String], &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI, NULL);
+  *result = sqlite3_open_v2([[self.dbFileURL absoluteString] UTF8String], &db, flags, NULL);
   if (*result != SQLITE_OK) {
-    MSACLogError([MSACAppCenter logTag], @"Failed to open database with result: %d.", *result);
+    sqlite3_close(db);
     return NULL;
   }
+
+  // A negative cache size is a number of KiB rather than a number of pages.
+  if (cacheSizeInKiB > 0) {
+    NSString *query = [NSString stringWithFormat:@"PRAGMA cache_size = -%ld", cacheSizeInKiB];
+    [MSACDBStorage executeNonSelectionQuery:query inOpenedDatabase:db];
+  }
+  if (profile.tempStoreInMemory) {
+    [MSACDBStorage executeNonSelectionQuery:@"PRAGMA temp_store = MEMORY" inOpenedDatabase:db];
+  }
   return db;
 }
 
@@ -512,6 +1330,10 @@ static int sqliteConfigurationResult = SQLITE_ERROR;
   return [MSACDBStorage querySingleValue:@"PRAGMA page_count;" inOpenedDatabase:db];
 }
 
++ (long)getFreePageCountInOpenedDatabase:(void *)db {
+  return [MSACDBStorage querySingleValue:@"PRAGMA freelist_count;" inOpenedDatabase:db];
+}
+
 + (long)getMaxPageCountInOpenedDatabase:(void *)db {
   return [MSACDBStorage querySingleValue:@"PRAGMA max_page_count;" inOpenedDatabase:db];
 }
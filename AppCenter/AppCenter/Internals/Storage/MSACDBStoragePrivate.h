@@ -3,6 +3,8 @@
 
 #import "MSACDBStorage.h"
 
+@class MSACDBStorageProfile;
+
 NS_ASSUME_NONNULL_BEGIN
 
 typedef int (^MSACDBStorageQueryBlock)(void *);
@@ -10,6 +12,32 @@ typedef int (^MSACDBStorageQueryBlock)(void *);
 // 10 MiB.
 static const long kMSACDefaultDatabaseSizeInBytes = 10 * 1024 * 1024;
 
+/**
+ * Size of the write-ahead log, in pages, that triggers an automatic checkpoint.
+ */
+static const int kMSACWALAutoCheckpointPageCount = 256;
+
+/**
+ * Minimum interval, in seconds, between two periodic checkpoints of the write-ahead log.
+ */
+static const NSTimeInterval kMSACWALCheckpointInterval = 60;
+
+/**
+ * Values of the SQLite "auto_vacuum" setting.
+ */
+static const long kMSACAutoVacuumNone = 0;
+static const long kMSACAutoVacuumFull = 1;
+static const long kMSACAutoVacuumIncremental = 2;
+
+/**
+ * Table tracking the progress of the incremental migrations, and its columns.
+ */
+static NSString *const kMSACMigrationsTableName = @"migrations";
+static NSString *const kMSACMigrationTableColumnName = @"tableName";
+static NSString *const kMSACMigrationStagedTableColumnName = @"stagedTableName";
+static NSString *const kMSACMigrationVersionColumnName = @"version";
+static NSString *const kMSACMigrationLastRowIdColumnName = @"lastRowId";
+
 @interface MSACDBStorage ()
 
 /**
@@ -27,11 +55,126 @@ static const long kMSACDefaultDatabaseSizeInBytes = 10 * 1024 * 1024;
  */
 @property(nonatomic) long pageSize;
 
+/**
+ * SQLite settings applied to the connections opened from now on.
+ */
+@property(nonatomic) MSACDBStorageProfile *profile;
+
 /**
  * Schema for the table.
  */
 @property(nonatomic, readonly, nullable) MSACDBSchema *schema;
 
+/**
+ * Database connection kept open for the lifetime of this storage. It is opened on first query and closed when the database is dropped.
+ */
+@property(nonatomic, nullable) void *connection;
+
+/**
+ * Prepared statements of the long-lived connection, keyed by their SQLite query.
+ */
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, NSValue *> *cachedStatements;
+
+/**
+ * Read-only connection used from the reader queue. It is opened on first read and closed along with the long-lived connection.
+ */
+@property(atomic, nullable) void *readerConnection;
+
+/**
+ * Prepared statements of the read-only connection, keyed by their SQLite query.
+ */
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, NSValue *> *readerCachedStatements;
+
+/**
+ * Serial queue the read-only connection is used from.
+ */
+@property(nonatomic, nullable) dispatch_queue_t readerQueue;
+
+/**
+ * Serial queue the results of the reads made on the read-only connection are delivered on.
+ */
+@property(nonatomic, nullable) dispatch_queue_t readerCompletionQueue;
+
+/**
+ * Whether the long-lived connection uses a write-ahead log.
+ */
+@property(nonatomic, getter=isWALEnabled) BOOL walEnabled;
+
+/**
+ * Maximum number of changes grouped in a single transaction.
+ */
+@property(nonatomic) NSUInteger groupCommitMaxChangesCount;
+
+/**
+ * Maximum time, in seconds, a grouped change is kept uncommitted.
+ */
+@property(nonatomic) NSTimeInterval groupCommitWindow;
+
+/**
+ * Serial queue the pending transaction is committed on once the group commit window has elapsed.
+ */
+@property(nonatomic, nullable) dispatch_queue_t groupCommitQueue;
+
+/**
+ * Timer committing the pending transaction once the group commit window has elapsed.
+ */
+@property(nonatomic, nullable) dispatch_source_t groupCommitTimerSource;
+
+/**
+ * Number of changes made in the pending transaction.
+ */
+@property(nonatomic) NSUInteger pendingTransactionChangesCount;
+
+/**
+ * Time of the last periodic checkpoint of the write-ahead log.
+ */
+@property(nonatomic) NSTimeInterval lastCheckpointTime;
+
+/**
+ * Total number of rows changed on the long-lived connection at the time of the last periodic checkpoint.
+ */
+@property(nonatomic) int changesAtLastCheckpoint;
+
+/**
+ * Whether the database has been created without auto vacuum and must be vacuumed once to enable incremental vacuum.
+ */
+@property(nonatomic) BOOL needsVacuum;
+
+/**
+ * Maximum number of pages freed by a single incremental vacuum.
+ */
+@property(nonatomic) NSUInteger incrementalVacuumMaxPagesCount;
+
+/**
+ * Time, in seconds, without deletion after which unused pages are freed.
+ */
+@property(nonatomic) NSTimeInterval incrementalVacuumIdleDelay;
+
+/**
+ * Serial queue unused pages are freed on.
+ */
+@property(nonatomic, nullable) dispatch_queue_t incrementalVacuumQueue;
+
+/**
+ * Timer freeing unused pages once the idle delay has elapsed.
+ */
+@property(nonatomic, nullable) dispatch_source_t incrementalVacuumTimerSource;
+
+/**
+ * Maximum number of rows migrated in a single transaction.
+ */
+@property(nonatomic) NSUInteger incrementalMigrationChunkSize;
+
+/**
+ * Serial queue the rows of staged tables are migrated on.
+ */
+@property(nonatomic, nullable) dispatch_queue_t incrementalMigrationQueue;
+
+/**
+ * Whether the incremental migration stopped because the storage was full, it resumes once rows are deleted.
+ */
+@property(nonatomic) BOOL incrementalMigrationWaitingForRoom;
+
 /**
  * Called after the database is created. Override to customize the database.
  *
@@ -47,13 +190,162 @@ static const long kMSACDefaultDatabaseSizeInBytes = 10 * 1024 * 1024;
  */
 - (void)migrateDatabase:(void *)db fromVersion:(NSUInteger)version;
 
+/**
+ * Called for each chunk of rows of a staged table, within the transaction recording the progress. Override to transform the rows of a
+ * legacy schema. By default, the columns the staged table and the new table have in common are copied.
+ *
+ * @param stagedTableName Name of the table holding the rows left to migrate.
+ * @param tableName Name of the table the rows are migrated to.
+ * @param version Database version the staged table comes from.
+ * @param firstRowId Row id of the first row of the chunk.
+ * @param lastRowId Row id of the last row of the chunk.
+ * @param db Database handle.
+ *
+ * @return `SQLITE_OK` or an error code, the chunk is rolled back on error.
+ */
+- (int)migrateRowsOfStagedTable:(NSString *)stagedTableName
+                        toTable:(NSString *)tableName
+                    fromVersion:(NSUInteger)version
+                      fromRowId:(int64_t)firstRowId
+                        toRowId:(int64_t)lastRowId
+               inOpenedDatabase:(void *)db;
+
+/**
+ * Called when a pending transaction has been rolled back, the changes made since it began are lost. Override to discard state derived from
+ * these changes.
+ */
+- (void)transactionDidRollBack;
+
+/**
+ * Called when the pending transaction of grouped changes has been committed. Override to forget state kept until the changes are on disk.
+ */
+- (void)transactionDidCommit;
+
 /**
  * Open database to prepare actions in callback.
  *
  * @param block Actions to perform in query.
+ *
+ * @discussion The database handle given to the callback is the long-lived connection, it must not be closed.
  */
 - (int)executeQueryUsingBlock:(MSACDBStorageQueryBlock)block;
 
+/**
+ * Finalize cached statements and close the long-lived connection. The next query opens a new one.
+ */
+- (void)closeConnection;
+
+/**
+ * Whether reads are made on the read-only connection, which requires the reader connection to be enabled and the write-ahead log to be
+ * used.
+ */
+- (BOOL)canReadConcurrently;
+
+/**
+ * Read the database on the read-only connection, from the reader queue, then deliver the result on the queue the database is accessed
+ * from. Reads are made right away on the long-lived connection if they can't be made concurrently.
+ *
+ * @param block Reads to perform, the database handle must not be used to make changes.
+ * @param completionHandler Called with the result of the block once the reads are done.
+ *
+ * @discussion The pending transaction of grouped changes is committed first, the read-only connection only sees committed changes.
+ */
+- (void)executeReadQueryUsingBlock:(MSACDBStorageQueryBlock)block completionHandler:(void (^)(int result))completionHandler;
+
+/**
+ * Open database to prepare actions in callback, changes made by the callback are synced to disk when committed whatever the durability
+ * level is. The pending transaction of grouped changes is committed first.
+ *
+ * @param block Actions to perform in query.
+ */
+- (int)executeSynchronousQueryUsingBlock:(MSACDBStorageQueryBlock)block;
+
+/**
+ * Open database to prepare actions in callback, changes made by the callback are grouped with other changes in a single transaction when
+ * group commit is enabled.
+ *
+ * @param block Actions to perform in query, it must make a single change.
+ *
+ * @return The result of the callback, or the commit result when the pending transaction is committed.
+ */
+- (int)executeGroupedQueryUsingBlock:(MSACDBStorageQueryBlock)block;
+
+/**
+ * Checkpoint the write-ahead log into the database file if rows have changed since the last periodic checkpoint and the checkpoint
+ * interval has elapsed.
+ *
+ * @param db Database handle.
+ */
+- (void)checkpointIfNeededInOpenedDatabase:(void *)db;
+
+/**
+ * Checkpoint the write-ahead log into the database file.
+ *
+ * @param mode The checkpoint mode, e.g. `SQLITE_CHECKPOINT_PASSIVE`.
+ * @param db Database handle.
+ *
+ * @return `SQLITE_OK` or an error code.
+ */
++ (int)checkpointWithMode:(int)mode inOpenedDatabase:(void *)db;
+
+/**
+ * Execute a non selection SQLite query on the database using a statement cached for the lifetime of the connection.
+ *
+ * @param query A SQLite statement to execute. It is used as the cache key so it must not embed values.
+ * @param db Database handle.
+ * @param values An array of query parameters to be substituted using `sqlite3_bind`.
+ *
+ * @return A result code for the query execution.
+ */
+- (int)executeCachedNonSelectionQuery:(NSString *)query inOpenedDatabase:(void *)db withValues:(nullable MSACStorageBindableArray *)values;
+
+/**
+ * Execute a "SELECT" SQLite query on the database using a statement cached for the lifetime of the connection.
+ *
+ * @param query A SQLite "SELECT" query to execute. It is used as the cache key so it must not embed values.
+ * @param db Database handle.
+ * @param values An array of query parameters to be substituted using `sqlite3_bind`.
+ *
+ * @return The selected entries.
+ */
+- (NSArray<NSArray *> *)executeCachedSelectionQuery:(NSString *)query
+                                   inOpenedDatabase:(void *)db
+                                         withValues:(nullable MSACStorageBindableArray *)values;
+
+/**
+ * Execute a "SELECT" SQLite query on the database using a statement cached for the lifetime of the connection, and read the rows one by
+ * one without materializing them.
+ *
+ * @param query A SQLite "SELECT" query to execute. It is used as the cache key so it must not embed values.
+ * @param db Database handle.
+ * @param values An array of query parameters to be substituted using `sqlite3_bind`.
+ * @param block Block called with a cursor on each row.
+ *
+ * @return A result code for the query execution.
+ */
+- (int)enumerateRowsOfCachedQuery:(NSString *)query
+                 inOpenedDatabase:(void *)db
+                       withValues:(nullable MSACStorageBindableArray *)values
+                       usingBlock:(MSACDBStorageRowBlock)block;
+
+/**
+ * Execute a "SELECT" SQLite query on the database, and read the rows one by one without materializing them.
+ *
+ * @param query A SQLite "SELECT" query to execute.
+ * @param db Database handle.
+ * @param values An array of query parameters to be substituted using `sqlite3_bind`.
+ * @param cached Whether the statement is cached for the lifetime of the connection. Queries built with a variable number of values are
+ * not, each number would take an entry of the cache.
+ * @param block Block called with a cursor on each row.
+ *
+ * @return A result code for the query execution.
+ */
+- (int)enumerateRowsOfQuery:(NSString *)query
+           inOpenedDatabase:(void *)db
+                 withValues:(nullable MSACStorageBindableArray *)values
+                     cached:(BOOL)cached
+                 usingBlock:(MSACDBStorageRowBlock)block;
+
 /**
  * Creates a table within an existing database.
  *
@@ -74,6 +366,19 @@ static const long kMSACDefaultDatabaseSizeInBytes = 10 * 1024 * 1024;
  */
 + (int)createTablesWithSchema:(nullable MSACDBSchema *)schema inOpenedDatabase:(void *)db;
 
+/**
+ * Add the columns of the schema missing from an existing table.
+ *
+ * @param tableName Table name.
+ * @param columnsSchema Schema describing the columns structure.
+ * @param db Database handle.
+ *
+ * @return result `SQLITE_OK` or an error code.
+ *
+ * @discussion SQLite can only add columns at the end of a table, so new columns must be appended to the schema.
+ */
++ (int)addMissingColumnsToTable:(NSString *)tableName columnsSchema:(MSACDBColumnsSchema *)columnsSchema inOpenedDatabase:(void *)db;
+
 /**
  * Query the number of pages (i.e.: SQLite "page_count") of the database.
  *
@@ -93,11 +398,55 @@ static const long kMSACDefaultDatabaseSizeInBytes = 10 * 1024 * 1024;
 + (long)getPageSizeInOpenedDatabase:(void *)db;
 
 /**
- * Set the auto vacuum (i.e.: SQLite "auto_vacuum") of the database.
+ * Set the auto vacuum (i.e.: SQLite "auto_vacuum") of the database to incremental.
  *
  * @param db Database handle.
+ *
+ * @return `YES` if the database must be vacuumed for the change to take effect, `NO` otherwise.
  */
-+ (void)enableAutoVacuumInOpenedDatabase:(void *)db;
++ (BOOL)enableIncrementalVacuumInOpenedDatabase:(void *)db;
+
+/**
+ * Query the number of unused pages (i.e.: SQLite "freelist_count") of the database.
+ *
+ * @param db Database handle.
+ *
+ * @return The number of unused pages.
+ */
++ (long)getFreePageCountInOpenedDatabase:(void *)db;
+
+/**
+ * Rename a table so that its rows are migrated incrementally to a table with the new schema, and record the migration.
+ *
+ * @param tableName Table name.
+ * @param version Current database version.
+ * @param db Database handle.
+ *
+ * @return `SQLITE_OK` or an error code.
+ *
+ * @discussion The table with the new schema must be created afterwards. Nothing is done if the table has already been staged.
+ */
++ (int)stageTable:(NSString *)tableName forMigrationFromVersion:(NSUInteger)version inOpenedDatabase:(void *)db;
+
+/**
+ * Get the name a table is renamed to when it is staged for migration.
+ *
+ * @param tableName Table name.
+ * @param version Database version the table comes from.
+ *
+ * @return The name of the staged table.
+ */
++ (NSString *)stagedTableNameForTable:(NSString *)tableName fromVersion:(NSUInteger)version;
+
+/**
+ * Get the names of the columns of a table.
+ *
+ * @param tableName Table name.
+ * @param db Database handle.
+ *
+ * @return The column names, empty if the table doesn't exist.
+ */
++ (NSArray<NSString *> *)columnNamesOfTable:(NSString *)tableName inOpenedDatabase:(void *)db;
 
 /**
  * Check if a table exists in this database.
@@ -159,6 +508,21 @@ static const long kMSACDefaultDatabaseSizeInBytes = 10 * 1024 * 1024;
                              inOpenedDatabase:(void *)db
                                    withValues:(nullable MSACStorageBindableArray *)values;
 
+/**
+ * Execute a "SELECT" SQLite query on the database and read the rows one by one, without materializing them.
+ *
+ * @param query A SQLite "SELECT" query to execute.
+ * @param db Database handle.
+ * @param values An array of query parameters to be substituted using `sqlite3_bind`.
+ * @param block Block called with a cursor on each row.
+ *
+ * @return A result code for the query execution.
+ */
++ (int)enumerateRowsOfQuery:(NSString *)query
+           inOpenedDatabase:(void *)db
+                 withValues:(nullable MSACStorageBindableArray *)values
+                 usingBlock:(MSACDBStorageRowBlock)block;
+
 /**
  * Execute a "SELECT" SQLite query on the database.
  *
@@ -0,0 +1,69 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * SQLite settings applied to the databases of the SDK.
+ *
+ * @discussion The SDK links the SQLite library of the system, compile-time options can't be changed. The profile applies their runtime
+ * equivalents to the connections of the SDK only, the global configuration of SQLite is shared with the application and left untouched.
+ */
+@interface MSACDBStorageProfile : NSObject
+
+/**
+ * Initializes a profile.
+ *
+ * @param pageSize Page size of new databases, in bytes. 0 keeps the SQLite default.
+ * @param cacheSizeInKiB Page cache size of the long-lived connection, in KiB. 0 keeps the SQLite default.
+ * @param readerCacheSizeInKiB Page cache size of the read-only connection, in KiB. 0 keeps the SQLite default.
+ * @param tempStoreInMemory Whether temporary tables and indexes are kept in memory.
+ * @param connectionMutexEnabled Whether SQLite serializes the calls to a connection with its own mutex.
+ */
+- (instancetype)initWithPageSize:(long)pageSize
+                  cacheSizeInKiB:(long)cacheSizeInKiB
+            readerCacheSizeInKiB:(long)readerCacheSizeInKiB
+               tempStoreInMemory:(BOOL)tempStoreInMemory
+          connectionMutexEnabled:(BOOL)connectionMutexEnabled;
+
+/**
+ * Profile tuned for the access pattern of the log storage on the current platform: a single table used as a queue, written from a serial
+ * queue and read from another.
+ */
++ (instancetype)defaultProfile;
+
+/**
+ * Profile keeping all the SQLite defaults, used as a baseline by the benchmarks.
+ */
++ (instancetype)sqliteDefaultsProfile;
+
+/**
+ * Page size of new databases, in bytes. 0 keeps the SQLite default.
+ */
+@property(nonatomic, readonly) long pageSize;
+
+/**
+ * Page cache size of the long-lived connection, in KiB. 0 keeps the SQLite default.
+ */
+@property(nonatomic, readonly) long cacheSizeInKiB;
+
+/**
+ * Page cache size of the read-only connection, in KiB. 0 keeps the SQLite default.
+ */
+@property(nonatomic, readonly) long readerCacheSizeInKiB;
+
+/**
+ * Whether temporary tables and indexes are kept in memory.
+ */
+@property(nonatomic, readonly) BOOL tempStoreInMemory;
+
+/**
+ * Whether SQLite serializes the calls to a connection with its own mutex. Connections of the SDK are only used from one queue at a time.
+ */
+@property(nonatomic, readonly) BOOL connectionMutexEnabled;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,56 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACDBStorageProfile.h"
+
+/**
+ * Page size matching the file system block size.
+ */
+static const long kMSACDBPageSize = 4096;
+
+/*
+ * The storage is read by batches of recent rows and written at the end of the table, a small cache covers the pages being touched. The
+ * read-only connection only loads batches.
+ */
+#if TARGET_OS_OSX
+static const long kMSACDBCacheSizeInKiB = 1024;
+static const long kMSACDBReaderCacheSizeInKiB = 512;
+#else
+static const long kMSACDBCacheSizeInKiB = 512;
+static const long kMSACDBReaderCacheSizeInKiB = 256;
+#endif
+
+@implementation MSACDBStorageProfile
+
+- (instancetype)initWithPageSize:(long)pageSize
+                  cacheSizeInKiB:(long)cacheSizeInKiB
+            readerCacheSizeInKiB:(long)readerCacheSizeInKiB
+               tempStoreInMemory:(BOOL)tempStoreInMemory
+          connectionMutexEnabled:(BOOL)connectionMutexEnabled {
+  if ((self = [super init])) {
+    _pageSize = pageSize;
+    _cacheSizeInKiB = cacheSizeInKiB;
+    _readerCacheSizeInKiB = readerCacheSizeInKiB;
+    _tempStoreInMemory = tempStoreInMemory;
+    _connectionMutexEnabled = connectionMutexEnabled;
+  }
+  return self;
+}
+
++ (instancetype)defaultProfile {
+  return [[self alloc] initWithPageSize:kMSACDBPageSize
+                         cacheSizeInKiB:kMSACDBCacheSizeInKiB
+                   readerCacheSizeInKiB:kMSACDBReaderCacheSizeInKiB
+                      tempStoreInMemory:YES
+                 connectionMutexEnabled:NO];
+}
+
++ (instancetype)sqliteDefaultsProfile {
+  return [[self alloc] initWithPageSize:0
+                         cacheSizeInKiB:0
+                   readerCacheSizeInKiB:0
+                      tempStoreInMemory:NO
+                 connectionMutexEnabled:YES];
+}
+
+@end
@@ -0,0 +1,33 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Version of the dictionary used to compress new logs. Versions are stored along with the compressed logs, so the dictionary of a released
+ * version must never change: changes go to a new version.
+ */
+static const NSUInteger kMSACLogCompressionDictionaryVersion = 1;
+
+/**
+ * Preset dictionaries shared by the compressed logs of the storage.
+ *
+ * @discussion A log archive is too small for deflate to find repetitions in it. The dictionary primes the compressor with the class names,
+ * keys and common values of the log archives, encoded as in a binary archive.
+ */
+@interface MSACLogCompressionDictionary : NSObject
+
+/**
+ * Get a dictionary.
+ *
+ * @param version The version of the dictionary.
+ *
+ * @return The dictionary or `nil` if the version is unknown.
+ */
++ (nullable NSData *)dictionaryWithVersion:(NSUInteger)version;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,62 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACLogCompressionDictionary.h"
+#import "MSACBinaryArchiver.h"
+
+@implementation MSACLogCompressionDictionary
+
++ (nullable NSData *)dictionaryWithVersion:(NSUInteger)version {
+  if (version != 1) {
+    return nil;
+  }
+  static NSData *dictionaryVersion1 = nil;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+    NSArray<NSString *> *classNames = @[
+      @"MSACAppleErrorLog", @"MSACHandledErrorLog", @"MSACErrorAttachmentLog", @"MSACExceptionModel", @"MSACStackFrame", @"MSACThread",
+      @"MSACBinary", @"MSACCustomPropertiesLog", @"MSACDistributionStartSessionLog", @"MSACStartServiceLog", @"MSACStartSessionLog",
+      @"MSACPageLog", @"MSACCSData", @"MSACCSExtensions", @"MSACAppExtension", @"MSACDeviceExtension", @"MSACLocExtension",
+      @"MSACMetadataExtension", @"MSACNetExtension", @"MSACOSExtension", @"MSACProtocolExtension", @"MSACSDKExtension",
+      @"MSACUserExtension", @"MSACCommonSchemaLog", @"MSACOrderedDictionary", @"MSACEventProperties", @"MSACDateTimeTypedProperty",
+      @"MSACBooleanTypedProperty", @"MSACDoubleTypedProperty", @"MSACLongTypedProperty", @"MSACStringTypedProperty", @"MSACEventLog"
+    ];
+    NSArray<NSString *> *strings = @[
+      @"baseType", @"baseData", @"ticketKeys", @"devMake", @"devModel", @"localId", @"installId", @"libVer", @"epoch", @"seq",
+      @"provider", @"tz", @"metadata", @"protocol", @"loc", @"net", @"os", @"sdk", @"user", @"app", @"ext", @"data", @"cV", @"iKey",
+      @"popSample", @"flags", @"time", @"ver", @"3.0", @"services", @"Analytics", @"Crashes", @"Distribute", @"startService",
+      @"customProperties", @"startSession", @"page", @"boolean", @"dateTime", @"double", @"long", @"string", @"typedProperties",
+      @"value", @"name", @"properties", @"event", @"id", @"distributionGroupId", @"userId", @"type", @"timestamp", @"sid"
+    ];
+    dictionaryVersion1 = [MSACLogCompressionDictionary dictionaryWithClassNames:classNames strings:strings];
+  });
+  return dictionaryVersion1;
+}
+
+/**
+ * Build a dictionary from class names and strings encoded as in a binary archive. Deflate favors the closest matches, so the most common
+ * strings go last.
+ */
++ (NSData *)dictionaryWithClassNames:(NSArray<NSString *> *)classNames strings:(NSArray<NSString *> *)strings {
+  NSMutableData *dictionary = [NSMutableData new];
+  for (NSString *className in classNames) {
+    uint8_t tag = MSACBinaryArchiveTagObject;
+    [dictionary appendBytes:&tag length:sizeof(tag)];
+    [MSACLogCompressionDictionary appendString:className toDictionary:dictionary];
+  }
+  for (NSString *string in strings) {
+    [MSACLogCompressionDictionary appendString:string toDictionary:dictionary];
+  }
+  return dictionary;
+}
+
++ (void)appendString:(NSString *)string toDictionary:(NSMutableData *)dictionary {
+  NSData *bytes = [string dataUsingEncoding:NSUTF8StringEncoding];
+
+  // Entries are shorter than 128 bytes, their length fits in a single byte.
+  uint8_t header[] = {MSACBinaryArchiveTagString, (uint8_t)bytes.length};
+  [dictionary appendBytes:header length:sizeof(header)];
+  [dictionary appendData:bytes];
+}
+
+@end
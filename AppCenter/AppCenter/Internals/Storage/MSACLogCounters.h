@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Running number and size of the stored logs by group Id and target key.
+ */
+@interface MSACLogCounters : NSObject
+
+/**
+ * Add logs to the counters, or remove them with negative values. Counters never go below zero.
+ *
+ * @param count Number of logs.
+ * @param size Size of the logs in bytes.
+ * @param groupId The key used for grouping logs.
+ * @param targetKey The target key of the logs, `nil` for logs without target token.
+ */
+- (void)addLogsCount:(NSInteger)count size:(long long)size groupId:(NSString *)groupId targetKey:(nullable NSString *)targetKey;
+
+/**
+ * Reset all the counters.
+ */
+- (void)removeAllLogs;
+
+/**
+ * Get the number of logs.
+ *
+ * @param groupId The key used for grouping logs, `nil` for all groups.
+ * @param excludedTargetKeys The target keys of the logs not counted.
+ *
+ * @return The number of logs.
+ */
+- (NSUInteger)countLogsWithGroupId:(nullable NSString *)groupId excludedTargetKeys:(nullable NSArray<NSString *> *)excludedTargetKeys;
+
+/**
+ * Get the size of the logs.
+ *
+ * @param groupId The key used for grouping logs, `nil` for all groups.
+ *
+ * @return The size of the logs in bytes.
+ */
+- (long long)sizeOfLogsWithGroupId:(nullable NSString *)groupId;
+
+@end
+
+NS_ASSUME_NONNULL_END
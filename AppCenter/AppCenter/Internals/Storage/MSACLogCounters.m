@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACLogCounters.h"
+
+/**
+ * Number and size of the logs of a group with the same target key.
+ */
+@interface MSACLogCounter : NSObject
+
+@property(nonatomic) NSInteger count;
+
+@property(nonatomic) long long size;
+
+@end
+
+@implementation MSACLogCounter
+@end
+
+@interface MSACLogCounters ()
+
+/**
+ * Counters by target key by group Id. Logs without target key are counted under `NSNull`.
+ */
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, NSMutableDictionary<id, MSACLogCounter *> *> *counters;
+
+@end
+
+@implementation MSACLogCounters
+
+- (instancetype)init {
+  if ((self = [super init])) {
+    _counters = [NSMutableDictionary new];
+  }
+  return self;
+}
+
+- (void)addLogsCount:(NSInteger)count size:(long long)size groupId:(NSString *)groupId targetKey:(nullable NSString *)targetKey {
+  id key = targetKey ?: [NSNull null];
+  @synchronized(self) {
+    NSMutableDictionary<id, MSACLogCounter *> *groupCounters = self.counters[groupId];
+    if (!groupCounters) {
+      groupCounters = [NSMutableDictionary new];
+      self.counters[groupId] = groupCounters;
+    }
+    MSACLogCounter *counter = groupCounters[key];
+    if (!counter) {
+      counter = [MSACLogCounter new];
+      groupCounters[key] = counter;
+    }
+    counter.count = MAX(counter.count + count, 0);
+    counter.size = MAX(counter.size + size, 0);
+    if (counter.count == 0) {
+      [groupCounters removeObjectForKey:key];
+    }
+  }
+}
+
+- (void)removeAllLogs {
+  @synchronized(self) {
+    [self.counters removeAllObjects];
+  }
+}
+
+- (NSUInteger)countLogsWithGroupId:(nullable NSString *)groupId excludedTargetKeys:(nullable NSArray<NSString *> *)excludedTargetKeys {
+  NSUInteger count = 0;
+  @synchronized(self) {
+    NSArray<NSString *> *groupIds = groupId ? @[ (NSString *)groupId ] : self.counters.allKeys;
+    for (NSString *currentGroupId in groupIds) {
+      NSDictionary<id, MSACLogCounter *> *groupCounters = self.counters[currentGroupId];
+      for (id targetKey in groupCounters) {
+        if (![excludedTargetKeys containsObject:targetKey]) {
+          count += (NSUInteger)groupCounters[targetKey].count;
+        }
+      }
+    }
+  }
+  return count;
+}
+
+- (long long)sizeOfLogsWithGroupId:(nullable NSString *)groupId {
+  long long size = 0;
+  @synchronized(self) {
+    NSArray<NSString *> *groupIds = groupId ? @[ (NSString *)groupId ] : self.counters.allKeys;
+    for (NSString *currentGroupId in groupIds) {
+      for (MSACLogCounter *counter in [self.counters[currentGroupId] objectEnumerator]) {
+        size += counter.size;
+      }
+    }
+  }
+  return size;
+}
+
+@end
@@ -6,6 +6,40 @@
 #import "MSACDBStorage.h"
 #import "MSACStorage.h"
 
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Handler triggered when logs are evicted to make room for a new log.
+ *
+ * @param evictedLogsCounts The number of evicted logs by group Id.
+ */
+typedef void (^MSACLogEvictionHandler)(NSDictionary<NSString *, NSNumber *> *evictedLogsCounts);
+
 @interface MSACLogDBStorage : MSACDBStorage <MSACStorage>
 
+/**
+ * Number of bytes freed on top of the size of a new log when the storage is full, so that the next logs are less likely to evict logs
+ * too. Default is 8 KiB.
+ */
+@property(nonatomic) NSUInteger evictionHeadroom;
+
+/**
+ * Whether new logs are compressed with a dictionary shared by all the logs, when it makes them smaller. Compressed logs are loaded whatever
+ * the setting. Default is `YES`.
+ */
+@property(nonatomic) BOOL compressionEnabled;
+
+/**
+ * Handler triggered, on the thread saving the log, once logs have been evicted to make room for a new log.
+ */
+@property(nonatomic, copy, nullable) MSACLogEvictionHandler evictionHandler;
+
+/**
+ * Handler triggered, on the thread of the failed query or commit, once logs already saved have been lost because the transaction they were
+ * grouped in has been rolled back.
+ */
+@property(nonatomic, copy, nullable) MSACLogEvictionHandler lostLogsHandler;
+
 @end
+
+NS_ASSUME_NONNULL_END
@@ -1,18 +1,24 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
+#import <CommonCrypto/CommonDigest.h>
 #import <sqlite3.h>
 
 #import "MSACAppCenterInternal.h"
+#import "MSACBinaryArchiver.h"
+#import "MSACBinaryUnarchiver.h"
+#import "MSACCompression.h"
 #import "MSACConstants+Internal.h"
 #import "MSACDBStoragePrivate.h"
+#import "MSACDevice.h"
+#import "MSACLogCompressionDictionary.h"
 #import "MSACLogDBStoragePrivate.h"
 #import "MSACLogDBStorageVersion.h"
 #import "MSACStorageNumberType.h"
 #import "MSACStorageTextType.h"
 #import "MSACUtility+StringFormatting.h"
 
-static const NSUInteger kMSACSchemaVersion = 5;
+static const NSUInteger kMSACSchemaVersion = 13;
 
 @implementation MSACLogDBStorage
 
@@ -27,24 +33,55 @@ static const NSUInteger kMSACSchemaVersion = 5;
     kMSACLogTableName : @[
       @{kMSACIdColumnName : @[ kMSACSQLiteTypeInteger, kMSACSQLiteConstraintPrimaryKey, kMSACSQLiteConstraintAutoincrement ]},
       @{kMSACGroupIdColumnName : @[ kMSACSQLiteTypeText, kMSACSQLiteConstraintNotNull ]},
-      @{kMSACLogColumnName : @[ kMSACSQLiteTypeText, kMSACSQLiteConstraintNotNull ]},
+      @{kMSACLogColumnName : @[ kMSACSQLiteTypeBlob, kMSACSQLiteConstraintNotNull ]},
       @{kMSACTargetTokenColumnName : @[ kMSACSQLiteTypeText ]}, @{kMSACTargetKeyColumnName : @[ kMSACSQLiteTypeText ]},
-      @{kMSACPriorityColumnName : @[ kMSACSQLiteTypeInteger ]}
+      @{kMSACPriorityColumnName : @[ kMSACSQLiteTypeInteger ]}, @{kMSACBatchIdColumnName : @[ kMSACSQLiteTypeText ]},
+      @{kMSACSizeColumnName : @[ kMSACSQLiteTypeInteger ]}, @{kMSACTimestampColumnName : @[ kMSACSQLiteTypeInteger ]},
+      @{kMSACDeviceIdColumnName : @[ kMSACSQLiteTypeInteger ]}, @{kMSACTargetTokenIdColumnName : @[ kMSACSQLiteTypeInteger ]},
+      @{kMSACDictionaryVersionColumnName : @[ kMSACSQLiteTypeInteger ]}, @{kMSACPayloadSizeColumnName : @[ kMSACSQLiteTypeInteger ]}
+    ],
+    kMSACDeviceTableName : @[
+      @{kMSACIdColumnName : @[ kMSACSQLiteTypeInteger, kMSACSQLiteConstraintPrimaryKey, kMSACSQLiteConstraintAutoincrement ]},
+      @{kMSACHashColumnName : @[ kMSACSQLiteTypeBlob, kMSACSQLiteConstraintNotNull ]},
+      @{kMSACDeviceColumnName : @[ kMSACSQLiteTypeBlob, kMSACSQLiteConstraintNotNull ]},
+      @{kMSACReferenceCountColumnName : @[ kMSACSQLiteTypeInteger, kMSACSQLiteConstraintNotNull ]}
+    ],
+    kMSACTargetTokenTableName : @[
+      @{kMSACIdColumnName : @[ kMSACSQLiteTypeInteger, kMSACSQLiteConstraintPrimaryKey, kMSACSQLiteConstraintAutoincrement ]},
+      @{kMSACHashColumnName : @[ kMSACSQLiteTypeBlob, kMSACSQLiteConstraintNotNull ]},
+      @{kMSACTargetTokenColumnName : @[ kMSACSQLiteTypeText, kMSACSQLiteConstraintNotNull ]},
+      @{kMSACReferenceCountColumnName : @[ kMSACSQLiteTypeInteger, kMSACSQLiteConstraintNotNull ]}
     ]
   };
   self = [self initWithSchema:schema version:kMSACSchemaVersion filename:kMSACDBFileName];
   if (self) {
-    NSDictionary *columnIndexes = [MSACDBStorage columnsIndexes:schema];
-    _idColumnIndex = ((NSNumber *)columnIndexes[kMSACLogTableName][kMSACIdColumnName]).unsignedIntegerValue;
-    _groupIdColumnIndex = ((NSNumber *)columnIndexes[kMSACLogTableName][kMSACGroupIdColumnName]).unsignedIntegerValue;
-    _logColumnIndex = ((NSNumber *)columnIndexes[kMSACLogTableName][kMSACLogColumnName]).unsignedIntegerValue;
-    _targetTokenColumnIndex = ((NSNumber *)columnIndexes[kMSACLogTableName][kMSACTargetTokenColumnName]).unsignedIntegerValue;
-    _batches = [NSMutableDictionary<NSString *, NSArray<NSNumber *> *> new];
     _targetTokenEncrypter = [MSACEncrypter new];
+    _decryptedTargetTokens = [NSCache new];
+    _decryptedTargetTokens.countLimit = kMSACMaxDecryptedTargetTokensCount;
+    _evictionHeadroom = kMSACDefaultEvictionHeadroom;
+    _compressionEnabled = YES;
+    _defaultTimeToLives = [NSMutableDictionary new];
+    _groupTimeToLives = [NSMutableDictionary new];
+    _batchSizeInBytesLimits = [NSMutableDictionary new];
+    _logCounters = [MSACLogCounters new];
+    _unbatchedLogCounters = [MSACLogCounters new];
+    _pendingLogsCounts = [NSMutableDictionary new];
+
+    // Batches claimed by a previous process can't be in flight anymore.
+    [self releaseAllBatches];
+    [self rebuildLogCounters];
+    [MSAC_NOTIFICATION_CENTER addObserver:self
+                                 selector:@selector(encryptionKeyDidRotate:)
+                                     name:kMSACEncryptionKeyDidRotateNotification
+                                   object:nil];
   }
   return self;
 }
 
+- (void)dealloc {
+  [MSAC_NOTIFICATION_CENTER removeObserver:self name:kMSACEncryptionKeyDidRotateNotification object:nil];
+}
+
 #pragma mark - Save logs
 
 - (BOOL)saveLog:(id<MSACLog>)log withGroupId:(NSString *)groupId flags:(MSACFlags)flags {
@@ -53,86 +90,262 @@ static const NSUInteger kMSACSchemaVersion = 5;
   }
   MSACFlags persistenceFlags = flags & kMSACPersistenceFlagsMask;
 
-  // Insert this log to the DB.
-  NSString *base64Data = [[MSACUtility archiveKeyedData:log] base64EncodedStringWithOptions:NSDataBase64EncodingEndLineWithLineFeed];
+  /*
+   * The device is stored once in the devices table, under the hash of its archive, and referenced by the log. Logs whose device can't be
+   * archived in the binary format keep it in their own archive.
+   */
+  NSData *logData = nil;
+  NSData *deviceData = nil;
+  NSData *deviceHash = nil;
+  if (log.device) {
+    deviceData = [MSACBinaryArchiver archivedDataWithRootObject:log.device];
+    logData = deviceData ? [MSACLogDBStorage archiveLogWithoutDevice:log] : nil;
+  }
+  if (logData) {
+    deviceHash = [MSACLogDBStorage hashOfData:(NSData *)deviceData];
+  } else {
+    deviceData = nil;
+    logData = [MSACLogDBStorage archiveLog:log];
+  }
+  if (!logData) {
+    return NO;
+  }
+
+  // Batches are cut on the size of the logs as they are sent, before compression and with their device.
+  NSUInteger payloadSize = logData.length + deviceData.length;
+
+  // The version of the dictionary is stored along with the log to decompress it.
+  NSUInteger dictionaryVersion = 0;
+  if (self.compressionEnabled) {
+    logData = [MSACLogDBStorage compressArchivedLog:logData dictionaryVersion:&dictionaryVersion];
+  }
 
+  // Target tokens are stored once in the target tokens table, under the hash of the token, and referenced by the log.
+  NSString *targetToken = nil;
+  NSString *targetKey = nil;
+  NSData *targetTokenHash = nil;
+  if ([(NSObject *)log isKindOfClass:[MSACCommonSchemaLog class]]) {
+    targetToken = [[log transmissionTargetTokens] anyObject];
+    targetKey = [MSACUtility targetKeyFromTargetToken:targetToken];
+    targetTokenHash = targetToken ? [MSACLogDBStorage hashOfData:(NSData *)[targetToken dataUsingEncoding:NSUTF8StringEncoding]] : nil;
+  }
+
+  // Insert this log to the DB.
   MSACStorageBindableArray *addLogValues = [MSACStorageBindableArray new];
   [addLogValues addString:groupId];
-  [addLogValues addString:base64Data];
+  [addLogValues addData:logData];
+  [addLogValues addString:targetKey];
   [addLogValues addNumber:@(persistenceFlags)];
-  NSString *addLogQuery = [NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\", \"%@\") VALUES (?, ?, ?)", kMSACLogTableName,
-                                                     kMSACGroupIdColumnName, kMSACLogColumnName, kMSACPriorityColumnName];
+  [addLogValues addNumber:@(logData.length)];
+  [addLogValues addNumber:@((long long)[[NSDate date] timeIntervalSince1970])];
+  [addLogValues addData:deviceHash];
+  [addLogValues addData:targetTokenHash];
+  [addLogValues addNumber:@(dictionaryVersion)];
+  [addLogValues addNumber:@(payloadSize)];
+  NSString *addLogQuery = [NSString
+      stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\", \"%@\", \"%@\", \"%@\", \"%@\", \"%@\", \"%@\", \"%@\", \"%@\") "
+                       @"VALUES (?, ?, ?, ?, ?, ?, %@, %@, ?, ?)",
+                       kMSACLogTableName, kMSACGroupIdColumnName, kMSACLogColumnName, kMSACTargetKeyColumnName, kMSACPriorityColumnName,
+                       kMSACSizeColumnName, kMSACTimestampColumnName, kMSACDeviceIdColumnName, kMSACTargetTokenIdColumnName,
+                       kMSACDictionaryVersionColumnName, kMSACPayloadSizeColumnName,
+                       [MSACLogDBStorage referenceToTable:kMSACDeviceTableName],
+                       [MSACLogDBStorage referenceToTable:kMSACTargetTokenTableName]];
+  NSMutableDictionary<NSString *, NSNumber *> *evictedLogsCounts = [NSMutableDictionary new];
+  MSACDBStorageQueryBlock saveBlock = ^int(void *db) {
+    // Check maximum size.
+    NSUInteger maxSize = [MSACDBStorage getMaxPageCountInOpenedDatabase:db] * self.pageSize;
+    if (logData.length >= maxSize) {
+      MSACLogError([MSACAppCenter logTag],
+                   @"Log is too large (%tu bytes) to store in database. Current maximum database size is %tu bytes.", logData.length,
+                   maxSize);
+      return SQLITE_ERROR;
+    }
 
-  // Serialize target token.
-  if ([(NSObject *)log isKindOfClass:[MSACCommonSchemaLog class]]) {
-    NSString *targetToken = [[log transmissionTargetTokens] anyObject];
-    NSString *encryptedToken = [self.targetTokenEncrypter encryptString:targetToken];
-    NSString *targetKey = [MSACUtility targetKeyFromTargetToken:targetToken];
-
-    addLogValues = [MSACStorageBindableArray new];
-    [addLogValues addString:groupId];
-    [addLogValues addString:base64Data];
-    [addLogValues addString:encryptedToken];
-    [addLogValues addString:targetKey];
-    [addLogValues addNumber:@(persistenceFlags)];
-    addLogQuery = [NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\", \"%@\", \"%@\", \"%@\") VALUES (?, ?, ?, ?, ?)",
-                                             kMSACLogTableName, kMSACGroupIdColumnName, kMSACLogColumnName, kMSACTargetTokenColumnName,
-                                             kMSACTargetKeyColumnName, kMSACPriorityColumnName];
-  }
-  return [self executeQueryUsingBlock:^int(void *db) {
-           // Check maximum size.
-           NSUInteger maxSize = [MSACDBStorage getMaxPageCountInOpenedDatabase:db] * self.pageSize;
-           if (base64Data.length >= maxSize) {
-             MSACLogError([MSACAppCenter logTag],
-                          @"Log is too large (%tu bytes) to store in database. Current maximum database size is %tu bytes.",
-                          base64Data.length, maxSize);
-             return SQLITE_ERROR;
-           }
-
-           // Try to insert.
-           int result = [MSACDBStorage executeNonSelectionQuery:addLogQuery inOpenedDatabase:db withValues:addLogValues];
-           NSMutableArray<NSNumber *> *logsCanBeDeleted = nil;
-           if (result == SQLITE_FULL) {
-
-             // Selecting logs with equal or lower priority and ordering by priority then age.
-             NSString *query = [NSString stringWithFormat:@"SELECT \"%@\" FROM \"%@\" WHERE \"%@\" <= ? ORDER BY \"%@\" ASC, \"%@\" ASC",
-                                                          kMSACIdColumnName, kMSACLogTableName, kMSACPriorityColumnName,
-                                                          kMSACPriorityColumnName, kMSACIdColumnName];
-             MSACStorageBindableArray *values = [MSACStorageBindableArray new];
-             [values addNumber:@(flags)];
-             NSArray<NSArray *> *entries = [MSACDBStorage executeSelectionQuery:query inOpenedDatabase:db withValues:values];
-             logsCanBeDeleted = [NSMutableArray new];
-             for (NSMutableArray *row in entries) {
-               [logsCanBeDeleted addObject:row[0]];
-             }
-           }
-
-           // If the database is full, delete logs until there is room to add the log.
-           long countOfLogsDeleted = 0;
-           NSUInteger index = 0;
-           while (result == SQLITE_FULL && index < [logsCanBeDeleted count]) {
-             result = [MSACLogDBStorage deleteLogsFromDBWithColumnValues:@[ logsCanBeDeleted[index] ]
-                                                              columnName:kMSACIdColumnName
-                                                        inOpenedDatabase:db];
-             if (result != SQLITE_OK) {
-               break;
-             }
-             MSACLogDebug([MSACAppCenter logTag], @"Deleted a log with id %@ to store a new log.", logsCanBeDeleted[index]);
-             ++countOfLogsDeleted;
-             ++index;
-             result = [MSACDBStorage executeNonSelectionQuery:addLogQuery inOpenedDatabase:db withValues:addLogValues];
-           }
-           if (countOfLogsDeleted > 0) {
-             MSACLogDebug([MSACAppCenter logTag], @"Log storage was over capacity, %ld oldest log(s) with equal or lower priority deleted.",
-                          (long)countOfLogsDeleted);
-           }
-           if (result == SQLITE_OK) {
-             MSACLogVerbose([MSACAppCenter logTag], @"Log is stored with id: '%ld'", (long)sqlite3_last_insert_rowid(db));
-           } else if (result == SQLITE_FULL && index == [logsCanBeDeleted count]) {
-             MSACLogError([MSACAppCenter logTag], @"Storage is full and no logs with equal or lower priority exist; discarding the log.");
-           }
-           return result;
-         }] == SQLITE_OK;
+    // Try to insert.
+    int result = [self insertLogWithQuery:addLogQuery
+                                   values:addLogValues
+                               deviceData:deviceData
+                               deviceHash:deviceHash
+                              targetToken:targetToken
+                          targetTokenHash:targetTokenHash
+                         inOpenedDatabase:db];
+
+    // If the database is full, evict enough logs with equal or lower priority to make room for the log, then try again.
+    while (result == SQLITE_FULL) {
+      result = [self evictLogsToStoreLogOfSize:logData.length
+                                      priority:persistenceFlags
+                              inOpenedDatabase:db
+                             evictedLogsCounts:evictedLogsCounts];
+      if (result == SQLITE_FULL) {
+        MSACLogError([MSACAppCenter logTag], @"Storage is full and no logs with equal or lower priority exist; discarding the log.");
+        break;
+      }
+      if (result == SQLITE_OK) {
+        result = [self insertLogWithQuery:addLogQuery
+                                   values:addLogValues
+                               deviceData:deviceData
+                               deviceHash:deviceHash
+                              targetToken:targetToken
+                          targetTokenHash:targetTokenHash
+                         inOpenedDatabase:db];
+      }
+    }
+    if (result == SQLITE_OK) {
+      MSACLogVerbose([MSACAppCenter logTag], @"Log is stored with id: '%ld'", (long)sqlite3_last_insert_rowid(db));
+      [self.logCounters addLogsCount:1 size:(long long)logData.length groupId:groupId targetKey:targetKey];
+      [self.unbatchedLogCounters addLogsCount:1 size:(long long)payloadSize groupId:groupId targetKey:targetKey];
+
+      // The log is acknowledged as saved before the transaction it is grouped in is committed.
+      if (!sqlite3_get_autocommit(db)) {
+        self.pendingLogsCounts[groupId] = @(self.pendingLogsCounts[groupId].unsignedIntegerValue + 1);
+      }
+    } else {
+      [self deleteUnreferencedRowWithHash:deviceHash fromTable:kMSACDeviceTableName inOpenedDatabase:db];
+      [self deleteUnreferencedRowWithHash:targetTokenHash fromTable:kMSACTargetTokenTableName inOpenedDatabase:db];
+    }
+    return result;
+  };
+
+  // Critical logs are committed and synced to disk as soon as they are stored, others are grouped in a single transaction.
+  int result = persistenceFlags == MSACFlagsCritical ? [self executeSynchronousQueryUsingBlock:saveBlock]
+                                                     : [self executeGroupedQueryUsingBlock:saveBlock];
+  MSACLogEvictionHandler evictionHandler = self.evictionHandler;
+  if (evictedLogsCounts.count > 0 && evictionHandler) {
+    evictionHandler(evictedLogsCounts);
+  }
+  return result == SQLITE_OK;
+}
+
+- (int)insertLogWithQuery:(NSString *)query
+                   values:(MSACStorageBindableArray *)values
+               deviceData:(nullable NSData *)deviceData
+               deviceHash:(nullable NSData *)deviceHash
+              targetToken:(nullable NSString *)targetToken
+          targetTokenHash:(nullable NSData *)targetTokenHash
+         inOpenedDatabase:(void *)db {
+
+  // Referenced rows are added unreferenced if they are not stored yet, inserting the log references them.
+  int result = SQLITE_OK;
+  if (deviceData) {
+    NSString *addDeviceQuery =
+        [NSString stringWithFormat:@"INSERT OR IGNORE INTO \"%@\" (\"%@\", \"%@\", \"%@\") VALUES (?, ?, 0)", kMSACDeviceTableName,
+                                   kMSACHashColumnName, kMSACDeviceColumnName, kMSACReferenceCountColumnName];
+    MSACStorageBindableArray *addDeviceValues = [MSACStorageBindableArray new];
+    [addDeviceValues addData:deviceHash];
+    [addDeviceValues addData:deviceData];
+    result = [self executeCachedNonSelectionQuery:addDeviceQuery inOpenedDatabase:db withValues:addDeviceValues];
+  }
+
+  // Tokens are only encrypted when they are not stored yet.
+  if (result == SQLITE_OK && targetToken &&
+      ![self rowExistsWithHash:(NSData *)targetTokenHash inTable:kMSACTargetTokenTableName inOpenedDatabase:db]) {
+    NSString *addTargetTokenQuery =
+        [NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\", \"%@\") VALUES (?, ?, 0)", kMSACTargetTokenTableName,
+                                   kMSACHashColumnName, kMSACTargetTokenColumnName, kMSACReferenceCountColumnName];
+    MSACStorageBindableArray *addTargetTokenValues = [MSACStorageBindableArray new];
+    [addTargetTokenValues addData:targetTokenHash];
+    [addTargetTokenValues addString:[self.targetTokenEncrypter encryptString:(NSString *)targetToken]];
+    result = [self executeCachedNonSelectionQuery:addTargetTokenQuery inOpenedDatabase:db withValues:addTargetTokenValues];
+  }
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  return [self executeCachedNonSelectionQuery:query inOpenedDatabase:db withValues:values];
+}
+
++ (NSString *)referenceToTable:(NSString *)table {
+  return [NSString stringWithFormat:@"(SELECT \"%@\" FROM \"%@\" WHERE \"%@\" = ?)", kMSACIdColumnName, table, kMSACHashColumnName];
+}
+
+- (BOOL)rowExistsWithHash:(NSData *)hash inTable:(NSString *)table inOpenedDatabase:(void *)db {
+  NSString *existsQuery = [NSString stringWithFormat:@"SELECT 1 FROM \"%@\" WHERE \"%@\" = ?", table, kMSACHashColumnName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addData:hash];
+  __block BOOL exists = NO;
+  [self enumerateRowsOfCachedQuery:existsQuery
+                  inOpenedDatabase:db
+                        withValues:values
+                        usingBlock:^(__unused MSACStorageCursor *cursor, __unused BOOL *stop) {
+                          exists = YES;
+                        }];
+  return exists;
+}
+
+- (void)deleteUnreferencedRowWithHash:(nullable NSData *)hash fromTable:(NSString *)table inOpenedDatabase:(void *)db {
+  if (!hash) {
+    return;
+  }
+  NSString *deleteQuery = [NSString stringWithFormat:@"DELETE FROM \"%@\" WHERE \"%@\" = ? AND \"%@\" <= 0", table, kMSACHashColumnName,
+                                                     kMSACReferenceCountColumnName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addData:hash];
+  [self executeCachedNonSelectionQuery:deleteQuery inOpenedDatabase:db withValues:values];
+}
+
+- (int)evictLogsToStoreLogOfSize:(NSUInteger)logSize
+                        priority:(MSACFlags)priority
+                inOpenedDatabase:(void *)db
+               evictedLogsCounts:(NSMutableDictionary<NSString *, NSNumber *> *)evictedLogsCounts {
+
+  // Logs of the batches being loaded are not evicted.
+  NSString *claimedCondition =
+      self.loadingBatchesCount > 0 ? [NSString stringWithFormat:@" AND \"%@\" IS NULL", kMSACBatchIdColumnName] : @"";
+
+  // Logs stored prior to version 8 of the schema have no size.
+  NSString *candidatesQuery =
+      [NSString stringWithFormat:@"SELECT \"%@\", \"%@\", \"%@\", COALESCE(\"%@\", LENGTH(\"%@\")) FROM \"%@\" "
+                                 @"WHERE \"%@\" <= ?%@ ORDER BY \"%@\" ASC, \"%@\" ASC",
+                                 kMSACIdColumnName, kMSACGroupIdColumnName, kMSACPriorityColumnName, kMSACSizeColumnName,
+                                 kMSACLogColumnName, kMSACLogTableName, kMSACPriorityColumnName, claimedCondition, kMSACPriorityColumnName,
+                                 kMSACIdColumnName];
+  MSACStorageBindableArray *candidatesValues = [MSACStorageBindableArray new];
+  [candidatesValues addNumber:@(priority)];
+
+  // Plan the eviction of the oldest logs with the lowest priority until their sizes cover the new log and the headroom.
+  NSUInteger requiredSize = logSize + self.evictionHeadroom;
+  __block NSUInteger plannedSize = 0;
+  __block BOOL planned = NO;
+  __block int64_t lastPlannedId = 0;
+  __block int64_t lastPlannedPriority = 0;
+  NSMutableDictionary<NSString *, NSNumber *> *plannedLogsCounts = [NSMutableDictionary new];
+  [self enumerateRowsOfCachedQuery:candidatesQuery
+                  inOpenedDatabase:db
+                        withValues:candidatesValues
+                        usingBlock:^(MSACStorageCursor *cursor, BOOL *stop) {
+                          NSString *groupId = (NSString *)[cursor stringAtIndex:1];
+                          plannedLogsCounts[groupId] = @(plannedLogsCounts[groupId].unsignedIntegerValue + 1);
+                          plannedSize += (NSUInteger)[cursor int64AtIndex:3];
+                          lastPlannedId = [cursor int64AtIndex:0];
+                          lastPlannedPriority = [cursor int64AtIndex:2];
+                          planned = YES;
+                          *stop = plannedSize >= requiredSize;
+                        }];
+  if (!planned) {
+    return SQLITE_FULL;
+  }
+
+  // Planned logs are the first ones in priority then id order, they are deleted at once.
+  NSString *evictionCondition = [NSString stringWithFormat:@"(\"%@\" < ? OR (\"%@\" = ? AND \"%@\" <= ?))%@", kMSACPriorityColumnName,
+                                                           kMSACPriorityColumnName, kMSACIdColumnName, claimedCondition];
+  NSString *evictionQuery = [NSString stringWithFormat:@"DELETE FROM \"%@\" WHERE %@", kMSACLogTableName, evictionCondition];
+  MSACStorageBindableArray *evictionValues = [MSACStorageBindableArray new];
+  [evictionValues addNumber:@(lastPlannedPriority)];
+  [evictionValues addNumber:@(lastPlannedPriority)];
+  [evictionValues addNumber:@(lastPlannedId)];
+  NSArray<NSArray *> *evictedLogCounts = [self logCountsWhere:evictionCondition withValues:evictionValues inOpenedDatabase:db];
+  int result = [self executeCachedNonSelectionQuery:evictionQuery inOpenedDatabase:db withValues:evictionValues];
+  if (result != SQLITE_OK) {
+    MSACLogError([MSACAppCenter logTag], @"Failed to evict logs to store a new log, result=%d.", result);
+    return result;
+  }
+  [self discountLogCounts:evictedLogCounts];
+  MSACLogDebug([MSACAppCenter logTag],
+               @"Log storage was over capacity, %d oldest log(s) with equal or lower priority deleted to free %tu byte(s).",
+               sqlite3_changes(db), plannedSize);
+  for (NSString *groupId in plannedLogsCounts) {
+    evictedLogsCounts[groupId] = @(evictedLogsCounts[groupId].unsignedIntegerValue + plannedLogsCounts[groupId].unsignedIntegerValue);
+  }
+  return SQLITE_OK;
 }
 
 #pragma mark - Load logs
@@ -147,214 +360,568 @@ static const NSUInteger kMSACSchemaVersion = 5;
                       limit:(NSUInteger)limit
          excludedTargetKeys:(nullable NSArray<NSString *> *)excludedTargetKeys
           completionHandler:(nullable MSACLoadDataCompletionHandler)completionHandler {
-  BOOL logsAvailable;
-  BOOL moreLogsAvailable = NO;
-  NSString *batchId;
-  NSMutableArray<NSArray *> *logEntries;
+  NSString *batchId = MSAC_UUID_STRING;
+  __block BOOL moreLogsAvailable = NO;
   NSMutableArray<NSNumber *> *dbIds = [NSMutableArray<NSNumber *> new];
-  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray<id<MSACLog>> new];
 
-  // Get ids from batches.
-  NSMutableArray<NSNumber *> *idsInBatches = [NSMutableArray<NSNumber *> new];
-  for (NSString *batchKey in [self.batches allKeys]) {
-    if ([batchKey hasPrefix:groupId]) {
-      [idsInBatches addObjectsFromArray:(NSArray<NSNumber *> *_Nonnull)self.batches[batchKey]];
-    }
+  // Build the "WHERE" clause's conditions, take only logs that are not already part of a batch.
+  NSMutableString *condition =
+      [NSMutableString stringWithFormat:@"\"%@\" = ? AND \"%@\" IS NULL", kMSACGroupIdColumnName, kMSACBatchIdColumnName];
+  MSACStorageBindableArray *conditionValues = [MSACStorageBindableArray new];
+  MSACStorageBindableArray *sizeValues = [MSACStorageBindableArray new];
+  MSACStorageBindableArray *claimValues = [MSACStorageBindableArray new];
+  [claimValues addString:batchId];
+  for (MSACStorageBindableArray *values in @[ conditionValues, sizeValues, claimValues ]) {
+    [values addString:groupId];
   }
 
-  // Build the "WHERE" clause's conditions.
-  NSMutableString *condition = [NSMutableString stringWithFormat:@"\"%@\" = ?", kMSACGroupIdColumnName];
-  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
-  [values addString:groupId];
-
   // Filter out paused target keys.
   if (excludedTargetKeys != nil && excludedTargetKeys.count > 0) {
     NSString *keyFormat = [self buildKeyFormatWithCount:excludedTargetKeys.count];
     [condition appendFormat:@" AND \"%@\" NOT IN %@", kMSACTargetKeyColumnName, keyFormat];
     for (NSString *item in excludedTargetKeys) {
-      [values addString:item];
+      [conditionValues addString:item];
+      [sizeValues addString:item];
+      [claimValues addString:item];
     }
   }
-
-  // Take only logs that are not already part of a batch.
-  if (idsInBatches.count > 0) {
-    NSString *keyFormat = [self buildKeyFormatWithCount:idsInBatches.count];
-    [condition appendFormat:@" AND \"%@\" NOT IN %@", kMSACIdColumnName, keyFormat];
-    for (NSNumber *item in idsInBatches) {
-      [values addNumber:item];
-    }
+  [sizeValues addNumber:@(limit)];
+  NSUInteger sizeInBytesLimit;
+  @synchronized(self) {
+    sizeInBytesLimit = self.batchSizeInBytesLimits[groupId].unsignedIntegerValue;
   }
 
-  // Build the "ORDER BY" clause's conditions.
-  [condition appendFormat:@" ORDER BY \"%@\" DESC, \"%@\" ASC", kMSACPriorityColumnName, kMSACIdColumnName];
+  // Claim the logs of the batch, in priority then age order.
+  NSString *claimQuery = [NSString stringWithFormat:@"UPDATE \"%@\" SET \"%@\" = ? WHERE \"%@\" IN "
+                                                    @"(SELECT \"%@\" FROM \"%@\" WHERE %@ ORDER BY \"%@\" DESC, \"%@\" ASC LIMIT ?)",
+                                                    kMSACLogTableName, kMSACBatchIdColumnName, kMSACIdColumnName, kMSACIdColumnName,
+                                                    kMSACLogTableName, condition, kMSACPriorityColumnName, kMSACIdColumnName];
+  NSString *moreLogsQuery = [NSString stringWithFormat:@"SELECT EXISTS(SELECT 1 FROM \"%@\" WHERE %@)", kMSACLogTableName, condition];
 
   /*
-   * There is a need to determine if there will be more logs available than those under the limit. This is just about knowing if there is at
-   * least 1 log above the limit.
-   *
-   * FIXME: We should simply use a count API from the consumer object instead of the "limit + 1" technique, it only requires 1 SQL request
-   * instead of 2 for the count but it is a bit confusing and doesn't really fit a database storage.
+   * Logs are sized before compression. Logs stored prior to version 13 of the schema are sized as stored, prior to version 8 they have no
+   * size.
    */
-  [condition appendFormat:@" LIMIT %lu", (unsigned long)((limit < NSUIntegerMax) ? limit + 1 : limit)];
+  NSString *sizesQuery = [NSString
+      stringWithFormat:@"SELECT COALESCE(\"%@\", \"%@\", LENGTH(\"%@\")) FROM \"%@\" WHERE %@ ORDER BY \"%@\" DESC, \"%@\" ASC LIMIT ?",
+                       kMSACPayloadSizeColumnName, kMSACSizeColumnName, kMSACLogColumnName, kMSACLogTableName, condition,
+                       kMSACPriorityColumnName, kMSACIdColumnName];
+  NSString *claimedLogsCondition =
+      [NSString stringWithFormat:@"\"%@\" = ? AND \"%@\" = ?", kMSACGroupIdColumnName, kMSACBatchIdColumnName];
+  MSACStorageBindableArray *claimedLogsValues = [MSACStorageBindableArray new];
+  [claimedLogsValues addString:groupId];
+  [claimedLogsValues addString:batchId];
 
-  // Get log entries from DB.
-  logEntries = [[self logsWithCondition:condition andValues:values] mutableCopy];
+  // Each number of paused target keys makes different statements, they are not worth caching.
+  BOOL cached = excludedTargetKeys.count == 0;
+  __block int claimedLogsCount = 0;
+  [self executeQueryUsingBlock:^int(void *db) {
 
-  // More logs available for the next batch, remove the log in excess for this batch.
-  if (logEntries.count > 0 && logEntries.count > limit) {
-    [logEntries removeLastObject];
-    moreLogsAvailable = YES;
-  }
+    /*
+     * The batch is cut at the size limit, the logs are sized in the order they are claimed. The claim selects the same logs as nothing
+     * changes the table in between, and always takes the first one even if it is bigger than the limit.
+     */
+    __block NSUInteger claimLimit = limit;
+    if (sizeInBytesLimit > 0) {
+      __block NSUInteger sizedLogsCount = 0;
+      __block unsigned long long batchSize = 0;
+      [self enumerateRowsOfQuery:sizesQuery
+                inOpenedDatabase:db
+                      withValues:sizeValues
+                          cached:cached
+                      usingBlock:^(MSACStorageCursor *cursor, BOOL *stop) {
+                        batchSize += (unsigned long long)MAX([cursor int64AtIndex:0], 0);
+                        if (sizedLogsCount > 0 && batchSize > sizeInBytesLimit) {
+                          *stop = YES;
+                          return;
+                        }
+                        sizedLogsCount++;
+                      }];
+      claimLimit = MAX(sizedLogsCount, 1);
+    }
+    [claimValues addNumber:@(claimLimit)];
+    int result = cached ? [self executeCachedNonSelectionQuery:claimQuery inOpenedDatabase:db withValues:claimValues]
+                        : [MSACDBStorage executeNonSelectionQuery:claimQuery inOpenedDatabase:db withValues:claimValues];
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    claimedLogsCount = sqlite3_changes(db);
 
-  // Get lists of logs and DB ids.
-  for (NSArray *logEntry in logEntries) {
-    [dbIds addObject:logEntry[self.idColumnIndex]];
-    [logs addObject:logEntry[self.logColumnIndex]];
+    // Check whether there are logs left for the next batch.
+    if (claimedLogsCount > 0) {
+      [self moveLogCounts:[self logCountsWhere:claimedLogsCondition withValues:claimedLogsValues inOpenedDatabase:db] intoBatch:YES];
+      [self enumerateRowsOfQuery:moreLogsQuery
+                inOpenedDatabase:db
+                      withValues:conditionValues
+                          cached:cached
+                      usingBlock:^(MSACStorageCursor *cursor, __unused BOOL *stop) {
+                        moreLogsAvailable = [cursor int64AtIndex:0] != 0;
+                      }];
+    }
+    return SQLITE_OK;
+  }];
+  if (claimedLogsCount == 0) {
+    if (completionHandler) {
+      completionHandler(@[], nil);
+    }
+    return NO;
   }
 
-  // Generate batch Id.
-  logsAvailable = logEntries.count > 0;
-  if (logsAvailable) {
-    batchId = MSAC_UUID_STRING;
-    self.batches[[groupId stringByAppendingString:batchId]] = dbIds;
-    MSACLogVerbose([MSACAppCenter logTag], @"Load log(s) with id(s) '%@' as batch Id:%@", [dbIds componentsJoinedByString:@"','"], batchId);
+  /*
+   * Get logs from DB. They are read and decoded on the read-only connection when possible, while logs keep being saved. Logs of the
+   * claimed batches are not evicted nor expired until they are loaded.
+   */
+  __block NSArray<id<MSACLog>> *logs = @[];
+  NSMutableArray<NSNumber *> *invalidDbIds = [NSMutableArray<NSNumber *> new];
+  NSString *batchCondition = [NSString stringWithFormat:@"\"%@\" = ? ORDER BY \"%@\" DESC, \"%@\" ASC", kMSACBatchIdColumnName,
+                                                       kMSACPriorityColumnName, kMSACIdColumnName];
+  MSACStorageBindableArray *batchValues = [MSACStorageBindableArray new];
+  [batchValues addString:batchId];
+  self.loadingBatchesCount += 1;
+  [self executeReadQueryUsingBlock:^int(void *db) {
+    logs = [self logsWithCondition:batchCondition andValues:batchValues dbIds:dbIds invalidDbIds:invalidDbIds inOpenedDatabase:db];
+    return SQLITE_OK;
   }
+      completionHandler:^(__unused int result) {
+        self.loadingBatchesCount -= 1;
+        if (invalidDbIds.count > 0) {
+          [self deleteLogsFromDBWithColumnValues:invalidDbIds columnName:kMSACIdColumnName];
+        }
 
-  // Load completed.
-  if (completionHandler) {
-    completionHandler(logs, batchId);
-  }
+        // Logs that can't be deserialized are deleted while loading, the batch may be empty.
+        NSString *loadedBatchId = batchId;
+        if (logs.count > 0) {
+          MSACLogVerbose([MSACAppCenter logTag], @"Load log(s) with id(s) '%@' as batch Id:%@", [dbIds componentsJoinedByString:@"','"],
+                         batchId);
+        } else {
+          loadedBatchId = nil;
+        }
+
+        // Load completed.
+        if (completionHandler) {
+          completionHandler(logs, loadedBatchId);
+        }
+      }];
 
   // Return YES if more logs available.
   return moreLogsAvailable;
 }
 
+- (void)releaseLogsWithBatchId:(NSString *)batchId groupId:(NSString *)groupId {
+  NSString *releaseCondition =
+      [NSString stringWithFormat:@"\"%@\" = ? AND \"%@\" = ?", kMSACGroupIdColumnName, kMSACBatchIdColumnName];
+  NSString *releaseQuery = [NSString stringWithFormat:@"UPDATE \"%@\" SET \"%@\" = NULL WHERE %@", kMSACLogTableName,
+                                                      kMSACBatchIdColumnName, releaseCondition];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addString:groupId];
+  [values addString:batchId];
+  [self executeQueryUsingBlock:^int(void *db) {
+    NSArray<NSArray *> *releasedLogCounts = [self logCountsWhere:releaseCondition withValues:values inOpenedDatabase:db];
+    int result = [self executeCachedNonSelectionQuery:releaseQuery inOpenedDatabase:db withValues:values];
+    if (result == SQLITE_OK) {
+      MSACLogVerbose([MSACAppCenter logTag], @"Released %d log(s) of batch Id:%@", sqlite3_changes(db), batchId);
+      [self moveLogCounts:releasedLogCounts intoBatch:NO];
+    }
+    return result;
+  }];
+}
+
+- (void)releaseAllBatches {
+  NSString *releaseQuery = [NSString stringWithFormat:@"UPDATE \"%@\" SET \"%@\" = NULL WHERE \"%@\" IS NOT NULL", kMSACLogTableName,
+                                                      kMSACBatchIdColumnName, kMSACBatchIdColumnName];
+  [self executeQueryUsingBlock:^int(void *db) {
+    int result = [MSACDBStorage executeNonSelectionQuery:releaseQuery inOpenedDatabase:db];
+    if (result == SQLITE_OK && sqlite3_changes(db) > 0) {
+      MSACLogDebug([MSACAppCenter logTag], @"Released %d log(s) from batches of a previous session.", sqlite3_changes(db));
+    }
+    return result;
+  }];
+}
+
+- (void)setBatchSizeInBytesLimit:(NSUInteger)sizeInBytes forGroupId:(NSString *)groupId {
+  @synchronized(self) {
+    self.batchSizeInBytesLimits[groupId] = @(sizeInBytes);
+  }
+}
+
 #pragma mark - Delete logs
 
 - (NSArray<id<MSACLog>> *)deleteLogsWithGroupId:(NSString *)groupId {
   NSArray<id<MSACLog>> *logs = [self logsFromDBWithGroupId:groupId];
 
-  // Delete logs.
+  // Delete logs, including the ones of pending batches.
   [self deleteLogsFromDBWithColumnValue:groupId columnName:kMSACGroupIdColumnName];
-
-  // Delete related batches.
-  for (NSString *batchKey in [self.batches allKeys]) {
-    if ([batchKey hasPrefix:groupId]) {
-      [self.batches removeObjectForKey:batchKey];
-    }
-  }
+  [self scheduleIncrementalVacuum];
+  [self resumeIncrementalMigration];
   return logs;
 }
 
 - (void)deleteLogsWithBatchId:(NSString *)batchId groupId:(NSString *)groupId {
+  NSString *deleteCondition =
+      [NSString stringWithFormat:@"\"%@\" = ? AND \"%@\" = ?", kMSACGroupIdColumnName, kMSACBatchIdColumnName];
+  NSString *deleteQuery = [NSString stringWithFormat:@"DELETE FROM \"%@\" WHERE %@", kMSACLogTableName, deleteCondition];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addString:groupId];
+  [values addString:batchId];
+  [self executeQueryUsingBlock:^int(void *db) {
+    NSArray<NSArray *> *deletedLogCounts = [self logCountsWhere:deleteCondition withValues:values inOpenedDatabase:db];
+    int result = [self executeCachedNonSelectionQuery:deleteQuery inOpenedDatabase:db withValues:values];
+    if (result == SQLITE_OK) {
+      MSACLogVerbose([MSACAppCenter logTag], @"Deletion of %d log(s) of batch Id:%@ succeeded.", sqlite3_changes(db), batchId);
+      [self discountLogCounts:deletedLogCounts];
+    } else {
+      MSACLogError([MSACAppCenter logTag], @"Deletion of log(s) of batch Id:%@ failed.", batchId);
+    }
+    return result;
+  }];
+
+  // Free the pages of the deleted logs once no more logs are sent.
+  [self scheduleIncrementalVacuum];
+  [self resumeIncrementalMigration];
+}
 
-  // Get log Ids.
-  NSString *batchIdKey = [groupId stringByAppendingString:batchId];
-  NSArray<NSNumber *> *ids = self.batches[batchIdKey];
+#pragma mark - Expiry
 
-  // Delete logs and associated batch.
-  if (ids.count > 0) {
-    [self deleteLogsFromDBWithColumnValues:ids columnName:kMSACIdColumnName];
-    [self.batches removeObjectForKey:batchIdKey];
+- (void)setTimeToLive:(NSTimeInterval)timeToLive forGroupId:(nullable NSString *)groupId flags:(MSACFlags)flags {
+  NSNumber *persistenceFlags = @(flags & kMSACPersistenceFlagsMask);
+  @synchronized(self) {
+    NSMutableDictionary<NSNumber *, NSNumber *> *timeToLives = self.defaultTimeToLives;
+    if (groupId) {
+      timeToLives = self.groupTimeToLives[(NSString *)groupId];
+      if (!timeToLives) {
+        timeToLives = [NSMutableDictionary new];
+        self.groupTimeToLives[(NSString *)groupId] = timeToLives;
+      }
+    }
+    timeToLives[persistenceFlags] = @(timeToLive);
+  }
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)deleteExpiredLogsWithLimit:(NSUInteger)limit {
+  NSMutableDictionary<NSString *, NSNumber *> *expiredLogsCounts = [NSMutableDictionary new];
+  NSDictionary<NSNumber *, NSNumber *> *defaultTimeToLives;
+  NSMutableDictionary<NSString *, NSDictionary<NSNumber *, NSNumber *> *> *groupTimeToLives = [NSMutableDictionary new];
+  @synchronized(self) {
+    defaultTimeToLives = [self.defaultTimeToLives copy];
+    for (NSString *groupId in self.groupTimeToLives) {
+      groupTimeToLives[groupId] = [self.groupTimeToLives[groupId] copy];
+    }
+  }
+  NSString *groupsQuery = [NSString stringWithFormat:@"SELECT DISTINCT \"%@\" FROM \"%@\"", kMSACGroupIdColumnName, kMSACLogTableName];
+
+  /*
+   * Expired logs are found with the index on group Id, priority and timestamp, the oldest ones are deleted first. Logs of the batches being
+   * loaded are kept until they are loaded.
+   */
+  NSString *claimedCondition =
+      self.loadingBatchesCount > 0 ? [NSString stringWithFormat:@" AND \"%@\" IS NULL", kMSACBatchIdColumnName] : @"";
+  NSString *deleteCondition = [NSString stringWithFormat:@"\"%@\" IN (SELECT \"%@\" FROM \"%@\" WHERE \"%@\" = ? AND \"%@\" = ? "
+                                                         @"AND \"%@\" < ?%@ ORDER BY \"%@\" ASC, \"%@\" ASC LIMIT ?)",
+                                                         kMSACIdColumnName, kMSACIdColumnName, kMSACLogTableName, kMSACGroupIdColumnName,
+                                                         kMSACPriorityColumnName, kMSACTimestampColumnName, claimedCondition,
+                                                         kMSACTimestampColumnName, kMSACIdColumnName];
+  NSString *deleteQuery = [NSString stringWithFormat:@"DELETE FROM \"%@\" WHERE %@", kMSACLogTableName, deleteCondition];
+  long long now = (long long)[[NSDate date] timeIntervalSince1970];
+  [self executeQueryUsingBlock:^int(void *db) {
+    NSUInteger remaining = limit;
+    NSArray<NSArray *> *groups = [self executeCachedSelectionQuery:groupsQuery inOpenedDatabase:db withValues:nil];
+    for (NSArray *row in groups) {
+      NSString *groupId = row[0];
+      for (NSNumber *flags in @[ @(MSACFlagsNormal), @(MSACFlagsCritical) ]) {
+        NSNumber *timeToLive = groupTimeToLives[groupId][flags] ?: defaultTimeToLives[flags];
+        if (remaining == 0) {
+          return SQLITE_OK;
+        }
+        if (timeToLive.doubleValue <= 0) {
+          continue;
+        }
+        MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+        [values addString:groupId];
+        [values addNumber:flags];
+        [values addNumber:@(now - (long long)timeToLive.doubleValue)];
+        [values addNumber:@(remaining)];
+        NSArray<NSArray *> *deletedLogCounts = [self logCountsWhere:deleteCondition withValues:values inOpenedDatabase:db];
+        int result = [self executeCachedNonSelectionQuery:deleteQuery inOpenedDatabase:db withValues:values];
+        if (result != SQLITE_OK) {
+          MSACLogError([MSACAppCenter logTag], @"Failed to delete expired logs of %@, result=%d.", groupId, result);
+          return result;
+        }
+        [self discountLogCounts:deletedLogCounts];
+        NSUInteger count = (NSUInteger)sqlite3_changes(db);
+        if (count > 0) {
+          expiredLogsCounts[groupId] = @(expiredLogsCounts[groupId].unsignedIntegerValue + count);
+          remaining -= count;
+        }
+      }
+    }
+    return SQLITE_OK;
+  }];
+  for (NSString *groupId in expiredLogsCounts) {
+    MSACLogDebug([MSACAppCenter logTag], @"Deleted %@ expired log(s) of %@.", expiredLogsCounts[groupId], groupId);
+  }
+  if (expiredLogsCounts.count > 0) {
+    [self scheduleIncrementalVacuum];
+    [self resumeIncrementalMigration];
   }
+  return expiredLogsCounts;
 }
 
 #pragma mark - DB selection
 
 - (NSArray<id<MSACLog>> *)logsFromDBWithGroupId:(NSString *)groupId {
-
-  // Get log entries for the given group Id.
   NSString *condition = [NSString stringWithFormat:@"\"%@\" = ?", kMSACGroupIdColumnName];
   MSACStorageBindableArray *values = [MSACStorageBindableArray new];
   [values addString:groupId];
-  NSArray<NSArray *> *logEntries = [self logsWithCondition:condition andValues:values];
+  return [self logsWithCondition:condition andValues:values dbIds:nil];
+}
 
-  // Get logs only.
-  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray<id<MSACLog>> new];
-  for (NSArray *logEntry in logEntries) {
-    [logs addObject:logEntry[self.logColumnIndex]];
+- (NSArray<id<MSACLog>> *)logsWithCondition:(NSString *)condition
+                                  andValues:(nullable MSACStorageBindableArray *)values
+                                      dbIds:(nullable NSMutableArray<NSNumber *> *)dbIds {
+  __block NSArray<id<MSACLog>> *logs = nil;
+  NSMutableArray<NSNumber *> *invalidDbIds = [NSMutableArray<NSNumber *> new];
+  [self executeQueryUsingBlock:^int(void *db) {
+    logs = [self logsWithCondition:condition andValues:values dbIds:dbIds invalidDbIds:invalidDbIds inOpenedDatabase:db];
+    return SQLITE_OK;
+  }];
+
+  // The archived logs that are not valid are deleted once all the rows are read.
+  if (invalidDbIds.count > 0) {
+    [self deleteLogsFromDBWithColumnValues:invalidDbIds columnName:kMSACIdColumnName];
   }
+  return logs ?: @[];
+}
+
+- (NSArray<id<MSACLog>> *)logsWithCondition:(NSString *)condition
+                                  andValues:(nullable MSACStorageBindableArray *)values
+                                      dbIds:(nullable NSMutableArray<NSNumber *> *)dbIds
+                               invalidDbIds:(NSMutableArray<NSNumber *> *)invalidDbIds
+                           inOpenedDatabase:(void *)db {
+  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray<id<MSACLog>> new];
+
+  // Logs referencing the same device share a single instance of it.
+  NSMutableDictionary<NSNumber *, MSACDevice *> *devices = [NSMutableDictionary new];
+  NSString *query = [NSString stringWithFormat:@"SELECT \"%@\", \"%@\", \"%@\", \"%@\", \"%@\", \"%@\" FROM \"%@\" WHERE %@",
+                                               kMSACIdColumnName, kMSACLogColumnName, kMSACTargetTokenColumnName, kMSACDeviceIdColumnName,
+                                               kMSACTargetTokenIdColumnName, kMSACDictionaryVersionColumnName, kMSACLogTableName,
+                                               condition];
+  [self enumerateRowsOfCachedQuery:query
+                  inOpenedDatabase:db
+                        withValues:values
+                        usingBlock:^(MSACStorageCursor *cursor, __unused BOOL *stop) {
+                          int64_t dbId = [cursor int64AtIndex:0];
+
+                          /*
+                           * Binary archives are unarchived straight from the row bytes, compressed logs are decompressed and
+                           * other formats get a copy.
+                           */
+                          id value;
+                          int64_t dictionaryVersion = [cursor int64AtIndex:5];
+                          if ([cursor isTextAtIndex:1]) {
+                            value = [cursor stringAtIndex:1];
+                          } else if (dictionaryVersion > 0) {
+                            NSData *data = [cursor dataWithoutCopyAtIndex:1];
+                            value = data ? [MSACLogDBStorage decompressArchivedLog:(NSData *)data
+                                                                 dictionaryVersion:(NSUInteger)dictionaryVersion]
+                                         : nil;
+                          } else {
+                            NSData *data = [cursor dataWithoutCopyAtIndex:1];
+                            if (data && ![MSACBinaryUnarchiver isBinaryArchive:(NSData *)data]) {
+                              data = [NSData dataWithBytes:data.bytes length:data.length];
+                            }
+                            value = data;
+                          }
+                          id<MSACLog> log = value ? [MSACLogDBStorage unarchiveLogFromColumnValue:(id)value] : nil;
+                          if (!log) {
+
+                            // The archived log is not valid, it is deleted once all the rows are read.
+                            MSACLogError([MSACAppCenter logTag], @"Deserialization failed for log with Id %lld", dbId);
+                            [invalidDbIds addObject:@(dbId)];
+                            return;
+                          }
+
+                          // Restore the device.
+                          if (![cursor isNullAtIndex:3]) {
+                            int64_t deviceId = [cursor int64AtIndex:3];
+                            MSACDevice *device = devices[@(deviceId)] ?: [self deviceWithId:deviceId inOpenedDatabase:db];
+                            if (!device) {
+                              MSACLogError([MSACAppCenter logTag], @"Missing device %lld for log with Id %lld", deviceId, dbId);
+                              [invalidDbIds addObject:@(dbId)];
+                              return;
+                            }
+                            devices[@(deviceId)] = device;
+                            log.device = device;
+                          }
+
+                          // Restore the target token, logs stored prior to version 11 of the schema have their own token.
+                          if (![cursor isNullAtIndex:4]) {
+                            NSString *targetToken = [self targetTokenWithId:[cursor int64AtIndex:4] inOpenedDatabase:db];
+                            if (targetToken) {
+                              [log addTransmissionTargetToken:targetToken];
+                            } else {
+                              MSACLogError([MSACAppCenter logTag], @"Failed to decrypt the target token for log with Id %lld.", dbId);
+                            }
+                          }
+                          NSString *encryptedToken = [cursor stringAtIndex:2];
+                          if (encryptedToken) {
+                            if (encryptedToken.length > 0) {
+                              NSString *targetToken = [self.targetTokenEncrypter decryptString:encryptedToken];
+                              if (targetToken) {
+                                [log addTransmissionTargetToken:targetToken];
+                              } else {
+                                MSACLogError([MSACAppCenter logTag], @"Failed to decrypt the target token for log with Id %lld.", dbId);
+                              }
+                            } else {
+                              MSACLogError([MSACAppCenter logTag], @"Unexpected empty target token for log with Id %lld.", dbId);
+                            }
+                          }
+                          [dbIds addObject:@(dbId)];
+                          [logs addObject:log];
+                        }];
   return logs;
 }
 
-- (NSArray<NSArray *> *)logsWithCondition:(NSString *_Nullable)condition andValues:(nullable MSACStorageBindableArray *)values {
-  NSMutableArray<NSArray *> *logEntries = [NSMutableArray<NSArray *> new];
-  NSMutableString *query = [NSMutableString stringWithFormat:@"SELECT * FROM \"%@\"", kMSACLogTableName];
-  if (condition.length > 0) {
-    [query appendFormat:@" WHERE %@", condition];
+- (nullable MSACDevice *)deviceWithId:(int64_t)deviceId inOpenedDatabase:(void *)db {
+  NSString *deviceQuery = [NSString stringWithFormat:@"SELECT \"%@\" FROM \"%@\" WHERE \"%@\" = ?", kMSACDeviceColumnName,
+                                                     kMSACDeviceTableName, kMSACIdColumnName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addNumber:@(deviceId)];
+  __block id device = nil;
+  [self enumerateRowsOfCachedQuery:deviceQuery
+                  inOpenedDatabase:db
+                        withValues:values
+                        usingBlock:^(MSACStorageCursor *cursor, __unused BOOL *stop) {
+                          NSData *data = [cursor dataWithoutCopyAtIndex:0];
+                          device = data ? [MSACBinaryUnarchiver unarchivedObjectWithData:(NSData *)data] : nil;
+                        }];
+  return [device isKindOfClass:[MSACDevice class]] ? device : nil;
+}
+
+- (nullable NSString *)targetTokenWithId:(int64_t)targetTokenId inOpenedDatabase:(void *)db {
+  NSString *targetToken = [self.decryptedTargetTokens objectForKey:@(targetTokenId)];
+  if (targetToken) {
+    return targetToken;
+  }
+  NSString *targetTokenQuery = [NSString stringWithFormat:@"SELECT \"%@\" FROM \"%@\" WHERE \"%@\" = ?", kMSACTargetTokenColumnName,
+                                                          kMSACTargetTokenTableName, kMSACIdColumnName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addNumber:@(targetTokenId)];
+  __block NSString *encryptedToken = nil;
+  [self enumerateRowsOfCachedQuery:targetTokenQuery
+                  inOpenedDatabase:db
+                        withValues:values
+                        usingBlock:^(MSACStorageCursor *cursor, __unused BOOL *stop) {
+                          encryptedToken = [cursor stringAtIndex:0];
+                        }];
+  targetToken = encryptedToken.length > 0 ? [self.targetTokenEncrypter decryptString:(NSString *)encryptedToken] : nil;
+  if (targetToken) {
+    [self.decryptedTargetTokens setObject:(NSString *)targetToken forKey:@(targetTokenId)];
   }
-  NSArray<NSArray *> *entries = [self executeSelectionQuery:query withValues:values];
+  return targetToken;
+}
 
-  // Get logs from DB.
-  for (NSMutableArray *row in entries) {
-    NSNumber *dbId = row[self.idColumnIndex];
-    NSData *logData = [[NSData alloc] initWithBase64EncodedString:row[self.logColumnIndex]
-                                                          options:NSDataBase64DecodingIgnoreUnknownCharacters];
-    id<MSACLog> log;
+- (void)encryptionKeyDidRotate:(__unused NSNotification *)notification {
 
-    // Deserialize the log.
-    log = (id<MSACLog>)[MSACUtility unarchiveKeyedData:logData];
-    if (!log) {
+  // Tokens encrypted with the previous key are decrypted again rather than trusted from memory.
+  [self.decryptedTargetTokens removeAllObjects];
+}
 
-      // The archived log is not valid.
-      MSACLogError([MSACAppCenter logTag], @"Deserialization failed for log with Id %@", dbId);
-      [self deleteLogFromDBWithId:dbId];
-      continue;
-    }
+#pragma mark - Serialization
 
-    // Deserialize target token. A token value from the row dictionary can't be `nil` but can be of class `NSNull`.
-    NSString *encryptedToken = row[self.targetTokenColumnIndex];
-    if ([encryptedToken isKindOfClass:[NSString class]]) {
-      if (encryptedToken.length > 0) {
-        NSString *targetToken = [self.targetTokenEncrypter decryptString:encryptedToken];
-        if (targetToken) {
-          [log addTransmissionTargetToken:targetToken];
-        } else {
-          MSACLogError([MSACAppCenter logTag], @"Failed to decrypt the target token for log with Id %@.", dbId);
-        }
-      } else {
-        MSACLogError([MSACAppCenter logTag], @"Unexpected empty target token for log with Id %@.", dbId);
-      }
-    }
++ (nullable NSData *)archiveLog:(id<MSACLog>)log {
+  NSData *data = [MSACBinaryArchiver archivedDataWithRootObject:log];
+  if (!data) {
 
-    // Update with deserialized log.
-    row[self.logColumnIndex] = log;
-    [logEntries addObject:row];
+    // Keep the log anyway if it can't be archived in the compact format.
+    data = [MSACUtility archiveKeyedData:log];
   }
-  return logEntries;
+  return data;
 }
 
-#pragma mark - DB deletion
++ (NSData *)compressArchivedLog:(NSData *)data dictionaryVersion:(nullable NSUInteger *)dictionaryVersion {
+  NSData *dictionary = [MSACLogCompressionDictionary dictionaryWithVersion:kMSACLogCompressionDictionaryVersion];
+  NSData *compressedData = dictionary ? [MSACCompression compressData:data withDictionary:(NSData *)dictionary] : nil;
+  BOOL compressed = compressedData && compressedData.length < data.length;
+  if (dictionaryVersion) {
+    *dictionaryVersion = compressed ? kMSACLogCompressionDictionaryVersion : 0;
+  }
+  return compressed ? (NSData *)compressedData : data;
+}
+
++ (nullable NSData *)decompressArchivedLog:(NSData *)data dictionaryVersion:(NSUInteger)dictionaryVersion {
+  NSData *dictionary = [MSACLogCompressionDictionary dictionaryWithVersion:dictionaryVersion];
+  if (!dictionary) {
+    MSACLogError([MSACAppCenter logTag], @"Unknown compression dictionary version %tu.", dictionaryVersion);
+    return nil;
+  }
+  return [MSACCompression decompressData:data withDictionary:(NSData *)dictionary];
+}
+
++ (nullable NSData *)archiveLogWithoutDevice:(id<MSACLog>)log {
+  return [MSACBinaryArchiver archivedDataWithRootObject:log excludingObject:log.device];
+}
+
++ (NSData *)hashOfData:(NSData *)data {
+  unsigned char hash[CC_SHA256_DIGEST_LENGTH];
+  CC_SHA256(data.bytes, (CC_LONG)data.length, hash);
+  return [NSData dataWithBytes:hash length:CC_SHA256_DIGEST_LENGTH];
+}
+
++ (nullable id<MSACLog>)unarchiveLogFromColumnValue:(id)value {
+  id object;
+  if ([value isKindOfClass:[NSData class]]) {
+    NSData *data = value;
+    if ([MSACBinaryUnarchiver isBinaryArchive:data]) {
+      object = [MSACBinaryUnarchiver unarchivedObjectWithData:data];
+    } else {
+      object = [MSACUtility unarchiveKeyedData:data];
+    }
+  } else if ([value isKindOfClass:[NSString class]]) {
 
-- (void)deleteLogFromDBWithId:(NSNumber *)dbId {
-  [self deleteLogsFromDBWithColumnValue:dbId columnName:kMSACIdColumnName];
+    // Logs stored prior to version 6 of the schema are base64 encoded keyed archives.
+    NSData *data = [[NSData alloc] initWithBase64EncodedString:value options:NSDataBase64DecodingIgnoreUnknownCharacters];
+    object = [MSACUtility unarchiveKeyedData:data];
+  }
+  return [object conformsToProtocol:@protocol(MSACLog)] ? object : nil;
 }
 
+#pragma mark - DB deletion
+
 - (void)deleteLogsFromDBWithColumnValue:(id)columnValue columnName:(NSString *)columnName {
   [self deleteLogsFromDBWithColumnValues:@[ columnValue ] columnName:columnName];
 }
 
 - (void)deleteLogsFromDBWithColumnValues:(NSArray *)columnValues columnName:(NSString *)columnName {
   [self executeQueryUsingBlock:^int(void *db) {
-    return [MSACLogDBStorage deleteLogsFromDBWithColumnValues:columnValues columnName:columnName inOpenedDatabase:db];
+    return [self deleteLogsFromDBWithColumnValues:columnValues columnName:columnName inOpenedDatabase:db];
   }];
 }
 
-+ (int)deleteLogsFromDBWithColumnValues:(NSArray *)columnValues columnName:(NSString *)columnName inOpenedDatabase:(void *)db {
+- (int)deleteLogsFromDBWithColumnValues:(NSArray *)columnValues columnName:(NSString *)columnName inOpenedDatabase:(void *)db {
   NSString *deletionTrace = [NSString
       stringWithFormat:@"Deletion of log(s) by %@ with value(s) '%@'", columnName, [columnValues componentsJoinedByString:@"','"]];
 
-  // Build up delete query.
-  char surroundingChar = (char)(([(NSObject *)[columnValues firstObject] isKindOfClass:[NSString class]]) ? '\'' : '\0');
-  NSString *valuesSeparation = [NSString stringWithFormat:@"%c, %c", surroundingChar, surroundingChar];
-  NSString *whereCondition = [NSString stringWithFormat:@"\"%@\" IN (%c%@%c)", columnName, surroundingChar,
-                                                        [columnValues componentsJoinedByString:valuesSeparation], surroundingChar];
-  NSString *deleteLogsQuery = [NSString stringWithFormat:@"DELETE FROM \"%@\" WHERE %@", kMSACLogTableName, whereCondition];
+  // Build up delete query, values are bound so that the statement of a single value is reused. Lists of several values are not cached.
+  NSString *deleteCondition =
+      [NSString stringWithFormat:@"\"%@\" IN %@", columnName, [self buildKeyFormatWithCount:columnValues.count]];
+  NSString *deleteLogsQuery = [NSString stringWithFormat:@"DELETE FROM \"%@\" WHERE %@", kMSACLogTableName, deleteCondition];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  for (id value in columnValues) {
+    if ([value isKindOfClass:[NSNumber class]]) {
+      [values addNumber:value];
+    } else {
+      [values addString:value];
+    }
+  }
 
   // Execute.
-  int result = [MSACDBStorage executeNonSelectionQuery:deleteLogsQuery inOpenedDatabase:db];
+  BOOL cached = columnValues.count == 1;
+  NSArray<NSArray *> *deletedLogCounts = [self logCountsWhere:deleteCondition withValues:values cached:cached inOpenedDatabase:db];
+  int result = cached ? [self executeCachedNonSelectionQuery:deleteLogsQuery inOpenedDatabase:db withValues:values]
+                      : [MSACDBStorage executeNonSelectionQuery:deleteLogsQuery inOpenedDatabase:db withValues:values];
   if (result == SQLITE_OK) {
     MSACLogVerbose([MSACAppCenter logTag], @"%@ succeeded.", deletionTrace);
+    [self discountLogCounts:deletedLogCounts];
   } else {
     MSACLogError([MSACAppCenter logTag], @"%@ failed.", deletionTrace);
   }
@@ -367,33 +934,289 @@ static const NSUInteger kMSACSchemaVersion = 5;
   return [self countEntriesForTable:kMSACLogTableName condition:nil withValues:nil];
 }
 
+- (NSUInteger)countLogsWithGroupId:(NSString *)groupId excludedTargetKeys:(nullable NSArray<NSString *> *)excludedTargetKeys {
+  if (self.logCountersNeedRebuild) {
+    [self rebuildLogCounters];
+  }
+  return [self.logCounters countLogsWithGroupId:groupId excludedTargetKeys:excludedTargetKeys];
+}
+
+- (long long)sizeOfLogsWithGroupId:(NSString *)groupId {
+  if (self.logCountersNeedRebuild) {
+    [self rebuildLogCounters];
+  }
+  return [self.logCounters sizeOfLogsWithGroupId:groupId];
+}
+
+- (long long)sizeOfUnbatchedLogsWithGroupId:(NSString *)groupId {
+  if (self.logCountersNeedRebuild) {
+    [self rebuildLogCounters];
+  }
+  return [self.unbatchedLogCounters sizeOfLogsWithGroupId:groupId];
+}
+
+- (void)rebuildLogCounters {
+  self.logCountersNeedRebuild = NO;
+  [self executeQueryUsingBlock:^int(void *db) {
+    NSArray<NSArray *> *logCounts = [self logCountsWhere:nil withValues:nil inOpenedDatabase:db];
+    [self.logCounters removeAllLogs];
+    [self.unbatchedLogCounters removeAllLogs];
+    [self countLogCounts:logCounts];
+    return SQLITE_OK;
+  }];
+}
+
+- (NSArray<NSArray *> *)logCountsWhere:(nullable NSString *)condition
+                            withValues:(nullable MSACStorageBindableArray *)values
+                      inOpenedDatabase:(void *)db {
+  return [self logCountsWhere:condition withValues:values cached:YES inOpenedDatabase:db];
+}
+
+- (NSArray<NSArray *> *)logCountsWhere:(nullable NSString *)condition
+                            withValues:(nullable MSACStorageBindableArray *)values
+                                cached:(BOOL)cached
+                      inOpenedDatabase:(void *)db {
+
+  /*
+   * Logs are counted with their stored size and their size before compression, apart from the logs of pending batches. Logs stored prior to
+   * version 13 of the schema have no size before compression, prior to version 8 they have no size.
+   */
+  NSString *whereClause = condition ? [@" WHERE " stringByAppendingString:(NSString *)condition] : @"";
+  NSString *query =
+      [NSString stringWithFormat:@"SELECT \"%@\", \"%@\", COUNT(*), SUM(COALESCE(\"%@\", LENGTH(\"%@\"))), "
+                                 @"SUM(COALESCE(\"%@\", \"%@\", LENGTH(\"%@\"))), \"%@\" IS NULL FROM \"%@\"%@ "
+                                 @"GROUP BY \"%@\", \"%@\", \"%@\" IS NULL",
+                                 kMSACGroupIdColumnName, kMSACTargetKeyColumnName, kMSACSizeColumnName, kMSACLogColumnName,
+                                 kMSACPayloadSizeColumnName, kMSACSizeColumnName, kMSACLogColumnName, kMSACBatchIdColumnName,
+                                 kMSACLogTableName, whereClause, kMSACGroupIdColumnName, kMSACTargetKeyColumnName, kMSACBatchIdColumnName];
+  return cached ? [self executeCachedSelectionQuery:query inOpenedDatabase:db withValues:values]
+                : [MSACDBStorage executeSelectionQuery:query inOpenedDatabase:db withValues:values];
+}
+
+- (void)countLogCounts:(NSArray<NSArray *> *)logCounts {
+  [self addLogCounts:logCounts sign:1];
+}
+
+- (void)discountLogCounts:(NSArray<NSArray *> *)logCounts {
+  [self addLogCounts:logCounts sign:-1];
+}
+
+- (void)addLogCounts:(NSArray<NSArray *> *)logCounts sign:(NSInteger)sign {
+  for (NSArray *row in logCounts) {
+    NSString *targetKey = row[1] == [NSNull null] ? nil : row[1];
+    [self.logCounters addLogsCount:sign * [row[2] integerValue] size:sign * [row[3] longLongValue] groupId:row[0] targetKey:targetKey];
+    if ([row[5] boolValue]) {
+      [self.unbatchedLogCounters addLogsCount:sign * [row[2] integerValue]
+                                         size:sign * [row[4] longLongValue]
+                                      groupId:row[0]
+                                    targetKey:targetKey];
+    }
+  }
+}
+
+- (void)moveLogCounts:(NSArray<NSArray *> *)logCounts intoBatch:(BOOL)intoBatch {
+  NSInteger sign = intoBatch ? -1 : 1;
+  for (NSArray *row in logCounts) {
+    [self.unbatchedLogCounters addLogsCount:sign * [row[2] integerValue]
+                                       size:sign * [row[4] longLongValue]
+                                    groupId:row[0]
+                                  targetKey:row[1] == [NSNull null] ? nil : row[1]];
+  }
+}
+
+- (void)transactionDidRollBack {
+
+  // Counters have been updated along with changes that are now lost.
+  self.logCountersNeedRebuild = YES;
+
+  // Logs of the transaction have been reported as saved, the channels are told they are lost.
+  NSDictionary<NSString *, NSNumber *> *lostLogsCounts = [self.pendingLogsCounts copy];
+  [self.pendingLogsCounts removeAllObjects];
+  MSACLogEvictionHandler lostLogsHandler = self.lostLogsHandler;
+  if (lostLogsCounts.count > 0 && lostLogsHandler) {
+    lostLogsHandler(lostLogsCounts);
+  }
+}
+
+- (void)transactionDidCommit {
+  [self.pendingLogsCounts removeAllObjects];
+}
+
+- (void)commitPendingLogs {
+  [self commitPendingTransaction];
+}
+
 #pragma mark - DB migration
 
+- (int)migrateRowsOfStagedTable:(NSString *)stagedTableName
+                        toTable:(NSString *)tableName
+                    fromVersion:(NSUInteger)version
+                      fromRowId:(int64_t)firstRowId
+                        toRowId:(int64_t)lastRowId
+               inOpenedDatabase:(void *)db {
+  if (![tableName isEqualToString:kMSACLogTableName]) {
+    return [super migrateRowsOfStagedTable:stagedTableName
+                                   toTable:tableName
+                               fromVersion:version
+                                 fromRowId:firstRowId
+                                   toRowId:lastRowId
+                          inOpenedDatabase:db];
+  }
+
+  /*
+   * Legacy logs are base64 archives in a TEXT column, which are still read. They keep their id, the columns added by later versions of the
+   * schema are left empty and their age is unknown, they start aging from now on.
+   */
+  NSArray<NSString *> *stagedColumnNames = [MSACDBStorage columnNamesOfTable:stagedTableName inOpenedDatabase:db];
+  NSString * (^column)(NSString *) = ^NSString *(NSString *columnName) {
+    return [stagedColumnNames containsObject:columnName] ? [NSString stringWithFormat:@"\"%@\"", columnName] : @"NULL";
+  };
+  NSString *query = [NSString
+      stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\", \"%@\", \"%@\", \"%@\", \"%@\", \"%@\") "
+                       @"SELECT \"rowid\", \"%@\", \"%@\", %@, %@, COALESCE(%@, ?), ? FROM \"%@\" WHERE \"rowid\" BETWEEN ? AND ?",
+                       kMSACLogTableName, kMSACIdColumnName, kMSACGroupIdColumnName, kMSACLogColumnName, kMSACTargetTokenColumnName,
+                       kMSACTargetKeyColumnName, kMSACPriorityColumnName, kMSACTimestampColumnName, kMSACGroupIdColumnName,
+                       kMSACLogColumnName, column(kMSACTargetTokenColumnName), column(kMSACTargetKeyColumnName),
+                       column(kMSACPriorityColumnName), stagedTableName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addNumber:@(MSACFlagsNormal)];
+  [values addNumber:@((long long)[[NSDate date] timeIntervalSince1970])];
+  [values addNumber:@(firstRowId)];
+  [values addNumber:@(lastRowId)];
+  int result = [MSACDBStorage executeNonSelectionQuery:query inOpenedDatabase:db withValues:values];
+  if (result == SQLITE_OK) {
+    NSString *condition = [NSString stringWithFormat:@"\"%@\" BETWEEN ? AND ?", kMSACIdColumnName];
+    MSACStorageBindableArray *countValues = [MSACStorageBindableArray new];
+    [countValues addNumber:@(firstRowId)];
+    [countValues addNumber:@(lastRowId)];
+    [self countLogCounts:[self logCountsWhere:condition withValues:countValues inOpenedDatabase:db]];
+  }
+  return result;
+}
+
 - (void)createPriorityIndex:(void *)db {
   NSString *indexStatement = [NSString stringWithFormat:@"CREATE INDEX \"ix_%@_%@\" ON \"%@\" (\"%@\")", kMSACLogTableName,
                                                         kMSACPriorityColumnName, kMSACLogTableName, kMSACPriorityColumnName];
   [MSACDBStorage executeNonSelectionQuery:indexStatement inOpenedDatabase:db];
 }
 
+- (void)createBatchIndex:(void *)db {
+  NSString *indexStatement =
+      [NSString stringWithFormat:@"CREATE INDEX IF NOT EXISTS \"ix_%@_%@_%@_%@_%@\" ON \"%@\" (\"%@\", \"%@\", \"%@\" DESC, \"%@\")",
+                                 kMSACLogTableName, kMSACGroupIdColumnName, kMSACBatchIdColumnName, kMSACPriorityColumnName,
+                                 kMSACIdColumnName, kMSACLogTableName, kMSACGroupIdColumnName, kMSACBatchIdColumnName,
+                                 kMSACPriorityColumnName, kMSACIdColumnName];
+  [MSACDBStorage executeNonSelectionQuery:indexStatement inOpenedDatabase:db];
+}
+
+- (void)createTimestampIndex:(void *)db {
+  NSString *indexStatement =
+      [NSString stringWithFormat:@"CREATE INDEX IF NOT EXISTS \"ix_%@_%@_%@_%@\" ON \"%@\" (\"%@\", \"%@\", \"%@\")", kMSACLogTableName,
+                                 kMSACGroupIdColumnName, kMSACPriorityColumnName, kMSACTimestampColumnName, kMSACLogTableName,
+                                 kMSACGroupIdColumnName, kMSACPriorityColumnName, kMSACTimestampColumnName];
+  [MSACDBStorage executeNonSelectionQuery:indexStatement inOpenedDatabase:db];
+}
+
+/*
+ * Devices and target tokens are counted by the logs referencing them and deleted along with the last one. Triggers keep the count up to
+ * date whichever statement inserts or deletes the logs.
+ */
+- (void)createReferencesWithName:(NSString *)name column:(NSString *)column table:(NSString *)table inOpenedDatabase:(void *)db {
+  NSString *indexStatement = [NSString stringWithFormat:@"CREATE UNIQUE INDEX IF NOT EXISTS \"ix_%@_%@\" ON \"%@\" (\"%@\")", table,
+                                                        kMSACHashColumnName, table, kMSACHashColumnName];
+  NSString *insertTrigger =
+      [NSString stringWithFormat:@"CREATE TRIGGER IF NOT EXISTS \"tr_%@_insert_%@\" AFTER INSERT ON \"%@\" WHEN NEW.\"%@\" IS NOT NULL "
+                                 @"BEGIN UPDATE \"%@\" SET \"%@\" = \"%@\" + 1 WHERE \"%@\" = NEW.\"%@\"; END",
+                                 kMSACLogTableName, name, kMSACLogTableName, column, table, kMSACReferenceCountColumnName,
+                                 kMSACReferenceCountColumnName, kMSACIdColumnName, column];
+  NSString *deleteTrigger =
+      [NSString stringWithFormat:@"CREATE TRIGGER IF NOT EXISTS \"tr_%@_delete_%@\" AFTER DELETE ON \"%@\" WHEN OLD.\"%@\" IS NOT NULL "
+                                 @"BEGIN UPDATE \"%@\" SET \"%@\" = \"%@\" - 1 WHERE \"%@\" = OLD.\"%@\"; "
+                                 @"DELETE FROM \"%@\" WHERE \"%@\" = OLD.\"%@\" AND \"%@\" <= 0; END",
+                                 kMSACLogTableName, name, kMSACLogTableName, column, table, kMSACReferenceCountColumnName,
+                                 kMSACReferenceCountColumnName, kMSACIdColumnName, column, table, kMSACIdColumnName, column,
+                                 kMSACReferenceCountColumnName];
+  [MSACDBStorage executeNonSelectionQuery:indexStatement inOpenedDatabase:db];
+  [MSACDBStorage executeNonSelectionQuery:insertTrigger inOpenedDatabase:db];
+  [MSACDBStorage executeNonSelectionQuery:deleteTrigger inOpenedDatabase:db];
+}
+
+- (void)createDeviceReferences:(void *)db {
+  [self createReferencesWithName:kMSACDeviceColumnName column:kMSACDeviceIdColumnName table:kMSACDeviceTableName inOpenedDatabase:db];
+}
+
+- (void)createTargetTokenReferences:(void *)db {
+  [self createReferencesWithName:kMSACTargetTokenColumnName
+                          column:kMSACTargetTokenIdColumnName
+                           table:kMSACTargetTokenTableName
+                inOpenedDatabase:db];
+}
+
 - (void)customizeDatabase:(void *)db {
   [self createPriorityIndex:db];
+  [self createBatchIndex:db];
+  [self createTimestampIndex:db];
+  [self createDeviceReferences:db];
+  [self createTargetTokenReferences:db];
 }
 
 /*
  * Migration process is implemented through database versioning.
  * After altering current schema, database version should be bumped and actions for migration should be implemented in this method.
  */
-- (void)migrateDatabase:(void *)db fromVersion:(NSUInteger __unused)version {
+- (void)migrateDatabase:(void *)db fromVersion:(NSUInteger)version {
+
+  /*
+   * With version 3.0 of the SDK we decided to remove timestamp column and SQLite does not support removing column. The legacy table is
+   * staged and its logs are copied to a new table chunk by chunk, see `migrateRowsOfStagedTable:toTable:fromVersion:fromRowId:toRowId:`.
+   * New logs are numbered after the legacy ones so that they keep their order.
+   */
+  if (version < kMSACStageTableVersion) {
+    if ([MSACDBStorage stageTable:kMSACLogTableName forMigrationFromVersion:version inOpenedDatabase:db] != SQLITE_OK) {
+      [self dropTable:kMSACLogTableName];
+    }
+    [MSACDBStorage createTablesWithSchema:self.schema inOpenedDatabase:db];
+    [self customizeDatabase:db];
+    NSString *stagedTableName = [MSACDBStorage stagedTableNameForTable:kMSACLogTableName fromVersion:version];
+    if ([MSACDBStorage tableExists:stagedTableName inOpenedDatabase:db]) {
+      NSString *sequenceQuery = [NSString
+          stringWithFormat:@"INSERT INTO \"sqlite_sequence\" (\"name\", \"seq\") SELECT ?, \"rowid\" FROM \"%@\" WHERE NOT EXISTS "
+                           @"(SELECT 1 FROM \"sqlite_sequence\" WHERE \"name\" = ?) ORDER BY \"rowid\" DESC LIMIT 1",
+                           stagedTableName];
+      MSACStorageBindableArray *sequenceValues = [MSACStorageBindableArray new];
+      [sequenceValues addString:kMSACLogTableName];
+      [sequenceValues addString:kMSACLogTableName];
+      [MSACDBStorage executeNonSelectionQuery:sequenceQuery inOpenedDatabase:db withValues:sequenceValues];
+    }
+    return;
+  }
 
   /*
-   * With version 3.0 of the SDK we decided to remove timestamp column and as
-   * it's a major SDK version and SQLite does not support removing column we just start over.
-   * When adding a new column in a future version, update this code by something like
-   * if (version <= kMSACDropTableVersion) {drop/create} else {add missing columns}
+   * Version 6 stores logs as binary archives in a BLOB column. The declared type of the existing column can't be changed but, with its
+   * TEXT affinity, it stores BLOB values as is. Logs stored as base64 strings are still read, so they are not rewritten.
    */
-  [self dropTable:kMSACLogTableName];
-  [MSACDBStorage createTablesWithSchema:self.schema inOpenedDatabase:db];
-  [self customizeDatabase:db];
+
+  // Version 7 adds the batch Id column, version 8 the size column. Sizes of existing logs are computed when they are needed.
+  [MSACDBStorage addMissingColumnsToTable:kMSACLogTableName columnsSchema:self.schema[kMSACLogTableName] inOpenedDatabase:db];
+  [self createBatchIndex:db];
+
+  // Version 9 adds the timestamp column. The age of existing logs is unknown, they start aging from now on.
+  NSString *timestampQuery = [NSString stringWithFormat:@"UPDATE \"%@\" SET \"%@\" = ? WHERE \"%@\" IS NULL", kMSACLogTableName,
+                                                        kMSACTimestampColumnName, kMSACTimestampColumnName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addNumber:@((long long)[[NSDate date] timeIntervalSince1970])];
+  [MSACDBStorage executeNonSelectionQuery:timestampQuery inOpenedDatabase:db withValues:values];
+  [self createTimestampIndex:db];
+
+  // Version 10 adds the devices table and the device Id column. Existing logs keep their device in their archive.
+  [self createDeviceReferences:db];
+
+  // Version 11 adds the target tokens table and the target token Id column. Existing logs keep their own encrypted token.
+  [self createTargetTokenReferences:db];
+
+  // Version 12 adds the compression dictionary version column. Existing logs are not compressed.
+
+  // Version 13 adds the size before compression column. Existing logs are budgeted in batches on their stored size.
 }
 
 @end
@@ -2,6 +2,7 @@
 // Licensed under the MIT License.
 
 #import "MSACEncrypter.h"
+#import "MSACLogCounters.h"
 #import "MSACLogDBStorage.h"
 
 NS_ASSUME_NONNULL_BEGIN
@@ -14,40 +15,83 @@ static NSString *const kMSACLogColumnName = @"log";
 static NSString *const kMSACTargetTokenColumnName = @"targetToken";
 static NSString *const kMSACTargetKeyColumnName = @"targetKey";
 static NSString *const kMSACPriorityColumnName = @"priority";
+static NSString *const kMSACBatchIdColumnName = @"batchId";
+static NSString *const kMSACSizeColumnName = @"size";
+static NSString *const kMSACTimestampColumnName = @"timestamp";
+static NSString *const kMSACDeviceIdColumnName = @"deviceId";
+static NSString *const kMSACDeviceTableName = @"devices";
+static NSString *const kMSACHashColumnName = @"hash";
+static NSString *const kMSACDeviceColumnName = @"device";
+static NSString *const kMSACReferenceCountColumnName = @"referenceCount";
+static NSString *const kMSACTargetTokenIdColumnName = @"targetTokenId";
+static NSString *const kMSACTargetTokenTableName = @"targetTokens";
+static NSString *const kMSACDictionaryVersionColumnName = @"dictionaryVersion";
+static NSString *const kMSACPayloadSizeColumnName = @"payloadSize";
 
+/**
+ * Default number of bytes freed on top of the size of a new log when the storage is full.
+ */
+static const NSUInteger kMSACDefaultEvictionHeadroom = 8 * 1024;
+
+/**
+ * Maximum number of target tokens kept in memory, the cache evicts tokens one by one beyond this count rather than being cleared.
+ */
+static const NSUInteger kMSACMaxDecryptedTargetTokensCount = 16;
+
+@class MSACDevice;
 @protocol MSACDatabaseConnection;
 
 @interface MSACLogDBStorage ()
 
 /**
- * Keep track of logs batches per group Id associated with their logs Ids.
+ * Encrypter for target tokens.
  */
-@property(nonatomic) NSMutableDictionary<NSString *, NSArray<NSNumber *> *> *batches;
+@property(nonatomic, readonly) MSACEncrypter *targetTokenEncrypter;
 
 /**
- * "id" database column index.
+ * Decrypted target tokens by id in the target tokens table. Cleared when the encryption key rotates.
  */
-@property(nonatomic, readonly) NSUInteger idColumnIndex;
+@property(nonatomic, readonly) NSCache<NSNumber *, NSString *> *decryptedTargetTokens;
 
 /**
- * "groupId" database column index.
+ * Maximum age, in seconds, of the logs by persistence flags, for the groups without a specific time to live.
  */
-@property(nonatomic, readonly) NSUInteger groupIdColumnIndex;
+@property(nonatomic, readonly) NSMutableDictionary<NSNumber *, NSNumber *> *defaultTimeToLives;
 
 /**
- * "log" database column index.
+ * Maximum age, in seconds, of the logs by persistence flags, by group Id.
  */
-@property(nonatomic, readonly) NSUInteger logColumnIndex;
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, NSMutableDictionary<NSNumber *, NSNumber *> *> *groupTimeToLives;
 
 /**
- * "targetToken" database column index.
+ * Maximum total size, in bytes, of the logs of a batch, by group Id.
  */
-@property(nonatomic, readonly) NSUInteger targetTokenColumnIndex;
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, NSNumber *> *batchSizeInBytesLimits;
 
 /**
- * Encrypter for target tokens.
+ * Running number and size of the stored logs, updated along with the changes of the logs table.
  */
-@property(nonatomic, readonly) MSACEncrypter *targetTokenEncrypter;
+@property(nonatomic, readonly) MSACLogCounters *logCounters;
+
+/**
+ * Running number and size, before compression, of the stored logs that are not part of a pending batch.
+ */
+@property(nonatomic, readonly) MSACLogCounters *unbatchedLogCounters;
+
+/**
+ * Whether the log counters must be rebuilt from the logs table before being read, e.g. after a transaction has been rolled back.
+ */
+@property(atomic) BOOL logCountersNeedRebuild;
+
+/**
+ * Number of claimed batches whose logs are being loaded. Only accessed from the queue of the storage.
+ */
+@property(nonatomic) NSUInteger loadingBatchesCount;
+
+/**
+ * Number of logs by group Id saved in the pending transaction, lost if it is rolled back. Only accessed from the queue of the storage.
+ */
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, NSNumber *> *pendingLogsCounts;
 
 /**
  * Get all logs with the given group Id from the storage.
@@ -58,6 +102,154 @@ static NSString *const kMSACPriorityColumnName = @"priority";
  */
 - (NSArray<id<MSACLog>> *)logsFromDBWithGroupId:(NSString *)groupId;
 
+/**
+ * Read and deserialize the logs matching a condition.
+ *
+ * @param condition The condition of the logs, optionally followed by an order clause.
+ * @param values The values bound to the condition.
+ * @param dbIds Array in which the ids of the logs are added.
+ * @param invalidDbIds Array in which the ids of the logs that can't be deserialized are added.
+ * @param db The database connection, either the writer or the read-only connection.
+ *
+ * @return The logs.
+ */
+- (NSArray<id<MSACLog>> *)logsWithCondition:(NSString *)condition
+                                  andValues:(nullable MSACStorageBindableArray *)values
+                                      dbIds:(nullable NSMutableArray<NSNumber *> *)dbIds
+                               invalidDbIds:(NSMutableArray<NSNumber *> *)invalidDbIds
+                           inOpenedDatabase:(void *)db;
+
+/**
+ * Serialize a log to be stored in the "log" column.
+ *
+ * @param log The log to serialize.
+ *
+ * @return The log as a binary archive, or as a keyed archive if it can't be archived in the binary format.
+ */
++ (nullable NSData *)archiveLog:(id<MSACLog>)log;
+
+/**
+ * Compress an archived log with the current compression dictionary.
+ *
+ * @param data The archived log.
+ * @param dictionaryVersion Set to the version of the dictionary, or to 0 if the log is not compressed.
+ *
+ * @return The compressed log, or the archived log itself if compression doesn't make it smaller.
+ */
++ (NSData *)compressArchivedLog:(NSData *)data dictionaryVersion:(nullable NSUInteger *)dictionaryVersion;
+
+/**
+ * Decompress an archived log.
+ *
+ * @param data The compressed log.
+ * @param dictionaryVersion The version of the dictionary the log has been compressed with.
+ *
+ * @return The archived log or `nil` if the dictionary version is unknown or the data is not valid.
+ */
++ (nullable NSData *)decompressArchivedLog:(NSData *)data dictionaryVersion:(NSUInteger)dictionaryVersion;
+
+/**
+ * Serialize a log without its device, which is stored in the devices table.
+ *
+ * @param log The log to serialize.
+ *
+ * @return The log as a binary archive or `nil` if it can't be archived in the binary format.
+ */
++ (nullable NSData *)archiveLogWithoutDevice:(id<MSACLog>)log;
+
+/**
+ * Get the device referenced by logs.
+ *
+ * @param deviceId The id of the device in the devices table.
+ * @param db The database connection.
+ *
+ * @return The device or `nil` if it doesn't exist or can't be deserialized.
+ */
+- (nullable MSACDevice *)deviceWithId:(int64_t)deviceId inOpenedDatabase:(void *)db;
+
+/**
+ * Get a target token referenced by logs, decrypted once then read from memory.
+ *
+ * @param targetTokenId The id of the target token in the target tokens table.
+ * @param db The database connection.
+ *
+ * @return The target token or `nil` if it doesn't exist or can't be decrypted.
+ */
+- (nullable NSString *)targetTokenWithId:(int64_t)targetTokenId inOpenedDatabase:(void *)db;
+
+/**
+ * Deserialize a log read from the "log" column.
+ *
+ * @param value The column value, either archived data or a base64 encoded keyed archive stored prior to version 6 of the schema.
+ *
+ * @return The log or `nil` if the value can't be deserialized.
+ */
++ (nullable id<MSACLog>)unarchiveLogFromColumnValue:(id)value;
+
+/**
+ * Delete, in a single statement, the oldest logs with equal or lower priority whose sizes cover the size of a new log and the eviction
+ * headroom.
+ *
+ * @param logSize The size of the new log in bytes.
+ * @param priority The priority of the new log.
+ * @param db The database connection.
+ * @param evictedLogsCounts Dictionary in which the numbers of evicted logs are added, by group Id.
+ *
+ * @return `SQLITE_OK` if logs have been evicted, `SQLITE_FULL` if there are no logs with equal or lower priority, or another error code.
+ */
+- (int)evictLogsToStoreLogOfSize:(NSUInteger)logSize
+                        priority:(MSACFlags)priority
+                inOpenedDatabase:(void *)db
+               evictedLogsCounts:(NSMutableDictionary<NSString *, NSNumber *> *)evictedLogsCounts;
+
+/**
+ * Release the logs of all the batches so that they can be loaded again.
+ */
+- (void)releaseAllBatches;
+
+/**
+ * Delete the logs whose column has one of the given values.
+ *
+ * @param columnValues The values.
+ * @param columnName The name of the column.
+ */
+- (void)deleteLogsFromDBWithColumnValues:(NSArray *)columnValues columnName:(NSString *)columnName;
+
+/**
+ * Rebuild the log counters from the logs table.
+ */
+- (void)rebuildLogCounters;
+
+/**
+ * Count and measure stored logs by group Id, target key and whether they are part of a pending batch.
+ *
+ * @param condition The condition of the counted logs, `nil` for all the logs.
+ * @param values The values bound to the condition.
+ * @param db The database connection.
+ *
+ * @return Rows of group Id, target key, number of logs, stored size of logs, size of logs before compression and whether the logs are not
+ * part of a pending batch.
+ */
+- (NSArray<NSArray *> *)logCountsWhere:(nullable NSString *)condition
+                            withValues:(nullable MSACStorageBindableArray *)values
+                      inOpenedDatabase:(void *)db;
+
+/**
+ * Count and measure stored logs by group Id, target key and whether they are part of a pending batch.
+ *
+ * @param condition The condition of the counted logs, `nil` for all the logs.
+ * @param values The values bound to the condition.
+ * @param cached Whether the statement is cached, `NO` for conditions built with a variable number of values.
+ * @param db The database connection.
+ *
+ * @return Rows of group Id, target key, number of logs, stored size of logs, size of logs before compression and whether the logs are not
+ * part of a pending batch.
+ */
+- (NSArray<NSArray *> *)logCountsWhere:(nullable NSString *)condition
+                            withValues:(nullable MSACStorageBindableArray *)values
+                                cached:(BOOL)cached
+                      inOpenedDatabase:(void *)db;
+
 /**
  * Builds a string for sqlite values binding: for example, (?, ?, ?).
  */
@@ -3,6 +3,9 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
-static NSUInteger const kMSACDropTableVersion = 5;
+/**
+ * Logs tables older than this version are migrated incrementally to a new table.
+ */
+static NSUInteger const kMSACStageTableVersion = 5;
 
 NS_ASSUME_NONNULL_END
@@ -0,0 +1,56 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+#import "MSACLogDBStorage.h"
+#import "MSACStorage.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Storage appending the logs of each group to segment files, as an alternative to the database.
+ *
+ * @discussion Records are length prefixed and checksummed. Deleted logs are recorded by tombstones and the oldest segments are compacted
+ * once most of their logs are deleted. When the storage is full, the segments holding evicted or deleted logs are rewritten without them,
+ * a log that can't fit even so is discarded without evicting any log. The index of the logs is kept in memory and rebuilt from the
+ * segments when the storage is opened, a record torn by a crash is truncated.
+ */
+@interface MSACLogSegmentStorage : NSObject <MSACStorage>
+
+/**
+ * Initializes a storage.
+ *
+ * @param directoryURL The directory of the segment files, a directory by group Id is created in it.
+ */
+- (instancetype)initWithDirectoryURL:(NSURL *)directoryURL;
+
+/**
+ * Size in bytes above which a new segment is started. Default is 256 KiB.
+ */
+@property(nonatomic) NSUInteger maxSegmentSizeInBytes;
+
+/**
+ * Number of bytes freed on top of the size of a new log when the storage is full, so that the next logs are less likely to evict logs
+ * too. Default is 8 KiB.
+ */
+@property(nonatomic) NSUInteger evictionHeadroom;
+
+/**
+ * Whether new logs are compressed with a dictionary shared by all the logs, when it makes them smaller. Default is `YES`.
+ */
+@property(nonatomic) BOOL compressionEnabled;
+
+/**
+ * Handler triggered, on the thread saving the log, once logs have been evicted to make room for a new log.
+ */
+@property(nonatomic, copy, nullable) MSACLogEvictionHandler evictionHandler;
+
+/**
+ * Number of bytes written to the segment files since the storage has been opened, including tombstones and compacted logs.
+ */
+@property(nonatomic, readonly) unsigned long long bytesWritten;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,1134 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+#import "MSACAppCenterInternal.h"
+#import "MSACConstants+Internal.h"
+#import "MSACLogDBStoragePrivate.h"
+#import "MSACLogSegmentStoragePrivate.h"
+#import "MSACUtility+File.h"
+#import "MSACUtility+StringFormatting.h"
+#import "zlib.h"
+
+/**
+ * Segments are at most this fraction of the maximum storage size, so that evicting the oldest logs frees whole segments.
+ */
+static const long long kMSACSegmentsPerStorage = 8;
+
+/**
+ * Size of the fixed fields of a log record payload: id, timestamp, persistence flags, compression dictionary version and archive length.
+ */
+static const NSUInteger kMSACLogPayloadFixedSize = 22;
+
+/**
+ * Sequential reader of little endian values, it fails rather than reading past the end.
+ */
+typedef struct {
+  const uint8_t *bytes;
+  NSUInteger length;
+  NSUInteger offset;
+  BOOL failed;
+} MSACSegmentReader;
+
+static uint64_t MSACSegmentReadUInt(MSACSegmentReader *reader, NSUInteger size) {
+  if (reader->failed || reader->length - reader->offset < size) {
+    reader->failed = YES;
+    return 0;
+  }
+  uint64_t value = 0;
+  for (NSUInteger i = 0; i < size; i++) {
+    value |= (uint64_t)reader->bytes[reader->offset + i] << (8 * i);
+  }
+  reader->offset += size;
+  return value;
+}
+
+static NSString *MSACSegmentReadString(MSACSegmentReader *reader) {
+  NSUInteger length = (NSUInteger)MSACSegmentReadUInt(reader, 2);
+  if (reader->failed || reader->length - reader->offset < length) {
+    reader->failed = YES;
+    return nil;
+  }
+  NSString *string = nil;
+  if (length > 0) {
+    string = [[NSString alloc] initWithBytes:reader->bytes + reader->offset length:length encoding:NSUTF8StringEncoding];
+  }
+  reader->offset += length;
+  return string;
+}
+
+static void MSACSegmentAppendUInt(NSMutableData *data, uint64_t value, NSUInteger size) {
+  uint8_t bytes[8];
+  for (NSUInteger i = 0; i < size; i++) {
+    bytes[i] = (uint8_t)(value >> (8 * i));
+  }
+  [data appendBytes:bytes length:size];
+}
+
+static BOOL MSACSegmentAppendString(NSMutableData *data, NSString *string) {
+  NSData *bytes = [string dataUsingEncoding:NSUTF8StringEncoding] ?: [NSData data];
+  if (bytes.length > UINT16_MAX) {
+    return NO;
+  }
+  MSACSegmentAppendUInt(data, bytes.length, 2);
+  [data appendData:bytes];
+  return YES;
+}
+
+static uint32_t MSACSegmentChecksum(uint8_t type, const void *payload, NSUInteger length) {
+  uLong checksum = crc32(0L, Z_NULL, 0);
+  checksum = crc32(checksum, &type, 1);
+  checksum = crc32(checksum, payload, (uInt)length);
+  return (uint32_t)checksum;
+}
+
+@implementation MSACLogSegmentEntry
+@end
+
+@implementation MSACLogSegment
+
+- (instancetype)initWithNumber:(NSUInteger)number fileURL:(NSURL *)fileURL {
+  if ((self = [super init])) {
+    _number = number;
+    _fileURL = fileURL;
+    _fileDescriptor = -1;
+  }
+  return self;
+}
+
+- (void)dealloc {
+  [self closeFile];
+}
+
+- (BOOL)openFile {
+  if (self.fileDescriptor < 0) {
+    self.fileDescriptor = open(self.fileURL.fileSystemRepresentation, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (self.fileDescriptor < 0) {
+      MSACLogError([MSACAppCenter logTag], @"Failed to open log segment %@, errno=%d.", self.fileURL.lastPathComponent, errno);
+    }
+  }
+  return self.fileDescriptor >= 0;
+}
+
+- (void)closeFile {
+  if (self.fileDescriptor >= 0) {
+    close(self.fileDescriptor);
+    self.fileDescriptor = -1;
+  }
+}
+
+@end
+
+@implementation MSACLogSegmentGroup
+
+- (instancetype)initWithGroupId:(NSString *)groupId directoryURL:(NSURL *)directoryURL {
+  if ((self = [super init])) {
+    _groupId = groupId;
+    _directoryURL = directoryURL;
+    _segments = [NSMutableArray new];
+    _entries = [NSMutableArray new];
+    _entriesById = [NSMutableDictionary new];
+    _batches = [NSMutableDictionary new];
+  }
+  return self;
+}
+
+- (nullable MSACLogSegment *)segmentWithNumber:(NSUInteger)number {
+  for (MSACLogSegment *segment in self.segments) {
+    if (segment.number == number) {
+      return segment;
+    }
+  }
+  return nil;
+}
+
+@end
+
+@implementation MSACLogSegmentStorage
+
+#pragma mark - Initialization
+
+- (instancetype)init {
+  NSURL *directoryURL = [MSACUtility createDirectoryForPathComponent:kMSACLogSegmentsDirectoryName];
+  return [self initWithDirectoryURL:directoryURL ?: [MSACUtility fullURLForPathComponent:kMSACLogSegmentsDirectoryName]];
+}
+
+- (instancetype)initWithDirectoryURL:(NSURL *)directoryURL {
+  if ((self = [super init])) {
+    _directoryURL = directoryURL;
+    _groups = [NSMutableDictionary new];
+    _nextLogId = 1;
+    _maxSizeInBytes = kMSACDefaultSegmentStorageSizeInBytes;
+    _maxSegmentSizeInBytes = kMSACDefaultMaxSegmentSizeInBytes;
+    _evictionHeadroom = kMSACDefaultEvictionHeadroom;
+    _compressionEnabled = YES;
+    _logCounters = [MSACLogCounters new];
+    _unbatchedLogCounters = [MSACLogCounters new];
+    _targetTokenEncrypter = [MSACEncrypter new];
+    _encryptedTargetTokens = [NSCache new];
+    _encryptedTargetTokens.countLimit = kMSACMaxDecryptedTargetTokensCount;
+    _decryptedTargetTokens = [NSCache new];
+    _decryptedTargetTokens.countLimit = kMSACMaxDecryptedTargetTokensCount;
+    _defaultTimeToLives = [NSMutableDictionary new];
+    _groupTimeToLives = [NSMutableDictionary new];
+    _batchSizeInBytesLimits = [NSMutableDictionary new];
+    [self openGroups];
+    [MSAC_NOTIFICATION_CENTER addObserver:self
+                                 selector:@selector(encryptionKeyDidRotate:)
+                                     name:kMSACEncryptionKeyDidRotateNotification
+                                   object:nil];
+  }
+  return self;
+}
+
+- (void)dealloc {
+  [MSAC_NOTIFICATION_CENTER removeObserver:self name:kMSACEncryptionKeyDidRotateNotification object:nil];
+  [self close];
+}
+
+- (void)close {
+  @synchronized(self) {
+    for (MSACLogSegmentGroup *group in [self.groups objectEnumerator]) {
+      for (MSACLogSegment *segment in group.segments) {
+        [segment closeFile];
+      }
+    }
+  }
+}
+
+#pragma mark - Recovery
+
+- (void)openGroups {
+  NSFileManager *fileManager = [NSFileManager defaultManager];
+  [fileManager createDirectoryAtURL:self.directoryURL withIntermediateDirectories:YES attributes:nil error:nil];
+  NSArray<NSURL *> *groupURLs = [fileManager contentsOfDirectoryAtURL:self.directoryURL
+                                           includingPropertiesForKeys:nil
+                                                              options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                error:nil];
+  for (NSURL *groupURL in groupURLs) {
+    NSString *groupId = [groupURL.lastPathComponent stringByRemovingPercentEncoding];
+    if (!groupId) {
+      continue;
+    }
+    MSACLogSegmentGroup *group = [[MSACLogSegmentGroup alloc] initWithGroupId:groupId directoryURL:groupURL];
+    [self recoverGroup:group];
+    self.groups[groupId] = group;
+
+    // Batches claimed by a previous process are not recorded, their logs are loaded again.
+    for (MSACLogSegmentEntry *entry in group.entries) {
+      [self.logCounters addLogsCount:1 size:(long long)entry.size groupId:groupId targetKey:entry.targetKey];
+      [self.unbatchedLogCounters addLogsCount:1 size:(long long)entry.payloadSize groupId:groupId targetKey:entry.targetKey];
+    }
+    [self compactGroup:group];
+  }
+}
+
+- (void)recoverGroup:(MSACLogSegmentGroup *)group {
+  NSArray<NSURL *> *fileURLs = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:group.directoryURL
+                                                             includingPropertiesForKeys:nil
+                                                                                options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                                  error:nil];
+  NSMutableArray<MSACLogSegment *> *segments = [NSMutableArray new];
+  for (NSURL *fileURL in fileURLs) {
+
+    // A rewrite interrupted by a crash is discarded, the segment it was replacing is still complete.
+    if ([fileURL.pathExtension isEqualToString:kMSACLogSegmentRewriteExtension]) {
+      [[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+      continue;
+    }
+    NSInteger number = [[fileURL.lastPathComponent stringByDeletingPathExtension] integerValue];
+    if ([fileURL.pathExtension isEqualToString:kMSACLogSegmentFileExtension] && number > 0) {
+      [segments addObject:[[MSACLogSegment alloc] initWithNumber:(NSUInteger)number fileURL:fileURL]];
+    }
+  }
+  [segments sortUsingComparator:^NSComparisonResult(MSACLogSegment *segment1, MSACLogSegment *segment2) {
+    return [@(segment1.number) compare:@(segment2.number)];
+  }];
+
+  // Records are replayed in order: a log moved by a compaction interrupted by a crash is found twice, the last copy is kept.
+  for (MSACLogSegment *segment in segments) {
+    [self replaySegment:segment ofGroup:group];
+    [group.segments addObject:segment];
+  }
+  NSArray<MSACLogSegmentEntry *> *entries = [[group.entriesById allValues]
+      sortedArrayUsingComparator:^NSComparisonResult(MSACLogSegmentEntry *entry1, MSACLogSegmentEntry *entry2) {
+        return [@(entry1.logId) compare:@(entry2.logId)];
+      }];
+  [group.entries addObjectsFromArray:entries];
+  for (MSACLogSegmentEntry *entry in entries) {
+    MSACLogSegment *segment = [group segmentWithNumber:entry.segmentNumber];
+    segment.liveCount += 1;
+    segment.liveSize += entry.recordLength;
+  }
+}
+
+- (void)replaySegment:(MSACLogSegment *)segment ofGroup:(MSACLogSegmentGroup *)group {
+  NSData *data = [NSData dataWithContentsOfURL:segment.fileURL options:NSDataReadingMappedIfSafe error:nil] ?: [NSData data];
+  const uint8_t *bytes = data.bytes;
+  NSUInteger offset = 0;
+  while (data.length - offset >= kMSACSegmentRecordHeaderSize) {
+    MSACSegmentReader header = {bytes + offset, kMSACSegmentRecordHeaderSize, 0, NO};
+    NSUInteger payloadLength = (NSUInteger)MSACSegmentReadUInt(&header, 4);
+    uint32_t checksum = (uint32_t)MSACSegmentReadUInt(&header, 4);
+    uint8_t type = (uint8_t)MSACSegmentReadUInt(&header, 1);
+    if (payloadLength > data.length - offset - kMSACSegmentRecordHeaderSize) {
+      break;
+    }
+    const uint8_t *payload = bytes + offset + kMSACSegmentRecordHeaderSize;
+    if (MSACSegmentChecksum(type, payload, payloadLength) != checksum) {
+      break;
+    }
+    MSACSegmentReader reader = {payload, payloadLength, 0, NO};
+    if (type == MSACSegmentRecordTypeLog || type == MSACSegmentRecordTypeSizedLog) {
+      MSACLogSegmentEntry *entry = [MSACLogSegmentEntry new];
+      entry.logId = (int64_t)MSACSegmentReadUInt(&reader, 8);
+      entry.timestamp = (long long)MSACSegmentReadUInt(&reader, 8);
+      entry.flags = (MSACFlags)MSACSegmentReadUInt(&reader, 1);
+      MSACSegmentReadUInt(&reader, 1);
+      NSUInteger payloadSize = type == MSACSegmentRecordTypeSizedLog ? (NSUInteger)MSACSegmentReadUInt(&reader, 4) : 0;
+      entry.targetKey = MSACSegmentReadString(&reader);
+      MSACSegmentReadString(&reader);
+      if (!reader.failed) {
+        entry.segmentNumber = segment.number;
+        entry.offset = offset;
+        entry.recordLength = kMSACSegmentRecordHeaderSize + payloadLength;
+        entry.size = payloadLength - reader.offset;
+
+        // Logs recorded without their archive length are budgeted on their stored size.
+        entry.payloadSize = type == MSACSegmentRecordTypeSizedLog ? payloadSize : entry.size;
+        group.entriesById[@(entry.logId)] = entry;
+        self.nextLogId = MAX(self.nextLogId, entry.logId + 1);
+      }
+    } else if (type == MSACSegmentRecordTypeTombstone) {
+      segment.tombstoneSize += kMSACSegmentRecordHeaderSize + payloadLength;
+      NSUInteger count = (NSUInteger)MSACSegmentReadUInt(&reader, 4);
+      for (NSUInteger i = 0; i < count && !reader.failed; i++) {
+        int64_t logId = (int64_t)MSACSegmentReadUInt(&reader, 8);
+        [group.entriesById removeObjectForKey:@(logId)];
+        self.nextLogId = MAX(self.nextLogId, logId + 1);
+      }
+    }
+    offset += kMSACSegmentRecordHeaderSize + payloadLength;
+  }
+
+  // A record torn by a crash, or corrupted, ends the segment.
+  if (offset < data.length) {
+    MSACLogWarning([MSACAppCenter logTag], @"Log segment %@ of %@ is truncated at offset %tu, %tu byte(s) discarded.",
+                   segment.fileURL.lastPathComponent, group.groupId, offset, data.length - offset);
+    if (truncate(segment.fileURL.fileSystemRepresentation, (off_t)offset) != 0) {
+      MSACLogError([MSACAppCenter logTag], @"Failed to truncate log segment %@, errno=%d.", segment.fileURL.lastPathComponent, errno);
+    }
+  }
+  segment.size = offset;
+}
+
+#pragma mark - Save logs
+
+- (BOOL)saveLog:(id<MSACLog>)log withGroupId:(NSString *)groupId flags:(MSACFlags)flags {
+  if (!log) {
+    return NO;
+  }
+  MSACFlags persistenceFlags = flags & kMSACPersistenceFlagsMask;
+  NSData *logData = [MSACLogDBStorage archiveLog:log];
+  if (!logData) {
+    return NO;
+  }
+  NSUInteger payloadSize = logData.length;
+  NSUInteger dictionaryVersion = 0;
+  if (self.compressionEnabled) {
+    logData = [MSACLogDBStorage compressArchivedLog:logData dictionaryVersion:&dictionaryVersion];
+  }
+  NSString *targetToken = nil;
+  NSString *targetKey = nil;
+  if ([(NSObject *)log isKindOfClass:[MSACCommonSchemaLog class]]) {
+    targetToken = [[log transmissionTargetTokens] anyObject];
+    targetKey = targetToken ? [MSACUtility targetKeyFromTargetToken:(NSString *)targetToken] : nil;
+  }
+  NSMutableDictionary<NSString *, NSNumber *> *evictedLogsCounts = [NSMutableDictionary new];
+  BOOL saved = NO;
+  @synchronized(self) {
+    NSString *encryptedTargetToken = targetToken ? [self encryptedTargetToken:(NSString *)targetToken] : nil;
+    long long timestamp = (long long)[[NSDate date] timeIntervalSince1970];
+    NSMutableData *payload = [NSMutableData dataWithCapacity:kMSACLogPayloadFixedSize + logData.length];
+    MSACSegmentAppendUInt(payload, (uint64_t)self.nextLogId, 8);
+    MSACSegmentAppendUInt(payload, (uint64_t)timestamp, 8);
+    MSACSegmentAppendUInt(payload, persistenceFlags, 1);
+    MSACSegmentAppendUInt(payload, dictionaryVersion, 1);
+    MSACSegmentAppendUInt(payload, payloadSize, 4);
+    if (!MSACSegmentAppendString(payload, targetKey) || !MSACSegmentAppendString(payload, encryptedTargetToken)) {
+      MSACLogError([MSACAppCenter logTag], @"Target token is too long to be stored.");
+      return NO;
+    }
+    [payload appendData:logData];
+    NSData *record = [MSACLogSegmentStorage recordWithType:MSACSegmentRecordTypeSizedLog payload:payload];
+    if ((long long)record.length >= self.maxSizeInBytes) {
+      MSACLogError([MSACAppCenter logTag], @"Log is too large (%tu bytes) to store. Current maximum storage size is %lld bytes.",
+                   record.length, self.maxSizeInBytes);
+      return NO;
+    }
+
+    // If the storage is full, evict enough logs with equal or lower priority to make room for the log.
+    BOOL fits = YES;
+    if ((long long)([self totalSize] + record.length) > self.maxSizeInBytes &&
+        ![self evictLogsToStoreRecordOfLength:record.length priority:persistenceFlags evictedLogsCounts:evictedLogsCounts]) {
+      MSACLogError([MSACAppCenter logTag],
+                   @"Storage is full and evicting logs with equal or lower priority can't make room; discarding the log.");
+      fits = NO;
+    }
+    if (fits) {
+      MSACLogSegmentGroup *group = [self groupWithId:groupId];
+      MSACLogSegment *segment = [self appendRecord:record toGroup:group sync:persistenceFlags == MSACFlagsCritical];
+      if (segment) {
+        MSACLogSegmentEntry *entry = [MSACLogSegmentEntry new];
+        entry.logId = self.nextLogId;
+        entry.segmentNumber = segment.number;
+        entry.offset = segment.size - record.length;
+        entry.recordLength = record.length;
+        entry.size = logData.length;
+        entry.payloadSize = payloadSize;
+        entry.flags = persistenceFlags;
+        entry.timestamp = timestamp;
+        entry.targetKey = targetKey;
+        [group.entries addObject:entry];
+        group.entriesById[@(entry.logId)] = entry;
+        segment.liveCount += 1;
+        segment.liveSize += record.length;
+        self.nextLogId += 1;
+        [self.logCounters addLogsCount:1 size:(long long)logData.length groupId:groupId targetKey:targetKey];
+        [self.unbatchedLogCounters addLogsCount:1 size:(long long)payloadSize groupId:groupId targetKey:targetKey];
+        MSACLogVerbose([MSACAppCenter logTag], @"Log is stored with id: '%lld'", entry.logId);
+        saved = YES;
+      }
+    }
+  }
+  MSACLogEvictionHandler evictionHandler = self.evictionHandler;
+  if (evictedLogsCounts.count > 0 && evictionHandler) {
+    evictionHandler(evictedLogsCounts);
+  }
+  return saved;
+}
+
+- (MSACLogSegmentGroup *)groupWithId:(NSString *)groupId {
+  MSACLogSegmentGroup *group = self.groups[groupId];
+  if (!group) {
+    NSString *directoryName =
+        [groupId stringByAddingPercentEncodingWithAllowedCharacters:[NSCharacterSet alphanumericCharacterSet]] ?: groupId;
+    NSURL *directoryURL = [self.directoryURL URLByAppendingPathComponent:directoryName];
+    group = [[MSACLogSegmentGroup alloc] initWithGroupId:groupId directoryURL:directoryURL];
+    self.groups[groupId] = group;
+  }
+  return group;
+}
+
+- (nullable MSACLogSegment *)appendRecord:(NSData *)record toGroup:(MSACLogSegmentGroup *)group sync:(BOOL)sync {
+  MSACLogSegment *segment = group.segments.lastObject;
+  unsigned long long maxSegmentSize =
+      (unsigned long long)MIN((long long)self.maxSegmentSizeInBytes, MAX(self.maxSizeInBytes / kMSACSegmentsPerStorage, 1));
+  if (!segment || (segment.size > 0 && segment.size + record.length > maxSegmentSize)) {
+    segment = [self startSegmentInGroup:group];
+  }
+  if (!segment || ![segment openFile]) {
+    return nil;
+  }
+  ssize_t written = pwrite(segment.fileDescriptor, record.bytes, record.length, (off_t)segment.size);
+  if (written != (ssize_t)record.length) {
+    MSACLogError([MSACAppCenter logTag], @"Failed to append to log segment %@, errno=%d.", segment.fileURL.lastPathComponent, errno);
+
+    // Drop the part that may have been written, the next record is appended at the same offset.
+    ftruncate(segment.fileDescriptor, (off_t)segment.size);
+    return nil;
+  }
+  if (sync || self.durability == MSACStorageDurabilityFull) {
+    fsync(segment.fileDescriptor);
+  }
+  segment.size += record.length;
+  self.bytesWritten += record.length;
+  return segment;
+}
+
+- (nullable MSACLogSegment *)startSegmentInGroup:(MSACLogSegmentGroup *)group {
+  [[NSFileManager defaultManager] createDirectoryAtURL:group.directoryURL withIntermediateDirectories:YES attributes:nil error:nil];
+  NSUInteger number = group.segments.lastObject.number + 1;
+  NSString *fileName = [NSString stringWithFormat:@"%010tu.%@", number, kMSACLogSegmentFileExtension];
+  NSURL *fileURL = [group.directoryURL URLByAppendingPathComponent:fileName];
+  MSACLogSegment *segment = [[MSACLogSegment alloc] initWithNumber:number fileURL:fileURL];
+  if (![segment openFile] || ftruncate(segment.fileDescriptor, 0) != 0) {
+    return nil;
+  }
+
+  // Only the last segment is appended to.
+  [group.segments.lastObject closeFile];
+  [group.segments addObject:segment];
+  return segment;
+}
+
++ (NSData *)recordWithType:(MSACSegmentRecordType)type payload:(NSData *)payload {
+  NSMutableData *record = [NSMutableData dataWithCapacity:kMSACSegmentRecordHeaderSize + payload.length];
+  MSACSegmentAppendUInt(record, payload.length, 4);
+  MSACSegmentAppendUInt(record, MSACSegmentChecksum(type, payload.bytes, payload.length), 4);
+  MSACSegmentAppendUInt(record, type, 1);
+  [record appendData:payload];
+  return record;
+}
+
+- (BOOL)evictLogsToStoreRecordOfLength:(NSUInteger)length
+                              priority:(MSACFlags)priority
+                     evictedLogsCounts:(NSMutableDictionary<NSString *, NSNumber *> *)evictedLogsCounts {
+
+  /*
+   * Tombstones would take room instead of freeing it: the segments are rewritten without the evicted logs instead. Rewriting also
+   * reclaims the records of the logs deleted earlier, and the tombstones of the oldest segment of each group.
+   */
+  unsigned long long requiredSize = [self totalSize] + length - (unsigned long long)self.maxSizeInBytes;
+  unsigned long long preferredSize = requiredSize + self.evictionHeadroom;
+  unsigned long long plannedSize = 0;
+  NSMutableArray<NSArray *> *candidates = [NSMutableArray new];
+  for (MSACLogSegmentGroup *group in [self.groups objectEnumerator]) {
+    for (MSACLogSegment *segment in group.segments) {
+      plannedSize += [self reclaimableSizeOfSegment:segment inGroup:group];
+    }
+    for (MSACLogSegmentEntry *entry in group.entries) {
+      if (entry.flags <= priority) {
+        [candidates addObject:@[ entry, group ]];
+      }
+    }
+  }
+  [candidates sortUsingComparator:^NSComparisonResult(NSArray *candidate1, NSArray *candidate2) {
+    MSACLogSegmentEntry *entry1 = candidate1[0];
+    MSACLogSegmentEntry *entry2 = candidate2[0];
+    if (entry1.flags != entry2.flags) {
+      return entry1.flags < entry2.flags ? NSOrderedAscending : NSOrderedDescending;
+    }
+    return [@(entry1.logId) compare:@(entry2.logId)];
+  }];
+
+  // Plan the eviction of the oldest logs with the lowest priority until they cover the new log and the headroom, or at least the new log.
+  NSUInteger requiredCount = plannedSize >= requiredSize ? 0 : NSNotFound;
+  NSUInteger preferredCount = plannedSize >= preferredSize ? 0 : NSNotFound;
+  for (NSUInteger i = 0; i < candidates.count && preferredCount == NSNotFound; i++) {
+    plannedSize += ((MSACLogSegmentEntry *)candidates[i][0]).recordLength;
+    if (requiredCount == NSNotFound && plannedSize >= requiredSize) {
+      requiredCount = i + 1;
+    }
+    if (plannedSize >= preferredSize) {
+      preferredCount = i + 1;
+    }
+  }
+  if (requiredCount == NSNotFound) {
+    return NO;
+  }
+  NSUInteger plannedCount = preferredCount != NSNotFound ? preferredCount : requiredCount;
+  NSMutableDictionary<NSString *, NSMutableArray<MSACLogSegmentEntry *> *> *plannedEntries = [NSMutableDictionary new];
+  for (NSArray *candidate in [candidates subarrayWithRange:NSMakeRange(0, plannedCount)]) {
+    MSACLogSegmentGroup *group = candidate[1];
+    if (!plannedEntries[group.groupId]) {
+      plannedEntries[group.groupId] = [NSMutableArray new];
+    }
+    [plannedEntries[group.groupId] addObject:candidate[0]];
+  }
+  unsigned long long previousSize = [self totalSize];
+  for (MSACLogSegmentGroup *group in [self.groups allValues]) {
+    NSArray<MSACLogSegmentEntry *> *entries = plannedEntries[group.groupId] ?: @[];
+    [self forgetEntries:entries ofGroup:group];
+
+    // Logs of a segment that fails to be rewritten are deleted by a tombstone, they are not loaded again.
+    NSMutableArray<MSACLogSegmentEntry *> *remainingEntries = [NSMutableArray new];
+    for (MSACLogSegment *segment in [group.segments copy]) {
+      if ([self reclaimableSizeOfSegment:segment inGroup:group] > 0 && ![self rewriteSegment:segment inGroup:group]) {
+        for (MSACLogSegmentEntry *entry in entries) {
+          if (entry.segmentNumber == segment.number) {
+            [remainingEntries addObject:entry];
+          }
+        }
+      }
+    }
+    [self appendTombstoneOfEntries:remainingEntries toGroup:group];
+    [self compactGroup:group];
+    if (entries.count > 0) {
+      evictedLogsCounts[group.groupId] = @(evictedLogsCounts[group.groupId].unsignedIntegerValue + entries.count);
+    }
+  }
+  unsigned long long currentSize = [self totalSize];
+  MSACLogDebug([MSACAppCenter logTag],
+               @"Log storage was over capacity, %tu oldest log(s) with equal or lower priority deleted to free %llu byte(s).",
+               plannedCount, previousSize > currentSize ? previousSize - currentSize : 0);
+  return (long long)(currentSize + length) <= self.maxSizeInBytes;
+}
+
+- (unsigned long long)reclaimableSizeOfSegment:(MSACLogSegment *)segment inGroup:(MSACLogSegmentGroup *)group {
+  unsigned long long keptSize = segment.liveSize + (segment == group.segments.firstObject ? 0 : segment.tombstoneSize);
+  return segment.size > keptSize ? segment.size - keptSize : 0;
+}
+
+#pragma mark - Load logs
+
+- (BOOL)loadLogsWithGroupId:(NSString *)groupId
+                      limit:(NSUInteger)limit
+         excludedTargetKeys:(nullable NSArray<NSString *> *)excludedTargetKeys
+          completionHandler:(nullable MSACLoadDataCompletionHandler)completionHandler {
+  NSString *batchId = MSAC_UUID_STRING;
+  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray new];
+  NSMutableArray<NSNumber *> *logIds = [NSMutableArray new];
+  BOOL moreLogsAvailable = NO;
+  @synchronized(self) {
+    MSACLogSegmentGroup *group = self.groups[groupId];
+
+    // Take the logs that are not already part of a batch, highest priority first then oldest.
+    NSMutableDictionary<NSNumber *, NSMutableArray<MSACLogSegmentEntry *> *> *entriesByPriority = [NSMutableDictionary new];
+    for (MSACLogSegmentEntry *entry in group.entries) {
+      if (entry.batchId || (entry.targetKey && [excludedTargetKeys containsObject:(NSString *)entry.targetKey])) {
+        continue;
+      }
+      NSMutableArray<MSACLogSegmentEntry *> *entries = entriesByPriority[@(entry.flags)];
+      if (!entries) {
+        entries = [NSMutableArray new];
+        entriesByPriority[@(entry.flags)] = entries;
+      }
+      [entries addObject:entry];
+    }
+
+    /*
+     * The batch is cut at the size limit, but always takes the first log even if it is bigger than the limit. Logs are budgeted on the
+     * length of their archive before compression, closer to what they take in the request than their stored size.
+     */
+    NSUInteger sizeInBytesLimit = self.batchSizeInBytesLimits[groupId].unsignedIntegerValue;
+    unsigned long long batchSize = 0;
+    NSMutableArray<MSACLogSegmentEntry *> *claimedEntries = [NSMutableArray new];
+    NSArray<NSNumber *> *priorities = [[entriesByPriority allKeys] sortedArrayUsingSelector:@selector(compare:)];
+    for (NSNumber *priority in [priorities reverseObjectEnumerator]) {
+      for (MSACLogSegmentEntry *entry in entriesByPriority[priority]) {
+        batchSize += entry.payloadSize;
+        if (claimedEntries.count == limit || (sizeInBytesLimit > 0 && claimedEntries.count > 0 && batchSize > sizeInBytesLimit)) {
+          moreLogsAvailable = YES;
+          break;
+        }
+        [claimedEntries addObject:entry];
+      }
+      if (moreLogsAvailable) {
+        break;
+      }
+    }
+
+    // Logs that can't be read are deleted.
+    NSMutableArray<MSACLogSegmentEntry *> *invalidEntries = [NSMutableArray new];
+    for (MSACLogSegmentEntry *entry in claimedEntries) {
+      id<MSACLog> log = [self logOfEntry:entry inGroup:(MSACLogSegmentGroup *)group];
+      if (!log) {
+        MSACLogError([MSACAppCenter logTag], @"Deserialization failed for log with Id %lld", entry.logId);
+        [invalidEntries addObject:entry];
+        continue;
+      }
+      entry.batchId = batchId;
+      [self.unbatchedLogCounters addLogsCount:-1 size:-(long long)entry.payloadSize groupId:groupId targetKey:entry.targetKey];
+      [logs addObject:log];
+      [logIds addObject:@(entry.logId)];
+    }
+    if (invalidEntries.count > 0) {
+      [self deleteEntries:invalidEntries fromGroup:(MSACLogSegmentGroup *)group];
+    }
+    if (logIds.count > 0) {
+      group.batches[batchId] = logIds;
+      MSACLogVerbose([MSACAppCenter logTag], @"Load log(s) with id(s) '%@' as batch Id:%@", [logIds componentsJoinedByString:@"','"],
+                     batchId);
+    }
+  }
+  if (completionHandler) {
+    completionHandler(logs, logs.count > 0 ? batchId : nil);
+  }
+  return moreLogsAvailable;
+}
+
+- (nullable id<MSACLog>)logOfEntry:(MSACLogSegmentEntry *)entry inGroup:(MSACLogSegmentGroup *)group {
+  NSData *record = [self recordOfEntry:entry inGroup:group];
+  if (!record) {
+    return nil;
+  }
+  MSACSegmentReader reader = {(const uint8_t *)record.bytes + kMSACSegmentRecordHeaderSize,
+                              record.length - kMSACSegmentRecordHeaderSize, 0, NO};
+  uint8_t type = ((const uint8_t *)record.bytes)[kMSACSegmentRecordHeaderSize - 1];
+  MSACSegmentReadUInt(&reader, 8 + 8 + 1);
+  NSUInteger dictionaryVersion = (NSUInteger)MSACSegmentReadUInt(&reader, 1);
+  if (type == MSACSegmentRecordTypeSizedLog) {
+    MSACSegmentReadUInt(&reader, 4);
+  }
+  MSACSegmentReadString(&reader);
+  NSString *encryptedTargetToken = MSACSegmentReadString(&reader);
+  if (reader.failed) {
+    return nil;
+  }
+  NSData *logData = [record subdataWithRange:NSMakeRange(kMSACSegmentRecordHeaderSize + reader.offset, reader.length - reader.offset)];
+  if (dictionaryVersion > 0) {
+    logData = [MSACLogDBStorage decompressArchivedLog:logData dictionaryVersion:dictionaryVersion];
+  }
+  id<MSACLog> log = logData ? [MSACLogDBStorage unarchiveLogFromColumnValue:(NSData *)logData] : nil;
+  if (log && encryptedTargetToken) {
+    NSString *targetToken = [self decryptedTargetToken:(NSString *)encryptedTargetToken];
+    if (targetToken) {
+      [log addTransmissionTargetToken:targetToken];
+    } else {
+      MSACLogError([MSACAppCenter logTag], @"Failed to decrypt the target token for log with Id %lld.", entry.logId);
+    }
+  }
+  return log;
+}
+
+- (nullable NSData *)recordOfEntry:(MSACLogSegmentEntry *)entry inGroup:(MSACLogSegmentGroup *)group {
+  MSACLogSegment *segment = [group segmentWithNumber:entry.segmentNumber];
+  if (!segment || ![segment openFile]) {
+    return nil;
+  }
+  NSMutableData *record = [NSMutableData dataWithLength:entry.recordLength];
+  ssize_t readLength = pread(segment.fileDescriptor, record.mutableBytes, entry.recordLength, (off_t)entry.offset);
+  if (readLength != (ssize_t)entry.recordLength) {
+    return nil;
+  }
+
+  // The checksum catches records corrupted since the storage has been opened.
+  MSACSegmentReader header = {record.bytes, kMSACSegmentRecordHeaderSize, 0, NO};
+  NSUInteger payloadLength = (NSUInteger)MSACSegmentReadUInt(&header, 4);
+  uint32_t checksum = (uint32_t)MSACSegmentReadUInt(&header, 4);
+  uint8_t type = (uint8_t)MSACSegmentReadUInt(&header, 1);
+  const uint8_t *payload = (const uint8_t *)record.bytes + kMSACSegmentRecordHeaderSize;
+  if ((type != MSACSegmentRecordTypeLog && type != MSACSegmentRecordTypeSizedLog) ||
+      payloadLength != entry.recordLength - kMSACSegmentRecordHeaderSize || MSACSegmentChecksum(type, payload, payloadLength) != checksum) {
+    return nil;
+  }
+  return record;
+}
+
+#pragma mark - Target tokens
+
+- (nullable NSString *)encryptedTargetToken:(NSString *)targetToken {
+  NSString *encryptedTargetToken = [self.encryptedTargetTokens objectForKey:targetToken];
+  if (!encryptedTargetToken) {
+    encryptedTargetToken = [self.targetTokenEncrypter encryptString:targetToken];
+    if (encryptedTargetToken) {
+      [self.encryptedTargetTokens setObject:(NSString *)encryptedTargetToken forKey:targetToken];
+    }
+  }
+  return encryptedTargetToken;
+}
+
+- (nullable NSString *)decryptedTargetToken:(NSString *)encryptedTargetToken {
+  NSString *targetToken = [self.decryptedTargetTokens objectForKey:encryptedTargetToken];
+  if (!targetToken) {
+    targetToken = [self.targetTokenEncrypter decryptString:encryptedTargetToken];
+    if (targetToken) {
+      [self.decryptedTargetTokens setObject:(NSString *)targetToken forKey:encryptedTargetToken];
+    }
+  }
+  return targetToken;
+}
+
+- (void)encryptionKeyDidRotate:(__unused NSNotification *)notification {
+
+  // New tokens are encrypted with the new key and tokens encrypted with the previous key are decrypted again.
+  @synchronized(self) {
+    [self.encryptedTargetTokens removeAllObjects];
+    [self.decryptedTargetTokens removeAllObjects];
+  }
+}
+
+#pragma mark - Release and delete logs
+
+- (void)releaseLogsWithBatchId:(NSString *)batchId groupId:(NSString *)groupId {
+  @synchronized(self) {
+    MSACLogSegmentGroup *group = self.groups[groupId];
+    NSArray<NSNumber *> *logIds = group.batches[batchId];
+    for (NSNumber *logId in logIds) {
+      MSACLogSegmentEntry *entry = group.entriesById[logId];
+      if (entry.batchId) {
+        entry.batchId = nil;
+        [self.unbatchedLogCounters addLogsCount:1 size:(long long)entry.payloadSize groupId:groupId targetKey:entry.targetKey];
+      }
+    }
+    [group.batches removeObjectForKey:batchId];
+    MSACLogVerbose([MSACAppCenter logTag], @"Released %tu log(s) of batch Id:%@", logIds.count, batchId);
+  }
+}
+
+- (void)deleteLogsWithBatchId:(NSString *)batchId groupId:(NSString *)groupId {
+  @synchronized(self) {
+    MSACLogSegmentGroup *group = self.groups[groupId];
+    NSMutableArray<MSACLogSegmentEntry *> *entries = [NSMutableArray new];
+    for (NSNumber *logId in group.batches[batchId]) {
+      MSACLogSegmentEntry *entry = group.entriesById[logId];
+      if (entry) {
+        [entries addObject:entry];
+      }
+    }
+    if (group) {
+      [self deleteEntries:entries fromGroup:(MSACLogSegmentGroup *)group];
+    }
+    MSACLogVerbose([MSACAppCenter logTag], @"Deletion of %tu log(s) of batch Id:%@ succeeded.", entries.count, batchId);
+  }
+}
+
+- (NSArray<id<MSACLog>> *)deleteLogsWithGroupId:(NSString *)groupId {
+  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray new];
+  @synchronized(self) {
+    MSACLogSegmentGroup *group = self.groups[groupId];
+    if (!group) {
+      return logs;
+    }
+    for (MSACLogSegmentEntry *entry in group.entries) {
+      id<MSACLog> log = [self logOfEntry:entry inGroup:(MSACLogSegmentGroup *)group];
+      if (log) {
+        [logs addObject:log];
+      }
+      [self discountEntry:entry ofGroup:groupId];
+    }
+
+    // Delete the segments, including the logs of pending batches.
+    for (MSACLogSegment *segment in group.segments) {
+      [segment closeFile];
+    }
+    [[NSFileManager defaultManager] removeItemAtURL:group.directoryURL error:nil];
+    [self.groups removeObjectForKey:groupId];
+  }
+  return logs;
+}
+
+- (void)deleteEntries:(NSArray<MSACLogSegmentEntry *> *)entries fromGroup:(MSACLogSegmentGroup *)group {
+  if (entries.count == 0) {
+    return;
+  }
+  [self appendTombstoneOfEntries:entries toGroup:group];
+  [self forgetEntries:entries ofGroup:group];
+  [self compactGroup:group];
+}
+
+- (void)appendTombstoneOfEntries:(NSArray<MSACLogSegmentEntry *> *)entries toGroup:(MSACLogSegmentGroup *)group {
+  if (entries.count == 0) {
+    return;
+  }
+
+  // A lost tombstone only makes the logs be loaded again, it is not synced.
+  NSMutableData *payload = [NSMutableData dataWithCapacity:4 + entries.count * 8];
+  MSACSegmentAppendUInt(payload, entries.count, 4);
+  for (MSACLogSegmentEntry *entry in entries) {
+    MSACSegmentAppendUInt(payload, (uint64_t)entry.logId, 8);
+  }
+  NSData *record = [MSACLogSegmentStorage recordWithType:MSACSegmentRecordTypeTombstone payload:payload];
+  MSACLogSegment *segment = [self appendRecord:record toGroup:group sync:NO];
+  if (segment) {
+    segment.tombstoneSize += record.length;
+  } else {
+    MSACLogError([MSACAppCenter logTag], @"Failed to record the deletion of %tu log(s) of %@.", entries.count, group.groupId);
+  }
+}
+
+- (void)forgetEntries:(NSArray<MSACLogSegmentEntry *> *)entries ofGroup:(MSACLogSegmentGroup *)group {
+  NSMutableIndexSet *indexes = [NSMutableIndexSet new];
+  for (MSACLogSegmentEntry *entry in entries) {
+    NSUInteger index = [group.entries indexOfObject:entry
+                                      inSortedRange:NSMakeRange(0, group.entries.count)
+                                            options:NSBinarySearchingFirstEqual
+                                    usingComparator:^NSComparisonResult(MSACLogSegmentEntry *entry1, MSACLogSegmentEntry *entry2) {
+                                      return [@(entry1.logId) compare:@(entry2.logId)];
+                                    }];
+    if (index != NSNotFound) {
+      [indexes addIndex:index];
+    }
+    [group.entriesById removeObjectForKey:@(entry.logId)];
+    MSACLogSegment *segment = [group segmentWithNumber:entry.segmentNumber];
+    segment.liveCount -= 1;
+    segment.liveSize -= entry.recordLength;
+    if (entry.batchId) {
+      [group.batches[(NSString *)entry.batchId] removeObject:@(entry.logId)];
+      if (group.batches[(NSString *)entry.batchId].count == 0) {
+        [group.batches removeObjectForKey:(NSString *)entry.batchId];
+      }
+    }
+    [self discountEntry:entry ofGroup:group.groupId];
+  }
+  [group.entries removeObjectsAtIndexes:indexes];
+}
+
+- (void)discountEntry:(MSACLogSegmentEntry *)entry ofGroup:(NSString *)groupId {
+  [self.logCounters addLogsCount:-1 size:-(long long)entry.size groupId:groupId targetKey:entry.targetKey];
+  if (!entry.batchId) {
+    [self.unbatchedLogCounters addLogsCount:-1 size:-(long long)entry.payloadSize groupId:groupId targetKey:entry.targetKey];
+  }
+}
+
+#pragma mark - Compaction
+
+- (void)compactGroup:(MSACLogSegmentGroup *)group {
+
+  /*
+   * Only the oldest segment is compacted: the tombstones it contains can only refer to its own logs, they don't need to be kept. Its live
+   * logs are appended to the last segment before it is deleted.
+   */
+  while (group.segments.count > 0) {
+    MSACLogSegment *oldest = group.segments.firstObject;
+    if (oldest.liveCount > 0 && oldest.liveSize * 2 >= oldest.size) {
+      break;
+    }
+    if (oldest.liveCount > 0) {
+
+      // Without room for a copy of its live logs, the segment is rewritten in place instead.
+      if ((long long)([self totalSize] + oldest.liveSize) > self.maxSizeInBytes) {
+        [self rewriteSegment:oldest inGroup:group];
+        break;
+      }
+      if (oldest == group.segments.lastObject && ![self startSegmentInGroup:group]) {
+        break;
+      }
+      if (![self moveLogsOfSegment:oldest inGroup:group]) {
+        break;
+      }
+    }
+    [oldest closeFile];
+    [[NSFileManager defaultManager] removeItemAtURL:oldest.fileURL error:nil];
+    [group.segments removeObjectAtIndex:0];
+  }
+}
+
+- (BOOL)moveLogsOfSegment:(MSACLogSegment *)segment inGroup:(MSACLogSegmentGroup *)group {
+  NSMutableIndexSet *lostIndexes = [NSMutableIndexSet new];
+  MSACLogSegment *lastSegment = nil;
+  for (NSUInteger i = 0; i < group.entries.count; i++) {
+    MSACLogSegmentEntry *entry = group.entries[i];
+    if (entry.segmentNumber != segment.number) {
+      continue;
+    }
+    NSData *record = [self recordOfEntry:entry inGroup:group];
+    if (!record) {
+      MSACLogError([MSACAppCenter logTag], @"Failed to read log with Id %lld to compact its segment, the log is discarded.", entry.logId);
+      [lostIndexes addIndex:i];
+      [group.entriesById removeObjectForKey:@(entry.logId)];
+      [self discountEntry:entry ofGroup:group.groupId];
+      continue;
+    }
+    if ((long long)([self totalSize] + record.length) > self.maxSizeInBytes) {
+      MSACLogError([MSACAppCenter logTag], @"Storage is full, failed to move log with Id %lld to compact its segment.", entry.logId);
+      return NO;
+    }
+    MSACLogSegment *destination = [self appendRecord:record toGroup:group sync:NO];
+    if (!destination) {
+      return NO;
+    }
+    entry.segmentNumber = destination.number;
+    entry.offset = destination.size - record.length;
+    destination.liveCount += 1;
+    destination.liveSize += record.length;
+    lastSegment = destination;
+  }
+  [group.entries removeObjectsAtIndexes:lostIndexes];
+
+  // The moved logs must be on disk before their previous copy is deleted.
+  if (lastSegment && [lastSegment openFile]) {
+    fsync(lastSegment.fileDescriptor);
+  }
+  segment.liveCount = 0;
+  segment.liveSize = 0;
+  return YES;
+}
+
+- (BOOL)rewriteSegment:(MSACLogSegment *)segment inGroup:(MSACLogSegmentGroup *)group {
+  NSData *data = nil;
+  if ([segment openFile]) {
+    NSMutableData *bytes = [NSMutableData dataWithLength:(NSUInteger)segment.size];
+    if (pread(segment.fileDescriptor, bytes.mutableBytes, bytes.length, 0) == (ssize_t)bytes.length) {
+      data = bytes;
+    }
+  }
+  if (!data) {
+    MSACLogError([MSACAppCenter logTag], @"Failed to read log segment %@ to rewrite it.", segment.fileURL.lastPathComponent);
+    return NO;
+  }
+
+  // The records were checked when the segment was replayed, only the log ids are read again.
+  BOOL oldest = segment == group.segments.firstObject;
+  NSMutableData *rewritten = [NSMutableData dataWithCapacity:(NSUInteger)segment.size];
+  NSMutableArray<MSACLogSegmentEntry *> *movedEntries = [NSMutableArray new];
+  NSMutableArray<NSNumber *> *movedOffsets = [NSMutableArray new];
+  unsigned long long tombstoneSize = 0;
+  const uint8_t *bytes = data.bytes;
+  NSUInteger offset = 0;
+  while (data.length - offset >= kMSACSegmentRecordHeaderSize) {
+    MSACSegmentReader header = {bytes + offset, kMSACSegmentRecordHeaderSize, 0, NO};
+    NSUInteger payloadLength = (NSUInteger)MSACSegmentReadUInt(&header, 4);
+    MSACSegmentReadUInt(&header, 4);
+    uint8_t type = (uint8_t)MSACSegmentReadUInt(&header, 1);
+    NSUInteger recordLength = kMSACSegmentRecordHeaderSize + payloadLength;
+    if (payloadLength > data.length - offset - kMSACSegmentRecordHeaderSize) {
+      break;
+    }
+    BOOL kept = NO;
+    if (type == MSACSegmentRecordTypeLog || type == MSACSegmentRecordTypeSizedLog) {
+      MSACSegmentReader reader = {bytes + offset + kMSACSegmentRecordHeaderSize, payloadLength, 0, NO};
+      MSACLogSegmentEntry *entry = group.entriesById[@((int64_t)MSACSegmentReadUInt(&reader, 8))];
+      if (entry && entry.segmentNumber == segment.number && entry.offset == offset) {
+        [movedEntries addObject:entry];
+        [movedOffsets addObject:@(rewritten.length)];
+        kept = YES;
+      }
+    } else if (type == MSACSegmentRecordTypeTombstone && !oldest) {
+
+      // Tombstones of a segment can refer to the logs of older segments, they are only dropped from the oldest one.
+      tombstoneSize += recordLength;
+      kept = YES;
+    }
+    if (kept) {
+      [rewritten appendBytes:bytes + offset length:recordLength];
+    }
+    offset += recordLength;
+  }
+
+  // The rewritten segment replaces the segment only once it is complete on disk.
+  NSURL *rewriteURL = [segment.fileURL URLByAppendingPathExtension:kMSACLogSegmentRewriteExtension];
+  int fileDescriptor = open(rewriteURL.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  BOOL written = fileDescriptor >= 0 && write(fileDescriptor, rewritten.bytes, rewritten.length) == (ssize_t)rewritten.length &&
+                 fsync(fileDescriptor) == 0;
+  if (fileDescriptor >= 0) {
+    close(fileDescriptor);
+  }
+  [segment closeFile];
+  if (!written || rename(rewriteURL.fileSystemRepresentation, segment.fileURL.fileSystemRepresentation) != 0) {
+    MSACLogError([MSACAppCenter logTag], @"Failed to rewrite log segment %@, errno=%d.", segment.fileURL.lastPathComponent, errno);
+    [[NSFileManager defaultManager] removeItemAtURL:rewriteURL error:nil];
+    return NO;
+  }
+  for (NSUInteger i = 0; i < movedEntries.count; i++) {
+    movedEntries[i].offset = movedOffsets[i].unsignedLongLongValue;
+  }
+  segment.size = rewritten.length;
+  segment.tombstoneSize = tombstoneSize;
+  self.bytesWritten += rewritten.length;
+  return YES;
+}
+
+#pragma mark - Expiry
+
+- (void)setTimeToLive:(NSTimeInterval)timeToLive forGroupId:(nullable NSString *)groupId flags:(MSACFlags)flags {
+  NSNumber *persistenceFlags = @(flags & kMSACPersistenceFlagsMask);
+  @synchronized(self) {
+    NSMutableDictionary<NSNumber *, NSNumber *> *timeToLives = self.defaultTimeToLives;
+    if (groupId) {
+      timeToLives = self.groupTimeToLives[(NSString *)groupId];
+      if (!timeToLives) {
+        timeToLives = [NSMutableDictionary new];
+        self.groupTimeToLives[(NSString *)groupId] = timeToLives;
+      }
+    }
+    timeToLives[persistenceFlags] = @(timeToLive);
+  }
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)deleteExpiredLogsWithLimit:(NSUInteger)limit {
+  NSMutableDictionary<NSString *, NSNumber *> *expiredLogsCounts = [NSMutableDictionary new];
+  long long now = (long long)[[NSDate date] timeIntervalSince1970];
+  @synchronized(self) {
+    NSUInteger remaining = limit;
+    for (MSACLogSegmentGroup *group in [self.groups allValues]) {
+      for (NSNumber *flags in @[ @(MSACFlagsNormal), @(MSACFlagsCritical) ]) {
+        NSNumber *timeToLive = self.groupTimeToLives[group.groupId][flags] ?: self.defaultTimeToLives[flags];
+        if (remaining == 0) {
+          break;
+        }
+        if (timeToLive.doubleValue <= 0) {
+          continue;
+        }
+
+        // Logs are in saving order, the oldest ones are deleted first.
+        long long expiryTimestamp = now - (long long)timeToLive.doubleValue;
+        NSMutableArray<MSACLogSegmentEntry *> *expiredEntries = [NSMutableArray new];
+        for (MSACLogSegmentEntry *entry in group.entries) {
+          if (expiredEntries.count == remaining) {
+            break;
+          }
+          if (entry.flags == flags.unsignedIntegerValue && entry.timestamp < expiryTimestamp) {
+            [expiredEntries addObject:entry];
+          }
+        }
+        if (expiredEntries.count > 0) {
+          [self deleteEntries:expiredEntries fromGroup:group];
+          expiredLogsCounts[group.groupId] = @(expiredLogsCounts[group.groupId].unsignedIntegerValue + expiredEntries.count);
+          remaining -= expiredEntries.count;
+        }
+      }
+    }
+  }
+  for (NSString *groupId in expiredLogsCounts) {
+    MSACLogDebug([MSACAppCenter logTag], @"Deleted %@ expired log(s) of %@.", expiredLogsCounts[groupId], groupId);
+  }
+  return expiredLogsCounts;
+}
+
+#pragma mark - Count and size
+
+- (NSUInteger)countLogs {
+  NSUInteger count = 0;
+  @synchronized(self) {
+    for (MSACLogSegmentGroup *group in [self.groups objectEnumerator]) {
+      count += group.entries.count;
+    }
+  }
+  return count;
+}
+
+- (NSUInteger)countLogsWithGroupId:(NSString *)groupId excludedTargetKeys:(nullable NSArray<NSString *> *)excludedTargetKeys {
+  return [self.logCounters countLogsWithGroupId:groupId excludedTargetKeys:excludedTargetKeys];
+}
+
+- (long long)sizeOfLogsWithGroupId:(NSString *)groupId {
+  return [self.logCounters sizeOfLogsWithGroupId:groupId];
+}
+
+- (long long)sizeOfUnbatchedLogsWithGroupId:(NSString *)groupId {
+  return [self.unbatchedLogCounters sizeOfLogsWithGroupId:groupId];
+}
+
+- (unsigned long long)totalSize {
+  unsigned long long size = 0;
+  for (MSACLogSegmentGroup *group in [self.groups objectEnumerator]) {
+    for (MSACLogSegment *segment in group.segments) {
+      size += segment.size;
+    }
+  }
+  return size;
+}
+
+#pragma mark - Settings
+
+- (void)setBatchSizeInBytesLimit:(NSUInteger)sizeInBytes forGroupId:(NSString *)groupId {
+  @synchronized(self) {
+    self.batchSizeInBytesLimits[groupId] = @(sizeInBytes);
+  }
+}
+
+- (void)setMaxStorageSize:(long)sizeInBytes completionHandler:(nullable void (^)(BOOL))completionHandler {
+  BOOL success;
+  @synchronized(self) {
+    unsigned long long currentSize = [self totalSize];
+    success = sizeInBytes > 0 && (unsigned long long)sizeInBytes >= currentSize;
+    if (success) {
+      self.maxSizeInBytes = sizeInBytes;
+      MSACLogDebug([MSACAppCenter logTag], @"Changed maximum storage size to %ld bytes.", sizeInBytes);
+    } else {
+      MSACLogError([MSACAppCenter logTag], @"Cannot change the maximum storage size to %ld bytes, the logs take %llu bytes.", sizeInBytes,
+                   currentSize);
+    }
+  }
+  if (completionHandler) {
+    completionHandler(success);
+  }
+}
+
+- (void)setDurability:(MSACStorageDurability)durability {
+  @synchronized(self) {
+    _durability = durability;
+  }
+}
+
+- (void)commitPendingLogs {
+
+  // Records are written to the segment files as logs are saved, nothing is pending.
+}
+
+@end
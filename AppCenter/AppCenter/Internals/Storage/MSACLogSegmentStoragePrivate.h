@@ -0,0 +1,268 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACEncrypter.h"
+#import "MSACLogCounters.h"
+#import "MSACLogSegmentStorage.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+static NSString *const kMSACLogSegmentsDirectoryName = @"LogSegments";
+static NSString *const kMSACLogSegmentFileExtension = @"segment";
+
+/**
+ * Extension appended to a segment being rewritten, until it replaces the segment.
+ */
+static NSString *const kMSACLogSegmentRewriteExtension = @"rewrite";
+
+/**
+ * Default maximum size of all the segment files.
+ */
+static const long long kMSACDefaultSegmentStorageSizeInBytes = 10 * 1024 * 1024;
+
+/**
+ * Default size above which a new segment is started.
+ */
+static const NSUInteger kMSACDefaultMaxSegmentSizeInBytes = 256 * 1024;
+
+/**
+ * Size of the header of the records: the length of the payload and its checksum, as little endian 32-bit integers, then the record type.
+ */
+static const NSUInteger kMSACSegmentRecordHeaderSize = 9;
+
+/**
+ * Types of the records.
+ */
+typedef NS_ENUM(uint8_t, MSACSegmentRecordType) {
+
+  /**
+   * A log with its id, timestamp, persistence flags, compression dictionary version, target key and encrypted target token.
+   */
+  MSACSegmentRecordTypeLog = 1,
+
+  /**
+   * Ids of deleted logs.
+   */
+  MSACSegmentRecordTypeTombstone = 2,
+
+  /**
+   * A log, as `MSACSegmentRecordTypeLog`, with the length of its archive before compression after the compression dictionary version.
+   */
+  MSACSegmentRecordTypeSizedLog = 3
+};
+
+/**
+ * Stored log as indexed in memory.
+ */
+@interface MSACLogSegmentEntry : NSObject
+
+@property(nonatomic) int64_t logId;
+
+/**
+ * Number of the segment holding the record of the log.
+ */
+@property(nonatomic) NSUInteger segmentNumber;
+
+@property(nonatomic) unsigned long long offset;
+
+/**
+ * Length of the record, header included.
+ */
+@property(nonatomic) NSUInteger recordLength;
+
+/**
+ * Length of the stored log data, counted in the size of the logs.
+ */
+@property(nonatomic) NSUInteger size;
+
+/**
+ * Length of the log archive before compression, budgeted in batches.
+ */
+@property(nonatomic) NSUInteger payloadSize;
+
+@property(nonatomic) MSACFlags flags;
+
+@property(nonatomic) long long timestamp;
+
+@property(nonatomic, copy, nullable) NSString *targetKey;
+
+@property(nonatomic, copy, nullable) NSString *batchId;
+
+@end
+
+/**
+ * Segment file of a group.
+ */
+@interface MSACLogSegment : NSObject
+
+@property(nonatomic, readonly) NSUInteger number;
+
+@property(nonatomic, readonly) NSURL *fileURL;
+
+/**
+ * Size of the file in bytes.
+ */
+@property(nonatomic) unsigned long long size;
+
+/**
+ * Number and length of the records of the logs that are not deleted.
+ */
+@property(nonatomic) NSUInteger liveCount;
+
+@property(nonatomic) unsigned long long liveSize;
+
+/**
+ * Length of the tombstone records.
+ */
+@property(nonatomic) unsigned long long tombstoneSize;
+
+/**
+ * File descriptor, -1 until the file is opened.
+ */
+@property(nonatomic) int fileDescriptor;
+
+- (instancetype)initWithNumber:(NSUInteger)number fileURL:(NSURL *)fileURL;
+
+/**
+ * Open the file if it is not already open, creating it if needed.
+ *
+ * @return `YES` if the file is open.
+ */
+- (BOOL)openFile;
+
+- (void)closeFile;
+
+@end
+
+/**
+ * Segments and index of the logs of a group.
+ */
+@interface MSACLogSegmentGroup : NSObject
+
+@property(nonatomic, readonly) NSString *groupId;
+
+@property(nonatomic, readonly) NSURL *directoryURL;
+
+/**
+ * Segments by ascending number, the last one is the one logs are appended to.
+ */
+@property(nonatomic, readonly) NSMutableArray<MSACLogSegment *> *segments;
+
+/**
+ * Logs by ascending id.
+ */
+@property(nonatomic, readonly) NSMutableArray<MSACLogSegmentEntry *> *entries;
+
+/**
+ * Logs by id.
+ */
+@property(nonatomic, readonly) NSMutableDictionary<NSNumber *, MSACLogSegmentEntry *> *entriesById;
+
+/**
+ * Ids of the logs of the pending batches, by batch Id.
+ */
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, NSMutableArray<NSNumber *> *> *batches;
+
+- (instancetype)initWithGroupId:(NSString *)groupId directoryURL:(NSURL *)directoryURL;
+
+- (nullable MSACLogSegment *)segmentWithNumber:(NSUInteger)number;
+
+@end
+
+@interface MSACLogSegmentStorage ()
+
+@property(nonatomic, readonly) NSURL *directoryURL;
+
+/**
+ * Groups by group Id.
+ */
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, MSACLogSegmentGroup *> *groups;
+
+/**
+ * Id of the next saved log.
+ */
+@property(nonatomic) int64_t nextLogId;
+
+/**
+ * Maximum size of all the segment files.
+ */
+@property(nonatomic) long long maxSizeInBytes;
+
+@property(nonatomic) MSACStorageDurability durability;
+
+@property(nonatomic, readonly) MSACLogCounters *logCounters;
+
+/**
+ * Running number and size, before compression, of the logs that are not part of a pending batch.
+ */
+@property(nonatomic, readonly) MSACLogCounters *unbatchedLogCounters;
+
+@property(nonatomic, readonly) MSACEncrypter *targetTokenEncrypter;
+
+/**
+ * Encrypted target tokens by target token, so that a token is encrypted once.
+ */
+@property(nonatomic, readonly) NSCache<NSString *, NSString *> *encryptedTargetTokens;
+
+/**
+ * Decrypted target tokens by encrypted target token. Cleared when the encryption key rotates.
+ */
+@property(nonatomic, readonly) NSCache<NSString *, NSString *> *decryptedTargetTokens;
+
+/**
+ * Maximum age, in seconds, of the logs by persistence flags, for the groups without a specific time to live.
+ */
+@property(nonatomic, readonly) NSMutableDictionary<NSNumber *, NSNumber *> *defaultTimeToLives;
+
+/**
+ * Maximum age, in seconds, of the logs by persistence flags, by group Id.
+ */
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, NSMutableDictionary<NSNumber *, NSNumber *> *> *groupTimeToLives;
+
+/**
+ * Maximum total size, in bytes, of the logs of a batch, by group Id.
+ */
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, NSNumber *> *batchSizeInBytesLimits;
+
+@property(nonatomic) unsigned long long bytesWritten;
+
+/**
+ * Size of all the segment files in bytes.
+ */
+- (unsigned long long)totalSize;
+
+/**
+ * Compact the oldest segments of a group while most of their logs are deleted, deleting the segments without logs.
+ *
+ * @param group The group.
+ */
+- (void)compactGroup:(MSACLogSegmentGroup *)group;
+
+/**
+ * Rewrite a segment with only the records of its live logs, and its tombstones unless it is the oldest segment of its group.
+ *
+ * @param segment The segment.
+ * @param group The group of the segment.
+ *
+ * @return `YES` if the segment has been rewritten.
+ */
+- (BOOL)rewriteSegment:(MSACLogSegment *)segment inGroup:(MSACLogSegmentGroup *)group;
+
+/**
+ * Close the segment files, the storage can't be used anymore.
+ */
+- (void)close;
+
+/**
+ * Encode a record.
+ *
+ * @param type The record type.
+ * @param payload The payload.
+ *
+ * @return The record with its header.
+ */
++ (NSData *)recordWithType:(MSACSegmentRecordType)type payload:(NSData *)payload;
+
+@end
+
+NS_ASSUME_NONNULL_END
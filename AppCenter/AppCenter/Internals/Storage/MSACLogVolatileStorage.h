@@ -0,0 +1,53 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+#import "MSACLogDBStorage.h"
+#import "MSACStorage.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Default maximum number of logs kept in memory.
+ */
+static const NSUInteger kMSACDefaultVolatileStorageCapacity = 500;
+
+/**
+ * Storage keeping the logs enqueued with `MSACFlagsVolatile` in memory, so that high volume logs which can be lost are never written to
+ * disk while the app is running.
+ *
+ * @discussion The number of logs is bounded, the oldest logs that are not part of a batch are dropped to make room for new ones. Logs can
+ * be moved to a persistent storage before the app is suspended or when memory runs low.
+ */
+@interface MSACLogVolatileStorage : NSObject <MSACStorage>
+
+/**
+ * Initializes a storage.
+ *
+ * @param capacity The maximum number of logs kept in memory.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+/**
+ * Maximum number of logs kept in memory.
+ */
+@property(nonatomic, readonly) NSUInteger capacity;
+
+/**
+ * Handler triggered, on the thread saving the log, once the oldest log has been dropped to make room for a new log.
+ */
+@property(nonatomic, copy, nullable) MSACLogEvictionHandler evictionHandler;
+
+/**
+ * Move the logs that are not part of a batch to another storage, with normal persistence. Logs of batches being sent stay in memory.
+ *
+ * @param storage The storage the logs are saved to.
+ *
+ * @return The number of moved logs by group Id.
+ */
+- (NSDictionary<NSString *, NSNumber *> *)moveLogsToStorage:(id<MSACStorage>)storage;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,256 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACLogVolatileStorage.h"
+#import "MSACAppCenterInternal.h"
+#import "MSACUtility+StringFormatting.h"
+
+/**
+ * Log kept in memory.
+ */
+@interface MSACVolatileLogEntry : NSObject
+
+@property(nonatomic) int64_t logId;
+
+@property(nonatomic, copy) NSString *groupId;
+
+@property(nonatomic) id<MSACLog> log;
+
+@property(nonatomic, copy, nullable) NSString *targetKey;
+
+@property(nonatomic, copy, nullable) NSString *batchId;
+
+@end
+
+@implementation MSACVolatileLogEntry
+@end
+
+@interface MSACLogVolatileStorage ()
+
+/**
+ * Logs from the oldest to the newest.
+ */
+@property(nonatomic, readonly) NSMutableArray<MSACVolatileLogEntry *> *entries;
+
+@property(nonatomic) int64_t nextLogId;
+
+@end
+
+@implementation MSACLogVolatileStorage
+
+- (instancetype)init {
+  return [self initWithCapacity:kMSACDefaultVolatileStorageCapacity];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+  if ((self = [super init])) {
+    _capacity = MAX(capacity, 1);
+    _entries = [NSMutableArray arrayWithCapacity:_capacity];
+    _nextLogId = 1;
+  }
+  return self;
+}
+
+#pragma mark - Save logs
+
+- (BOOL)saveLog:(id<MSACLog>)log withGroupId:(NSString *)groupId flags:(__unused MSACFlags)flags {
+  if (!log) {
+    return NO;
+  }
+  NSString *targetKey = nil;
+  if ([(NSObject *)log isKindOfClass:[MSACCommonSchemaLog class]]) {
+    NSString *targetToken = [[log transmissionTargetTokens] anyObject];
+    targetKey = targetToken ? [MSACUtility targetKeyFromTargetToken:(NSString *)targetToken] : nil;
+  }
+  MSACVolatileLogEntry *droppedEntry = nil;
+  @synchronized(self) {
+
+    // Drop the oldest log that is not being sent to make room for the new one.
+    if (self.entries.count >= self.capacity) {
+      NSUInteger index = NSNotFound;
+      for (NSUInteger i = 0; i < self.entries.count; i++) {
+        if (!self.entries[i].batchId) {
+          index = i;
+          break;
+        }
+      }
+      if (index == NSNotFound) {
+        MSACLogDebug([MSACAppCenter logTag], @"Volatile storage is full of logs being sent; discarding the log.");
+        return NO;
+      }
+      droppedEntry = self.entries[index];
+      [self.entries removeObjectAtIndex:index];
+    }
+    MSACVolatileLogEntry *entry = [MSACVolatileLogEntry new];
+    entry.logId = self.nextLogId++;
+    entry.groupId = groupId;
+    entry.log = log;
+    entry.targetKey = targetKey;
+    [self.entries addObject:entry];
+    MSACLogVerbose([MSACAppCenter logTag], @"Log is kept in memory with id: '%lld'", entry.logId);
+  }
+  MSACLogEvictionHandler evictionHandler = self.evictionHandler;
+  if (droppedEntry && evictionHandler) {
+    evictionHandler(@{droppedEntry.groupId : @1});
+  }
+  return YES;
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)moveLogsToStorage:(id<MSACStorage>)storage {
+  NSMutableArray<MSACVolatileLogEntry *> *movedEntries = [NSMutableArray new];
+  @synchronized(self) {
+    NSMutableIndexSet *indexes = [NSMutableIndexSet new];
+    [self.entries enumerateObjectsUsingBlock:^(MSACVolatileLogEntry *entry, NSUInteger idx, __unused BOOL *stop) {
+      if (!entry.batchId) {
+        [indexes addIndex:idx];
+        [movedEntries addObject:entry];
+      }
+    }];
+    [self.entries removeObjectsAtIndexes:indexes];
+  }
+
+  // Save outside of the lock, the other storage may take a while to write the logs.
+  NSMutableDictionary<NSString *, NSNumber *> *movedLogsCounts = [NSMutableDictionary new];
+  for (MSACVolatileLogEntry *entry in movedEntries) {
+    if ([storage saveLog:entry.log withGroupId:entry.groupId flags:MSACFlagsNormal]) {
+      movedLogsCounts[entry.groupId] = @(movedLogsCounts[entry.groupId].unsignedIntegerValue + 1);
+    }
+  }
+  if (movedEntries.count > 0) {
+    MSACLogDebug([MSACAppCenter logTag], @"Moved %tu volatile log(s) to disk.", movedEntries.count);
+  }
+  return movedLogsCounts;
+}
+
+#pragma mark - Load logs
+
+- (BOOL)loadLogsWithGroupId:(NSString *)groupId
+                      limit:(NSUInteger)limit
+         excludedTargetKeys:(nullable NSArray<NSString *> *)excludedTargetKeys
+          completionHandler:(nullable MSACLoadDataCompletionHandler)completionHandler {
+  NSString *batchId = MSAC_UUID_STRING;
+  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray new];
+  BOOL moreLogsAvailable = NO;
+  @synchronized(self) {
+    for (MSACVolatileLogEntry *entry in self.entries) {
+      if (entry.batchId || ![entry.groupId isEqualToString:groupId] ||
+          (entry.targetKey && [excludedTargetKeys containsObject:(NSString *)entry.targetKey])) {
+        continue;
+      }
+      if (logs.count == limit) {
+        moreLogsAvailable = YES;
+        break;
+      }
+      entry.batchId = batchId;
+      [logs addObject:entry.log];
+    }
+  }
+
+  // Logs are in memory, the completion handler is always called right away.
+  if (completionHandler) {
+    completionHandler(logs, logs.count > 0 ? batchId : nil);
+  }
+  return moreLogsAvailable;
+}
+
+#pragma mark - Release and delete logs
+
+- (void)releaseLogsWithBatchId:(NSString *)batchId groupId:(__unused NSString *)groupId {
+  @synchronized(self) {
+    for (MSACVolatileLogEntry *entry in self.entries) {
+      if ([entry.batchId isEqualToString:batchId]) {
+        entry.batchId = nil;
+      }
+    }
+  }
+}
+
+- (void)deleteLogsWithBatchId:(NSString *)batchId groupId:(__unused NSString *)groupId {
+  @synchronized(self) {
+    NSMutableIndexSet *indexes = [NSMutableIndexSet new];
+    [self.entries enumerateObjectsUsingBlock:^(MSACVolatileLogEntry *entry, NSUInteger idx, __unused BOOL *stop) {
+      if ([entry.batchId isEqualToString:batchId]) {
+        [indexes addIndex:idx];
+      }
+    }];
+    [self.entries removeObjectsAtIndexes:indexes];
+  }
+}
+
+- (NSArray<id<MSACLog>> *)deleteLogsWithGroupId:(NSString *)groupId {
+  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray new];
+  @synchronized(self) {
+    NSMutableIndexSet *indexes = [NSMutableIndexSet new];
+    [self.entries enumerateObjectsUsingBlock:^(MSACVolatileLogEntry *entry, NSUInteger idx, __unused BOOL *stop) {
+      if ([entry.groupId isEqualToString:groupId]) {
+        [indexes addIndex:idx];
+        [logs addObject:entry.log];
+      }
+    }];
+    [self.entries removeObjectsAtIndexes:indexes];
+  }
+  return logs;
+}
+
+#pragma mark - Count logs
+
+- (NSUInteger)countLogs {
+  @synchronized(self) {
+    return self.entries.count;
+  }
+}
+
+- (NSUInteger)countLogsWithGroupId:(NSString *)groupId excludedTargetKeys:(nullable NSArray<NSString *> *)excludedTargetKeys {
+  NSUInteger count = 0;
+  @synchronized(self) {
+    for (MSACVolatileLogEntry *entry in self.entries) {
+      if ([entry.groupId isEqualToString:groupId] &&
+          !(entry.targetKey && [excludedTargetKeys containsObject:(NSString *)entry.targetKey])) {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+- (long long)sizeOfLogsWithGroupId:(__unused NSString *)groupId {
+
+  // Logs are not serialized while they are in memory.
+  return 0;
+}
+
+- (long long)sizeOfUnbatchedLogsWithGroupId:(__unused NSString *)groupId {
+  return 0;
+}
+
+#pragma mark - Settings
+
+- (void)setBatchSizeInBytesLimit:(__unused NSUInteger)sizeInBytes forGroupId:(__unused NSString *)groupId {
+
+  // Logs are not serialized while they are in memory, batches are only limited by their number of logs.
+}
+
+- (void)setTimeToLive:(__unused NSTimeInterval)timeToLive forGroupId:(nullable __unused NSString *)groupId flags:(__unused MSACFlags)flags {
+
+  // Logs are kept in memory for a short while, they expire with the time to live of the storage they are moved to.
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)deleteExpiredLogsWithLimit:(__unused NSUInteger)limit {
+  return @{};
+}
+
+- (void)setMaxStorageSize:(__unused long)sizeInBytes completionHandler:(nullable void (^)(BOOL))completionHandler {
+
+  // The memory used by the logs is bounded by the capacity of the storage.
+  if (completionHandler) {
+    completionHandler(YES);
+  }
+}
+
+- (void)setDurability:(__unused MSACStorageDurability)durability {
+}
+
+- (void)commitPendingLogs {
+}
+
+@end
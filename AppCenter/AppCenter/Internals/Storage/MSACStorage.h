@@ -4,6 +4,7 @@
 #import <Foundation/Foundation.h>
 
 #import "MSACConstants+Flags.h"
+#import "MSACConstants.h"
 #import "MSACLog.h"
 #import "MSACLogContainer.h"
 
@@ -39,9 +40,39 @@ typedef void (^MSACLoadDataCompletionHandler)(NSArray<id<MSACLog>> *_Nullable lo
  * Get the number of logs stored in the storage.
  *
  * @return The number of logs.
+ *
+ * @discussion This counts the rows of the database, use `countLogsWithGroupId:excludedTargetKeys:` on hot paths.
  */
 - (NSUInteger)countLogs;
 
+/**
+ * Get the number of logs of a group, without querying the database.
+ *
+ * @param groupId The key used for grouping logs.
+ * @param excludedTargetKeys The target keys of the logs not counted.
+ *
+ * @return The number of logs of the group, including the logs of pending batches.
+ */
+- (NSUInteger)countLogsWithGroupId:(NSString *)groupId excludedTargetKeys:(nullable NSArray<NSString *> *)excludedTargetKeys;
+
+/**
+ * Get the size of the logs of a group, without querying the database.
+ *
+ * @param groupId The key used for grouping logs.
+ *
+ * @return The size of the logs of the group in bytes, including the logs of pending batches.
+ */
+- (long long)sizeOfLogsWithGroupId:(NSString *)groupId;
+
+/**
+ * Get the size of the logs of a group that are not part of a pending batch, without querying the database.
+ *
+ * @param groupId The key used for grouping logs.
+ *
+ * @return The size of the logs in bytes before compression, as they are budgeted in batches.
+ */
+- (long long)sizeOfUnbatchedLogsWithGroupId:(NSString *)groupId;
+
 /**
  * Delete logs related to given group from the storage.
  *
@@ -59,6 +90,14 @@ typedef void (^MSACLoadDataCompletionHandler)(NSArray<id<MSACLog>> *_Nullable lo
  */
 - (void)deleteLogsWithBatchId:(NSString *)batchId groupId:(NSString *)groupId;
 
+/**
+ * Release the logs of a batch so that they can be loaded again in another batch.
+ *
+ * @param batchId Id of the batch to release.
+ * @param groupId The key used for grouping logs.
+ */
+- (void)releaseLogsWithBatchId:(NSString *)batchId groupId:(NSString *)groupId;
+
 /**
  * Return the most recent logs for a Group Id.
  *
@@ -74,6 +113,34 @@ typedef void (^MSACLoadDataCompletionHandler)(NSArray<id<MSACLog>> *_Nullable lo
          excludedTargetKeys:(nullable NSArray<NSString *> *)excludedTargetKeys
           completionHandler:(nullable MSACLoadDataCompletionHandler)completionHandler;
 
+/**
+ * Limit the total size of the logs loaded in a single batch for a Group Id, on top of the number of logs.
+ *
+ * @param sizeInBytes Maximum total size, in bytes, of the stored logs of a batch, 0 to only limit batches by their number of logs.
+ * @param groupId The key used for grouping logs.
+ *
+ * @discussion A batch always contains at least one log, a log bigger than the limit is loaded in a batch of its own.
+ */
+- (void)setBatchSizeInBytesLimit:(NSUInteger)sizeInBytes forGroupId:(NSString *)groupId;
+
+/**
+ * Set the maximum age of stored logs. Logs older than that are deleted by `deleteExpiredLogsWithLimit:`.
+ *
+ * @param timeToLive Maximum age of the logs in seconds, 0 to keep them until they are sent.
+ * @param groupId The key used for grouping logs, `nil` for the groups without a specific time to live.
+ * @param flags The persistence flags of the logs.
+ */
+- (void)setTimeToLive:(NSTimeInterval)timeToLive forGroupId:(nullable NSString *)groupId flags:(MSACFlags)flags;
+
+/**
+ * Delete logs older than their time to live.
+ *
+ * @param limit Maximum number of logs deleted.
+ *
+ * @return The number of deleted logs by group Id.
+ */
+- (NSDictionary<NSString *, NSNumber *> *)deleteExpiredLogsWithLimit:(NSUInteger)limit;
+
 /**
  * Set the maximum size of the internal storage. This method must be called before App Center is started.
  *
@@ -87,6 +154,20 @@ typedef void (^MSACLoadDataCompletionHandler)(NSArray<id<MSACLog>> *_Nullable lo
  */
 - (void)setMaxStorageSize:(long)sizeInBytes completionHandler:(nullable void (^)(BOOL))completionHandler;
 
+/**
+ * Set the durability level of the stored logs.
+ *
+ * @param durability The durability level.
+ *
+ * @discussion The default level relies on a write-ahead log only synced to disk for logs with critical persistence.
+ */
+- (void)setDurability:(MSACStorageDurability)durability;
+
+/**
+ * Commit the logs saved but still pending, grouped in a transaction for instance, so that they are not lost if the process is killed.
+ */
+- (void)commitPendingLogs;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -30,6 +30,13 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)addNumber:(NSNumber *)value;
 
+/**
+ * Adds a data object into array.
+ *
+ * @param value A data value to be added to the array.
+ */
+- (void)addData:(nullable NSData *)value;
+
 /**
  * Binds all values in an array with given sqlite statement.
  *
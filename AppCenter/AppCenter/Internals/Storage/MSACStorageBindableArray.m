@@ -5,6 +5,7 @@
 
 #import "MSACAppCenterInternal.h"
 #import "MSACStorageBindableArray.h"
+#import "MSACStorageBlobType.h"
 #import "MSACStorageNumberType.h"
 #import "MSACStorageTextType.h"
 
@@ -25,6 +26,10 @@
   [self.array addObject:[[MSACStorageNumberType alloc] initWithValue:value]];
 }
 
+- (void)addData:(nullable NSData *)value {
+  [self.array addObject:[[MSACStorageBlobType alloc] initWithValue:value]];
+}
+
 - (int)bindAllValuesWithStatement:(void *)query inOpenedDatabase:(void *)db {
   for (int i = 0; i < (int)self.array.count; i++) {
     id<MSACStorageBindableType> value = self.array[i];
@@ -0,0 +1,19 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACStorageBindableType.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface MSACStorageBlobType : NSObject <MSACStorageBindableType>
+
+@property(nonatomic, nullable) NSData *value;
+
+/**
+ * Initializer with a value represented as NSData.
+ */
+- (instancetype __nonnull)initWithValue:(nullable NSData *)value;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,25 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <sqlite3.h>
+
+#import "MSACStorageBlobType.h"
+
+@implementation MSACStorageBlobType
+
+- (instancetype)initWithValue:(nullable NSData *)value {
+  if ((self = [super init])) {
+    _value = value;
+  }
+  return self;
+}
+
+- (int)bindWithStatement:(void *)query atIndex:(int)index {
+  if (self.value) {
+    return sqlite3_bind_blob(query, index, self.value.bytes, (int)self.value.length, SQLITE_TRANSIENT);
+  } else {
+    return sqlite3_bind_null(query, index);
+  }
+}
+
+@end
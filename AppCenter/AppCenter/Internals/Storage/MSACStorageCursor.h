@@ -0,0 +1,95 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Cursor on the current row of a selection query. Values are read from the statement without being boxed.
+ *
+ * @discussion Pointers returned by the cursor, as well as data created without copy, are only valid until the cursor moves to the next row.
+ */
+@interface MSACStorageCursor : NSObject
+
+/**
+ * Initializes a cursor on a statement.
+ *
+ * @param statement A SQLite statement.
+ */
+- (instancetype)initWithStatement:(void *)statement;
+
+/**
+ * Number of columns of the rows.
+ */
+@property(nonatomic, readonly) NSUInteger columnCount;
+
+/**
+ * Check whether a column value is `NULL`.
+ *
+ * @param index The column index.
+ */
+- (BOOL)isNullAtIndex:(NSUInteger)index;
+
+/**
+ * Check whether a column value is a text.
+ *
+ * @param index The column index.
+ */
+- (BOOL)isTextAtIndex:(NSUInteger)index;
+
+/**
+ * Read a column value as a 64-bit integer.
+ *
+ * @param index The column index.
+ */
+- (int64_t)int64AtIndex:(NSUInteger)index;
+
+/**
+ * Read a column value as a double.
+ *
+ * @param index The column index.
+ */
+- (double)doubleAtIndex:(NSUInteger)index;
+
+/**
+ * Read a column value as UTF-8 bytes, not copied.
+ *
+ * @param index The column index.
+ * @param length Set to the number of bytes, the terminating null character excluded.
+ *
+ * @return The bytes or `NULL` if the value is `NULL`.
+ */
+- (nullable const char *)textAtIndex:(NSUInteger)index length:(NSUInteger *)length;
+
+/**
+ * Read a column value as bytes, not copied.
+ *
+ * @param index The column index.
+ * @param length Set to the number of bytes.
+ *
+ * @return The bytes or `NULL` if the value is `NULL` or empty.
+ */
+- (nullable const void *)blobAtIndex:(NSUInteger)index length:(NSUInteger *)length;
+
+/**
+ * Read a column value as a string.
+ *
+ * @param index The column index.
+ *
+ * @return The string or `nil` if the value is `NULL`.
+ */
+- (nullable NSString *)stringAtIndex:(NSUInteger)index;
+
+/**
+ * Read a column value as data wrapping the bytes of the row, without copying them.
+ *
+ * @param index The column index.
+ *
+ * @return The data or `nil` if the value is `NULL`.
+ */
+- (nullable NSData *)dataWithoutCopyAtIndex:(NSUInteger)index;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,75 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <sqlite3.h>
+
+#import "MSACStorageCursor.h"
+
+@interface MSACStorageCursor ()
+
+@property(nonatomic, readonly) sqlite3_stmt *statement;
+
+@end
+
+@implementation MSACStorageCursor
+
+- (instancetype)initWithStatement:(void *)statement {
+  if ((self = [super init])) {
+    _statement = statement;
+  }
+  return self;
+}
+
+- (NSUInteger)columnCount {
+  return (NSUInteger)sqlite3_column_count(self.statement);
+}
+
+- (BOOL)isNullAtIndex:(NSUInteger)index {
+  return sqlite3_column_type(self.statement, (int)index) == SQLITE_NULL;
+}
+
+- (BOOL)isTextAtIndex:(NSUInteger)index {
+  return sqlite3_column_type(self.statement, (int)index) == SQLITE_TEXT;
+}
+
+- (int64_t)int64AtIndex:(NSUInteger)index {
+  return sqlite3_column_int64(self.statement, (int)index);
+}
+
+- (double)doubleAtIndex:(NSUInteger)index {
+  return sqlite3_column_double(self.statement, (int)index);
+}
+
+- (nullable const char *)textAtIndex:(NSUInteger)index length:(NSUInteger *)length {
+
+  // The length must be read after the conversion to text.
+  const char *text = (const char *)sqlite3_column_text(self.statement, (int)index);
+  *length = (NSUInteger)sqlite3_column_bytes(self.statement, (int)index);
+  return text;
+}
+
+- (nullable const void *)blobAtIndex:(NSUInteger)index length:(NSUInteger *)length {
+  const void *blob = sqlite3_column_blob(self.statement, (int)index);
+  *length = (NSUInteger)sqlite3_column_bytes(self.statement, (int)index);
+  return blob;
+}
+
+- (nullable NSString *)stringAtIndex:(NSUInteger)index {
+  NSUInteger length;
+  const char *text = [self textAtIndex:index length:&length];
+  if (!text) {
+    return nil;
+  }
+  return [[NSString alloc] initWithBytes:text length:length encoding:NSUTF8StringEncoding];
+}
+
+- (nullable NSData *)dataWithoutCopyAtIndex:(NSUInteger)index {
+  if ([self isNullAtIndex:index]) {
+    return nil;
+  }
+  NSUInteger length;
+  const void *bytes = [self blobAtIndex:index length:&length];
+  return [NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO];
+}
+
+@end
@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * First byte of a binary archive. It can't be mistaken for the first byte of a keyed archive property list ("bplist").
+ */
+static const uint8_t kMSACBinaryArchiveMagic = 0xAC;
+
+/**
+ * Version of the binary archive format, stored right after the magic byte. Bump it on any incompatible change of the format.
+ */
+static const uint8_t kMSACBinaryArchiveVersion = 1;
+
+/**
+ * Prefix of the keys generated for the values encoded without a key.
+ */
+static NSString *const kMSACBinaryArchiveUnkeyedPrefix = @"$";
+
+/**
+ * Tags preceding each value of a binary archive.
+ */
+typedef NS_ENUM(uint8_t, MSACBinaryArchiveTag) {
+
+  // End of the values of an object.
+  MSACBinaryArchiveTagEnd = 0x00,
+
+  // Scalars.
+  MSACBinaryArchiveTagNil = 0x01,
+  MSACBinaryArchiveTagNull = 0x02,
+  MSACBinaryArchiveTagTrue = 0x03,
+  MSACBinaryArchiveTagFalse = 0x04,
+  MSACBinaryArchiveTagInteger = 0x05,
+  MSACBinaryArchiveTagUnsignedInteger = 0x06,
+  MSACBinaryArchiveTagDouble = 0x07,
+
+  // Strings, a string is written once per archive then referenced by its index.
+  MSACBinaryArchiveTagString = 0x10,
+  MSACBinaryArchiveTagStringReference = 0x11,
+
+  // Foundation values.
+  MSACBinaryArchiveTagData = 0x20,
+  MSACBinaryArchiveTagDate = 0x21,
+  MSACBinaryArchiveTagUUID = 0x22,
+
+  // Collections.
+  MSACBinaryArchiveTagArray = 0x30,
+  MSACBinaryArchiveTagMutableArray = 0x31,
+  MSACBinaryArchiveTagDictionary = 0x32,
+  MSACBinaryArchiveTagMutableDictionary = 0x33,
+  MSACBinaryArchiveTagSet = 0x34,
+  MSACBinaryArchiveTagMutableSet = 0x35,
+  MSACBinaryArchiveTagMutableDictionaryOfClass = 0x36,
+
+  // Objects conforming to `NSCoding`.
+  MSACBinaryArchiveTagObject = 0x40
+};
+
+/**
+ * Keyed archiver writing a compact binary representation of an object graph.
+ *
+ * @discussion Strings are interned, integers are variable-length encoded and nil values are skipped. Objects are archived through their
+ * `NSCoding` implementation, shared references are archived as distinct copies.
+ */
+@interface MSACBinaryArchiver : NSCoder
+
+/**
+ * Archive an object graph.
+ *
+ * @param rootObject The root object of the graph.
+ *
+ * @return The archived data or `nil` if the graph contains an object that can't be archived.
+ */
++ (nullable NSData *)archivedDataWithRootObject:(id)rootObject;
+
+/**
+ * Archive an object graph without one of its objects.
+ *
+ * @param rootObject The root object of the graph.
+ * @param excludedObject An object of the graph, the keys referencing it are not archived and decoded as nil.
+ *
+ * @return The archived data or `nil` if the graph contains an object that can't be archived.
+ */
++ (nullable NSData *)archivedDataWithRootObject:(id)rootObject excludingObject:(nullable id)excludedObject;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,238 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACAppCenterInternal.h"
+#import "MSACBinaryArchiverPrivate.h"
+#import "MSACLogger.h"
+
+@implementation MSACBinaryArchiver
+
+- (instancetype)init {
+  if ((self = [super init])) {
+    _data = [NSMutableData new];
+    _stringIndexes = [NSMutableDictionary new];
+    uint8_t header[] = {kMSACBinaryArchiveMagic, kMSACBinaryArchiveVersion};
+    [_data appendBytes:header length:sizeof(header)];
+  }
+  return self;
+}
+
++ (nullable NSData *)archivedDataWithRootObject:(id)rootObject {
+  return [self archivedDataWithRootObject:rootObject excludingObject:nil];
+}
+
++ (nullable NSData *)archivedDataWithRootObject:(id)rootObject excludingObject:(nullable id)excludedObject {
+  MSACBinaryArchiver *archiver = [MSACBinaryArchiver new];
+  archiver.excludedObject = excludedObject;
+  @try {
+    [archiver writeValue:rootObject];
+  } @catch (NSException *exception) {
+    MSACLogError([MSACAppCenter logTag], @"Unable to archive %@ in binary format: %@", NSStringFromClass([rootObject class]), exception);
+    return nil;
+  }
+  return archiver.data;
+}
+
+#pragma mark - NSCoder
+
+- (BOOL)allowsKeyedCoding {
+  return YES;
+}
+
+- (void)encodeObject:(nullable id)object forKey:(NSString *)key {
+
+  // Missing keys are decoded as nil, no need to store anything.
+  if (!object || object == self.excludedObject) {
+    return;
+  }
+  [self writeString:key];
+  [self writeValue:object];
+}
+
+- (void)encodeConditionalObject:(nullable id)object forKey:(NSString *)key {
+  [self encodeObject:object forKey:key];
+}
+
+- (void)encodeBool:(BOOL)value forKey:(NSString *)key {
+  [self encodeObject:@(value) forKey:key];
+}
+
+- (void)encodeInt:(int)value forKey:(NSString *)key {
+  [self encodeObject:@(value) forKey:key];
+}
+
+- (void)encodeInt32:(int32_t)value forKey:(NSString *)key {
+  [self encodeObject:@(value) forKey:key];
+}
+
+- (void)encodeInt64:(int64_t)value forKey:(NSString *)key {
+  [self encodeObject:@(value) forKey:key];
+}
+
+- (void)encodeInteger:(NSInteger)value forKey:(NSString *)key {
+  [self encodeObject:@(value) forKey:key];
+}
+
+- (void)encodeFloat:(float)value forKey:(NSString *)key {
+  [self encodeObject:@(value) forKey:key];
+}
+
+- (void)encodeDouble:(double)value forKey:(NSString *)key {
+  [self encodeObject:@(value) forKey:key];
+}
+
+- (void)encodeBytes:(nullable const uint8_t *)bytes length:(NSUInteger)length forKey:(NSString *)key {
+  [self encodeObject:[NSData dataWithBytes:bytes length:length] forKey:key];
+}
+
+/*
+ * Unkeyed values are stored under generated keys in the order they are encoded.
+ */
+- (void)encodeObject:(nullable id)object {
+  NSString *key = [NSString stringWithFormat:@"%@%lu", kMSACBinaryArchiveUnkeyedPrefix, (unsigned long)self.unkeyedCount++];
+  [self encodeObject:object forKey:key];
+}
+
+- (void)encodeRootObject:(id)rootObject {
+  [self encodeObject:rootObject];
+}
+
+- (void)encodeDataObject:(NSData *)data {
+  [self encodeObject:data];
+}
+
+- (void)encodeValueOfObjCType:(const char *)type at:(const void *)__unused addr {
+  [NSException raise:NSInvalidArchiveOperationException format:@"Raw values of type %s are not supported by the binary archiver.", type];
+}
+
+#pragma mark - Writing
+
+- (void)writeValue:(nullable id)value {
+  if (!value) {
+    [self writeTag:MSACBinaryArchiveTagNil];
+  } else if (value == [NSNull null]) {
+    [self writeTag:MSACBinaryArchiveTagNull];
+  } else if ([value isKindOfClass:[NSString class]]) {
+    [self writeString:value];
+  } else if ([value isKindOfClass:[NSNumber class]]) {
+    [self writeNumber:value];
+  } else if ([value isKindOfClass:[NSData class]]) {
+    NSData *data = value;
+    [self writeTag:MSACBinaryArchiveTagData];
+    [self writeVarint:data.length];
+    [self.data appendData:data];
+  } else if ([value isKindOfClass:[NSDate class]]) {
+    [self writeTag:MSACBinaryArchiveTagDate];
+    [self writeDouble:[(NSDate *)value timeIntervalSinceReferenceDate]];
+  } else if ([value isKindOfClass:[NSUUID class]]) {
+    uuid_t bytes;
+    [(NSUUID *)value getUUIDBytes:bytes];
+    [self writeTag:MSACBinaryArchiveTagUUID];
+    [self.data appendBytes:bytes length:sizeof(uuid_t)];
+  } else if ([value isKindOfClass:[NSArray class]]) {
+    BOOL isMutable = [[value classForCoder] isSubclassOfClass:[NSMutableArray class]];
+    [self writeTag:isMutable ? MSACBinaryArchiveTagMutableArray : MSACBinaryArchiveTagArray];
+    [self writeVarint:[(NSArray *)value count]];
+    for (id item in value) {
+      [self writeValue:item];
+    }
+  } else if ([value isKindOfClass:[NSSet class]]) {
+    BOOL isMutable = [[value classForCoder] isSubclassOfClass:[NSMutableSet class]];
+    [self writeTag:isMutable ? MSACBinaryArchiveTagMutableSet : MSACBinaryArchiveTagSet];
+    [self writeVarint:[(NSSet *)value count]];
+    for (id item in value) {
+      [self writeValue:item];
+    }
+  } else if ([value isKindOfClass:[NSDictionary class]]) {
+    [self writeDictionary:value];
+  } else if ([value conformsToProtocol:@protocol(NSCoding)]) {
+    [self writeTag:MSACBinaryArchiveTagObject];
+    [self writeString:NSStringFromClass([value classForCoder])];
+
+    // Each object has its own unkeyed values.
+    NSUInteger unkeyedCount = self.unkeyedCount;
+    self.unkeyedCount = 0;
+    [(id<NSCoding>)value encodeWithCoder:self];
+    self.unkeyedCount = unkeyedCount;
+    [self writeTag:MSACBinaryArchiveTagEnd];
+  } else {
+    [NSException raise:NSInvalidArchiveOperationException
+                format:@"Objects of class %@ can't be archived.", NSStringFromClass([value class])];
+  }
+}
+
+- (void)writeDictionary:(NSDictionary *)dictionary {
+  Class dictionaryClass = [dictionary classForCoder];
+  NSString *className = NSStringFromClass(dictionaryClass);
+  BOOL isMutable = [dictionaryClass isSubclassOfClass:[NSMutableDictionary class]];
+  if (isMutable && ![className hasPrefix:@"NS"] && ![className hasPrefix:@"__NS"]) {
+
+    // Custom dictionaries, such as ordered ones, are rebuilt by inserting the entries in their enumeration order.
+    [self writeTag:MSACBinaryArchiveTagMutableDictionaryOfClass];
+    [self writeString:className];
+  } else {
+    [self writeTag:isMutable ? MSACBinaryArchiveTagMutableDictionary : MSACBinaryArchiveTagDictionary];
+  }
+  [self writeVarint:dictionary.count];
+  for (id key in [dictionary keyEnumerator]) {
+    [self writeValue:key];
+    [self writeValue:dictionary[key]];
+  }
+}
+
+- (void)writeNumber:(NSNumber *)number {
+  if (CFGetTypeID((__bridge CFTypeRef)number) == CFBooleanGetTypeID()) {
+    [self writeTag:[number boolValue] ? MSACBinaryArchiveTagTrue : MSACBinaryArchiveTagFalse];
+    return;
+  }
+  const char type = *[number objCType];
+  if (type == 'f' || type == 'd') {
+    [self writeTag:MSACBinaryArchiveTagDouble];
+    [self writeDouble:[number doubleValue]];
+  } else if (type == 'Q' && [number unsignedLongLongValue] > INT64_MAX) {
+    [self writeTag:MSACBinaryArchiveTagUnsignedInteger];
+    [self writeVarint:[number unsignedLongLongValue]];
+  } else {
+
+    // ZigZag encoding keeps small negative values short.
+    int64_t value = [number longLongValue];
+    [self writeTag:MSACBinaryArchiveTagInteger];
+    [self writeVarint:((uint64_t)value << 1) ^ (uint64_t)(value >> 63)];
+  }
+}
+
+- (void)writeString:(NSString *)string {
+  NSNumber *index = self.stringIndexes[string];
+  if (index) {
+    [self writeTag:MSACBinaryArchiveTagStringReference];
+    [self writeVarint:[index unsignedLongLongValue]];
+    return;
+  }
+  self.stringIndexes[string] = @(self.stringIndexes.count);
+  NSData *bytes = [string dataUsingEncoding:NSUTF8StringEncoding];
+  [self writeTag:MSACBinaryArchiveTagString];
+  [self writeVarint:bytes.length];
+  [self.data appendData:bytes];
+}
+
+- (void)writeDouble:(double)value {
+  CFSwappedFloat64 swapped = CFConvertDoubleHostToSwapped(value);
+  [self.data appendBytes:&swapped length:sizeof(swapped)];
+}
+
+- (void)writeVarint:(uint64_t)value {
+  uint8_t buffer[10];
+  size_t length = 0;
+  while (value >= 0x80) {
+    buffer[length++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  buffer[length++] = (uint8_t)value;
+  [self.data appendBytes:buffer length:length];
+}
+
+- (void)writeTag:(MSACBinaryArchiveTag)tag {
+  [self.data appendBytes:&tag length:sizeof(tag)];
+}
+
+@end
@@ -0,0 +1,34 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+#import "MSACBinaryArchiver.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface MSACBinaryArchiver ()
+
+/**
+ * Archived data.
+ */
+@property(nonatomic, readonly) NSMutableData *data;
+
+/**
+ * Indexes of the strings already written to the archive.
+ */
+@property(nonatomic, readonly) NSMutableDictionary<NSString *, NSNumber *> *stringIndexes;
+
+/**
+ * Count of the values encoded without a key in the object being archived.
+ */
+@property(nonatomic) NSUInteger unkeyedCount;
+
+/**
+ * Object archived as if it was nil wherever it is referenced.
+ */
+@property(nonatomic, nullable) id excludedObject;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,35 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * Keyed unarchiver reading the object graphs archived by `MSACBinaryArchiver`.
+ */
+@interface MSACBinaryUnarchiver : NSCoder
+
+/**
+ * Unarchive an object graph.
+ *
+ * @param data The archived data.
+ *
+ * @return The root object of the graph or `nil` if the data is corrupted or contains an unknown class.
+ *
+ * @discussion The unarchived objects don't reference the bytes of the archived data, which can be released right after.
+ */
++ (nullable id)unarchivedObjectWithData:(NSData *)data;
+
+/**
+ * Check whether data has been archived by `MSACBinaryArchiver`.
+ *
+ * @param data The archived data.
+ *
+ * @return `YES` if the data starts with the binary archive header, `NO` otherwise.
+ */
++ (BOOL)isBinaryArchive:(NSData *)data;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,349 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACAppCenterInternal.h"
+#import "MSACBinaryArchiver.h"
+#import "MSACBinaryUnarchiver.h"
+#import "MSACLogger.h"
+
+static NSUInteger const kMSACBinaryArchiveHeaderLength = 2;
+
+@interface MSACBinaryUnarchiver ()
+
+@property(nonatomic, readonly) NSData *data;
+
+/**
+ * Offset of the next byte to read.
+ */
+@property(nonatomic) NSUInteger offset;
+
+/**
+ * Strings already read from the archive, in order of appearance.
+ */
+@property(nonatomic, readonly) NSMutableArray<NSString *> *strings;
+
+/**
+ * Values of the object being unarchived by key.
+ */
+@property(nonatomic, nullable) NSDictionary<NSString *, id> *values;
+
+/**
+ * Count of the values decoded without a key in the object being unarchived.
+ */
+@property(nonatomic) NSUInteger unkeyedCount;
+
+@end
+
+@implementation MSACBinaryUnarchiver
+
+- (instancetype)initWithData:(NSData *)data {
+  if ((self = [super init])) {
+    _data = data;
+    _offset = kMSACBinaryArchiveHeaderLength;
+    _strings = [NSMutableArray new];
+  }
+  return self;
+}
+
++ (nullable id)unarchivedObjectWithData:(NSData *)data {
+  if (![self isBinaryArchive:data]) {
+    MSACLogError([MSACAppCenter logTag], @"Unable to unarchive data: unsupported binary archive header.");
+    return nil;
+  }
+  MSACBinaryUnarchiver *unarchiver = [[MSACBinaryUnarchiver alloc] initWithData:data];
+  id rootObject;
+  @try {
+    rootObject = [unarchiver readValue];
+    if (unarchiver.offset != data.length) {
+      [NSException raise:NSInvalidUnarchiveOperationException format:@"Unexpected bytes at the end of the archive."];
+    }
+  } @catch (NSException *exception) {
+    MSACLogError([MSACAppCenter logTag], @"Unable to unarchive data: %@", exception);
+    return nil;
+  }
+  return rootObject;
+}
+
++ (BOOL)isBinaryArchive:(NSData *)data {
+  if (data.length < kMSACBinaryArchiveHeaderLength) {
+    return NO;
+  }
+  const uint8_t *bytes = data.bytes;
+  return bytes[0] == kMSACBinaryArchiveMagic && bytes[1] == kMSACBinaryArchiveVersion;
+}
+
+#pragma mark - NSCoder
+
+- (BOOL)allowsKeyedCoding {
+  return YES;
+}
+
+- (BOOL)containsValueForKey:(NSString *)key {
+  return self.values[key] != nil;
+}
+
+- (nullable id)decodeObjectForKey:(NSString *)key {
+  return self.values[key];
+}
+
+- (nullable id)decodeObjectOfClasses:(nullable NSSet<Class> *)__unused classes forKey:(NSString *)key {
+  return [self decodeObjectForKey:key];
+}
+
+- (BOOL)decodeBoolForKey:(NSString *)key {
+  return [self.values[key] boolValue];
+}
+
+- (int)decodeIntForKey:(NSString *)key {
+  return [self.values[key] intValue];
+}
+
+- (int32_t)decodeInt32ForKey:(NSString *)key {
+  return [self.values[key] intValue];
+}
+
+- (int64_t)decodeInt64ForKey:(NSString *)key {
+  return [self.values[key] longLongValue];
+}
+
+- (NSInteger)decodeIntegerForKey:(NSString *)key {
+  return [self.values[key] integerValue];
+}
+
+- (float)decodeFloatForKey:(NSString *)key {
+  return [self.values[key] floatValue];
+}
+
+- (double)decodeDoubleForKey:(NSString *)key {
+  return [self.values[key] doubleValue];
+}
+
+- (nullable const uint8_t *)decodeBytesForKey:(NSString *)key returnedLength:(nullable NSUInteger *)lengthp {
+  NSData *data = self.values[key];
+  if (lengthp) {
+    *lengthp = data.length;
+  }
+  return data.bytes;
+}
+
+- (nullable id)decodeObject {
+  NSString *key = [NSString stringWithFormat:@"%@%lu", kMSACBinaryArchiveUnkeyedPrefix, (unsigned long)self.unkeyedCount++];
+  return [self decodeObjectForKey:key];
+}
+
+- (nullable NSData *)decodeDataObject {
+  return [self decodeObject];
+}
+
+- (void)decodeValueOfObjCType:(const char *)type at:(void *)__unused data {
+  [NSException raise:NSInvalidUnarchiveOperationException
+              format:@"Raw values of type %s are not supported by the binary unarchiver.", type];
+}
+
+#pragma mark - Reading
+
+- (nullable id)readValue {
+  MSACBinaryArchiveTag tag = [self readTag];
+  switch (tag) {
+  case MSACBinaryArchiveTagNil:
+    return nil;
+  case MSACBinaryArchiveTagNull:
+    return [NSNull null];
+  case MSACBinaryArchiveTagTrue:
+    return @YES;
+  case MSACBinaryArchiveTagFalse:
+    return @NO;
+  case MSACBinaryArchiveTagInteger: {
+    uint64_t value = [self readVarint];
+    return @((int64_t)(value >> 1) ^ -(int64_t)(value & 1));
+  }
+  case MSACBinaryArchiveTagUnsignedInteger:
+    return @([self readVarint]);
+  case MSACBinaryArchiveTagDouble:
+    return @([self readDouble]);
+  case MSACBinaryArchiveTagString:
+  case MSACBinaryArchiveTagStringReference:
+    return [self readStringWithTag:tag];
+  case MSACBinaryArchiveTagData: {
+    NSUInteger length = [self readLength];
+    return [self readBytesOfLength:length];
+  }
+  case MSACBinaryArchiveTagDate:
+    return [NSDate dateWithTimeIntervalSinceReferenceDate:[self readDouble]];
+  case MSACBinaryArchiveTagUUID: {
+    uuid_t bytes;
+    [self readBytes:bytes length:sizeof(uuid_t)];
+    return [[NSUUID alloc] initWithUUIDBytes:bytes];
+  }
+  case MSACBinaryArchiveTagArray:
+  case MSACBinaryArchiveTagMutableArray: {
+    NSUInteger count = [self readLength];
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+      [array addObject:[self readNonNilValue]];
+    }
+    return tag == MSACBinaryArchiveTagMutableArray ? array : [array copy];
+  }
+  case MSACBinaryArchiveTagSet:
+  case MSACBinaryArchiveTagMutableSet: {
+    NSUInteger count = [self readLength];
+    NSMutableSet *set = [NSMutableSet setWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+      [set addObject:[self readNonNilValue]];
+    }
+    return tag == MSACBinaryArchiveTagMutableSet ? set : [set copy];
+  }
+  case MSACBinaryArchiveTagDictionary:
+  case MSACBinaryArchiveTagMutableDictionary: {
+    NSMutableDictionary *dictionary = [self readDictionaryEntriesInto:[NSMutableDictionary new]];
+    return tag == MSACBinaryArchiveTagMutableDictionary ? dictionary : [dictionary copy];
+  }
+  case MSACBinaryArchiveTagMutableDictionaryOfClass: {
+    Class dictionaryClass = [self readClass];
+    if (![dictionaryClass isSubclassOfClass:[NSMutableDictionary class]]) {
+      [NSException raise:NSInvalidUnarchiveOperationException format:@"Class %@ is not a mutable dictionary.", dictionaryClass];
+    }
+    return [self readDictionaryEntriesInto:[dictionaryClass new]];
+  }
+  case MSACBinaryArchiveTagObject:
+    return [self readObject];
+  default:
+    [NSException raise:NSInvalidUnarchiveOperationException
+                format:@"Unknown tag 0x%02x at offset %lu.", tag, (unsigned long)self.offset - 1];
+    return nil;
+  }
+}
+
+- (id)readNonNilValue {
+  id value = [self readValue];
+  if (!value) {
+    [NSException raise:NSInvalidUnarchiveOperationException format:@"Unexpected nil value in a collection."];
+  }
+  return value;
+}
+
+- (NSMutableDictionary *)readDictionaryEntriesInto:(NSMutableDictionary *)dictionary {
+  NSUInteger count = [self readLength];
+  for (NSUInteger i = 0; i < count; i++) {
+    id key = [self readNonNilValue];
+    dictionary[key] = [self readNonNilValue];
+  }
+  return dictionary;
+}
+
+- (nullable id)readObject {
+  Class objectClass = [self readClass];
+  if (![objectClass conformsToProtocol:@protocol(NSCoding)]) {
+    [NSException raise:NSInvalidUnarchiveOperationException format:@"Class %@ doesn't conform to NSCoding.", objectClass];
+  }
+
+  // Children are read before the object is initialized so that it can decode its values in any order.
+  NSMutableDictionary<NSString *, id> *values = [NSMutableDictionary new];
+  while (YES) {
+    MSACBinaryArchiveTag tag = [self readTag];
+    if (tag == MSACBinaryArchiveTagEnd) {
+      break;
+    }
+    NSString *key = [self readStringWithTag:tag];
+    values[key] = [self readNonNilValue];
+  }
+  NSDictionary<NSString *, id> *parentValues = self.values;
+  NSUInteger parentUnkeyedCount = self.unkeyedCount;
+  self.values = values;
+  self.unkeyedCount = 0;
+  id object = [(id<NSCoding>)[objectClass alloc] initWithCoder:self];
+  self.values = parentValues;
+  self.unkeyedCount = parentUnkeyedCount;
+  return [object awakeAfterUsingCoder:self];
+}
+
+- (Class)readClass {
+  NSString *className = [self readStringWithTag:[self readTag]];
+  Class class = NSClassFromString(className);
+  if (!class) {
+    [NSException raise:NSInvalidUnarchiveOperationException format:@"Unknown class %@.", className];
+  }
+  return class;
+}
+
+- (NSString *)readStringWithTag:(MSACBinaryArchiveTag)tag {
+  if (tag == MSACBinaryArchiveTagStringReference) {
+    uint64_t index = [self readVarint];
+    if (index >= self.strings.count) {
+      [NSException raise:NSInvalidUnarchiveOperationException format:@"Invalid string reference %llu.", index];
+    }
+    return self.strings[(NSUInteger)index];
+  }
+  if (tag != MSACBinaryArchiveTagString) {
+    [NSException raise:NSInvalidUnarchiveOperationException format:@"Expected a string, found tag 0x%02x.", tag];
+  }
+  NSUInteger length = [self readLength];
+  [self checkAvailableLength:length];
+  NSString *string = [[NSString alloc] initWithBytes:(const uint8_t *)self.data.bytes + self.offset
+                                              length:length
+                                            encoding:NSUTF8StringEncoding];
+  self.offset += length;
+  if (!string) {
+    [NSException raise:NSInvalidUnarchiveOperationException format:@"Invalid UTF-8 string."];
+  }
+  [self.strings addObject:string];
+  return string;
+}
+
+- (double)readDouble {
+  CFSwappedFloat64 swapped;
+  [self readBytes:&swapped length:sizeof(swapped)];
+  return CFConvertDoubleSwappedToHost(swapped);
+}
+
+- (NSUInteger)readLength {
+  uint64_t length = [self readVarint];
+  if (length > self.data.length - self.offset) {
+    [NSException raise:NSInvalidUnarchiveOperationException format:@"Length %llu exceeds the archive size.", length];
+  }
+  return (NSUInteger)length;
+}
+
+- (uint64_t)readVarint {
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    uint8_t byte;
+    [self readBytes:&byte length:1];
+    value |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+  [NSException raise:NSInvalidUnarchiveOperationException format:@"Malformed variable-length integer."];
+  return 0;
+}
+
+- (MSACBinaryArchiveTag)readTag {
+  MSACBinaryArchiveTag tag;
+  [self readBytes:&tag length:sizeof(tag)];
+  return tag;
+}
+
+- (NSData *)readBytesOfLength:(NSUInteger)length {
+  [self checkAvailableLength:length];
+
+  // Always copy, the archived data may wrap a buffer that doesn't outlive the unarchived objects.
+  NSData *bytes = [NSData dataWithBytes:(const uint8_t *)self.data.bytes + self.offset length:length];
+  self.offset += length;
+  return bytes;
+}
+
+- (void)readBytes:(void *)buffer length:(NSUInteger)length {
+  [self checkAvailableLength:length];
+  [self.data getBytes:buffer range:NSMakeRange(self.offset, length)];
+  self.offset += length;
+}
+
+- (void)checkAvailableLength:(NSUInteger)length {
+  if (length > self.data.length - self.offset) {
+    [NSException raise:NSInvalidUnarchiveOperationException
+                format:@"Unexpected end of the archive at offset %lu.", (unsigned long)self.offset];
+  }
+}
+
+@end
@@ -14,4 +14,24 @@
  */
 + (NSData *)compressData:(NSData *)data;
 
+/**
+ * Compress given data using raw deflate primed with a preset dictionary.
+ *
+ * @param data Data to compress.
+ * @param dictionary Preset dictionary, the same dictionary is required to decompress the data.
+ *
+ * @return Compressed data without header and trailer, or `nil` if the compression failed.
+ */
++ (NSData *)compressData:(NSData *)data withDictionary:(NSData *)dictionary;
+
+/**
+ * Decompress data compressed using raw deflate with a preset dictionary.
+ *
+ * @param data Data to decompress.
+ * @param dictionary Preset dictionary the data has been compressed with.
+ *
+ * @return Decompressed data, or `nil` if the data is not valid.
+ */
++ (NSData *)decompressData:(NSData *)data withDictionary:(NSData *)dictionary;
+
 @end
@@ -86,4 +86,87 @@
   return compressedData;
 }
 
++ (NSData *)compressData:(NSData *)data withDictionary:(NSData *)dictionary {
+  if (data == nil || data.length < 1) {
+    return nil;
+  }
+  z_stream zStreamStruct;
+  memset(&zStreamStruct, 0, sizeof(zStreamStruct));
+
+  // windowBits is -15: raw deflate, the data is identified by its dictionary rather than by a header.
+  int status = deflateInit2(&zStreamStruct, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+  if (status != Z_OK) {
+    MSACLogError(MSACAppCenter.logTag, @"Compression failed with error: %d", status);
+    return nil;
+  }
+  status = deflateSetDictionary(&zStreamStruct, (const Bytef *)dictionary.bytes, (unsigned int)dictionary.length);
+  if (status != Z_OK) {
+    MSACLogError(MSACAppCenter.logTag, @"Setting compression dictionary failed with error: %d", status);
+    deflateEnd(&zStreamStruct);
+    return nil;
+  }
+
+  // The bound is large enough to deflate the data in a single call.
+  NSMutableData *compressedData = [NSMutableData dataWithLength:deflateBound(&zStreamStruct, (uLong)data.length)];
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wcast-qual"
+  zStreamStruct.next_in = (Bytef *)[data bytes];
+#pragma clang diagnostic pop
+  zStreamStruct.avail_in = (unsigned int)data.length;
+  zStreamStruct.next_out = (Bytef *)[compressedData mutableBytes];
+  zStreamStruct.avail_out = (unsigned int)compressedData.length;
+  status = deflate(&zStreamStruct, Z_FINISH);
+  deflateEnd(&zStreamStruct);
+  if (status != Z_STREAM_END) {
+    MSACLogError(MSACAppCenter.logTag, @"Deflate failed with error: %d", status);
+    return nil;
+  }
+  [compressedData setLength:zStreamStruct.total_out];
+  return compressedData;
+}
+
++ (NSData *)decompressData:(NSData *)data withDictionary:(NSData *)dictionary {
+  if (data == nil || data.length < 1) {
+    return nil;
+  }
+  z_stream zStreamStruct;
+  memset(&zStreamStruct, 0, sizeof(zStreamStruct));
+  int status = inflateInit2(&zStreamStruct, -15);
+  if (status != Z_OK) {
+    MSACLogError(MSACAppCenter.logTag, @"Decompression failed with error: %d", status);
+    return nil;
+  }
+
+  // Raw inflate takes its dictionary up front.
+  status = inflateSetDictionary(&zStreamStruct, (const Bytef *)dictionary.bytes, (unsigned int)dictionary.length);
+  if (status != Z_OK) {
+    MSACLogError(MSACAppCenter.logTag, @"Setting decompression dictionary failed with error: %d", status);
+    inflateEnd(&zStreamStruct);
+    return nil;
+  }
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wcast-qual"
+  zStreamStruct.next_in = (Bytef *)[data bytes];
+#pragma clang diagnostic pop
+  zStreamStruct.avail_in = (unsigned int)data.length;
+
+  // Grow the output until the whole stream is inflated.
+  NSMutableData *decompressedData = [NSMutableData dataWithLength:data.length * 4];
+  do {
+    if (zStreamStruct.total_out >= decompressedData.length) {
+      [decompressedData increaseLengthBy:decompressedData.length];
+    }
+    zStreamStruct.next_out = (unsigned char *)[decompressedData mutableBytes] + zStreamStruct.total_out;
+    zStreamStruct.avail_out = (unsigned int)(decompressedData.length - zStreamStruct.total_out);
+    status = inflate(&zStreamStruct, Z_NO_FLUSH);
+  } while (status == Z_OK);
+  inflateEnd(&zStreamStruct);
+  if (status != Z_STREAM_END) {
+    MSACLogError(MSACAppCenter.logTag, @"Inflate failed with error: %d", status);
+    return nil;
+  }
+  [decompressedData setLength:zStreamStruct.total_out];
+  return decompressedData;
+}
+
 @end
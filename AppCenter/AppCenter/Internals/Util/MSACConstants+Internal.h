@@ -92,3 +92,56 @@ static NSString *const kMSACCommonSchemaPrefixSeparator = @":";
  * Default flush interval for channel.
  */
 static NSUInteger const kMSACFlushIntervalDefault = 3;
+
+/**
+ * Default bounds, in seconds, of the delay before sending the logs of channels with the default flush interval.
+ */
+static NSUInteger const kMSACMinFlushIntervalDefault = 1;
+static NSUInteger const kMSACMaxFlushIntervalDefault = 60;
+
+/**
+ * Duration, in seconds, within which the timers of the channels of a group fire together.
+ */
+static NSTimeInterval const kMSACTimerWheelTolerance = 1;
+
+/**
+ * Minimum duration, in seconds, a channel timer can fire late by to share a wakeup, and part of its delay it can fire late by.
+ */
+static NSTimeInterval const kMSACFlushTimerMinLeeway = 1;
+static double const kMSACFlushTimerLeewayRatio = 0.1;
+
+/**
+ * Default bounds of the number of logs sent in a single batch.
+ */
+static NSUInteger const kMSACMinBatchSizeLimitDefault = 10;
+static NSUInteger const kMSACMaxBatchSizeLimitDefault = 200;
+
+/**
+ * Default maximum number of batches a channel sends at the same time, its window grows up to it while batches are sent quickly.
+ */
+static NSUInteger const kMSACMaxPendingBatchesPerChannelDefault = 8;
+
+/**
+ * Default maximum number of batches all the channels send at the same time. Requests are multiplexed on the connections to the ingestion.
+ */
+static NSUInteger const kMSACMaxPendingBatchesDefault = 16;
+
+/**
+ * Maximum number of logs enqueued and waiting to be stored, for all the channels.
+ */
+static NSUInteger const kMSACEnqueueRingCapacity = 1024;
+
+/**
+ * Default maximum number of logs sent in a single batch.
+ */
+static NSUInteger const kMSACBatchSizeLimitDefault = 50;
+
+/**
+ * Default maximum total size, in bytes, of the logs sent in a single batch, measured before compression (256 KiB).
+ */
+static NSUInteger const kMSACBatchSizeInBytesLimitDefault = 256 * 1024;
+
+/**
+ * Default maximum age, in seconds, of the logs stored on disk, 0 means logs never expire.
+ */
+static NSTimeInterval const kMSACLogTimeToLiveDefault = 0;
@@ -5,6 +5,11 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/**
+ * Notification posted when the encryption key used for new data changes.
+ */
+static NSString *const kMSACEncryptionKeyDidRotateNotification = @"MSACEncryptionKeyDidRotateNotification";
+
 /**
  * Class for Encryption. Uses RSA algorithm with key size 256. If no key pair is specified, generates new key pair and stores it in
  * Keychain. Key pair is loaded if it is present in Keychain.
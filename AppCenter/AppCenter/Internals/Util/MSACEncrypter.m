@@ -189,6 +189,7 @@ static NSObject *const classLock;
   // Format is {keyTag}/{expiration as iso}.
   NSString *keyMetadata = [@[ newKeyTag, expirationIso ] componentsJoinedByString:kMSACEncryptionMetadataInternalSeparator];
   [MSAC_APP_CENTER_USER_DEFAULTS setObject:keyMetadata forKey:kMSACEncryptionKeyMetadataKey];
+  [MSAC_NOTIFICATION_CENTER postNotificationName:kMSACEncryptionKeyDidRotateNotification object:nil];
 }
 
 - (NSData *)getKeyWithKeyTag:(NSString *)keyTag {
@@ -179,6 +179,82 @@ NS_SWIFT_NAME(AppCenter)
  */
 + (void)setMaxStorageSize:(long)sizeInBytes completionHandler:(void (^)(BOOL))completionHandler;
 
+/**
+ * Durability level of the logs stored on disk before they are sent.
+ *
+ * @discussion The default level writes logs to a write-ahead log synced to disk periodically, logs enqueued with critical persistence are
+ * synced to disk as soon as they are stored. Normal logs are committed to the database in groups of up to 50 logs or 0.5 seconds, an app
+ * crash loses the normal logs stored within that window. Use `MSACStorageDurabilityFull` to sync every log to disk as soon as it is stored.
+ * The value passed to this property is not persisted on disk.
+ */
+@property(class, nonatomic) MSACStorageDurability storageDurability;
+
+/**
+ * Backend storing the logs on disk before they are sent.
+ *
+ * @discussion The backend must be set before App Center is started, it is ignored afterwards. The default backend is
+ * `MSACStorageBackendDatabase`. The value passed to this property is not persisted on disk.
+ */
+@property(class, nonatomic) MSACStorageBackend storageBackend;
+
+/**
+ * Maximum age, in seconds, of the logs stored on disk before they are sent. Older logs are deleted without being sent.
+ *
+ * @discussion The default value is 0, logs are kept on disk until they are sent. Logs enqueued with critical persistence never expire. The
+ * value passed to this property is not persisted on disk.
+ */
+@property(class, nonatomic) NSTimeInterval logTimeToLive;
+
+/**
+ * Set the bounds of the delay, in seconds, before sending logs.
+ *
+ * @discussion The delay adapts to the number of logs waiting to be sent and to the network within these bounds: logs are sent quickly on a
+ * fast network and grouped in fewer requests on a slow or unreliable one. The default bounds are 1 and 60 seconds. Services with a custom
+ * transmission interval keep it. The values passed to this method are not persisted on disk.
+ *
+ * @param minimum Minimum delay in seconds.
+ * @param maximum Maximum delay in seconds, greater than or equal to the minimum.
+ */
++ (void)setFlushIntervalBoundsWithMinimum:(NSUInteger)minimum
+                                  maximum:(NSUInteger)maximum NS_SWIFT_NAME(setFlushIntervalBounds(minimum:maximum:));
+
+/**
+ * Set the bounds of the number of logs sent in a single request.
+ *
+ * @discussion The number of logs adapts to the number of logs waiting to be sent and to the network within these bounds. The default bounds
+ * are 10 and 200 logs. The values passed to this method are not persisted on disk.
+ *
+ * @param minimum Minimum number of logs, greater than 0.
+ * @param maximum Maximum number of logs, greater than or equal to the minimum.
+ */
++ (void)setBatchSizeBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum NS_SWIFT_NAME(setBatchSizeBounds(minimum:maximum:));
+
+/**
+ * Set the maximum number of requests sending logs at the same time.
+ *
+ * @discussion Each service starts with a few requests at a time and sends more at once while they complete quickly, so that logs stored
+ * while offline are sent faster. It sends fewer requests at once when they fail. The default limits are 8 requests per service and 16 in
+ * total. The values passed to this method are not persisted on disk.
+ *
+ * @param perServiceLimit Maximum number of requests of a service, greater than 0.
+ * @param totalLimit Maximum number of requests of all the services, greater than or equal to the limit per service.
+ */
++ (void)setMaxPendingRequestsPerService:(NSUInteger)perServiceLimit
+                             totalLimit:(NSUInteger)totalLimit NS_SWIFT_NAME(setMaxPendingRequests(perService:total:));
+
+/**
+ * What happens to the logs enqueued while too many logs are waiting to be stored, for example when many events are tracked in a loop.
+ *
+ * @discussion By default the log being enqueued is dropped, so that the thread enqueuing it never waits. The value passed to this property
+ * is not persisted on disk.
+ */
+@property(class, nonatomic) MSACBackpressurePolicy backpressurePolicy;
+
+/**
+ * Number of logs deleted from the disk because they expired since App Center has been started.
+ */
+@property(class, readonly, nonatomic) NSUInteger expiredLogsCount;
+
 /**
  * Set the user identifier.
  *
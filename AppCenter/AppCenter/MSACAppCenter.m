@@ -260,6 +260,55 @@ static const long kMSACMinUpperSizeLimitInBytes = 24 * 1024;
   [[MSACAppCenter sharedInstance] setMaxStorageSize:sizeInBytes completionHandler:completionHandler];
 }
 
++ (MSACStorageDurability)storageDurability {
+  return [MSACAppCenter sharedInstance].requestedStorageDurability;
+}
+
++ (void)setStorageDurability:(MSACStorageDurability)storageDurability {
+  [[MSACAppCenter sharedInstance] setStorageDurability:storageDurability];
+}
+
++ (MSACStorageBackend)storageBackend {
+  return [MSACAppCenter sharedInstance].requestedStorageBackend;
+}
+
++ (void)setStorageBackend:(MSACStorageBackend)storageBackend {
+  [[MSACAppCenter sharedInstance] setStorageBackend:storageBackend];
+}
+
++ (NSTimeInterval)logTimeToLive {
+  return [MSACAppCenter sharedInstance].requestedLogTimeToLive;
+}
+
++ (void)setLogTimeToLive:(NSTimeInterval)logTimeToLive {
+  [[MSACAppCenter sharedInstance] setLogTimeToLive:logTimeToLive];
+}
+
++ (void)setFlushIntervalBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum {
+  [[MSACAppCenter sharedInstance] setFlushIntervalBoundsWithMinimum:minimum maximum:maximum];
+}
+
++ (void)setBatchSizeBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum {
+  [[MSACAppCenter sharedInstance] setBatchSizeBoundsWithMinimum:minimum maximum:maximum];
+}
+
++ (void)setMaxPendingRequestsPerService:(NSUInteger)perServiceLimit totalLimit:(NSUInteger)totalLimit {
+  [[MSACAppCenter sharedInstance] setMaxPendingRequestsPerService:perServiceLimit totalLimit:totalLimit];
+}
+
++ (MSACBackpressurePolicy)backpressurePolicy {
+  return [MSACAppCenter sharedInstance].requestedBackpressurePolicy;
+}
+
++ (void)setBackpressurePolicy:(MSACBackpressurePolicy)backpressurePolicy {
+  [[MSACAppCenter sharedInstance] setBackpressurePolicy:backpressurePolicy];
+}
+
++ (NSUInteger)expiredLogsCount {
+  id<MSACChannelGroupProtocol> channelGroup = [MSACAppCenter sharedInstance].channelGroup;
+  return [channelGroup respondsToSelector:@selector(expiredLogsCount)] ? channelGroup.expiredLogsCount : 0;
+}
+
 + (void)setUserId:(NSString *)userId {
   [[MSACAppCenter sharedInstance] setUserId:userId];
 }
@@ -274,6 +323,8 @@ static const long kMSACMinUpperSizeLimitInBytes = 24 * 1024;
   if ((self = [super init])) {
     _services = [NSMutableArray new];
     _enabledStateUpdating = NO;
+    _requestedLogTimeToLive = kMSACLogTimeToLiveDefault;
+    _requestedBackpressurePolicy = MSACBackpressurePolicyDropNewest;
     NSDictionary *changedKeys = @{
       @"MSAppCenterChannelStartTimer" : MSACPrefixKeyFrom(@"MSChannelStartTimer"),
       // [MSACChannelUnitDefault oldestPendingLogTimestampKey]
@@ -561,6 +612,84 @@ static const long kMSACMinUpperSizeLimitInBytes = 24 * 1024;
   }
 }
 
+- (void)setStorageDurability:(MSACStorageDurability)storageDurability {
+  @synchronized(self) {
+    self.requestedStorageDurability = storageDurability;
+    if ([self.channelGroup respondsToSelector:@selector(setStorageDurability:)]) {
+      [self.channelGroup setStorageDurability:storageDurability];
+    }
+  }
+}
+
+- (void)setStorageBackend:(MSACStorageBackend)storageBackend {
+  @synchronized(self) {
+    if (self.channelGroup) {
+      MSACLogWarning([MSACAppCenter logTag], @"Unable to set the storage backend after App Center has been started");
+    } else {
+      self.requestedStorageBackend = storageBackend;
+    }
+  }
+}
+
+- (void)setLogTimeToLive:(NSTimeInterval)logTimeToLive {
+  @synchronized(self) {
+    self.requestedLogTimeToLive = MAX(logTimeToLive, 0);
+    if ([self.channelGroup respondsToSelector:@selector(setLogTimeToLive:forGroupId:flags:)]) {
+      [self.channelGroup setLogTimeToLive:self.requestedLogTimeToLive forGroupId:nil flags:MSACFlagsNormal];
+    }
+  }
+}
+
+- (void)setFlushIntervalBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum {
+  if (minimum > maximum) {
+    MSACLogError([MSACAppCenter logTag], @"Invalid flush interval bounds, the minimum must not be greater than the maximum.");
+    return;
+  }
+  @synchronized(self) {
+    self.requestedFlushIntervalBounds = @[ @(minimum), @(maximum) ];
+    if ([self.channelGroup respondsToSelector:@selector(setFlushIntervalBoundsWithMinimum:maximum:)]) {
+      [self.channelGroup setFlushIntervalBoundsWithMinimum:minimum maximum:maximum];
+    }
+  }
+}
+
+- (void)setBatchSizeBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum {
+  if (minimum == 0 || minimum > maximum) {
+    MSACLogError([MSACAppCenter logTag],
+                 @"Invalid batch size bounds, the minimum must be greater than 0 and not greater than the maximum.");
+    return;
+  }
+  @synchronized(self) {
+    self.requestedBatchSizeBounds = @[ @(minimum), @(maximum) ];
+    if ([self.channelGroup respondsToSelector:@selector(setBatchSizeBoundsWithMinimum:maximum:)]) {
+      [self.channelGroup setBatchSizeBoundsWithMinimum:minimum maximum:maximum];
+    }
+  }
+}
+
+- (void)setMaxPendingRequestsPerService:(NSUInteger)perServiceLimit totalLimit:(NSUInteger)totalLimit {
+  if (perServiceLimit == 0 || totalLimit < perServiceLimit) {
+    MSACLogError([MSACAppCenter logTag],
+                 @"Invalid pending requests limits, the limit per service must be greater than 0 and not greater than the total limit.");
+    return;
+  }
+  @synchronized(self) {
+    self.requestedPendingBatchesLimits = @[ @(perServiceLimit), @(totalLimit) ];
+    if ([self.channelGroup respondsToSelector:@selector(setMaxPendingBatchesPerChannel:totalLimit:)]) {
+      [self.channelGroup setMaxPendingBatchesPerChannel:perServiceLimit totalLimit:totalLimit];
+    }
+  }
+}
+
+- (void)setBackpressurePolicy:(MSACBackpressurePolicy)backpressurePolicy {
+  @synchronized(self) {
+    self.requestedBackpressurePolicy = backpressurePolicy;
+    if ([self.channelGroup respondsToSelector:@selector(setBackpressurePolicy:)]) {
+      [self.channelGroup setBackpressurePolicy:backpressurePolicy];
+    }
+  }
+}
+
 - (void)setUserId:(NSString *)userId {
   if (!self.configuredFromApplication) {
     MSACLogError([MSACAppCenter logTag], @"AppCenter must be configured from application, libraries cannot call setUserId.");
@@ -710,12 +839,34 @@ static const long kMSACMinUpperSizeLimitInBytes = 24 * 1024;
       }
       self.channelGroup = [[MSACChannelGroupDefault alloc] initWithHttpClient:httpClient
                                                                     installId:self.installId
-                                                                       logUrl:self.logUrl ?: kMSACAppCenterBaseUrl];
+                                                                       logUrl:self.logUrl ?: kMSACAppCenterBaseUrl
+                                                               storageBackend:self.requestedStorageBackend];
       [self.channelGroup addDelegate:self.oneCollectorChannelDelegate];
       if (self.requestedMaxStorageSizeInBytes) {
         long storageSize = [self.requestedMaxStorageSizeInBytes longValue];
         [self.channelGroup setMaxStorageSize:storageSize completionHandler:self.maxStorageSizeCompletionHandler];
       }
+      if (self.requestedStorageDurability != MSACStorageDurabilityDefault) {
+        [self.channelGroup setStorageDurability:self.requestedStorageDurability];
+      }
+      if (self.requestedLogTimeToLive != kMSACLogTimeToLiveDefault) {
+        [self.channelGroup setLogTimeToLive:self.requestedLogTimeToLive forGroupId:nil flags:MSACFlagsNormal];
+      }
+      if (self.requestedFlushIntervalBounds) {
+        [self.channelGroup setFlushIntervalBoundsWithMinimum:self.requestedFlushIntervalBounds[0].unsignedIntegerValue
+                                                     maximum:self.requestedFlushIntervalBounds[1].unsignedIntegerValue];
+      }
+      if (self.requestedBatchSizeBounds) {
+        [self.channelGroup setBatchSizeBoundsWithMinimum:self.requestedBatchSizeBounds[0].unsignedIntegerValue
+                                                 maximum:self.requestedBatchSizeBounds[1].unsignedIntegerValue];
+      }
+      if (self.requestedPendingBatchesLimits) {
+        [self.channelGroup setMaxPendingBatchesPerChannel:self.requestedPendingBatchesLimits[0].unsignedIntegerValue
+                                               totalLimit:self.requestedPendingBatchesLimits[1].unsignedIntegerValue];
+      }
+      if (self.requestedBackpressurePolicy != MSACBackpressurePolicyDropNewest) {
+        [self.channelGroup setBackpressurePolicy:self.requestedBackpressurePolicy];
+      }
     }
     [self.channelGroup setAppSecret:self.appSecret];
 
@@ -17,12 +17,14 @@ static NSString *const kMSACACErrorDomain = MSAC_APP_CENTER_BASE_DOMAIN @"ErrorD
 #pragma mark - General
 
 // Error codes.
-NS_ENUM(NSInteger){MSACACLogInvalidContainerErrorCode = 1, MSACACCanceledErrorCode = 2, MSACACDisabledErrorCode = 3};
+NS_ENUM(NSInteger){MSACACLogInvalidContainerErrorCode = 1, MSACACCanceledErrorCode = 2, MSACACDisabledErrorCode = 3,
+                   MSACACLogDroppedErrorCode = 4};
 
 // Error descriptions.
 static NSString const *kMSACACLogInvalidContainerErrorDesc = @"Invalid log container.";
 static NSString const *kMSACACCanceledErrorDesc = @"The operation was canceled.";
 static NSString const *kMSACACDisabledErrorDesc = @"The service is disabled.";
+static NSString const *kMSACACLogDroppedErrorDesc = @"The log was dropped, too many logs were being enqueued.";
 
 #pragma mark - Connection
 
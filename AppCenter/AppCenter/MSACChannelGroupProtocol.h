@@ -8,8 +8,12 @@
 
 #if __has_include(<AppCenter/MSACChannelProtocol.h>)
 #import <AppCenter/MSACChannelProtocol.h>
+#import <AppCenter/MSACConstants+Flags.h>
+#import <AppCenter/MSACConstants.h>
 #else
 #import "MSACChannelProtocol.h"
+#import "MSACConstants+Flags.h"
+#import "MSACConstants.h"
 #endif
 
 NS_ASSUME_NONNULL_BEGIN
@@ -71,6 +75,63 @@ NS_SWIFT_NAME(ChannelGroupProtocol)
 - (void)setMaxStorageSize:(long)sizeInBytes
         completionHandler:(nullable void (^)(BOOL))completionHandler NS_SWIFT_NAME(setMaxStorageSize(_:completionHandler:));
 
+@optional
+
+/**
+ * Set the durability level of the logs stored on disk.
+ *
+ * @param durability The durability level.
+ */
+- (void)setStorageDurability:(MSACStorageDurability)durability;
+
+/**
+ * Set the maximum age of the logs stored on disk. Older logs are deleted without being sent.
+ *
+ * @param timeToLive Maximum age of the logs in seconds, 0 to keep them until they are sent.
+ * @param groupId The group ID of the channel unit, `nil` for the channel units without a specific time to live.
+ * @param flags The persistence flags of the logs.
+ */
+- (void)setLogTimeToLive:(NSTimeInterval)timeToLive forGroupId:(nullable NSString *)groupId flags:(MSACFlags)flags;
+
+/**
+ * Set the bounds of the delay before sending the logs of the channel units with the default flush interval.
+ *
+ * @param minimum Minimum delay in seconds.
+ * @param maximum Maximum delay in seconds.
+ */
+- (void)setFlushIntervalBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum;
+
+/**
+ * Set the bounds of the number of logs sent in a single batch.
+ *
+ * @param minimum Minimum number of logs.
+ * @param maximum Maximum number of logs.
+ */
+- (void)setBatchSizeBoundsWithMinimum:(NSUInteger)minimum maximum:(NSUInteger)maximum;
+
+/**
+ * Set the maximum number of batches sent at the same time. Each channel unit starts with its configured pending batches limit and sends
+ * more batches at once while they are sent quickly.
+ *
+ * @param perChannelLimit Maximum number of batches of a channel unit, not smaller than its configured pending batches limit.
+ * @param totalLimit Maximum number of batches of all the channel units, not smaller than the limit per channel unit.
+ */
+- (void)setMaxPendingBatchesPerChannel:(NSUInteger)perChannelLimit totalLimit:(NSUInteger)totalLimit;
+
+/**
+ * Set what happens to the logs enqueued while too many logs are waiting to be stored.
+ *
+ * @param backpressurePolicy The policy.
+ */
+- (void)setBackpressurePolicy:(MSACBackpressurePolicy)backpressurePolicy;
+
+/**
+ * Number of logs deleted from the disk because they expired since the channel group has been created.
+ */
+@property(nonatomic, readonly) NSUInteger expiredLogsCount;
+
+@required
+
 /**
  * Return a channel unit instance for the given groupId.
  *
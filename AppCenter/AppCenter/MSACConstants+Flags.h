@@ -10,6 +10,7 @@ typedef NS_OPTIONS(NSUInteger, MSACFlags) {
   MSACFlagsNone = (0 << 0),     // => 00000000
   MSACFlagsNormal = (1 << 0),   // => 00000001
   MSACFlagsCritical = (1 << 1), // => 00000010
+  MSACFlagsVolatile = (1 << 2), // => 00000100, kept in memory, may be lost
   MSACFlagsPersistenceNormal DEPRECATED_MSG_ATTRIBUTE("please use MSACFlagsNormal") = MSACFlagsNormal,
   MSACFlagsPersistenceCritical DEPRECATED_MSG_ATTRIBUTE("please use MSACFlagsCritical") = MSACFlagsCritical,
   MSACFlagsDefault = MSACFlagsNormal
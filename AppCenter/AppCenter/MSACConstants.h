@@ -67,6 +67,63 @@ typedef NS_ENUM(NSInteger, MSACInitializationPriority) {
   MSACInitializationPriorityMax = 999
 } NS_SWIFT_NAME(InitializationPriority);
 
+/**
+ * Durability levels of the logs stored on disk before they are sent.
+ */
+typedef NS_ENUM(NSInteger, MSACStorageDurability) {
+
+  /**
+   * Logs are written to a write-ahead log which is synced to disk periodically. Logs enqueued with critical persistence are synced to disk
+   * as soon as they are stored. The database storage commits normal logs in groups of up to 50 logs or 0.5 seconds: normal logs stored
+   * within that window before an app crash are lost, and so are normal logs stored right before a power loss.
+   */
+  MSACStorageDurabilityDefault,
+
+  /**
+   * Every log is synced to disk as soon as it is stored. This is the most expensive level in terms of disk writes.
+   */
+  MSACStorageDurabilityFull
+} NS_SWIFT_NAME(StorageDurability);
+
+/**
+ * Backends storing the logs on disk before they are sent.
+ */
+typedef NS_ENUM(NSInteger, MSACStorageBackend) {
+
+  /**
+   * Logs are stored in a SQLite database.
+   */
+  MSACStorageBackendDatabase,
+
+  /**
+   * Logs are appended to segment files, one directory per channel. Deleted logs are recorded rather than removed in place, which makes
+   * storing logs cheaper in terms of disk writes. Logs stored in the database are not moved to segment files and vice versa.
+   */
+  MSACStorageBackendSegmentFiles
+} NS_SWIFT_NAME(StorageBackend);
+
+/**
+ * Policies applied to the logs enqueued while too many logs are waiting to be stored.
+ */
+typedef NS_ENUM(NSInteger, MSACBackpressurePolicy) {
+
+  /**
+   * The thread enqueuing a log waits until there is room for it, no log is dropped. The main thread may wait as well.
+   */
+  MSACBackpressurePolicyBlock,
+
+  /**
+   * The log being enqueued is dropped, the thread enqueuing it never waits. This is the default policy.
+   */
+  MSACBackpressurePolicyDropNewest,
+
+  /**
+   * The log being enqueued is dropped if it has normal persistence. The thread enqueuing a log with critical persistence waits until there
+   * is room for it. Logs already enqueued are never dropped.
+   */
+  MSACBackpressurePolicyDropNewestUnlessCritical
+} NS_SWIFT_NAME(BackpressurePolicy);
+
 /**
  * Enum with the different HTTP status codes.
  */
@@ -56,7 +56,11 @@ static NSString *const kMSACNullifiedInstallIdString = @"00000000-0000-0000-0000
   self.channelGroupMock = OCMClassMock([MSACChannelGroupDefault class]);
   self.channelUnitMock = OCMProtocolMock(@protocol(MSACChannelUnitProtocol));
   OCMStub([self.channelGroupMock alloc]).andReturn(self.channelGroupMock);
-  OCMStub([self.channelGroupMock initWithHttpClient:OCMOCK_ANY installId:OCMOCK_ANY logUrl:OCMOCK_ANY]).andReturn(self.channelGroupMock);
+  OCMStub([self.channelGroupMock initWithHttpClient:OCMOCK_ANY
+                                          installId:OCMOCK_ANY
+                                             logUrl:OCMOCK_ANY
+                                     storageBackend:MSACStorageBackendDatabase])
+      .andReturn(self.channelGroupMock);
   OCMStub([self.channelGroupMock addChannelUnitWithConfiguration:OCMOCK_ANY]).andReturn(self.channelUnitMock);
 
   // Device tracker.
@@ -441,7 +445,10 @@ static NSString *const kMSACNullifiedInstallIdString = @"00000000-0000-0000-0000
   XCTAssertTrue([[[MSACAppCenter sharedInstance] logUrl] isEqualToString:fakeUrl]);
 
   // Cast to void to get rid of warning that says "Expression result unused".
-  OCMVerify((void)[self.channelGroupMock initWithHttpClient:OCMOCK_ANY installId:OCMOCK_ANY logUrl:equalTo(fakeUrl)]);
+  OCMVerify((void)[self.channelGroupMock initWithHttpClient:OCMOCK_ANY
+                                                  installId:OCMOCK_ANY
+                                                     logUrl:equalTo(fakeUrl)
+                                             storageBackend:MSACStorageBackendDatabase]);
 
   // When
   [MSACAppCenter setLogUrl:updateUrl];
@@ -462,7 +469,10 @@ static NSString *const kMSACNullifiedInstallIdString = @"00000000-0000-0000-0000
   XCTAssertNil([[MSACAppCenter sharedInstance] logUrl]);
 
   // Cast to void to get rid of warning that says "Expression result unused".
-  OCMVerify((void)[self.channelGroupMock initWithHttpClient:OCMOCK_ANY installId:OCMOCK_ANY logUrl:equalTo(defaultUrl)]);
+  OCMVerify((void)[self.channelGroupMock initWithHttpClient:OCMOCK_ANY
+                                                  installId:OCMOCK_ANY
+                                                     logUrl:equalTo(defaultUrl)
+                                             storageBackend:MSACStorageBackendDatabase]);
 }
 
 - (void)testDefaultLogUrlWithNoAppsecret {
@@ -868,6 +878,160 @@ static NSString *const kMSACNullifiedInstallIdString = @"00000000-0000-0000-0000
                                }];
 }
 
+- (void)testSetStorageDurabilityBeforeStart {
+
+  // When
+  [MSACAppCenter setStorageDurability:MSACStorageDurabilityFull];
+
+  // Then
+  XCTAssertEqual(MSACAppCenter.storageDurability, MSACStorageDurabilityFull);
+  XCTAssertEqual([MSACAppCenter sharedInstance].requestedStorageDurability, MSACStorageDurabilityFull);
+}
+
+- (void)testSetStorageDurabilityIsForwardedToChannelGroup {
+
+  // If
+  id<MSACChannelGroupProtocol> channelGroup = OCMProtocolMock(@protocol(MSACChannelGroupProtocol));
+  [MSACAppCenter sharedInstance].channelGroup = channelGroup;
+
+  // When
+  [MSACAppCenter setStorageDurability:MSACStorageDurabilityFull];
+
+  // Then
+  OCMVerify([channelGroup setStorageDurability:MSACStorageDurabilityFull]);
+}
+
+- (void)testSetStorageBackendBeforeStart {
+
+  // If
+  OCMStub([self.channelGroupMock initWithHttpClient:OCMOCK_ANY
+                                          installId:OCMOCK_ANY
+                                             logUrl:OCMOCK_ANY
+                                     storageBackend:MSACStorageBackendSegmentFiles])
+      .andReturn(self.channelGroupMock);
+
+  // When
+  MSACAppCenter.storageBackend = MSACStorageBackendSegmentFiles;
+  [MSACAppCenter start:MSAC_UUID_STRING withServices:nil];
+
+  // Then
+  XCTAssertEqual(MSACAppCenter.storageBackend, MSACStorageBackendSegmentFiles);
+  OCMVerify((void)[self.channelGroupMock initWithHttpClient:OCMOCK_ANY
+                                                  installId:OCMOCK_ANY
+                                                     logUrl:OCMOCK_ANY
+                                             storageBackend:MSACStorageBackendSegmentFiles]);
+}
+
+- (void)testSetStorageBackendAfterStartIsIgnored {
+
+  // If
+  [MSACAppCenter start:MSAC_UUID_STRING withServices:nil];
+
+  // When
+  MSACAppCenter.storageBackend = MSACStorageBackendSegmentFiles;
+
+  // Then
+  XCTAssertEqual(MSACAppCenter.storageBackend, MSACStorageBackendDatabase);
+}
+
+- (void)testSetLogTimeToLiveBeforeStart {
+
+  // Then
+  XCTAssertEqual(MSACAppCenter.logTimeToLive, kMSACLogTimeToLiveDefault);
+
+  // When
+  MSACAppCenter.logTimeToLive = 60;
+
+  // Then
+  XCTAssertEqual(MSACAppCenter.logTimeToLive, 60);
+
+  // When
+  MSACAppCenter.logTimeToLive = -1;
+
+  // Then
+  XCTAssertEqual(MSACAppCenter.logTimeToLive, 0);
+}
+
+- (void)testSetLogTimeToLiveIsForwardedToChannelGroup {
+
+  // If
+  id<MSACChannelGroupProtocol> channelGroup = OCMProtocolMock(@protocol(MSACChannelGroupProtocol));
+  OCMStub([channelGroup expiredLogsCount]).andReturn(3);
+  [MSACAppCenter sharedInstance].channelGroup = channelGroup;
+
+  // When
+  MSACAppCenter.logTimeToLive = 60;
+
+  // Then
+  OCMVerify([channelGroup setLogTimeToLive:60 forGroupId:nil flags:MSACFlagsNormal]);
+  XCTAssertEqual(MSACAppCenter.expiredLogsCount, 3);
+}
+
+- (void)testSetFlushBoundsAreForwardedToChannelGroup {
+
+  // If
+  id<MSACChannelGroupProtocol> channelGroup = OCMProtocolMock(@protocol(MSACChannelGroupProtocol));
+  [MSACAppCenter sharedInstance].channelGroup = channelGroup;
+
+  // When
+  [MSACAppCenter setFlushIntervalBoundsWithMinimum:2 maximum:30];
+  [MSACAppCenter setBatchSizeBoundsWithMinimum:20 maximum:100];
+
+  // Then
+  OCMVerify([channelGroup setFlushIntervalBoundsWithMinimum:2 maximum:30]);
+  OCMVerify([channelGroup setBatchSizeBoundsWithMinimum:20 maximum:100]);
+}
+
+- (void)testSetInvalidFlushBoundsAreIgnored {
+
+  // If
+  id<MSACChannelGroupProtocol> channelGroup = OCMProtocolMock(@protocol(MSACChannelGroupProtocol));
+  OCMReject([channelGroup setFlushIntervalBoundsWithMinimum:30 maximum:2]);
+  OCMReject([channelGroup setBatchSizeBoundsWithMinimum:0 maximum:100]);
+  [MSACAppCenter sharedInstance].channelGroup = channelGroup;
+
+  // When
+  [MSACAppCenter setFlushIntervalBoundsWithMinimum:30 maximum:2];
+  [MSACAppCenter setBatchSizeBoundsWithMinimum:0 maximum:100];
+
+  // Then
+  XCTAssertNil([MSACAppCenter sharedInstance].requestedFlushIntervalBounds);
+  XCTAssertNil([MSACAppCenter sharedInstance].requestedBatchSizeBounds);
+}
+
+- (void)testSetMaxPendingRequestsIsForwardedToChannelGroup {
+
+  // If
+  id<MSACChannelGroupProtocol> channelGroup = OCMProtocolMock(@protocol(MSACChannelGroupProtocol));
+  OCMReject([channelGroup setMaxPendingBatchesPerChannel:8 totalLimit:4]);
+  [MSACAppCenter sharedInstance].channelGroup = channelGroup;
+
+  // When
+  [MSACAppCenter setMaxPendingRequestsPerService:8 totalLimit:4];
+  [MSACAppCenter setMaxPendingRequestsPerService:4 totalLimit:12];
+
+  // Then
+  OCMVerify([channelGroup setMaxPendingBatchesPerChannel:4 totalLimit:12]);
+}
+
+- (void)testSetBackpressurePolicyIsForwardedToChannelGroup {
+
+  // If
+  id<MSACChannelGroupProtocol> channelGroup = OCMProtocolMock(@protocol(MSACChannelGroupProtocol));
+  [MSACAppCenter sharedInstance].channelGroup = channelGroup;
+
+  // Then
+  // Logs are dropped by default, the main thread never waits.
+  XCTAssertEqual(MSACAppCenter.backpressurePolicy, MSACBackpressurePolicyDropNewest);
+
+  // When
+  [MSACAppCenter setBackpressurePolicy:MSACBackpressurePolicyBlock];
+
+  // Then
+  OCMVerify([channelGroup setBackpressurePolicy:MSACBackpressurePolicyBlock]);
+  XCTAssertEqual(MSACAppCenter.backpressurePolicy, MSACBackpressurePolicyBlock);
+}
+
 - (void)testSetValidUserIdForAppCenter {
 
   // If
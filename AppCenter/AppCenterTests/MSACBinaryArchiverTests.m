@@ -0,0 +1,146 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACBinaryArchiver.h"
+#import "MSACBinaryUnarchiver.h"
+#import "MSACDevice.h"
+#import "MSACLogWithProperties.h"
+#import "MSACModelTestsUtililty.h"
+#import "MSACOrderedDictionaryPrivate.h"
+#import "MSACStartServiceLog.h"
+#import "MSACTestFrameworks.h"
+#import "MSACUtility.h"
+
+@interface MSACBinaryArchiverTests : XCTestCase
+@end
+
+@implementation MSACBinaryArchiverTests
+
+- (void)testArchiveAndUnarchiveValues {
+
+  // If
+  NSDictionary *values = @{
+    @"string" : @"a string",
+    @"unicode" : @"ça marche 👍",
+    @"empty" : @"",
+    @"true" : @YES,
+    @"false" : @NO,
+    @"zero" : @0,
+    @"negative" : @(-42),
+    @"min" : @(INT64_MIN),
+    @"max" : @(INT64_MAX),
+    @"unsigned" : @(UINT64_MAX),
+    @"double" : @(3.14159),
+    @"null" : [NSNull null],
+    @"data" : [@"some bytes" dataUsingEncoding:NSUTF8StringEncoding],
+    @"date" : [NSDate dateWithTimeIntervalSinceReferenceDate:123456.789],
+    @"uuid" : [NSUUID UUID],
+    @"array" : @[ @"a", @"b", @"a" ],
+    @"set" : [NSSet setWithObjects:@"x", @"y", nil],
+    @"nested" : @{@"key" : @[ @1, @{@"deep" : @"value"} ]}
+  };
+
+  // When
+  NSData *data = [MSACBinaryArchiver archivedDataWithRootObject:values];
+  NSDictionary *actualValues = [MSACBinaryUnarchiver unarchivedObjectWithData:data];
+
+  // Then
+  XCTAssertTrue([MSACBinaryUnarchiver isBinaryArchive:data]);
+  XCTAssertEqualObjects(actualValues, values);
+  XCTAssertEqual(CFGetTypeID((__bridge CFTypeRef)actualValues[@"true"]), CFBooleanGetTypeID());
+  XCTAssertEqual([actualValues[@"unsigned"] unsignedLongLongValue], UINT64_MAX);
+}
+
+- (void)testArchiveKeepsMutability {
+
+  // If
+  NSArray *values = @[
+    [NSMutableArray arrayWithObject:@1], [NSMutableDictionary dictionaryWithObject:@1 forKey:@"key"], [NSMutableSet setWithObject:@1]
+  ];
+
+  // When
+  NSArray *actualValues = [MSACBinaryUnarchiver unarchivedObjectWithData:[MSACBinaryArchiver archivedDataWithRootObject:values]];
+
+  // Then
+  XCTAssertTrue([actualValues[0] isKindOfClass:[NSMutableArray class]]);
+  XCTAssertTrue([actualValues[1] isKindOfClass:[NSMutableDictionary class]]);
+  XCTAssertTrue([actualValues[2] isKindOfClass:[NSMutableSet class]]);
+}
+
+- (void)testArchiveKeepsOrderedDictionaryOrder {
+
+  // If
+  MSACOrderedDictionary *dictionary = (MSACOrderedDictionary *)[MSACModelTestsUtililty orderedDataDummies];
+
+  // When
+  MSACOrderedDictionary *actualDictionary =
+      [MSACBinaryUnarchiver unarchivedObjectWithData:[MSACBinaryArchiver archivedDataWithRootObject:dictionary]];
+
+  // Then
+  XCTAssertTrue([actualDictionary isKindOfClass:[MSACOrderedDictionary class]]);
+  XCTAssertEqualObjects(actualDictionary.order, dictionary.order);
+  XCTAssertTrue([actualDictionary isEqualToDictionary:dictionary]);
+}
+
+- (void)testArchiveAndUnarchiveLogs {
+
+  // If
+  MSACLogWithProperties *logWithProperties = [MSACLogWithProperties new];
+  [MSACModelTestsUtililty populateAbstractLogWithDummies:logWithProperties];
+  logWithProperties.properties = @{@"key1" : @"value1", @"key2" : @"value2"};
+  MSACStartServiceLog *startServiceLog = [MSACStartServiceLog new];
+  [MSACModelTestsUtililty populateAbstractLogWithDummies:startServiceLog];
+  startServiceLog.services = @[ @"Analytics", @"Crashes" ];
+
+  for (id<NSCoding> log in @[ logWithProperties, startServiceLog, [MSACModelTestsUtililty dummyDevice] ]) {
+
+    // When
+    NSData *data = [MSACBinaryArchiver archivedDataWithRootObject:log];
+    id actualLog = [MSACBinaryUnarchiver unarchivedObjectWithData:data];
+
+    // Then
+    XCTAssertEqualObjects(actualLog, log);
+    XCTAssertTrue([actualLog isMemberOfClass:[(NSObject *)log class]]);
+    XCTAssertLessThan(data.length, [MSACUtility archiveKeyedData:log].length);
+  }
+}
+
+- (void)testArchiveUnsupportedObjectReturnsNil {
+
+  // When
+  NSData *data = [MSACBinaryArchiver archivedDataWithRootObject:@[ [NSObject new] ]];
+
+  // Then
+  XCTAssertNil(data);
+}
+
+- (void)testUnarchiveCorruptedDataReturnsNil {
+
+  // If
+  NSMutableData *data = [[MSACBinaryArchiver archivedDataWithRootObject:[MSACModelTestsUtililty dummyDevice]] mutableCopy];
+
+  // When, Then
+  XCTAssertNil([MSACBinaryUnarchiver unarchivedObjectWithData:[data subdataWithRange:NSMakeRange(0, data.length / 2)]]);
+  XCTAssertNil([MSACBinaryUnarchiver unarchivedObjectWithData:[NSData data]]);
+  XCTAssertNil([MSACBinaryUnarchiver unarchivedObjectWithData:[MSACUtility archiveKeyedData:@"keyed"]]);
+  ((uint8_t *)data.mutableBytes)[2] = 0xFF;
+  XCTAssertNil([MSACBinaryUnarchiver unarchivedObjectWithData:data]);
+}
+
+- (void)testUnarchiveUnknownClassReturnsNil {
+
+  // If
+  MSACStartServiceLog *log = [MSACStartServiceLog new];
+  NSMutableData *data = [[MSACBinaryArchiver archivedDataWithRootObject:log] mutableCopy];
+  NSData *className = [@"MSACStartServiceLog" dataUsingEncoding:NSUTF8StringEncoding];
+  NSRange range = [data rangeOfData:className options:0 range:NSMakeRange(0, data.length)];
+  [data replaceBytesInRange:range withBytes:"MSACUnknownClassLog"];
+
+  // When
+  id actualLog = [MSACBinaryUnarchiver unarchivedObjectWithData:data];
+
+  // Then
+  XCTAssertNil(actualLog);
+}
+
+@end
@@ -0,0 +1,216 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACChannelDelegate.h"
+#import "MSACChannelDelegateTable.h"
+#import "MSACChannelUnitProtocol.h"
+#import "MSACMockLog.h"
+#import "MSACTestFrameworks.h"
+
+static NSUInteger const kMSACTestBenchmarkLogsCount = 20000;
+
+/**
+ * Delegate implementing the methods called while a log is enqueued, like the delegates of the services.
+ */
+@interface MSACTestEnqueueDelegate : NSObject <MSACChannelDelegate>
+
+@property(nonatomic) NSUInteger callsCount;
+
+- (void)customNotification;
+
+@end
+
+@implementation MSACTestEnqueueDelegate
+
+- (void)channel:(__unused id<MSACChannelProtocol>)channel prepareLog:(__unused id<MSACLog>)log {
+  self.callsCount++;
+}
+
+- (void)channel:(__unused id<MSACChannelProtocol>)channel
+      didPrepareLog:(__unused id<MSACLog>)log
+         internalId:(__unused NSString *)internalId
+              flags:(__unused MSACFlags)flags {
+  self.callsCount++;
+}
+
+- (BOOL)channelUnit:(__unused id<MSACChannelUnitProtocol>)channelUnit shouldFilterLog:(__unused id<MSACLog>)log {
+  self.callsCount++;
+  return NO;
+}
+
+- (void)channel:(__unused id<MSACChannelProtocol>)channel
+    didCompleteEnqueueingLog:(__unused id<MSACLog>)log
+                  internalId:(__unused NSString *)internalId {
+  self.callsCount++;
+}
+
+- (void)customNotification {
+  self.callsCount++;
+}
+
+@end
+
+@interface MSACChannelDelegateTableTests : XCTestCase
+
+@property(nonatomic) id channelUnitMock;
+
+@end
+
+@implementation MSACChannelDelegateTableTests
+
+#pragma mark - Housekeeping
+
+- (void)setUp {
+  [super setUp];
+  self.channelUnitMock = OCMProtocolMock(@protocol(MSACChannelUnitProtocol));
+}
+
+#pragma mark - Tests
+
+- (void)testDelegatesAreSortedBySelector {
+
+  // If
+  MSACTestEnqueueDelegate *enqueueDelegate = [MSACTestEnqueueDelegate new];
+  id delegateMock = OCMProtocolMock(@protocol(MSACChannelDelegate));
+  MSACChannelDelegateTable *sut = [[MSACChannelDelegateTable alloc] initWithDelegates:@[ enqueueDelegate, delegateMock ]];
+  NSMutableArray *prepareLogDelegates = [NSMutableArray new];
+  NSMutableArray *willSendLogDelegates = [NSMutableArray new];
+
+  // When
+  [sut enumerateDelegatesForSelector:@selector(channel:prepareLog:)
+                           withBlock:^(id<MSACChannelDelegate> delegate) {
+                             [prepareLogDelegates addObject:delegate];
+                           }];
+  [sut enumerateDelegatesForSelector:@selector(channel:willSendLog:)
+                           withBlock:^(id<MSACChannelDelegate> delegate) {
+                             [willSendLogDelegates addObject:delegate];
+                           }];
+
+  // Then
+  XCTAssertEqual(prepareLogDelegates.count, 2);
+  XCTAssertTrue([prepareLogDelegates containsObject:enqueueDelegate]);
+  XCTAssertEqual(willSendLogDelegates.count, 1);
+  XCTAssertEqual(willSendLogDelegates.firstObject, delegateMock);
+}
+
+- (void)testSelectorOutsideOfProtocolIsChecked {
+
+  // If
+  MSACTestEnqueueDelegate *enqueueDelegate = [MSACTestEnqueueDelegate new];
+  id delegateMock = OCMProtocolMock(@protocol(MSACChannelDelegate));
+  MSACChannelDelegateTable *sut = [[MSACChannelDelegateTable alloc] initWithDelegates:@[ enqueueDelegate, delegateMock ]];
+
+  // When
+  [sut enumerateDelegatesForSelector:@selector(customNotification)
+                           withBlock:^(id<MSACChannelDelegate> delegate) {
+                             [(MSACTestEnqueueDelegate *)delegate customNotification];
+                           }];
+
+  // Then
+  XCTAssertEqual(enqueueDelegate.callsCount, 1);
+}
+
+- (void)testDeallocatedDelegatesAreSkipped {
+
+  // If
+  MSACTestEnqueueDelegate *enqueueDelegate = [MSACTestEnqueueDelegate new];
+  MSACChannelDelegateTable *sut;
+  @autoreleasepool {
+    MSACTestEnqueueDelegate *deallocatedDelegate = [MSACTestEnqueueDelegate new];
+    sut = [[MSACChannelDelegateTable alloc] initWithDelegates:@[ enqueueDelegate, deallocatedDelegate ]];
+  }
+  __block NSUInteger notifiedCount = 0;
+
+  // When
+  [sut enumerateDelegatesForSelector:@selector(channel:prepareLog:)
+                           withBlock:^(__unused id<MSACChannelDelegate> delegate) {
+                             notifiedCount++;
+                           }];
+
+  // Then
+  XCTAssertEqual(notifiedCount, 1);
+}
+
+- (void)testCostPerEnqueuedLog {
+  for (NSUInteger delegatesCount = 5; delegatesCount <= 10; delegatesCount += 5) {
+
+    // If
+    NSHashTable<id<MSACChannelDelegate>> *delegates = [NSHashTable weakObjectsHashTable];
+    NSMutableArray *strongDelegates = [NSMutableArray new];
+    for (NSUInteger i = 0; i < delegatesCount; i++) {
+      MSACTestEnqueueDelegate *delegate = [MSACTestEnqueueDelegate new];
+      [strongDelegates addObject:delegate];
+      [delegates addObject:delegate];
+    }
+
+    // Delegates that don't care about logs, like the user id context.
+    for (NSUInteger i = 0; i < 2; i++) {
+      id otherDelegate = [NSObject new];
+      [strongDelegates addObject:otherDelegate];
+      [delegates addObject:otherDelegate];
+    }
+    MSACChannelDelegateTable *sut = [[MSACChannelDelegateTable alloc] initWithDelegates:[delegates allObjects]];
+    MSACMockLog *log = [MSACMockLog new];
+
+    // When
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger i = 0; i < kMSACTestBenchmarkLogsCount; i++) {
+      @autoreleasepool {
+        [self notifyEnqueueOfLog:log
+                  enumerator:^(SEL selector, void (^block)(id<MSACChannelDelegate> delegate)) {
+                    NSArray *synchronizedDelegates;
+                    @synchronized(delegates) {
+                      synchronizedDelegates = [delegates allObjects];
+                    }
+                    for (id<MSACChannelDelegate> delegate in synchronizedDelegates) {
+                      if ([delegate respondsToSelector:selector]) {
+                        block(delegate);
+                      }
+                    }
+                  }];
+      }
+    }
+    CFAbsoluteTime lockingDuration = CFAbsoluteTimeGetCurrent() - start;
+    start = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger i = 0; i < kMSACTestBenchmarkLogsCount; i++) {
+      @autoreleasepool {
+        [self notifyEnqueueOfLog:log
+                  enumerator:^(SEL selector, void (^block)(id<MSACChannelDelegate> delegate)) {
+                    [sut enumerateDelegatesForSelector:selector withBlock:block];
+                  }];
+      }
+    }
+    CFAbsoluteTime tableDuration = CFAbsoluteTimeGetCurrent() - start;
+
+    // Then
+    for (MSACTestEnqueueDelegate *delegate in [strongDelegates subarrayWithRange:NSMakeRange(0, delegatesCount)]) {
+      XCTAssertEqual(delegate.callsCount, kMSACTestBenchmarkLogsCount * 4 * 2);
+    }
+    NSLog(@"Delegates notified of an enqueued log, %tu delegates: lock and copy %.0f ns per log, delegate table %.0f ns per log.",
+          delegatesCount, lockingDuration * NSEC_PER_SEC / kMSACTestBenchmarkLogsCount,
+          tableDuration * NSEC_PER_SEC / kMSACTestBenchmarkLogsCount);
+  }
+}
+
+#pragma mark - Private
+
+/**
+ * Notify delegates the way a channel unit and its group do for a log enqueued by a service.
+ */
+- (void)notifyEnqueueOfLog:(id<MSACLog>)log
+                enumerator:(void (^)(SEL selector, void (^block)(id<MSACChannelDelegate> delegate)))enumerator {
+  enumerator(@selector(channel:prepareLog:), ^(id<MSACChannelDelegate> delegate) {
+    [delegate channel:self.channelUnitMock prepareLog:log];
+  });
+  enumerator(@selector(channel:didPrepareLog:internalId:flags:), ^(id<MSACChannelDelegate> delegate) {
+    [delegate channel:self.channelUnitMock didPrepareLog:log internalId:@"" flags:MSACFlagsDefault];
+  });
+  enumerator(@selector(channelUnit:shouldFilterLog:), ^(id<MSACChannelDelegate> delegate) {
+    [delegate channelUnit:self.channelUnitMock shouldFilterLog:log];
+  });
+  enumerator(@selector(channel:didCompleteEnqueueingLog:internalId:), ^(id<MSACChannelDelegate> delegate) {
+    [delegate channel:self.channelUnitMock didCompleteEnqueueingLog:log internalId:@""];
+  });
+}
+
+@end
@@ -4,18 +4,27 @@
 #import "MSACAbstractLogInternal.h"
 #import "MSACAppCenterIngestion.h"
 #import "MSACChannelDelegate.h"
+#import "MSACChannelDelegateTable.h"
 #import "MSACChannelGroupDefault.h"
 #import "MSACChannelGroupDefaultPrivate.h"
 #import "MSACChannelUnitConfiguration.h"
 #import "MSACChannelUnitDefault.h"
 #import "MSACChannelUnitDefaultPrivate.h"
+#import "MSACEnqueueRing.h"
+#import "MSACFlushScheduler.h"
 #import "MSACHttpClient.h"
 #import "MSACHttpTestUtil.h"
 #import "MSACHttpUtil.h"
 #import "MSACIngestionProtocol.h"
+#import "MSACLogDBStorage.h"
+#import "MSACLogDBStoragePrivate.h"
 #import "MSACMockLog.h"
 #import "MSACStorage.h"
 #import "MSACTestFrameworks.h"
+#import "MSACTimerWheel.h"
+#import "MSACUploadBudget.h"
+#import "MSACUploadWindow.h"
+#import "MSACUtility+Application.h"
 
 @interface MSACChannelGroupDefaultTests : XCTestCase
 
@@ -87,6 +96,35 @@
   OCMVerifyAll(sut);
   [sut stopMocking];
 }
+
+- (void)testVolatileLogsArePersistedInBackgroundTask {
+
+  // If
+  id storageMock = OCMProtocolMock(@protocol(MSACStorage));
+  self.sut.storage = storageMock;
+  MSACAbstractLog *log = [MSACAbstractLog new];
+  [self.sut.volatileStorage saveLog:log withGroupId:self.validConfiguration.groupId flags:MSACFlagsVolatile];
+  id applicationMock = OCMClassMock([UIApplication class]);
+  id utilityMock = OCMClassMock([MSACUtility class]);
+  OCMStub([utilityMock sharedApp]).andReturn(applicationMock);
+  OCMStub([applicationMock beginBackgroundTaskWithExpirationHandler:OCMOCK_ANY]).andReturn((UIBackgroundTaskIdentifier)42);
+  XCTestExpectation *expectation = [self expectationWithDescription:@"Background task ended"];
+  OCMStub([applicationMock endBackgroundTask:42]).andDo(^(__unused NSInvocation *invocation) {
+    [expectation fulfill];
+  });
+
+  // When
+  [self.sut applicationDidEnterBackground:applicationMock];
+
+  // Then
+  [self waitForExpectations:@[ expectation ] timeout:1];
+  OCMVerify([storageMock saveLog:log withGroupId:self.validConfiguration.groupId flags:MSACFlagsNormal]);
+  assertThatUnsignedInteger([self.sut.volatileStorage countLogs], equalToUnsignedInteger(0));
+
+  // Clear
+  [utilityMock stopMocking];
+  [applicationMock stopMocking];
+}
 #endif
 
 #pragma mark - Tests
@@ -122,6 +160,230 @@
   assertThatUnsignedLong(addedChannel.configuration.pendingBatchesLimit, equalToUnsignedLong(self.validConfiguration.pendingBatchesLimit));
 }
 
+- (void)testStorageEvictionDecreasesChannelItemsCount {
+
+  // If
+  MSACChannelUnitDefault *channelUnit = (MSACChannelUnitDefault *)[self.sut addChannelUnitWithConfiguration:self.validConfiguration];
+  [self waitForLogsDispatchQueue];
+  channelUnit.itemsCount = 5;
+  MSACLogDBStorage *storage = (MSACLogDBStorage *)self.sut.storage;
+
+  // When
+  storage.evictionHandler(@{self.validConfiguration.groupId : @3, @"Unknown" : @1});
+
+  // Then
+  assertThatUnsignedInteger(channelUnit.itemsCount, equalToUnsignedInteger(2));
+
+  // When
+  storage.evictionHandler(@{self.validConfiguration.groupId : @3});
+
+  // Then
+  assertThatUnsignedInteger(channelUnit.itemsCount, equalToUnsignedInteger(0));
+}
+
+- (void)testLogsLostByStorageDecreaseChannelItemsCount {
+
+  // If
+  MSACChannelUnitDefault *channelUnit = (MSACChannelUnitDefault *)[self.sut addChannelUnitWithConfiguration:self.validConfiguration];
+  [self waitForLogsDispatchQueue];
+  channelUnit.itemsCount = 5;
+  MSACLogDBStorage *storage = (MSACLogDBStorage *)self.sut.storage;
+
+  // When
+  storage.lostLogsHandler(@{self.validConfiguration.groupId : @2, @"Unknown" : @1});
+
+  // Then
+  assertThatUnsignedInteger(channelUnit.itemsCount, equalToUnsignedInteger(3));
+}
+
+- (void)testVolatileStorageEvictionDecreasesChannelItemsCount {
+
+  // If
+  MSACChannelUnitDefault *channelUnit = (MSACChannelUnitDefault *)[self.sut addChannelUnitWithConfiguration:self.validConfiguration];
+  [self waitForLogsDispatchQueue];
+  channelUnit.itemsCount = 5;
+
+  // When
+  self.sut.volatileStorage.evictionHandler(@{self.validConfiguration.groupId : @1});
+
+  // Then
+  XCTAssertEqual(channelUnit.volatileStorage, self.sut.volatileStorage);
+  assertThatUnsignedInteger(channelUnit.itemsCount, equalToUnsignedInteger(4));
+}
+
+- (void)testPersistVolatileLogsMovesLogsToStorage {
+
+  // If
+  id storageMock = OCMProtocolMock(@protocol(MSACStorage));
+  self.sut.storage = storageMock;
+  MSACAbstractLog *log = [MSACAbstractLog new];
+  [self.sut.volatileStorage saveLog:log withGroupId:self.validConfiguration.groupId flags:MSACFlagsVolatile];
+
+  // When
+  [self.sut persistVolatileLogs];
+
+  // Then
+  OCMVerify([storageMock saveLog:log withGroupId:self.validConfiguration.groupId flags:MSACFlagsNormal]);
+  OCMVerify([storageMock commitPendingLogs]);
+  assertThatUnsignedInteger([self.sut.volatileStorage countLogs], equalToUnsignedInteger(0));
+}
+
+- (void)testPruneExpiredLogsUpdatesCounters {
+
+  // If
+  MSACChannelUnitDefault *channelUnit = (MSACChannelUnitDefault *)[self.sut addChannelUnitWithConfiguration:self.validConfiguration];
+  [self waitForLogsDispatchQueue];
+  channelUnit.itemsCount = 5;
+  id storageMock = OCMProtocolMock(@protocol(MSACStorage));
+  OCMStub([storageMock deleteExpiredLogsWithLimit:100]).andReturn((@{self.validConfiguration.groupId : @3, @"Unknown" : @1}));
+  self.sut.storage = storageMock;
+
+  // When
+  [self.sut pruneExpiredLogs];
+
+  // Then
+  assertThatUnsignedInteger(self.sut.expiredLogsCount, equalToUnsignedInteger(4));
+  assertThatUnsignedInteger(channelUnit.itemsCount, equalToUnsignedInteger(2));
+}
+
+- (void)testLogsDoNotExpireByDefault {
+
+  // When
+  MSACLogDBStorage *storage = (MSACLogDBStorage *)self.sut.storage;
+
+  // Then
+  XCTAssertEqual(storage.defaultTimeToLives.count, 0);
+  XCTAssertEqual(storage.groupTimeToLives.count, 0);
+}
+
+- (void)testSetLogTimeToLiveIsForwardedToStorage {
+
+  // If
+  id storageMock = OCMProtocolMock(@protocol(MSACStorage));
+  self.sut.storage = storageMock;
+
+  // When
+  [self.sut setLogTimeToLive:60 forGroupId:self.validConfiguration.groupId flags:MSACFlagsCritical];
+
+  // Then
+  OCMVerify([storageMock setTimeToLive:60 forGroupId:self.validConfiguration.groupId flags:MSACFlagsCritical]);
+}
+
+- (void)testFlushSchedulerIsSharedByChannels {
+
+  // When
+  MSACChannelUnitDefault *channelUnit = (MSACChannelUnitDefault *)[self.sut addChannelUnitWithConfiguration:self.validConfiguration];
+  [self waitForLogsDispatchQueue];
+
+  // Then
+  assertThat(self.sut.flushScheduler, notNilValue());
+  assertThat(channelUnit.flushScheduler, equalTo(self.sut.flushScheduler));
+}
+
+- (void)testSetFlushBoundsAreForwardedToFlushScheduler {
+
+  // When
+  [self.sut setFlushIntervalBoundsWithMinimum:2 maximum:30];
+  [self.sut setBatchSizeBoundsWithMinimum:20 maximum:100];
+  [self waitForLogsDispatchQueue];
+
+  // Then
+  assertThatUnsignedInteger(self.sut.flushScheduler.minFlushInterval, equalToUnsignedInteger(2));
+  assertThatUnsignedInteger(self.sut.flushScheduler.maxFlushInterval, equalToUnsignedInteger(30));
+  assertThatUnsignedInteger(self.sut.flushScheduler.minBatchSizeLimit, equalToUnsignedInteger(20));
+  assertThatUnsignedInteger(self.sut.flushScheduler.maxBatchSizeLimit, equalToUnsignedInteger(100));
+}
+
+- (void)testChannelsShareTimerWheel {
+
+  // When
+  MSACChannelUnitDefault *channelUnit1 = (MSACChannelUnitDefault *)[self.sut addChannelUnitWithConfiguration:self.validConfiguration];
+  MSACChannelUnitDefault *channelUnit2 = (MSACChannelUnitDefault *)[self.sut addChannelUnitWithConfiguration:self.validConfiguration];
+  [self waitForLogsDispatchQueue];
+
+  // Then
+  assertThat(self.sut.timerWheel, notNilValue());
+  assertThat(channelUnit1.timerWheel, equalTo(self.sut.timerWheel));
+  assertThat(channelUnit2.timerWheel, equalTo(self.sut.timerWheel));
+  assertThatDouble(self.sut.timerWheel.tolerance, equalToDouble(kMSACTimerWheelTolerance));
+}
+
+- (void)testChannelsShareEnqueueRing {
+
+  // When
+  MSACChannelUnitDefault *channelUnit1 = (MSACChannelUnitDefault *)[self.sut addChannelUnitWithConfiguration:self.validConfiguration];
+  MSACChannelUnitDefault *channelUnit2 = (MSACChannelUnitDefault *)[self.sut addChannelUnitWithConfiguration:self.validConfiguration];
+  [self waitForLogsDispatchQueue];
+
+  // Then
+  assertThat(self.sut.enqueueRing, notNilValue());
+  assertThat(channelUnit1.enqueueRing, equalTo(self.sut.enqueueRing));
+  assertThat(channelUnit2.enqueueRing, equalTo(self.sut.enqueueRing));
+  assertThatUnsignedInteger(self.sut.enqueueRing.capacity, equalToUnsignedInteger(kMSACEnqueueRingCapacity));
+  assertThatInteger(self.sut.enqueueRing.backpressurePolicy, equalToInteger(MSACBackpressurePolicyDropNewest));
+}
+
+- (void)testSetBackpressurePolicyIsForwardedToEnqueueRing {
+
+  // When
+  [self.sut setBackpressurePolicy:MSACBackpressurePolicyDropNewestUnlessCritical];
+
+  // Then
+  assertThatInteger(self.sut.enqueueRing.backpressurePolicy, equalToInteger(MSACBackpressurePolicyDropNewestUnlessCritical));
+}
+
+- (void)testChannelsShareUploadBudget {
+
+  // When
+  MSACChannelUnitDefault *channelUnit = (MSACChannelUnitDefault *)[self.sut addChannelUnitWithConfiguration:self.validConfiguration];
+  [self waitForLogsDispatchQueue];
+
+  // Then
+  assertThat(channelUnit.uploadBudget, equalTo(self.sut.uploadBudget));
+  assertThatUnsignedInteger(channelUnit.uploadWindow.size, equalToUnsignedInteger(self.validConfiguration.pendingBatchesLimit));
+  assertThatUnsignedInteger(channelUnit.uploadWindow.maxSize, equalToUnsignedInteger(kMSACMaxPendingBatchesPerChannelDefault));
+  assertThatUnsignedInteger(self.sut.uploadBudget.limit, equalToUnsignedInteger(kMSACMaxPendingBatchesDefault));
+}
+
+- (void)testSetMaxPendingBatchesIsForwardedToChannels {
+
+  // If
+  MSACChannelUnitDefault *channelUnit = (MSACChannelUnitDefault *)[self.sut addChannelUnitWithConfiguration:self.validConfiguration];
+
+  // When
+  [self.sut setMaxPendingBatchesPerChannel:4 totalLimit:6];
+  [self waitForLogsDispatchQueue];
+
+  // Then
+  assertThatUnsignedInteger(channelUnit.uploadWindow.maxSize, equalToUnsignedInteger(4));
+  assertThatUnsignedInteger(self.sut.uploadBudget.limit, equalToUnsignedInteger(6));
+
+  // When
+  [self.sut setMaxPendingBatchesPerChannel:4 totalLimit:2];
+  [self waitForLogsDispatchQueue];
+
+  // Then
+  assertThatUnsignedInteger(self.sut.uploadBudget.limit, equalToUnsignedInteger(6));
+}
+
+- (void)testNetworkStateChangedReschedulesPendingLogs {
+
+  // If
+  id reachabilityMock = OCMClassMock([MSAC_Reachability class]);
+  OCMStub([reachabilityMock currentReachabilityStatus]).andReturn(ReachableViaWWAN);
+  id channelUnitMock = OCMProtocolMock(@protocol(MSACChannelUnitProtocol));
+  [self.sut.channels addObject:channelUnitMock];
+
+  // When
+  [self.sut networkStateChanged:[NSNotification notificationWithName:kMSACReachabilityChangedNotification object:reachabilityMock]];
+  [self waitForLogsDispatchQueue];
+
+  // Then
+  XCTAssertEqual(self.sut.flushScheduler.networkStatus, ReachableViaWWAN);
+  OCMVerify([channelUnitMock checkPendingLogs]);
+  [reachabilityMock stopMocking];
+}
+
 - (void)testAddNewChannelWithDefaultIngestion {
 
   // When
@@ -182,6 +444,29 @@
   XCTAssertNoThrow(block());
 }
 
+- (void)testDelegateTableIsReplacedWhenDelegatesChange {
+
+  // If
+  MSACChannelDelegateTable *initialTable = self.sut.delegateTable;
+  id<MSACChannelDelegate> delegateMock = OCMProtocolMock(@protocol(MSACChannelDelegate));
+
+  // When
+  [self.sut addDelegate:delegateMock];
+  MSACChannelDelegateTable *tableWithDelegate = self.sut.delegateTable;
+  [self.sut removeDelegate:delegateMock];
+
+  // Then
+  assertThat(initialTable, notNilValue());
+  assertThat(tableWithDelegate, isNot(sameInstance(initialTable)));
+  assertThat(self.sut.delegateTable, isNot(sameInstance(tableWithDelegate)));
+
+  // If
+  OCMReject([delegateMock channel:OCMOCK_ANY willSendLog:OCMOCK_ANY]);
+
+  // When
+  [self.sut channel:OCMProtocolMock(@protocol(MSACChannelUnitProtocol)) willSendLog:[MSACMockLog new]];
+}
+
 - (void)testSetEnabled {
 
   // If
@@ -35,10 +35,26 @@
   assertThat(sut.groupId, equalTo(groupId));
   XCTAssertTrue(sut.priority == priority);
   assertThatUnsignedInteger(sut.batchSizeLimit, equalToUnsignedInteger(batchSizeLimit));
+  assertThatUnsignedInteger(sut.batchSizeInBytesLimit, equalToUnsignedInteger(0));
   assertThatUnsignedInteger(sut.pendingBatchesLimit, equalToUnsignedInteger(pendingBatchesLimit));
   assertThatUnsignedInteger(sut.flushInterval, equalToUnsignedInteger(flushInterval));
 }
 
+- (void)testNewInstanceWithBatchSizeInBytesLimit {
+
+  // When
+  MSACChannelUnitConfiguration *sut = [[MSACChannelUnitConfiguration alloc] initWithGroupId:@"FooBar"
+                                                                                   priority:MSACPriorityDefault
+                                                                              flushInterval:9
+                                                                             batchSizeLimit:10
+                                                                      batchSizeInBytesLimit:4096
+                                                                        pendingBatchesLimit:20];
+
+  // Then
+  assertThatUnsignedInteger(sut.batchSizeLimit, equalToUnsignedInteger(10));
+  assertThatUnsignedInteger(sut.batchSizeInBytesLimit, equalToUnsignedInteger(4096));
+}
+
 - (void)testNewInstanceWithDefaultSettings {
 
   // If
@@ -52,6 +68,7 @@
   assertThat(sut.groupId, equalTo(groupId));
   XCTAssertTrue(sut.priority == MSACPriorityDefault);
   assertThatUnsignedInteger(sut.batchSizeLimit, equalToUnsignedInteger(50));
+  assertThatUnsignedInteger(sut.batchSizeInBytesLimit, equalToUnsignedInteger(kMSACBatchSizeInBytesLimitDefault));
   assertThatUnsignedInteger(sut.pendingBatchesLimit, equalToUnsignedInteger(3));
   assertThatUnsignedInteger(sut.flushInterval, equalToUnsignedInteger(3));
 }
@@ -11,6 +11,8 @@
 #import "MSACChannelUnitDefault.h"
 #import "MSACChannelUnitDefaultPrivate.h"
 #import "MSACDevice.h"
+#import "MSACEnqueueRing.h"
+#import "MSACFlushScheduler.h"
 #import "MSACHttpIngestion.h"
 #import "MSACHttpTestUtil.h"
 #import "MSACLogContainer.h"
@@ -18,6 +20,7 @@
 #import "MSACServiceCommon.h"
 #import "MSACStorage.h"
 #import "MSACTestFrameworks.h"
+#import "MSACTimerWheel.h"
 #import "MSACUserIdContext.h"
 #import "MSACUtility.h"
 
@@ -28,6 +31,8 @@ static NSString *const kMSACTestGroupId = @"GroupId";
 
 - (void)sendLogContainer:(MSACLogContainer *__nonnull)container;
 
+- (void)resetTimer;
+
 @end
 
 @interface MSACChannelUnitDefaultTests : XCTestCase
@@ -643,8 +648,9 @@ static NSString *const kMSACTestGroupId = @"GroupId";
   OCMExpect([delegateMock channel:channel didPrepareLog:enqueuedLog internalId:OCMOCK_ANY flags:MSACFlagsDefault]);
   OCMExpect([delegateMock channel:channel didCompleteEnqueueingLog:enqueuedLog internalId:OCMOCK_ANY]);
 
-  // The logs shouldn't be deleted after recoverable error.
+  // The logs shouldn't be deleted after recoverable error but released for a later batch.
   OCMReject([self.storageMock deleteLogsWithBatchId:expectedBatchId groupId:kMSACTestGroupId]);
+  OCMExpect([self.storageMock releaseLogsWithBatchId:expectedBatchId groupId:kMSACTestGroupId]);
 
   // When
   dispatch_async(channel.logsDispatchQueue, ^{
@@ -801,6 +807,222 @@ static NSString *const kMSACTestGroupId = @"GroupId";
                                }];
 }
 
+- (void)testBatchSizeInBytesLimitIsSetToStorage {
+
+  // When
+  [self createChannelUnitDefault];
+
+  // Then
+  OCMVerify([self.storageMock setBatchSizeInBytesLimit:kMSACBatchSizeInBytesLimitDefault forGroupId:kMSACTestGroupId]);
+}
+
+- (void)testLogsFlushedWhenStoredLogsReachBatchSizeInBytesLimit {
+
+  // If
+  __block MSACChannelUnitDefault *channel = [self createChannelUnitDefault];
+  [self initChannelEndJobExpectation];
+  OCMStub([self.storageMock sizeOfUnbatchedLogsWithGroupId:kMSACTestGroupId]).andReturn((long long)kMSACBatchSizeInBytesLimitDefault);
+
+  // When
+  [channel enqueueItem:[self getValidMockLog] flags:MSACFlagsDefault];
+  [self enqueueChannelEndJobExpectation];
+
+  // Then
+  [self waitForExpectationsWithTimeout:kMSACTestTimeout
+                               handler:^(NSError *error) {
+                                 // A single log is enough to fill the batch.
+                                 assertThatUnsignedLong(channel.itemsCount, equalToInt(0));
+                                 OCMVerify([self.storageMock loadLogsWithGroupId:kMSACTestGroupId
+                                                                           limit:50
+                                                              excludedTargetKeys:OCMOCK_ANY
+                                                               completionHandler:OCMOCK_ANY]);
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+}
+
+- (void)testLogsOfPendingBatchesDoNotFillBatchSizeInBytesLimit {
+
+  // If
+  __block MSACChannelUnitDefault *channel = [self createChannelUnitDefault];
+  [self initChannelEndJobExpectation];
+  OCMStub([self.storageMock sizeOfLogsWithGroupId:kMSACTestGroupId]).andReturn((long long)kMSACBatchSizeInBytesLimitDefault);
+  OCMStub([self.storageMock sizeOfUnbatchedLogsWithGroupId:kMSACTestGroupId]).andReturn(0);
+
+  // When
+  [channel enqueueItem:[self getValidMockLog] flags:MSACFlagsDefault];
+  [self enqueueChannelEndJobExpectation];
+
+  // Then
+  [self waitForExpectationsWithTimeout:kMSACTestTimeout
+                               handler:^(NSError *error) {
+                                 // The stored logs are already being sent, the new log waits for the timer.
+                                 assertThatUnsignedLong(channel.itemsCount, equalToInt(1));
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+}
+
+- (void)testFlushSchedulerDrainsBacklogWithBiggerBatches {
+
+  // If
+  __block MSACChannelUnitDefault *channel = [self createChannelUnitDefault];
+  channel.flushScheduler = [MSACFlushScheduler new];
+  [self initChannelEndJobExpectation];
+  OCMStub([self.storageMock countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:OCMOCK_ANY]).andReturn(120);
+
+  // When
+  for (NSUInteger i = 0; i < self.configuration.batchSizeLimit; i++) {
+    [channel enqueueItem:[self getValidMockLog] flags:MSACFlagsDefault];
+  }
+  [self enqueueChannelEndJobExpectation];
+
+  // Then
+  [self waitForExpectationsWithTimeout:kMSACTestTimeout
+                               handler:^(NSError *error) {
+                                 // The backlog of a good network is sent in a single batch.
+                                 assertThatUnsignedLong(channel.itemsCount, equalToInt(0));
+                                 OCMVerify([self.storageMock loadLogsWithGroupId:kMSACTestGroupId
+                                                                           limit:120
+                                                              excludedTargetKeys:OCMOCK_ANY
+                                                               completionHandler:OCMOCK_ANY]);
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+}
+
+- (void)testFlushSchedulerKeepsCustomBatchSizeLimit {
+
+  // If
+  self.configuration = [[MSACChannelUnitConfiguration alloc] initWithGroupId:kMSACTestGroupId
+                                                                    priority:MSACPriorityDefault
+                                                               flushInterval:kMSACFlushIntervalDefault
+                                                              batchSizeLimit:10
+                                                         pendingBatchesLimit:3];
+  __block MSACChannelUnitDefault *channel = [self createChannelUnitDefault];
+  channel.flushScheduler = [MSACFlushScheduler new];
+  [self initChannelEndJobExpectation];
+  OCMStub([self.storageMock countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:OCMOCK_ANY]).andReturn(120);
+
+  // When
+  for (NSUInteger i = 0; i < self.configuration.batchSizeLimit; i++) {
+    [channel enqueueItem:[self getValidMockLog] flags:MSACFlagsDefault];
+  }
+  [self enqueueChannelEndJobExpectation];
+
+  // Then
+  [self waitForExpectationsWithTimeout:kMSACTestTimeout
+                               handler:^(NSError *error) {
+                                 // The backlog is sent in batches of the configured size.
+                                 OCMVerify([self.storageMock loadLogsWithGroupId:kMSACTestGroupId
+                                                                           limit:10
+                                                              excludedTargetKeys:OCMOCK_ANY
+                                                               completionHandler:OCMOCK_ANY]);
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+}
+
+- (void)testFlushSchedulerTimerIsNotPostponedByNewLogs {
+
+  // If
+  __block MSACChannelUnitDefault *channel = [self createChannelUnitDefault];
+  channel.flushScheduler = [MSACFlushScheduler new];
+  [self initChannelEndJobExpectation];
+  __block NSDate *timerFireDate;
+
+  // When
+  [channel enqueueItem:[self getValidMockLog] flags:MSACFlagsDefault];
+  dispatch_async(self.dispatchQueue, ^{
+    timerFireDate = channel.timerFireDate;
+  });
+  [channel enqueueItem:[self getValidMockLog] flags:MSACFlagsDefault];
+  [self enqueueChannelEndJobExpectation];
+
+  // Then
+  [self waitForExpectationsWithTimeout:kMSACTestTimeout
+                               handler:^(NSError *error) {
+                                 assertThat(timerFireDate, notNilValue());
+                                 assertThat(channel.timerFireDate, equalTo(timerFireDate));
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+}
+
+- (void)testTimerIsScheduledOnTimerWheel {
+
+  // If
+  __block MSACChannelUnitDefault *channel = [self createChannelUnitDefault];
+  id timerWheelMock = OCMClassMock([MSACTimerWheel class]);
+  channel.timerWheel = timerWheelMock;
+  [self initChannelEndJobExpectation];
+
+  // When
+  [channel enqueueItem:[self getValidMockLog] flags:MSACFlagsDefault];
+  [self enqueueChannelEndJobExpectation];
+
+  // Then
+  [self waitForExpectationsWithTimeout:kMSACTestTimeout
+                               handler:^(NSError *error) {
+                                 OCMVerify([timerWheelMock scheduleDeadlineForOwner:channel
+                                                                         afterDelay:kMSACFlushIntervalDefault
+                                                                             leeway:kMSACFlushTimerMinLeeway
+                                                                            handler:OCMOCK_ANY]);
+                                 assertThat(channel.timerSource, nilValue());
+                                 assertThat(channel.timerFireDate, notNilValue());
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+  [timerWheelMock stopMocking];
+}
+
+- (void)testResetTimerCancelsTimerWheelDeadline {
+
+  // If
+  MSACChannelUnitDefault *channel = [self createChannelUnitDefault];
+  id timerWheelMock = OCMClassMock([MSACTimerWheel class]);
+  channel.timerWheel = timerWheelMock;
+
+  // When
+  [channel resetTimer];
+
+  // Then
+  OCMVerify([timerWheelMock cancelDeadlineForOwner:channel]);
+  assertThat(channel.timerFireDate, nilValue());
+  [timerWheelMock stopMocking];
+}
+
+- (void)testLogDroppedByEnqueueRingIsReportedAsFailure {
+
+  // If
+  MSACChannelUnitDefault *channel = [self createChannelUnitDefault];
+  id enqueueRingMock = OCMClassMock([MSACEnqueueRing class]);
+  OCMStub([enqueueRingMock pushLog:OCMOCK_ANY internalId:OCMOCK_ANY flags:MSACFlagsDefault target:channel]).andReturn(NO);
+  channel.enqueueRing = enqueueRingMock;
+  id delegateMock = OCMProtocolMock(@protocol(MSACChannelDelegate));
+  [channel addDelegate:delegateMock];
+  id<MSACLog> mockLog = [self getValidMockLog];
+  OCMReject([self.storageMock saveLog:OCMOCK_ANY withGroupId:OCMOCK_ANY flags:MSACFlagsDefault]);
+
+  // When
+  [channel enqueueItem:mockLog flags:MSACFlagsDefault];
+
+  // Then
+  OCMVerify([delegateMock channel:channel
+                didFailSendingLog:mockLog
+                        withError:[OCMArg checkWithBlock:^BOOL(NSError *error) {
+                          return error.code == MSACACLogDroppedErrorCode;
+                        }]]);
+  OCMVerify([delegateMock channel:channel didCompleteEnqueueingLog:mockLog internalId:OCMOCK_ANY]);
+  [enqueueRingMock stopMocking];
+}
+
 - (void)testNotCheckingPendingLogsOnEnqueueFailure {
 
   // If
@@ -876,6 +1098,55 @@ static NSString *const kMSACTestGroupId = @"GroupId";
                                }];
 }
 
+- (void)testEnqueueVolatileItem {
+
+  // If
+  __block MSACChannelUnitDefault *channel = [self createChannelUnitDefault];
+  id volatileStorageMock = OCMProtocolMock(@protocol(MSACStorage));
+  OCMStub([volatileStorageMock saveLog:OCMOCK_ANY withGroupId:OCMOCK_ANY flags:MSACFlagsVolatile]).andReturn(YES);
+  channel.volatileStorage = volatileStorageMock;
+  [self initChannelEndJobExpectation];
+  id<MSACLog> mockLog = [self getValidMockLog];
+  OCMReject([self.storageMock saveLog:mockLog withGroupId:OCMOCK_ANY flags:MSACFlagsVolatile]);
+
+  // When
+  [channel enqueueItem:mockLog flags:MSACFlagsVolatile];
+  [self enqueueChannelEndJobExpectation];
+
+  // Then
+  [self waitForExpectationsWithTimeout:kMSACTestTimeout
+                               handler:^(NSError *error) {
+                                 OCMVerify([volatileStorageMock saveLog:mockLog withGroupId:kMSACTestGroupId flags:MSACFlagsVolatile]);
+                                 OCMVerifyAll(self.storageMock);
+                                 assertThatUnsignedLong(channel.itemsCount, equalToInt(1));
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+  [volatileStorageMock stopMocking];
+}
+
+- (void)testEnqueueVolatileItemWithoutVolatileStorage {
+
+  // If
+  __block MSACChannelUnitDefault *channel = [self createChannelUnitDefault];
+  [self initChannelEndJobExpectation];
+  id<MSACLog> mockLog = [self getValidMockLog];
+
+  // When
+  [channel enqueueItem:mockLog flags:MSACFlagsVolatile];
+  [self enqueueChannelEndJobExpectation];
+
+  // Then
+  [self waitForExpectationsWithTimeout:kMSACTestTimeout
+                               handler:^(NSError *error) {
+                                 OCMVerify([self.storageMock saveLog:mockLog withGroupId:OCMOCK_ANY flags:MSACFlagsNormal]);
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+}
+
 - (void)testEnqueueItemWithFlagsDefault {
 
   // If
@@ -1775,7 +2046,7 @@ static NSString *const kMSACTestGroupId = @"GroupId";
   NSString *token = [NSString stringWithFormat:@"%@-secret", targetKey];
   id channelUnitMock = OCMPartialMock(channel);
   [channel pauseSendingLogsWithToken:token];
-  OCMStub([self.storageMock countLogs]).andReturn(60);
+  OCMStub([self.storageMock countLogsWithGroupId:channel.configuration.groupId excludedTargetKeys:@[]]).andReturn(60);
 
   // When
   [channel resumeSendingLogsWithToken:token];
@@ -1788,7 +2059,7 @@ static NSString *const kMSACTestGroupId = @"GroupId";
                                    XCTFail(@"Expectation Failed with error: %@", error);
                                  }
 
-                                 OCMVerify([self.storageMock countLogs]);
+                                 OCMVerify([self.storageMock countLogsWithGroupId:channel.configuration.groupId excludedTargetKeys:@[]]);
                                  OCMVerify([channelUnitMock checkPendingLogs]);
 
                                  // The count should be 0 since the logs were sent and not in pending state anymore.
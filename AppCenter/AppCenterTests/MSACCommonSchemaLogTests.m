@@ -2,6 +2,8 @@
 // Licensed under the MIT License.
 
 #import "MSACAppExtension.h"
+#import "MSACBinaryArchiver.h"
+#import "MSACBinaryUnarchiver.h"
 #import "MSACCSData.h"
 #import "MSACCSExtensions.h"
 #import "MSACCommonSchemaLog.h"
@@ -90,6 +92,21 @@
   XCTAssertEqualObjects(actualCSLog.data, self.csLogDummyValues[kMSACCSData]);
 }
 
+- (void)testCSLogBinarySerializationAndDeserialization {
+
+  // When
+  NSData *serializedCSLog = [MSACBinaryArchiver archivedDataWithRootObject:self.commonSchemaLog];
+  MSACCommonSchemaLog *actualCSLog = (MSACCommonSchemaLog *)[MSACBinaryUnarchiver unarchivedObjectWithData:serializedCSLog];
+
+  // Then
+  XCTAssertNotNil(actualCSLog);
+  XCTAssertEqualObjects(self.commonSchemaLog, actualCSLog);
+  XCTAssertTrue([actualCSLog isMemberOfClass:[MSACCommonSchemaLog class]]);
+  XCTAssertEqualObjects(actualCSLog.ext, self.csLogDummyValues[kMSACCSExt]);
+  XCTAssertEqualObjects(actualCSLog.data, self.csLogDummyValues[kMSACCSData]);
+  XCTAssertLessThan(serializedCSLog.length, [MSACUtility archiveKeyedData:self.commonSchemaLog].length);
+}
+
 - (void)testCSLogIsValid {
 
   // If
@@ -4,6 +4,7 @@
 #import <sqlite3.h>
 
 #import "MSACDBStoragePrivate.h"
+#import "MSACDBStorageProfile.h"
 #import "MSACStorageBindableArray.h"
 #import "MSACStorageTestUtil.h"
 #import "MSACTestFrameworks.h"
@@ -299,7 +300,7 @@ static const long kMSACTestStorageSizeMinimumUpperLimitInBytes = 40 * 1024;
   assertThatLong(counter, equalToLong(0));
 }
 
-- (void)testEnableAutoVacuumInOpenedDatabaseWhenQueryFails {
+- (void)testEnableIncrementalVacuumInOpenedDatabaseWhenQueryFails {
 
   // If
   // Query returns empty array.
@@ -310,9 +311,10 @@ static const long kMSACTestStorageSizeMinimumUpperLimitInBytes = 40 * 1024;
   OCMStub([dbStorageMock executeNonSelectionQuery:[OCMArg any] inOpenedDatabase:db withValues:OCMOCK_ANY]);
 
   // When
-  [MSACDBStorage enableAutoVacuumInOpenedDatabase:db];
+  BOOL needsVacuum = [MSACDBStorage enableIncrementalVacuumInOpenedDatabase:db];
 
   // Then
+  XCTAssertTrue(needsVacuum);
   OCMVerify([dbStorageMock executeSelectionQuery:[OCMArg any] inOpenedDatabase:db withValues:OCMOCK_ANY]);
 
   // If
@@ -321,10 +323,13 @@ static const long kMSACTestStorageSizeMinimumUpperLimitInBytes = 40 * 1024;
   OCMStub([dbStorageMock executeSelectionQuery:[OCMArg any] inOpenedDatabase:db withValues:OCMOCK_ANY]).andReturn(entries);
 
   // When
-  [MSACDBStorage enableAutoVacuumInOpenedDatabase:db];
+  needsVacuum = [MSACDBStorage enableIncrementalVacuumInOpenedDatabase:db];
 
   // Then
+  XCTAssertTrue(needsVacuum);
   OCMVerify([dbStorageMock executeSelectionQuery:[OCMArg any] inOpenedDatabase:db withValues:OCMOCK_ANY]);
+  [dbStorageMock stopMocking];
+  sqlite3_close(db);
 }
 
 - (void)testCreateTableWhenTableExists {
@@ -382,6 +387,417 @@ static const long kMSACTestStorageSizeMinimumUpperLimitInBytes = 40 * 1024;
   XCTAssertFalse([self tableExists:tableName2]);
 }
 
+- (void)testDropDatabaseClosesConnection {
+
+  // If
+  NSString *query = [NSString stringWithFormat:@"SELECT COUNT(*) FROM \"%@\"", kMSACTestTableName];
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    [self.sut executeCachedSelectionQuery:query inOpenedDatabase:db withValues:nil];
+    return SQLITE_OK;
+  }];
+  XCTAssertTrue(self.sut.connection != NULL);
+  XCTAssertEqual(self.sut.cachedStatements.count, 1);
+
+  // When
+  [self.sut dropDatabase];
+
+  // Then
+  XCTAssertTrue(self.sut.connection == NULL);
+  XCTAssertEqual(self.sut.cachedStatements.count, 0);
+}
+
+- (void)testConnectionIsKeptOpenBetweenQueries {
+
+  // If
+  __block void *firstConnection = NULL;
+  __block void *secondConnection = NULL;
+
+  // When
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    firstConnection = db;
+    return SQLITE_OK;
+  }];
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    secondConnection = db;
+    return SQLITE_OK;
+  }];
+
+  // Then
+  XCTAssertTrue(firstConnection != NULL);
+  XCTAssertTrue(firstConnection == secondConnection);
+  XCTAssertTrue(self.sut.connection == firstConnection);
+}
+
+- (void)testCachedStatementIsReused {
+
+  // If
+  [self addGuysToTheTableWithCount:3];
+  NSString *query =
+      [NSString stringWithFormat:@"SELECT COUNT(*) FROM \"%@\" WHERE \"%@\" > ?", kMSACTestTableName, kMSACTestPositionColName];
+  __block NSArray<NSArray *> *firstEntries;
+  __block NSArray<NSArray *> *secondEntries;
+  __block NSValue *cachedStatement;
+
+  // When
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+    [values addNumber:@0];
+    firstEntries = [self.sut executeCachedSelectionQuery:query inOpenedDatabase:db withValues:values];
+    cachedStatement = self.sut.cachedStatements[query];
+    values = [MSACStorageBindableArray new];
+    [values addNumber:@2];
+    secondEntries = [self.sut executeCachedSelectionQuery:query inOpenedDatabase:db withValues:values];
+    return SQLITE_OK;
+  }];
+
+  // Then
+  XCTAssertNotNil(cachedStatement);
+  XCTAssertEqualObjects(self.sut.cachedStatements[query], cachedStatement);
+  assertThat(firstEntries[0][0], equalToInt(3));
+  assertThat(secondEntries[0][0], equalToInt(1));
+}
+
+- (void)testConnectionIsOpenedWithProfile {
+
+  // If
+  MSACDBStorageProfile *profile = [MSACDBStorageProfile defaultProfile];
+  __block NSNumber *pageSize;
+  __block NSNumber *cacheSize;
+  __block NSNumber *tempStore;
+
+  // When
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    pageSize = [MSACDBStorage executeSelectionQuery:@"PRAGMA page_size" inOpenedDatabase:db withValues:nil][0][0];
+    cacheSize = [MSACDBStorage executeSelectionQuery:@"PRAGMA cache_size" inOpenedDatabase:db withValues:nil][0][0];
+    tempStore = [MSACDBStorage executeSelectionQuery:@"PRAGMA temp_store" inOpenedDatabase:db withValues:nil][0][0];
+    return SQLITE_OK;
+  }];
+
+  // Then
+  assertThat(pageSize, equalToLong(profile.pageSize));
+  assertThat(cacheSize, equalToLong(-profile.cacheSizeInKiB));
+
+  // MEMORY.
+  assertThat(tempStore, equalToInt(2));
+}
+
+- (void)testConnectionIsOpenedWithSQLiteDefaultsProfile {
+
+  // If
+  __block NSNumber *tempStore;
+  [self.sut closeConnection];
+  self.sut.profile = [MSACDBStorageProfile sqliteDefaultsProfile];
+
+  // When
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    tempStore = [MSACDBStorage executeSelectionQuery:@"PRAGMA temp_store" inOpenedDatabase:db withValues:nil][0][0];
+    return SQLITE_OK;
+  }];
+
+  // Then
+
+  // DEFAULT.
+  assertThat(tempStore, equalToInt(0));
+}
+
+- (void)testDefaultDurabilityUsesWriteAheadLog {
+
+  // If
+  __block NSString *journalMode;
+  __block NSNumber *synchronousMode;
+
+  // When
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    journalMode = [MSACDBStorage executeSelectionQuery:@"PRAGMA journal_mode" inOpenedDatabase:db withValues:nil][0][0];
+    synchronousMode = [MSACDBStorage executeSelectionQuery:@"PRAGMA synchronous" inOpenedDatabase:db withValues:nil][0][0];
+    return SQLITE_OK;
+  }];
+
+  // Then
+  XCTAssertEqual(self.sut.durability, MSACStorageDurabilityDefault);
+  XCTAssertTrue(self.sut.walEnabled);
+  assertThat(journalMode, equalToIgnoringCase(@"wal"));
+
+  // NORMAL.
+  assertThat(synchronousMode, equalToInt(1));
+}
+
+- (void)testFullDurabilityUsesRollbackJournal {
+
+  // If
+  __block NSString *journalMode;
+  __block NSNumber *synchronousMode;
+  [self.sut executeQueryUsingBlock:^int(__unused void *db) {
+    return SQLITE_OK;
+  }];
+
+  // When
+  self.sut.durability = MSACStorageDurabilityFull;
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    journalMode = [MSACDBStorage executeSelectionQuery:@"PRAGMA journal_mode" inOpenedDatabase:db withValues:nil][0][0];
+    synchronousMode = [MSACDBStorage executeSelectionQuery:@"PRAGMA synchronous" inOpenedDatabase:db withValues:nil][0][0];
+    return SQLITE_OK;
+  }];
+
+  // Then
+  XCTAssertFalse(self.sut.walEnabled);
+  assertThat(journalMode, equalToIgnoringCase(@"delete"));
+
+  // FULL.
+  assertThat(synchronousMode, equalToInt(2));
+}
+
+- (void)testSynchronousQueryIsSyncedOnCommit {
+
+  // If
+  __block NSNumber *synchronousModeInQuery;
+  __block NSNumber *synchronousModeAfterQuery;
+
+  // When
+  [self.sut executeSynchronousQueryUsingBlock:^int(void *db) {
+    synchronousModeInQuery = [MSACDBStorage executeSelectionQuery:@"PRAGMA synchronous" inOpenedDatabase:db withValues:nil][0][0];
+    return SQLITE_OK;
+  }];
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    synchronousModeAfterQuery = [MSACDBStorage executeSelectionQuery:@"PRAGMA synchronous" inOpenedDatabase:db withValues:nil][0][0];
+    return SQLITE_OK;
+  }];
+
+  // Then
+  assertThat(synchronousModeInQuery, equalToInt(2));
+  assertThat(synchronousModeAfterQuery, equalToInt(1));
+}
+
+- (void)testPeriodicCheckpointAfterChanges {
+
+  // If
+  NSString *query = [NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\") VALUES ('Joe', 'Pizza')", kMSACTestTableName,
+                                               kMSACTestPersonColName, kMSACTestMealColName];
+  [self.sut executeNonSelectionQuery:query];
+  int changes = self.sut.changesAtLastCheckpoint;
+
+  // Then
+  XCTAssertGreaterThan(self.sut.lastCheckpointTime, 0);
+
+  // When
+  self.sut.lastCheckpointTime = 0;
+  [self.sut executeQueryUsingBlock:^int(__unused void *db) {
+    return SQLITE_OK;
+  }];
+
+  // Then
+  XCTAssertEqual(self.sut.changesAtLastCheckpoint, changes + 1);
+  XCTAssertGreaterThan(self.sut.lastCheckpointTime, 0);
+
+  // When
+  self.sut.lastCheckpointTime = 0;
+  [self.sut executeQueryUsingBlock:^int(__unused void *db) {
+    return SQLITE_OK;
+  }];
+
+  // Then
+  // No change since the last checkpoint.
+  XCTAssertEqual(self.sut.lastCheckpointTime, 0);
+}
+
+- (void)testDropDatabaseDeletesWriteAheadLog {
+
+  // If
+  NSString *query = [NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\") VALUES ('Joe', 'Pizza')", kMSACTestTableName,
+                                               kMSACTestPersonColName, kMSACTestMealColName];
+  [self.sut executeNonSelectionQuery:query];
+  NSString *walPathComponent = [kMSACTestDBFileName stringByAppendingString:@"-wal"];
+  XCTAssertTrue([MSACUtility fileExistsForPathComponent:walPathComponent]);
+
+  // When
+  [self.sut dropDatabase];
+
+  // Then
+  XCTAssertFalse([MSACUtility fileExistsForPathComponent:walPathComponent]);
+  XCTAssertFalse([MSACUtility fileExistsForPathComponent:[kMSACTestDBFileName stringByAppendingString:@"-shm"]]);
+}
+
+- (void)testGroupedQueriesAreCommittedWhenReachingMaxChangesCount {
+
+  // If
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.DBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableGroupCommitWithMaxChangesCount:3 window:60 queue:queue];
+
+  // When
+  [self addGuyWithGroupedQuery];
+  [self addGuyWithGroupedQuery];
+
+  // Then
+  XCTAssertEqual(self.sut.pendingTransactionChangesCount, 2);
+  XCTAssertEqual([self countCommittedGuys], 0);
+  XCTAssertEqual([self.sut countEntriesForTable:kMSACTestTableName condition:nil withValues:nil], 2);
+
+  // When
+  [self addGuyWithGroupedQuery];
+
+  // Then
+  XCTAssertEqual(self.sut.pendingTransactionChangesCount, 0);
+  XCTAssertEqual([self countCommittedGuys], 3);
+}
+
+- (void)testGroupedQueriesAreCommittedWhenWindowElapses {
+
+  // If
+  XCTestExpectation *expectation = [self expectationWithDescription:@"Pending transaction committed."];
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.DBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableGroupCommitWithMaxChangesCount:10 window:0.1 queue:queue];
+
+  // When
+  dispatch_sync(queue, ^{
+    [self addGuyWithGroupedQuery];
+  });
+
+  // Then
+  XCTAssertEqual([self countCommittedGuys], 0);
+  dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.3 * NSEC_PER_SEC)), queue, ^{
+    [expectation fulfill];
+  });
+  [self waitForExpectationsWithTimeout:1
+                               handler:^(NSError *error) {
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                                 XCTAssertEqual([self countCommittedGuys], 1);
+                                 XCTAssertNil(self.sut.groupCommitTimerSource);
+                               }];
+}
+
+- (void)testSynchronousQueryCommitsPendingTransaction {
+
+  // If
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.DBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableGroupCommitWithMaxChangesCount:10 window:60 queue:queue];
+  [self addGuyWithGroupedQuery];
+  __block BOOL inTransaction = YES;
+
+  // When
+  [self.sut executeSynchronousQueryUsingBlock:^int(void *db) {
+    inTransaction = !sqlite3_get_autocommit(db);
+    return SQLITE_OK;
+  }];
+
+  // Then
+  XCTAssertFalse(inTransaction);
+  XCTAssertEqual([self countCommittedGuys], 1);
+}
+
+- (void)testGroupCommitIsDisabledWithFullDurability {
+
+  // If
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.DBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableGroupCommitWithMaxChangesCount:10 window:60 queue:queue];
+  self.sut.durability = MSACStorageDurabilityFull;
+
+  // When
+  [self addGuyWithGroupedQuery];
+
+  // Then
+  XCTAssertEqual(self.sut.pendingTransactionChangesCount, 0);
+  XCTAssertEqual([self countCommittedGuys], 1);
+}
+
+- (void)testCloseConnectionCommitsPendingTransaction {
+
+  // If
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.DBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableGroupCommitWithMaxChangesCount:10 window:60 queue:queue];
+  [self addGuyWithGroupedQuery];
+
+  // When
+  [self.sut closeConnection];
+
+  // Then
+  XCTAssertEqual([self countCommittedGuys], 1);
+}
+
+- (void)testReadQueryIsMadeOnReaderConnectionAfterCommit {
+
+  // If
+  XCTestExpectation *expectation = [self expectationWithDescription:@"Read completed."];
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.DBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  dispatch_queue_t readerQueue = dispatch_queue_create("com.microsoft.appcenter.DBStorageTestsReaderQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableGroupCommitWithMaxChangesCount:10 window:60 queue:queue];
+  [self.sut enableReaderConnectionWithReaderQueue:readerQueue queue:queue];
+  static char queueKey;
+  dispatch_queue_set_specific(queue, &queueKey, &queueKey, NULL);
+  __block void *readerDb = NULL;
+  __block int count = 0;
+  __block BOOL completedOnQueue = NO;
+  NSString *query = [NSString stringWithFormat:@"SELECT COUNT(*) FROM \"%@\"", kMSACTestTableName];
+
+  // When
+  dispatch_async(queue, ^{
+    [self addGuyWithGroupedQuery];
+    [self.sut executeReadQueryUsingBlock:^int(void *db) {
+      readerDb = db;
+      count = [[self.sut executeCachedSelectionQuery:query inOpenedDatabase:db withValues:nil][0][0] intValue];
+      return SQLITE_OK;
+    }
+        completionHandler:^(int result) {
+          XCTAssertEqual(result, SQLITE_OK);
+          completedOnQueue = dispatch_get_specific(&queueKey) != NULL;
+          [expectation fulfill];
+        }];
+
+    // The change made while reading is not seen by the read.
+    [self addGuyWithGroupedQuery];
+  });
+
+  // Then
+  [self waitForExpectationsWithTimeout:1
+                               handler:^(NSError *error) {
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+  XCTAssertTrue(readerDb != NULL);
+  XCTAssertTrue(readerDb != self.sut.connection);
+  XCTAssertTrue(readerDb == self.sut.readerConnection);
+  XCTAssertEqual(self.sut.readerCachedStatements.count, 1);
+  XCTAssertTrue(completedOnQueue);
+  XCTAssertEqual(count, 1);
+
+  // When
+  dispatch_sync(queue, ^{
+    [self.sut closeConnection];
+  });
+
+  // Then
+  XCTAssertTrue(self.sut.readerConnection == NULL);
+  XCTAssertEqual(self.sut.readerCachedStatements.count, 0);
+}
+
+- (void)testReadQueryIsMadeRightAwayWithoutWriteAheadLog {
+
+  // If
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.DBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  dispatch_queue_t readerQueue = dispatch_queue_create("com.microsoft.appcenter.DBStorageTestsReaderQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableReaderConnectionWithReaderQueue:readerQueue queue:queue];
+  self.sut.durability = MSACStorageDurabilityFull;
+  __block void *readerDb = NULL;
+  __block BOOL completed = NO;
+
+  // When
+  [self.sut executeReadQueryUsingBlock:^int(void *db) {
+    readerDb = db;
+    return SQLITE_OK;
+  }
+      completionHandler:^(__unused int result) {
+        completed = YES;
+      }];
+
+  // Then
+  XCTAssertFalse([self.sut canReadConcurrently]);
+  XCTAssertTrue(completed);
+  XCTAssertTrue(readerDb == self.sut.connection);
+  XCTAssertTrue(self.sut.readerConnection == NULL);
+}
+
 - (void)testDroppedTableWhenTableDoesNotExists {
 
   // If
@@ -483,6 +899,89 @@ static const long kMSACTestStorageSizeMinimumUpperLimitInBytes = 40 * 1024;
   assertThat(result, is(expectedGuys));
 }
 
+- (void)testEnumerateRowsReadsColumnValuesWithoutBoxing {
+
+  // If
+  __block NSUInteger rowsCount = 0;
+  __block int64_t integer = 0;
+  __block double real = 0;
+  __block NSString *text = nil;
+  __block NSData *blob = nil;
+  __block BOOL isNull = NO;
+  __block NSUInteger columnCount = 0;
+
+  // When
+  int result = [self.sut enumerateRowsOfQuery:@"SELECT 5000000000, 1.5, 'text', x'0102', NULL"
+                                   withValues:nil
+                                   usingBlock:^(MSACStorageCursor *cursor, __unused BOOL *stop) {
+                                     rowsCount++;
+                                     columnCount = cursor.columnCount;
+                                     integer = [cursor int64AtIndex:0];
+                                     real = [cursor doubleAtIndex:1];
+                                     text = [cursor stringAtIndex:2];
+                                     blob = [[cursor dataWithoutCopyAtIndex:3] copy];
+                                     isNull = [cursor isNullAtIndex:4];
+                                   }];
+
+  // Then
+  assertThatInt(result, equalToInt(SQLITE_OK));
+  assertThatUnsignedInteger(rowsCount, equalToInt(1));
+  assertThatUnsignedInteger(columnCount, equalToInt(5));
+  assertThatLongLong(integer, equalToLongLong(5000000000LL));
+  assertThatDouble(real, equalToDouble(1.5));
+  assertThat(text, is(@"text"));
+  const uint8_t expectedBytes[] = {0x01, 0x02};
+  assertThat(blob, is([NSData dataWithBytes:expectedBytes length:sizeof(expectedBytes)]));
+  XCTAssertTrue(isNull);
+}
+
+- (void)testEnumerateRowsStops {
+
+  // If
+  NSArray *expectedGuys = [self addGuysToTheTableWithCount:10];
+  NSMutableArray *persons = [NSMutableArray new];
+  NSString *query = [NSString stringWithFormat:@"SELECT \"%@\" FROM \"%@\" ORDER BY \"%@\"", kMSACTestPersonColName, kMSACTestTableName,
+                                               kMSACTestPositionColName];
+
+  // When
+  int result = [self.sut enumerateRowsOfQuery:query
+                                   withValues:nil
+                                   usingBlock:^(MSACStorageCursor *cursor, BOOL *stop) {
+                                     [persons addObject:(NSString *)[cursor stringAtIndex:0]];
+                                     *stop = persons.count == 3;
+                                   }];
+
+  // Then
+  assertThatInt(result, equalToInt(SQLITE_OK));
+  assertThat(persons, is(@[ expectedGuys[0][1], expectedGuys[1][1], expectedGuys[2][1] ]));
+}
+
+- (void)testEnumerateRowsOfInvalidQuery {
+
+  // If
+  __block BOOL called = NO;
+
+  // When
+  int result = [self.sut enumerateRowsOfQuery:@"SELECT * FROM \"unknown\""
+                                   withValues:nil
+                                   usingBlock:^(__unused MSACStorageCursor *cursor, __unused BOOL *stop) {
+                                     called = YES;
+                                   }];
+
+  // Then
+  assertThatInt(result, isNot(equalToInt(SQLITE_OK)));
+  XCTAssertFalse(called);
+}
+
+- (void)testSelectionQueryReturns64BitIntegers {
+
+  // When
+  NSArray<NSArray *> *result = [self.sut executeSelectionQuery:@"SELECT 5000000000, 1.5" withValues:nil];
+
+  // Then
+  assertThat(result, is(@[ @[ @(5000000000LL), @(1.5) ] ]));
+}
+
 - (void)testCount {
 
   // If
@@ -654,30 +1153,54 @@ static const long kMSACTestStorageSizeMinimumUpperLimitInBytes = 40 * 1024;
   // Didn't crash.
 }
 
-- (void)testNewDatabaseIsAutoVacuumed {
+- (void)testNewDatabaseIsIncrementallyVacuumed {
 
   // Then
-  XCTAssertTrue([self autoVacuumIsSetToFull]);
+  assertThatLong([self autoVacuumMode], equalToLong(kMSACAutoVacuumIncremental));
+  XCTAssertFalse(self.sut.needsVacuum);
 }
 
-- (void)testNonAutoVacuumingDatabaseIsManuallyVacuumedAndAutoVacuumedWhenInitialized {
+- (void)testNonAutoVacuumingDatabaseIsNotVacuumedWhenInitialized {
 
   // If
 
   // Reset database and ensure that auto_vacuum is disabled.
   [self.storageTestUtil deleteDatabase];
   sqlite3 *db = [self.storageTestUtil openDatabase];
-  sqlite3_exec(db, "PRAGMA auto_vacuum = NONE; VACUUM", NULL, NULL, NULL);
+  sqlite3_exec(db, "PRAGMA auto_vacuum = NONE; CREATE TABLE \"other\" (\"id\" INTEGER); VACUUM", NULL, NULL, NULL);
   sqlite3_close(db);
+  id dbStorageMock = OCMClassMock([MSACDBStorage class]);
+
+  // Then
+  OCMReject([dbStorageMock executeNonSelectionQuery:@"VACUUM" inOpenedDatabase:[OCMArg anyPointer]]);
 
   // When
   self.sut = [[MSACDBStorage alloc] initWithSchema:self.schema version:0 filename:kMSACTestDBFileName];
 
   // Then
-  XCTAssertTrue([self autoVacuumIsSetToFull]);
+  XCTAssertTrue(self.sut.needsVacuum);
+  assertThatLong([self autoVacuumMode], equalToLong(kMSACAutoVacuumNone));
+  [dbStorageMock stopMocking];
+}
+
+- (void)testNonAutoVacuumingDatabaseIsConvertedOnIncrementalVacuum {
+
+  // If
+  [self.storageTestUtil deleteDatabase];
+  sqlite3 *db = [self.storageTestUtil openDatabase];
+  sqlite3_exec(db, "PRAGMA auto_vacuum = NONE; CREATE TABLE \"other\" (\"id\" INTEGER); VACUUM", NULL, NULL, NULL);
+  sqlite3_close(db);
+  self.sut = [[MSACDBStorage alloc] initWithSchema:self.schema version:0 filename:kMSACTestDBFileName];
+
+  // When
+  [self.sut vacuumIncrementally];
+
+  // Then
+  XCTAssertFalse(self.sut.needsVacuum);
+  assertThatLong([self autoVacuumMode], equalToLong(kMSACAutoVacuumIncremental));
 }
 
-- (void)testDatabaseThatIsAutoVacuumedNotManuallyVacuumedWhenInitialized {
+- (void)testFullAutoVacuumingDatabaseIsSwitchedToIncrementalWithoutVacuum {
 
   // If
 
@@ -689,10 +1212,150 @@ static const long kMSACTestStorageSizeMinimumUpperLimitInBytes = 40 * 1024;
   id dbStorageMock = OCMClassMock([MSACDBStorage class]);
 
   // Then
-  OCMReject([dbStorageMock executeNonSelectionQuery:@"VACUUM" inOpenedDatabase:[OCMArg anyPointer] withValues:OCMOCK_ANY]);
+  OCMReject([dbStorageMock executeNonSelectionQuery:@"VACUUM" inOpenedDatabase:[OCMArg anyPointer]]);
 
   // When
   self.sut = [[MSACDBStorage alloc] initWithSchema:self.schema version:0 filename:kMSACTestDBFileName];
+
+  // Then
+  XCTAssertFalse(self.sut.needsVacuum);
+  assertThatLong([self autoVacuumMode], equalToLong(kMSACAutoVacuumIncremental));
+  [dbStorageMock stopMocking];
+}
+
+- (void)testVacuumIncrementallyFreesBoundedNumberOfPages {
+
+  // If
+  [self addGuysToTheTableWithCount:1000];
+  [self.sut executeNonSelectionQuery:[NSString stringWithFormat:@"DELETE FROM \"%@\"", kMSACTestTableName]];
+  long freePageCount = [self freePageCount];
+  XCTAssertGreaterThan(freePageCount, 2);
+  [self.sut enableIncrementalVacuumWithMaxPagesCount:2 idleDelay:60 queue:dispatch_get_main_queue()];
+
+  // When
+  long freedPageCount = [self.sut vacuumIncrementally];
+
+  // Then
+  assertThatLong(freedPageCount, equalToLong(2));
+  assertThatLong([self freePageCount], equalToLong(freePageCount - 2));
+
+  // Pages left are freed later.
+  XCTAssertNotNil(self.sut.incrementalVacuumTimerSource);
+}
+
+- (void)testVacuumIncrementallyWithoutFreePages {
+
+  // If
+  [self addGuysToTheTableWithCount:10];
+  [self.sut enableIncrementalVacuumWithMaxPagesCount:2 idleDelay:60 queue:dispatch_get_main_queue()];
+
+  // When
+  long freedPageCount = [self.sut vacuumIncrementally];
+
+  // Then
+  assertThatLong(freedPageCount, equalToLong(0));
+  XCTAssertNil(self.sut.incrementalVacuumTimerSource);
+}
+
+- (void)testIncrementalVacuumRunsOnQueueOnceIdle {
+
+  // If
+  XCTestExpectation *expectation = [self expectationWithDescription:@"Unused pages freed."];
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.DBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  [self addGuysToTheTableWithCount:1000];
+  [self.sut executeNonSelectionQuery:[NSString stringWithFormat:@"DELETE FROM \"%@\"", kMSACTestTableName]];
+  XCTAssertGreaterThan([self freePageCount], 0);
+  [self.sut enableIncrementalVacuumWithMaxPagesCount:1000 idleDelay:0.1 queue:queue];
+
+  // When
+  dispatch_sync(queue, ^{
+    [self.sut scheduleIncrementalVacuum];
+  });
+
+  // Then
+  XCTAssertGreaterThan([self freePageCount], 0);
+  dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.3 * NSEC_PER_SEC)), queue, ^{
+    [expectation fulfill];
+  });
+  [self waitForExpectationsWithTimeout:1
+                               handler:^(NSError *error) {
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                                 assertThatLong([self freePageCount], equalToLong(0));
+                                 XCTAssertNil(self.sut.incrementalVacuumTimerSource);
+                               }];
+}
+
+- (void)testMigrateIncrementallyCopiesRowsOfStagedTable {
+
+  // If
+  [self addGuysToTheTableWithCount:5];
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    [MSACDBStorage stageTable:kMSACTestTableName forMigrationFromVersion:0 inOpenedDatabase:db];
+    return [MSACDBStorage createTablesWithSchema:self.schema inOpenedDatabase:db];
+  }];
+  assertThatUnsignedInteger([self.sut countEntriesForTable:kMSACTestTableName condition:nil withValues:nil], equalToUnsignedInteger(0));
+  self.sut.incrementalMigrationChunkSize = 2;
+
+  // When
+  BOOL rowsLeft = [self.sut migrateIncrementally];
+
+  // Then
+  assertThatBool(rowsLeft, isTrue());
+  assertThatUnsignedInteger([self.sut countEntriesForTable:kMSACTestTableName condition:nil withValues:nil], equalToUnsignedInteger(2));
+
+  // When
+  while ([self.sut migrateIncrementally]) {
+  }
+
+  // Then
+  assertThatUnsignedInteger([self.sut countEntriesForTable:kMSACTestTableName condition:nil withValues:nil], equalToUnsignedInteger(5));
+  NSString *stagedTableName = [MSACDBStorage stagedTableNameForTable:kMSACTestTableName fromVersion:0];
+  assertThatUnsignedInteger([self.sut countEntriesForTable:@"sqlite_master"
+                                                 condition:[NSString stringWithFormat:@"\"name\" = '%@'", stagedTableName]
+                                                withValues:nil],
+                            equalToUnsignedInteger(0));
+  assertThatBool([self.sut migrateIncrementally], isFalse());
+}
+
+- (void)testMigrateIncrementallyKeepsStagedRowsWhenStorageIsFull {
+
+  // If
+  [self addGuysToTheTableWithCount:5];
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    [MSACDBStorage stageTable:kMSACTestTableName forMigrationFromVersion:0 inOpenedDatabase:db];
+    return [MSACDBStorage createTablesWithSchema:self.schema inOpenedDatabase:db];
+  }];
+  self.sut.incrementalMigrationChunkSize = 2;
+  id dbStorageMock = OCMPartialMock(self.sut);
+  OCMStub([dbStorageMock migrateRowsOfStagedTable:OCMOCK_ANY
+                                          toTable:OCMOCK_ANY
+                                      fromVersion:0
+                                        fromRowId:1
+                                          toRowId:2
+                                 inOpenedDatabase:[OCMArg anyPointer]])
+      .andReturn(SQLITE_FULL);
+
+  // When
+  BOOL rowsLeft = [self.sut migrateIncrementally];
+  [dbStorageMock stopMocking];
+
+  // Then
+  assertThatBool(rowsLeft, isFalse());
+  assertThatBool(self.sut.incrementalMigrationWaitingForRoom, isTrue());
+  assertThatUnsignedInteger([self.sut countEntriesForTable:kMSACTestTableName condition:nil withValues:nil], equalToUnsignedInteger(0));
+  NSString *stagedTableName = [MSACDBStorage stagedTableNameForTable:kMSACTestTableName fromVersion:0];
+  assertThatUnsignedInteger([self.sut countEntriesForTable:stagedTableName condition:nil withValues:nil], equalToUnsignedInteger(5));
+
+  // When
+  [self.sut resumeIncrementalMigration];
+  while ([self.sut migrateIncrementally]) {
+  }
+
+  // Then
+  assertThatBool(self.sut.incrementalMigrationWaitingForRoom, isFalse());
+  assertThatUnsignedInteger([self.sut countEntriesForTable:kMSACTestTableName condition:nil withValues:nil], equalToUnsignedInteger(5));
 }
 
 - (void)testDatabaseThatFileWasCorrupted {
@@ -783,6 +1446,31 @@ static const long kMSACTestStorageSizeMinimumUpperLimitInBytes = 40 * 1024;
   return guys;
 }
 
+- (int)addGuyWithGroupedQuery {
+  NSString *query = [NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\") VALUES (?, ?)", kMSACTestTableName,
+                                               kMSACTestPersonColName, kMSACTestMealColName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addString:@"Joe"];
+  [values addString:@"Pizza"];
+  return [self.sut executeGroupedQueryUsingBlock:^int(void *db) {
+    return [self.sut executeCachedNonSelectionQuery:query inOpenedDatabase:db withValues:values];
+  }];
+}
+
+- (int)countCommittedGuys {
+
+  // Uncommitted changes are only visible from the connection that made them.
+  sqlite3 *db = [self.storageTestUtil openDatabase];
+  sqlite3_stmt *statement = NULL;
+  NSString *query = [NSString stringWithFormat:@"SELECT COUNT(*) FROM \"%@\"", kMSACTestTableName];
+  sqlite3_prepare_v2(db, [query UTF8String], -1, &statement, NULL);
+  sqlite3_step(statement);
+  int count = sqlite3_column_int(statement, 0);
+  sqlite3_finalize(statement);
+  sqlite3_close(db);
+  return count;
+}
+
 - (NSString *)queryTable:(NSString *)tableName {
   return [self.sut executeSelectionQuery:[NSString stringWithFormat:@"SELECT sql FROM sqlite_master WHERE name='%@'", tableName]
                               withValues:nil][0][0];
@@ -796,15 +1484,23 @@ static const long kMSACTestStorageSizeMinimumUpperLimitInBytes = 40 * 1024;
   return [(NSNumber *)result[0][0] boolValue];
 }
 
-- (BOOL)autoVacuumIsSetToFull {
-  int autoVacuumFullState = 1;
+- (long)autoVacuumMode {
   sqlite3 *db = [self.storageTestUtil openDatabase];
   sqlite3_stmt *statement = NULL;
   sqlite3_prepare_v2(db, "PRAGMA auto_vacuum", -1, &statement, NULL);
   sqlite3_step(statement);
-  NSNumber *autoVacuum = @(sqlite3_column_int(statement, 0));
+  long autoVacuumMode = sqlite3_column_int(statement, 0);
   sqlite3_finalize(statement);
   sqlite3_close(db);
-  return [autoVacuum intValue] == autoVacuumFullState;
+  return autoVacuumMode;
+}
+
+- (long)freePageCount {
+  __block long freePageCount = 0;
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    freePageCount = [MSACDBStorage getFreePageCountInOpenedDatabase:db];
+    return SQLITE_OK;
+  }];
+  return freePageCount;
 }
 @end
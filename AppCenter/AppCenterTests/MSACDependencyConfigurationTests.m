@@ -20,7 +20,11 @@
   [MSACAppCenter resetSharedInstance];
   self.channelGroupDefaultClassMock = OCMClassMock([MSACChannelGroupDefault class]);
   OCMStub([self.channelGroupDefaultClassMock alloc]).andReturn(self.channelGroupDefaultClassMock);
-  OCMStub([self.channelGroupDefaultClassMock initWithHttpClient:OCMOCK_ANY installId:OCMOCK_ANY logUrl:OCMOCK_ANY]).andReturn(nil);
+  OCMStub([self.channelGroupDefaultClassMock initWithHttpClient:OCMOCK_ANY
+                                                      installId:OCMOCK_ANY
+                                                         logUrl:OCMOCK_ANY
+                                                 storageBackend:MSACStorageBackendDatabase])
+      .andReturn(nil);
 }
 
 - (void)tearDown {
@@ -40,7 +44,10 @@
 
   // Then
   // Cast to void to get rid of warning that says "Expression result unused".
-  OCMVerify((void)[self.channelGroupDefaultClassMock initWithHttpClient:httpClientClassMock installId:OCMOCK_ANY logUrl:OCMOCK_ANY]);
+  OCMVerify((void)[self.channelGroupDefaultClassMock initWithHttpClient:httpClientClassMock
+                                                              installId:OCMOCK_ANY
+                                                                 logUrl:OCMOCK_ANY
+                                                         storageBackend:MSACStorageBackendDatabase]);
 
   // Cleanup
   [httpClientClassMock stopMocking];
@@ -62,7 +69,10 @@
 
   // Then
   // Cast to void to get rid of warning that says "Expression result unused".
-  OCMVerify((void)[self.channelGroupDefaultClassMock initWithHttpClient:httpClientClassMock installId:OCMOCK_ANY logUrl:OCMOCK_ANY]);
+  OCMVerify((void)[self.channelGroupDefaultClassMock initWithHttpClient:httpClientClassMock
+                                                              installId:OCMOCK_ANY
+                                                                 logUrl:OCMOCK_ANY
+                                                         storageBackend:MSACStorageBackendDatabase]);
 
   // Cleanup
   MSACDependencyConfiguration.httpClient = nil;
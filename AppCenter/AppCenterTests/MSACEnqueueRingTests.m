@@ -0,0 +1,241 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACEnqueueRing.h"
+#import "MSACMockLog.h"
+#import "MSACTestFrameworks.h"
+
+static NSTimeInterval const kMSACTestTimeout = 5.0;
+static NSUInteger const kMSACTestProducersCount = 8;
+static NSUInteger const kMSACTestLogsPerProducer = 5000;
+
+@interface MSACEnqueueRingTests : XCTestCase
+
+@property(nonatomic) dispatch_queue_t queue;
+
+@property(nonatomic) NSMutableArray<NSString *> *takenInternalIds;
+
+@property(nonatomic) NSMutableArray<NSNumber *> *takenFlags;
+
+@property(nonatomic) NSUInteger takenLogsCount;
+
+@end
+
+@implementation MSACEnqueueRingTests
+
+#pragma mark - Housekeeping
+
+- (void)setUp {
+  [super setUp];
+  self.queue = dispatch_queue_create("MSACEnqueueRingTests", DISPATCH_QUEUE_SERIAL);
+  self.takenInternalIds = [NSMutableArray new];
+  self.takenFlags = [NSMutableArray new];
+}
+
+#pragma mark - Tests
+
+- (void)testCapacityIsRoundedUpToPowerOfTwo {
+
+  // When
+  MSACEnqueueRing *ring1 = [self createRingWithCapacity:0];
+  MSACEnqueueRing *ring2 = [self createRingWithCapacity:5];
+  MSACEnqueueRing *ring3 = [self createRingWithCapacity:1024];
+
+  // Then
+  XCTAssertEqual(ring1.capacity, 2);
+  XCTAssertEqual(ring2.capacity, 8);
+  XCTAssertEqual(ring3.capacity, 1024);
+  XCTAssertEqual(ring1.backpressurePolicy, MSACBackpressurePolicyDropNewest);
+}
+
+- (void)testBurstIsTakenOutInSingleDrain {
+
+  // If
+  MSACEnqueueRing *sut = [self createRingWithCapacity:16];
+  dispatch_suspend(self.queue);
+
+  // When
+  for (NSUInteger i = 0; i < 10; i++) {
+    XCTAssertTrue([sut pushLog:[MSACMockLog new] internalId:[@(i) stringValue] flags:MSACFlagsNormal target:self]);
+  }
+  dispatch_resume(self.queue);
+  [self waitForTakenLogsCount:10];
+
+  // Then
+  NSArray *expectedInternalIds = @[ @"0", @"1", @"2", @"3", @"4", @"5", @"6", @"7", @"8", @"9" ];
+  XCTAssertEqualObjects(self.takenInternalIds, expectedInternalIds);
+  XCTAssertEqual(sut.drainsCount, 1);
+}
+
+- (void)testDropNewestWhenFull {
+
+  // If
+  MSACEnqueueRing *sut = [self createRingWithCapacity:4];
+  sut.backpressurePolicy = MSACBackpressurePolicyDropNewest;
+  dispatch_suspend(self.queue);
+  for (NSUInteger i = 0; i < 4; i++) {
+    XCTAssertTrue([sut pushLog:[MSACMockLog new] internalId:[@(i) stringValue] flags:MSACFlagsNormal target:self]);
+  }
+
+  // When
+  BOOL pushed = [sut pushLog:[MSACMockLog new] internalId:@"4" flags:MSACFlagsCritical target:self];
+  dispatch_resume(self.queue);
+  [self waitForTakenLogsCount:4];
+
+  // Then
+  XCTAssertFalse(pushed);
+  XCTAssertEqual(sut.droppedLogsCount, 1);
+  XCTAssertEqualObjects(self.takenInternalIds, (@[ @"0", @"1", @"2", @"3" ]));
+}
+
+- (void)testDropNewestUnlessCriticalKeepsCriticalLogs {
+
+  // If
+  MSACEnqueueRing *sut = [self createRingWithCapacity:4];
+  sut.backpressurePolicy = MSACBackpressurePolicyDropNewestUnlessCritical;
+  dispatch_suspend(self.queue);
+  for (NSUInteger i = 0; i < 4; i++) {
+    XCTAssertTrue([sut pushLog:[MSACMockLog new] internalId:[@(i) stringValue] flags:MSACFlagsNormal target:self]);
+  }
+  XCTestExpectation *expectation = [self expectationWithDescription:@"Critical log pushed"];
+
+  // When
+  BOOL normalPushed = [sut pushLog:[MSACMockLog new] internalId:@"normal" flags:MSACFlagsNormal target:self];
+  dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+
+    // The thread waits for room.
+    XCTAssertTrue([sut pushLog:[MSACMockLog new] internalId:@"critical" flags:MSACFlagsCritical target:self]);
+    [expectation fulfill];
+  });
+  dispatch_resume(self.queue);
+
+  // Then
+  [self waitForExpectationsWithTimeout:kMSACTestTimeout
+                               handler:^(NSError *error) {
+                                 [self waitForTakenLogsCount:5];
+                                 XCTAssertFalse(normalPushed);
+                                 XCTAssertEqual(sut.droppedLogsCount, 1);
+                                 XCTAssertEqualObjects(self.takenInternalIds, (@[ @"0", @"1", @"2", @"3", @"critical" ]));
+                                 XCTAssertEqualObjects(self.takenFlags.lastObject, @(MSACFlagsCritical));
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+}
+
+- (void)testPushOnQueueWhenFullTakesLogsOutRightAway {
+
+  // If
+  MSACEnqueueRing *sut = [self createRingWithCapacity:2];
+  __block BOOL pushed = NO;
+  __block NSUInteger takenCountBeforeLastPush = 0;
+
+  // When
+  dispatch_sync(self.queue, ^{
+    [sut pushLog:[MSACMockLog new] internalId:@"0" flags:MSACFlagsNormal target:self];
+    [sut pushLog:[MSACMockLog new] internalId:@"1" flags:MSACFlagsNormal target:self];
+    takenCountBeforeLastPush = self.takenInternalIds.count;
+
+    // The queue can't wait for itself.
+    pushed = [sut pushLog:[MSACMockLog new] internalId:@"2" flags:MSACFlagsNormal target:self];
+  });
+  [self waitForTakenLogsCount:3];
+
+  // Then
+  XCTAssertTrue(pushed);
+  XCTAssertEqual(takenCountBeforeLastPush, 0);
+  XCTAssertEqualObjects(self.takenInternalIds, (@[ @"0", @"1", @"2" ]));
+  XCTAssertEqual(sut.droppedLogsCount, 0);
+}
+
+- (void)testConcurrentProducersKeepTheirOrder {
+
+  // If
+  NSMutableArray<NSMutableArray *> *takenInternalIds = [NSMutableArray new];
+  for (NSUInteger i = 0; i < kMSACTestProducersCount; i++) {
+    [takenInternalIds addObject:[NSMutableArray new]];
+  }
+  NSMutableArray<NSArray *> *pushedInternalIds = [NSMutableArray new];
+  for (NSUInteger i = 0; i < kMSACTestProducersCount; i++) {
+    NSMutableArray *internalIds = [NSMutableArray new];
+    for (NSUInteger j = 0; j < kMSACTestLogsPerProducer; j++) {
+      [internalIds addObject:[NSString stringWithFormat:@"%tu-%tu", i, j]];
+    }
+    [pushedInternalIds addObject:internalIds];
+  }
+  MSACMockLog *log = [MSACMockLog new];
+  MSACEnqueueRing *sut = [[MSACEnqueueRing alloc] initWithCapacity:64
+                                                              queue:self.queue
+                                                            handler:^(__unused id<MSACLog> takenLog, NSString *internalId,
+                                                                      __unused MSACFlags flags, id target) {
+                                                              [takenInternalIds[[(NSNumber *)target unsignedIntegerValue]]
+                                                                  addObject:internalId];
+                                                              self.takenLogsCount++;
+                                                            }];
+
+  // When
+  CFAbsoluteTime ringStart = CFAbsoluteTimeGetCurrent();
+  dispatch_apply(kMSACTestProducersCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t producer) {
+    for (NSString *internalId in pushedInternalIds[producer]) {
+      [sut pushLog:log internalId:internalId flags:MSACFlagsNormal target:@(producer)];
+    }
+  });
+  [self waitForTakenLogsCount:kMSACTestProducersCount * kMSACTestLogsPerProducer];
+  CFAbsoluteTime ringDuration = CFAbsoluteTimeGetCurrent() - ringStart;
+
+  // Then
+  XCTAssertEqualObjects(takenInternalIds, pushedInternalIds);
+  XCTAssertEqual(sut.droppedLogsCount, 0);
+  XCTAssertLessThan(sut.drainsCount, kMSACTestProducersCount * kMSACTestLogsPerProducer);
+
+  // When
+  __block NSUInteger baselineCount = 0;
+  __block NSUInteger finalBaselineCount = 0;
+  CFAbsoluteTime baselineStart = CFAbsoluteTimeGetCurrent();
+  dispatch_apply(kMSACTestProducersCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t producer) {
+    for (NSString *internalId in pushedInternalIds[producer]) {
+      dispatch_async(self.queue, ^{
+        (void)internalId;
+        baselineCount++;
+      });
+    }
+  });
+  dispatch_sync(self.queue, ^{
+    finalBaselineCount = baselineCount;
+  });
+  CFAbsoluteTime baselineDuration = CFAbsoluteTimeGetCurrent() - baselineStart;
+
+  // Then
+  XCTAssertEqual(finalBaselineCount, kMSACTestProducersCount * kMSACTestLogsPerProducer);
+  NSLog(@"Enqueued %tu logs from %tu threads: ring %.1f ms in %tu drains, a block per log %.1f ms.",
+        kMSACTestProducersCount * kMSACTestLogsPerProducer, kMSACTestProducersCount, ringDuration * 1000, sut.drainsCount,
+        baselineDuration * 1000);
+}
+
+#pragma mark - Private
+
+- (MSACEnqueueRing *)createRingWithCapacity:(NSUInteger)capacity {
+  __weak typeof(self) weakSelf = self;
+  return [[MSACEnqueueRing alloc] initWithCapacity:capacity
+                                             queue:self.queue
+                                           handler:^(__unused id<MSACLog> log, NSString *internalId, MSACFlags flags,
+                                                     __unused id target) {
+                                             typeof(self) strongSelf = weakSelf;
+                                             [strongSelf.takenInternalIds addObject:internalId];
+                                             [strongSelf.takenFlags addObject:@(flags)];
+                                             strongSelf.takenLogsCount++;
+                                           }];
+}
+
+- (void)waitForTakenLogsCount:(NSUInteger)count {
+
+  // Drains taking a full lap schedule the next one, wait until all the logs have been taken out.
+  __block BOOL waiting = YES;
+  while (waiting) {
+    dispatch_sync(self.queue, ^{
+      waiting = self.takenLogsCount < count;
+    });
+  }
+}
+
+@end
@@ -0,0 +1,307 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACFlushScheduler.h"
+#import "MSACTestFrameworks.h"
+
+static const NSUInteger kMSACTestBatchSizeLimit = 50;
+
+/**
+ * Number of logs sent by each request of a simulation, with the simulated time they are sent at and whether they have been sent.
+ */
+static const NSUInteger kMSACTraceTimeIndex = 0;
+static const NSUInteger kMSACTraceBatchSizeIndex = 1;
+static const NSUInteger kMSACTraceSucceededIndex = 2;
+
+@interface MSACFlushSchedulerTests : XCTestCase
+
+@property(nonatomic) MSACFlushScheduler *sut;
+
+@end
+
+@implementation MSACFlushSchedulerTests
+
+#pragma mark - Setup
+
+- (void)setUp {
+  [super setUp];
+  self.sut = [MSACFlushScheduler new];
+}
+
+#pragma mark - Tests
+
+- (void)testDefaultDecisionsOnUnknownNetwork {
+
+  // Then
+  XCTAssertEqual([self.sut linkQuality], 1);
+  XCTAssertFalse([self.sut isCoalescing]);
+  XCTAssertEqual([self.sut flushIntervalWithBacklog:1 batchSizeLimit:kMSACTestBatchSizeLimit], 3);
+  XCTAssertEqual([self.sut flushThresholdWithBatchSizeLimit:kMSACTestBatchSizeLimit], kMSACTestBatchSizeLimit);
+  XCTAssertEqual([self.sut batchSizeLimitWithBacklog:1 batchSizeLimit:kMSACTestBatchSizeLimit], kMSACTestBatchSizeLimit);
+}
+
+- (void)testLinkQualityDecreasesWithNetworkAndLatency {
+
+  // When
+  self.sut.networkStatus = ReachableViaWWAN;
+
+  // Then
+  XCTAssertEqualWithAccuracy([self.sut linkQuality], 0.7, 0.001);
+
+  // When
+  [self.sut recordRequestWithDuration:10 succeeded:YES];
+
+  // Then
+  XCTAssertEqualWithAccuracy([self.sut linkQuality], 0.07, 0.001);
+  XCTAssertTrue([self.sut isCoalescing]);
+
+  // When
+  self.sut.networkStatus = NotReachable;
+
+  // Then
+  XCTAssertEqual([self.sut linkQuality], 0);
+  XCTAssertEqual([self.sut flushIntervalWithBacklog:1 batchSizeLimit:kMSACTestBatchSizeLimit], self.sut.maxFlushInterval);
+}
+
+- (void)testFailuresShrinkBatches {
+
+  // When
+  [self.sut recordRequestWithDuration:0.5 succeeded:NO];
+  [self.sut recordRequestWithDuration:0.5 succeeded:NO];
+
+  // Then
+  XCTAssertLessThan(self.sut.successRate, 0.5);
+  XCTAssertEqual([self.sut batchSizeLimitWithBacklog:1000 batchSizeLimit:kMSACTestBatchSizeLimit], kMSACTestBatchSizeLimit / 2);
+
+  // When
+  for (int i = 0; i < 5; i++) {
+    [self.sut recordRequestWithDuration:0.5 succeeded:YES];
+  }
+
+  // Then
+  XCTAssertGreaterThan(self.sut.successRate, 0.5);
+  XCTAssertEqual([self.sut batchSizeLimitWithBacklog:1000 batchSizeLimit:kMSACTestBatchSizeLimit], self.sut.maxBatchSizeLimit);
+}
+
+- (void)testDecisionsStayWithinBounds {
+
+  // If
+  [self.sut recordRequestWithDuration:30 succeeded:YES];
+
+  // When
+  XCTAssertTrue([self.sut setFlushIntervalBoundsWithMinimum:5 maximum:20]);
+  XCTAssertTrue([self.sut setBatchSizeBoundsWithMinimum:60 maximum:80]);
+
+  // Then
+  XCTAssertEqual([self.sut flushIntervalWithBacklog:1 batchSizeLimit:kMSACTestBatchSizeLimit], 20);
+  XCTAssertEqual([self.sut batchSizeLimitWithBacklog:1 batchSizeLimit:kMSACTestBatchSizeLimit], 60);
+  XCTAssertEqual([self.sut batchSizeLimitWithBacklog:1000 batchSizeLimit:kMSACTestBatchSizeLimit], 80);
+  XCTAssertEqual([self.sut flushThresholdWithBatchSizeLimit:kMSACTestBatchSizeLimit], 80);
+}
+
+- (void)testInvalidBoundsAreIgnored {
+
+  // When
+  XCTAssertFalse([self.sut setFlushIntervalBoundsWithMinimum:20 maximum:5]);
+  XCTAssertFalse([self.sut setBatchSizeBoundsWithMinimum:0 maximum:80]);
+  XCTAssertFalse([self.sut setBatchSizeBoundsWithMinimum:80 maximum:60]);
+
+  // Then
+  XCTAssertEqual(self.sut.minFlushInterval, 1);
+  XCTAssertEqual(self.sut.maxFlushInterval, 60);
+  XCTAssertEqual(self.sut.minBatchSizeLimit, 10);
+  XCTAssertEqual(self.sut.maxBatchSizeLimit, 200);
+}
+
+#pragma mark - Simulations
+
+- (void)testGoodNetworkDrainsBacklogRightAway {
+
+  // When
+  NSUInteger remainingBacklog;
+  NSArray<NSArray<NSNumber *> *> *trace = [self simulateWithDuration:60
+                                                      initialBacklog:1000
+                                                       arrivalPeriod:0
+                                                     requestDuration:0.3
+                                                        failureEvery:0
+                                                    remainingBacklog:&remainingBacklog];
+
+  // Then
+  XCTAssertEqual(remainingBacklog, 0);
+  XCTAssertEqual(trace.count, 5);
+  for (NSArray<NSNumber *> *request in trace) {
+    XCTAssertEqual(request[kMSACTraceTimeIndex].unsignedIntegerValue, 0);
+    XCTAssertEqual(request[kMSACTraceBatchSizeIndex].unsignedIntegerValue, self.sut.maxBatchSizeLimit);
+  }
+}
+
+- (void)testPoorNetworkGroupsLogsInFewerRequests {
+
+  // If
+  NSArray<NSArray<NSNumber *> *> *goodNetworkTrace = [self simulateWithDuration:600
+                                                                 initialBacklog:0
+                                                                  arrivalPeriod:1
+                                                                requestDuration:0.3
+                                                                   failureEvery:0
+                                                               remainingBacklog:nil];
+  self.sut = [MSACFlushScheduler new];
+  self.sut.networkStatus = ReachableViaWWAN;
+
+  // When
+  NSArray<NSArray<NSNumber *> *> *poorNetworkTrace = [self simulateWithDuration:600
+                                                                 initialBacklog:0
+                                                                  arrivalPeriod:1
+                                                                requestDuration:8
+                                                                   failureEvery:0
+                                                               remainingBacklog:nil];
+
+  // Then
+  XCTAssertTrue([self.sut isCoalescing]);
+  XCTAssertEqual(goodNetworkTrace.count, 199);
+  XCTAssertEqual(poorNetworkTrace.count, 10);
+
+  // Once the network is known to be poor, the logs of the maximum delay are sent together.
+  for (NSUInteger i = 1; i < poorNetworkTrace.count; i++) {
+    XCTAssertEqual(poorNetworkTrace[i][kMSACTraceTimeIndex].unsignedIntegerValue -
+                       poorNetworkTrace[i - 1][kMSACTraceTimeIndex].unsignedIntegerValue,
+                   self.sut.maxFlushInterval);
+    XCTAssertEqual(poorNetworkTrace[i][kMSACTraceBatchSizeIndex].unsignedIntegerValue, 60);
+  }
+}
+
+- (void)testPoorNetworkSendsBacklogWithBiggestBatches {
+
+  // If
+  self.sut.networkStatus = ReachableViaWWAN;
+
+  // When
+  NSUInteger remainingBacklog;
+  NSArray<NSArray<NSNumber *> *> *trace = [self simulateWithDuration:60
+                                                      initialBacklog:1000
+                                                       arrivalPeriod:0
+                                                     requestDuration:8
+                                                        failureEvery:0
+                                                    remainingBacklog:&remainingBacklog];
+
+  // Then
+  XCTAssertEqual(remainingBacklog, 0);
+  XCTAssertEqual(trace.count, 6);
+
+  // The first request tells the network is poor.
+  XCTAssertEqual(trace[0][kMSACTraceBatchSizeIndex].unsignedIntegerValue, kMSACTestBatchSizeLimit);
+  for (NSUInteger i = 1; i < 5; i++) {
+    XCTAssertEqual(trace[i][kMSACTraceBatchSizeIndex].unsignedIntegerValue, self.sut.maxBatchSizeLimit);
+  }
+}
+
+- (void)testUnreliableNetworkSendsSmallerBatches {
+
+  // When
+  NSArray<NSArray<NSNumber *> *> *trace = [self simulateWithDuration:600
+                                                      initialBacklog:0
+                                                       arrivalPeriod:1
+                                                     requestDuration:0.3
+                                                        failureEvery:2
+                                                    remainingBacklog:nil];
+
+  // Then
+  NSUInteger failuresCount = 0;
+  for (NSArray<NSNumber *> *request in trace) {
+    failuresCount += request[kMSACTraceSucceededIndex].boolValue ? 0 : 1;
+  }
+  XCTAssertEqual(failuresCount, trace.count / 2);
+  XCTAssertLessThan(self.sut.successRate, 0.5);
+  XCTAssertEqual([self.sut batchSizeLimitWithBacklog:1000 batchSizeLimit:kMSACTestBatchSizeLimit], kMSACTestBatchSizeLimit / 2);
+}
+
+- (void)testSimulationIsDeterministic {
+
+  // When
+  NSArray<NSArray<NSNumber *> *> *trace = [self simulateWithDuration:600
+                                                      initialBacklog:300
+                                                       arrivalPeriod:2
+                                                     requestDuration:4
+                                                        failureEvery:3
+                                                    remainingBacklog:nil];
+  self.sut = [MSACFlushScheduler new];
+  NSArray<NSArray<NSNumber *> *> *otherTrace = [self simulateWithDuration:600
+                                                           initialBacklog:300
+                                                            arrivalPeriod:2
+                                                          requestDuration:4
+                                                             failureEvery:3
+                                                         remainingBacklog:nil];
+
+  // Then
+  XCTAssertEqual(trace.count, 42);
+  XCTAssertEqualObjects(trace, otherTrace);
+}
+
+#pragma mark - Helper
+
+/**
+ * Simulate a channel with the default flush interval on a network of constant latency, one second at a time.
+ *
+ * @param duration Simulated time in seconds.
+ * @param initialBacklog Number of logs waiting to be sent when the simulation starts.
+ * @param arrivalPeriod Time, in seconds, between two new logs, 0 for no new logs.
+ * @param requestDuration Duration of each request in seconds.
+ * @param failureEvery Period, in requests, of the failed requests, 0 for no failures.
+ * @param remainingBacklog Number of logs not sent when the simulation ends.
+ *
+ * @return The trace of the requests.
+ */
+- (NSArray<NSArray<NSNumber *> *> *)simulateWithDuration:(NSUInteger)duration
+                                          initialBacklog:(NSUInteger)initialBacklog
+                                           arrivalPeriod:(NSUInteger)arrivalPeriod
+                                         requestDuration:(NSTimeInterval)requestDuration
+                                            failureEvery:(NSUInteger)failureEvery
+                                        remainingBacklog:(NSUInteger *)remainingBacklog {
+  NSMutableArray<NSArray<NSNumber *> *> *trace = [NSMutableArray new];
+  __block NSUInteger backlog = 0;
+  __block NSUInteger itemsCount = 0;
+  __block NSUInteger timerFireTime = NSNotFound;
+
+  // Same as the channel flushing its queue: batches are sent until one fails or the backlog is empty.
+  void (^flush)(NSUInteger) = ^(NSUInteger time) {
+    itemsCount = 0;
+    timerFireTime = NSNotFound;
+    while (backlog > 0) {
+      NSUInteger batchSize = MIN([self.sut batchSizeLimitWithBacklog:backlog batchSizeLimit:kMSACTestBatchSizeLimit], backlog);
+      BOOL succeeded = failureEvery == 0 || (trace.count + 1) % failureEvery != 0;
+      [self.sut recordRequestWithDuration:requestDuration succeeded:succeeded];
+      [trace addObject:@[ @(time), @(batchSize), @(succeeded) ]];
+      if (!succeeded) {
+        break;
+      }
+      backlog -= batchSize;
+    }
+  };
+  for (NSUInteger time = 0; time < duration; time++) {
+    if (timerFireTime == time) {
+      flush(time);
+    }
+    NSUInteger newLogsCount = time == 0 ? initialBacklog : 0;
+    if (arrivalPeriod > 0 && time % arrivalPeriod == 0) {
+      newLogsCount += 1;
+    }
+    if (newLogsCount == 0) {
+      continue;
+    }
+
+    // Same as the channel checking its pending logs.
+    backlog += newLogsCount;
+    itemsCount += newLogsCount;
+    if (itemsCount >= [self.sut flushThresholdWithBatchSizeLimit:kMSACTestBatchSizeLimit]) {
+      flush(time);
+    } else {
+      NSUInteger flushInterval = [self.sut flushIntervalWithBacklog:backlog batchSizeLimit:kMSACTestBatchSizeLimit];
+      timerFireTime = MIN(timerFireTime, time + flushInterval);
+    }
+  }
+  if (remainingBacklog) {
+    *remainingBacklog = backlog;
+  }
+  return trace;
+}
+
+@end
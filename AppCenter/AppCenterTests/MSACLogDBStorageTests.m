@@ -4,7 +4,11 @@
 #import <sqlite3.h>
 
 #import "MSACAbstractLogInternal.h"
+#import "MSACBinaryUnarchiver.h"
 #import "MSACDBStoragePrivate.h"
+#import "MSACDeviceInternal.h"
+#import "MSACLogCompressionDictionary.h"
+#import "MSACLogContainer.h"
 #import "MSACLogDBStoragePrivate.h"
 #import "MSACLogDBStorageVersion.h"
 #import "MSACLogWithProperties.h"
@@ -24,10 +28,17 @@ static const long kMSACTestStorageSizeMinimumUpperLimitInBytes = 40 * 1024;
 static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
                                            @"\"id\" INTEGER PRIMARY KEY AUTOINCREMENT, "
                                            @"\"groupId\" TEXT NOT NULL, "
-                                           @"\"log\" TEXT NOT NULL, "
+                                           @"\"log\" BLOB NOT NULL, "
                                            @"\"targetToken\" TEXT, "
                                            @"\"targetKey\" TEXT, "
-                                           @"\"priority\" INTEGER)";
+                                           @"\"priority\" INTEGER, "
+                                           @"\"batchId\" TEXT, "
+                                           @"\"size\" INTEGER, "
+                                           @"\"timestamp\" INTEGER, "
+                                           @"\"deviceId\" INTEGER, "
+                                           @"\"targetTokenId\" INTEGER, "
+                                           @"\"dictionaryVersion\" INTEGER, "
+                                           @"\"payloadSize\" INTEGER)";
 
 @interface MSACLogDBStorageTests : XCTestCase
 
@@ -382,13 +393,156 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   assertThat(expectedLogs, is(logs));
 }
 
+- (void)testLoadLogsWithBatchSizeInBytesLimitBoundsBatches {
+
+  // If
+  self.sut.compressionEnabled = NO;
+  [self.sut saveLog:[self generateLogWithSize:@(1000)] withGroupId:kMSACAnotherTestGroupId flags:MSACFlagsNormal];
+  long long sizeInBytesLimit = [self.sut sizeOfLogsWithGroupId:kMSACAnotherTestGroupId] * 6;
+  [self.sut setBatchSizeInBytesLimit:(NSUInteger)sizeInBytesLimit forGroupId:kMSACTestGroupId];
+
+  // Mix of small, medium, oversized and critical logs.
+  NSArray<NSNumber *> *payloadSizes = @[ @10, @1000, @200, @5000, @1000, @50, @1000, @1000, @8000, @10 ];
+  for (NSUInteger i = 0; i < 30; i++) {
+    [self.sut saveLog:[self generateLogWithSize:payloadSizes[i % payloadSizes.count]]
+          withGroupId:kMSACTestGroupId
+                flags:i % 7 == 0 ? MSACFlagsCritical : MSACFlagsNormal];
+  }
+
+  // When
+  NSUInteger loadedLogsCount = 0;
+  NSUInteger oversizedBatchesCount = 0;
+  for (;;) {
+    __block NSArray<id<MSACLog>> *logs;
+    __block NSString *loadedBatchId;
+    [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                            limit:50
+               excludedTargetKeys:nil
+                completionHandler:^(NSArray<id<MSACLog>> *_Nonnull logArray, NSString *batchId) {
+                  logs = logArray;
+                  loadedBatchId = batchId;
+                }];
+    if (!loadedBatchId) {
+      break;
+    }
+
+    // Then
+    // Batches stay within the limit, unless they hold a single log bigger than that.
+    NSString *sizeQuery =
+        [NSString stringWithFormat:@"SELECT SUM(\"%@\") FROM \"%@\" WHERE \"%@\" = ?", kMSACPayloadSizeColumnName, kMSACLogTableName,
+                                   kMSACBatchIdColumnName];
+    MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+    [values addString:(NSString *)loadedBatchId];
+    long long batchSize = [[self.sut executeSelectionQuery:sizeQuery withValues:values][0][0] longLongValue];
+    if (batchSize > sizeInBytesLimit) {
+      assertThatUnsignedInteger(logs.count, equalToUnsignedInteger(1));
+      oversizedBatchesCount++;
+    }
+    loadedLogsCount += logs.count;
+  }
+  assertThatUnsignedInteger(loadedLogsCount, equalToUnsignedInteger(30));
+  assertThatUnsignedInteger(oversizedBatchesCount, equalToUnsignedInteger(3));
+}
+
+- (void)testBatchesOfCompressedLogsStayWithinBatchSizeInBytesLimitOnceSerialized {
+
+  // If
+  NSUInteger sizeInBytesLimit = 16 * 1024;
+  [self.sut setBatchSizeInBytesLimit:sizeInBytesLimit forGroupId:kMSACTestGroupId];
+
+  // Mix of small and big logs, compressing well, some of them with a device.
+  NSArray<NSNumber *> *payloadSizes = @[ @10, @500, @2000, @100, @4000, @50 ];
+  for (NSUInteger i = 0; i < 60; i++) {
+    MSACLogWithProperties *log = (MSACLogWithProperties *)[self generateLogWithSize:payloadSizes[i % payloadSizes.count]];
+    if (i % 3 == 0) {
+      log.device = [self generateDeviceWithModel:@"iPhone"];
+    }
+    [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  }
+
+  // Stored sizes alone would fit all the logs in a single batch.
+  XCTAssertLessThan([self.sut sizeOfLogsWithGroupId:kMSACTestGroupId], (long long)sizeInBytesLimit);
+
+  // When
+  NSUInteger loadedLogsCount = 0;
+  NSUInteger batchesCount = 0;
+  for (;;) {
+    __block NSArray<id<MSACLog>> *logs;
+    __block NSString *loadedBatchId;
+    [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                            limit:100
+               excludedTargetKeys:nil
+                completionHandler:^(NSArray<id<MSACLog>> *_Nonnull logArray, NSString *batchId) {
+                  logs = logArray;
+                  loadedBatchId = batchId;
+                }];
+    if (!loadedBatchId) {
+      break;
+    }
+
+    // Then
+    // The request body stays in the order of the limit, only the JSON encoding adds to the size of the logs.
+    NSString *requestBody = [[[MSACLogContainer alloc] initWithBatchId:(NSString *)loadedBatchId andLogs:logs] serializeLog];
+    NSUInteger requestSize = [requestBody lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    XCTAssertLessThan(requestSize, sizeInBytesLimit * 2);
+    loadedLogsCount += logs.count;
+    batchesCount++;
+  }
+  assertThatUnsignedInteger(loadedLogsCount, equalToUnsignedInteger(60));
+  XCTAssertGreaterThan(batchesCount, 2);
+}
+
+- (void)testSizeOfUnbatchedLogsExcludesLogsOfPendingBatches {
+
+  // If
+  id<MSACLog> log = [self generateLogWithSize:@(1024)];
+  NSUInteger payloadSize = [MSACLogDBStorage archiveLog:log].length;
+  [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self.sut saveLog:[self generateLogWithSize:@(1024)] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  long long unbatchedSize = [self.sut sizeOfUnbatchedLogsWithGroupId:kMSACTestGroupId];
+
+  // Then
+  // Logs are sized before compression.
+  XCTAssertGreaterThan(unbatchedSize, [self.sut sizeOfLogsWithGroupId:kMSACTestGroupId]);
+
+  // When
+  __block NSString *batchId;
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                          limit:1
+             excludedTargetKeys:nil
+              completionHandler:^(__unused NSArray<id<MSACLog>> *logArray, NSString *loadedBatchId) {
+                batchId = loadedBatchId;
+              }];
+
+  // Then
+  assertThatLongLong([self.sut sizeOfUnbatchedLogsWithGroupId:kMSACTestGroupId], equalToLongLong(unbatchedSize - (long long)payloadSize));
+
+  // When
+  [self.sut releaseLogsWithBatchId:batchId groupId:kMSACTestGroupId];
+
+  // Then
+  assertThatLongLong([self.sut sizeOfUnbatchedLogsWithGroupId:kMSACTestGroupId], equalToLongLong(unbatchedSize));
+
+  // When
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                          limit:1
+             excludedTargetKeys:nil
+              completionHandler:^(__unused NSArray<id<MSACLog>> *logArray, NSString *loadedBatchId) {
+                batchId = loadedBatchId;
+              }];
+  [self.sut deleteLogsWithBatchId:batchId groupId:kMSACTestGroupId];
+  self.sut = [MSACLogDBStorage new];
+
+  // Then
+  assertThatLongLong([self.sut sizeOfUnbatchedLogsWithGroupId:kMSACTestGroupId], equalToLongLong(unbatchedSize - (long long)payloadSize));
+}
+
 - (void)testDeleteLogsWithGroupId {
 
   // Test deletion with no batch.
 
   // If
   self.sut = [MSACLogDBStorage new];
-  //  [self.sut.batches removeAllObjects];
   [self generateAndSaveLogsWithCount:5 groupId:kMSACTestGroupId flags:MSACFlagsDefault andVerifyLogGeneration:YES];
 
   // When
@@ -396,7 +550,7 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
 
   // Then
   assertThatInteger([self.sut countEntriesForTable:kMSACLogTableName condition:nil withValues:nil], equalToInteger(0));
-  assertThatInteger(self.sut.batches.count, equalToInteger(0));
+  assertThatInteger([self batchIds].count, equalToInteger(0));
 
   // Test deletion with only the batch to delete.
 
@@ -410,7 +564,7 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
 
   // Then
   assertThatInteger([self.sut countEntriesForTable:kMSACLogTableName condition:nil withValues:nil], equalToInteger(0));
-  assertThatInteger(self.sut.batches.count, equalToInteger(0));
+  assertThatInteger([self batchIds].count, equalToInteger(0));
 
   // Test deletion with more than one batch to delete.
 
@@ -425,7 +579,7 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
 
   // Then
   assertThatInteger([self.sut countEntriesForTable:kMSACLogTableName condition:nil withValues:nil], equalToInteger(0));
-  assertThatInteger(self.sut.batches.count, equalToInteger(0));
+  assertThatInteger([self batchIds].count, equalToInteger(0));
 
   // Test deletion with the batch to delete and batches from other groups.
 
@@ -451,8 +605,8 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   // Then
   NSArray *remainingLogs = [self loadLogsWhere:nil withValues:nil];
   assertThat(remainingLogs, is(expectedLogs));
-  assertThatInteger(self.sut.batches.count, equalToInteger(1));
-  assertThatBool([self.sut.batches.allKeys containsObject:batchIdToDelete], isFalse());
+  assertThatInteger([self batchIds].count, equalToInteger(1));
+  assertThatBool([[self batchIds] containsObject:batchIdToDelete], isFalse());
 }
 
 - (void)testDeleteLogsByBatchIdWithOnlyOnePendingBatch {
@@ -462,7 +616,6 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   __block NSArray *expectedLogs;
   NSString *condition;
   NSArray *remainingLogs;
-  [self.sut.batches removeAllObjects];
   NSArray *savedLogs = [self generateAndSaveLogsWithCount:5 groupId:kMSACTestGroupId flags:MSACFlagsDefault andVerifyLogGeneration:YES];
   [self.sut loadLogsWithGroupId:kMSACTestGroupId
                           limit:2
@@ -472,7 +625,7 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
                 NSPredicate *predicate = [NSPredicate predicateWithFormat:@"NOT (self IN %@)", logArray];
                 expectedLogs = [savedLogs filteredArrayUsingPredicate:predicate];
               }];
-  NSArray *logIdsToDelete = self.sut.batches[batchIdToDelete];
+  NSArray *logIdsToDelete = [self dbIdsForBatchId:batchIdToDelete];
   MSACStorageBindableArray *array = [MSACStorageBindableArray new];
   for (NSNumber *item in logIdsToDelete) {
     [array addNumber:item];
@@ -487,7 +640,7 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   condition = [NSString stringWithFormat:@"%@ IN %@", kMSACIdColumnName, keyFormat];
   assertThatInteger([self.sut countEntriesForTable:kMSACLogTableName condition:condition withValues:array], equalToInteger(0));
   assertThat(expectedLogs, is(remainingLogs));
-  assertThatInteger(self.sut.batches.count, equalToInteger(0));
+  assertThatInteger([self batchIds].count, equalToInteger(0));
 }
 
 - (void)testDeleteLogsByBatchIdWithMultiplePendingBatches {
@@ -497,7 +650,6 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   __block NSArray *expectedLogs;
   NSString *condition;
   NSArray *remainingLogs;
-  [self.sut.batches removeAllObjects];
   NSArray *savedLogs = [self generateAndSaveLogsWithCount:5 groupId:kMSACTestGroupId flags:MSACFlagsDefault andVerifyLogGeneration:YES];
   [self.sut loadLogsWithGroupId:kMSACTestGroupId
                           limit:2
@@ -509,7 +661,7 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
                 NSPredicate *predicate = [NSPredicate predicateWithFormat:@"NOT (self IN %@)", logArray];
                 expectedLogs = [savedLogs filteredArrayUsingPredicate:predicate];
               }];
-  NSArray *logIdsToDelete = self.sut.batches[batchIdToDelete];
+  NSArray *logIdsToDelete = [self dbIdsForBatchId:batchIdToDelete];
   MSACStorageBindableArray *array = [MSACStorageBindableArray new];
   for (NSNumber *item in logIdsToDelete) {
     [array addNumber:item];
@@ -527,7 +679,7 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   condition = [NSString stringWithFormat:@"%@ IN %@", kMSACIdColumnName, keyFormat];
   assertThatInteger([self.sut countEntriesForTable:kMSACLogTableName condition:condition withValues:array], equalToInteger(0));
   assertThat(expectedLogs, is(remainingLogs));
-  assertThatInteger(self.sut.batches.count, equalToInteger(1));
+  assertThatInteger([self batchIds].count, equalToInteger(1));
 }
 
 - (void)testDeleteLogsByBatchIdWithPendingBatchesFromOtherGroups {
@@ -537,7 +689,6 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   __block NSMutableArray *expectedLogs;
   NSString *condition;
   NSArray *remainingLogs;
-  [self.sut.batches removeAllObjects];
   NSArray *savedLogs = [self generateAndSaveLogsWithCount:5 groupId:kMSACTestGroupId flags:MSACFlagsDefault andVerifyLogGeneration:YES];
   NSArray *savedLogsFromOtherGroup = [self generateAndSaveLogsWithCount:3
                                                                 groupId:kMSACAnotherTestGroupId
@@ -556,7 +707,7 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
                 // Remaining logs should contains logs for other groups.
                 [expectedLogs addObjectsFromArray:savedLogsFromOtherGroup];
               }];
-  NSArray *logIdsToDelete = self.sut.batches[batchIdToDelete];
+  NSArray *logIdsToDelete = [self dbIdsForBatchId:batchIdToDelete];
   MSACStorageBindableArray *array = [MSACStorageBindableArray new];
   for (NSNumber *item in logIdsToDelete) {
     [array addNumber:item];
@@ -573,7 +724,172 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   condition = [NSString stringWithFormat:@"%@ IN %@", kMSACIdColumnName, keyFormat];
   assertThatInteger([self.sut countEntriesForTable:kMSACLogTableName condition:condition withValues:array], equalToInteger(0));
   assertThat(expectedLogs, is(remainingLogs));
-  assertThatInteger(self.sut.batches.count, equalToInteger(1));
+  assertThatInteger([self batchIds].count, equalToInteger(1));
+}
+
+- (void)testReleaseLogsWithBatchId {
+
+  // If
+  NSArray *savedLogs = [self generateAndSaveLogsWithCount:5 groupId:kMSACTestGroupId flags:MSACFlagsDefault andVerifyLogGeneration:YES];
+  __block NSString *batchIdToRelease;
+  __block NSArray *releasedLogs;
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                          limit:2
+             excludedTargetKeys:nil
+              completionHandler:^(NSArray<MSACLog> *_Nonnull logArray, NSString *batchId) {
+                batchIdToRelease = batchId;
+                releasedLogs = logArray;
+              }];
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId limit:2 excludedTargetKeys:nil completionHandler:nil];
+
+  // When
+  [self.sut releaseLogsWithBatchId:batchIdToRelease groupId:kMSACTestGroupId];
+
+  // Then
+  assertThatInteger([self batchIds].count, equalToInteger(1));
+  assertThatUnsignedInteger([self.sut countLogs], equalToUnsignedInteger(savedLogs.count));
+  __block NSArray *reloadedLogs;
+  BOOL moreLogsAvailable = [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                                                   limit:10
+                                      excludedTargetKeys:nil
+                                       completionHandler:^(NSArray<MSACLog> *_Nonnull logArray, __unused NSString *batchId) {
+                                         reloadedLogs = logArray;
+                                       }];
+  XCTAssertFalse(moreLogsAvailable);
+  assertThatUnsignedInteger(reloadedLogs.count, equalToUnsignedInteger(3));
+  assertThat([reloadedLogs subarrayWithRange:NSMakeRange(0, 2)], is(releasedLogs));
+}
+
+- (void)testPendingBatchesAreReleasedAtStartup {
+
+  // If
+  NSArray *savedLogs = [self generateAndSaveLogsWithCount:5 groupId:kMSACTestGroupId flags:MSACFlagsDefault andVerifyLogGeneration:YES];
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId limit:2 excludedTargetKeys:nil completionHandler:nil];
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId limit:2 excludedTargetKeys:nil completionHandler:nil];
+  assertThatInteger([self batchIds].count, equalToInteger(2));
+
+  // When
+  self.sut = [MSACLogDBStorage new];
+
+  // Then
+  assertThatInteger([self batchIds].count, equalToInteger(0));
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                          limit:10
+             excludedTargetKeys:nil
+              completionHandler:^(NSArray<MSACLog> *_Nonnull logArray, __unused NSString *batchId) {
+                assertThat(logArray, is(savedLogs));
+              }];
+}
+
+- (void)testLoadLogsClaimsHighestPriorityLogsFirst {
+
+  // If
+  NSArray *normalLogs = [self generateAndSaveLogsWithCount:2 groupId:kMSACTestGroupId flags:MSACFlagsNormal andVerifyLogGeneration:YES];
+  NSArray *criticalLogs = [self generateAndSaveLogsWithCount:2
+                                                     groupId:kMSACTestGroupId
+                                                       flags:MSACFlagsCritical
+                                      andVerifyLogGeneration:YES];
+
+  // When
+  __block NSArray *loadedLogs;
+  __block NSString *loadedBatchId;
+  BOOL moreLogsAvailable = [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                                                   limit:3
+                                      excludedTargetKeys:nil
+                                       completionHandler:^(NSArray<MSACLog> *_Nonnull logArray, NSString *batchId) {
+                                         loadedLogs = logArray;
+                                         loadedBatchId = batchId;
+                                       }];
+
+  // Then
+  XCTAssertTrue(moreLogsAvailable);
+  NSArray *expectedLogs = [criticalLogs arrayByAddingObject:normalLogs[0]];
+  assertThat(loadedLogs, is(expectedLogs));
+  assertThatUnsignedInteger([self dbIdsForBatchId:loadedBatchId].count, equalToUnsignedInteger(3));
+}
+
+- (void)testLoadLogsOnReaderConnectionWhileSavingLogs {
+
+  // If
+  XCTestExpectation *expectation = [self expectationWithDescription:@"Logs loaded."];
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.LogDBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  dispatch_queue_t readerQueue = dispatch_queue_create("com.microsoft.appcenter.LogDBStorageTestsReaderQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableReaderConnectionWithReaderQueue:readerQueue queue:queue];
+  NSArray *expectedLogs = [self generateAndSaveLogsWithCount:3 groupId:kMSACTestGroupId flags:MSACFlagsDefault andVerifyLogGeneration:YES];
+  __block NSArray *loadedLogs;
+  __block NSString *loadedBatchId;
+  __block BOOL completedBeforeReturn = NO;
+  __block BOOL moreLogsAvailable = YES;
+
+  // When
+  dispatch_async(queue, ^{
+    __block BOOL returned = NO;
+    moreLogsAvailable = [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                                                limit:3
+                                   excludedTargetKeys:nil
+                                    completionHandler:^(NSArray<MSACLog> *_Nonnull logArray, NSString *batchId) {
+                                      completedBeforeReturn = !returned;
+                                      loadedLogs = logArray;
+                                      loadedBatchId = batchId;
+                                      [expectation fulfill];
+                                    }];
+    returned = YES;
+
+    // Logs keep being saved while the batch is loaded.
+    [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+  });
+
+  // Then
+  [self waitForExpectationsWithTimeout:1
+                               handler:^(NSError *error) {
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+  XCTAssertFalse(moreLogsAvailable);
+  XCTAssertFalse(completedBeforeReturn);
+  XCTAssertTrue(self.sut.readerConnection != NULL);
+  assertThat(loadedLogs, is(expectedLogs));
+  assertThatUnsignedInteger([self dbIdsForBatchId:loadedBatchId].count, equalToUnsignedInteger(3));
+  assertThatUnsignedInteger([self.sut countLogs], equalToUnsignedInteger(4));
+  assertThatUnsignedInteger(self.sut.loadingBatchesCount, equalToUnsignedInteger(0));
+}
+
+- (void)testLogsOfBatchBeingLoadedAreNotExpired {
+
+  // If
+  XCTestExpectation *expectation = [self expectationWithDescription:@"Logs loaded."];
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.LogDBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  dispatch_queue_t readerQueue = dispatch_queue_create("com.microsoft.appcenter.LogDBStorageTestsReaderQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableReaderConnectionWithReaderQueue:readerQueue queue:queue];
+  [self.sut setTimeToLive:60 forGroupId:nil flags:MSACFlagsNormal];
+  NSArray *savedLogs = [self generateAndSaveLogsWithCount:3 groupId:kMSACTestGroupId flags:MSACFlagsNormal andVerifyLogGeneration:YES];
+  [self ageLogsBy:120];
+  __block NSArray *loadedLogs;
+  __block NSDictionary<NSString *, NSNumber *> *expiredLogsCounts;
+
+  // When
+  dispatch_async(queue, ^{
+    [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                            limit:2
+               excludedTargetKeys:nil
+                completionHandler:^(NSArray<MSACLog> *_Nonnull logArray, __unused NSString *batchId) {
+                  loadedLogs = logArray;
+                  [expectation fulfill];
+                }];
+    expiredLogsCounts = [self.sut deleteExpiredLogsWithLimit:100];
+  });
+
+  // Then
+  [self waitForExpectationsWithTimeout:1
+                               handler:^(NSError *error) {
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+  assertThat(expiredLogsCounts, is(@{kMSACTestGroupId : @1}));
+  assertThat(loadedLogs, is([savedLogs subarrayWithRange:NSMakeRange(0, 2)]));
+  assertThatUnsignedInteger([self.sut countLogs], equalToUnsignedInteger(2));
 }
 
 - (void)testCommonSchemaLogTargetTokenIsSavedAndRestored {
@@ -598,6 +914,54 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
               }];
 }
 
+- (void)testTargetTokensAreStoredOnceAndDecryptedOnce {
+
+  // If
+  NSString *testTargetToken = @"targetKey-secret";
+  id encrypterMock = OCMPartialMock(self.sut.targetTokenEncrypter);
+  __block NSUInteger decryptCount = 0;
+  OCMStub([encrypterMock decryptString:OCMOCK_ANY]).andDo(^(NSInvocation *invocation) {
+    decryptCount++;
+    NSString *targetToken = testTargetToken;
+    [invocation setReturnValue:&targetToken];
+  });
+  for (int i = 0; i < 5; i++) {
+    MSACCommonSchemaLog *log = [MSACCommonSchemaLog new];
+    [log addTransmissionTargetToken:testTargetToken];
+    [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+  }
+
+  // Then
+  NSArray *targetTokens = [self.sut executeSelectionQuery:@"SELECT \"referenceCount\" FROM \"targetTokens\"" withValues:nil];
+  assertThat(targetTokens, is(@[ @[ @5 ] ]));
+
+  // When
+  NSArray<id<MSACLog>> *logs = [self.sut logsFromDBWithGroupId:kMSACTestGroupId];
+  [self.sut logsFromDBWithGroupId:kMSACTestGroupId];
+
+  // Then
+  assertThatUnsignedInteger(logs.count, equalToUnsignedInteger(5));
+  for (id<MSACLog> log in logs) {
+    assertThat([log transmissionTargetTokens], is([NSSet setWithObject:testTargetToken]));
+  }
+  assertThatUnsignedInteger(decryptCount, equalToUnsignedInteger(1));
+
+  // When
+  [MSAC_NOTIFICATION_CENTER postNotificationName:kMSACEncryptionKeyDidRotateNotification object:nil];
+  [self.sut logsFromDBWithGroupId:kMSACTestGroupId];
+
+  // Then
+  assertThatUnsignedInteger(decryptCount, equalToUnsignedInteger(2));
+
+  // When
+  [self.sut deleteLogsWithGroupId:kMSACTestGroupId];
+
+  // Then
+  assertThatUnsignedInteger([self.sut countEntriesForTable:kMSACTargetTokenTableName condition:nil withValues:nil],
+                            equalToUnsignedInteger(0));
+  [encrypterMock stopMocking];
+}
+
 - (void)testOnlyCommonSchemaLogTargetTokenIsSavedAndRestored {
 
   // If
@@ -620,17 +984,66 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
 - (void)testDeleteLogsByBatchIdWithNoPendingBatches {
 
   // If
-  [self.sut.batches removeAllObjects];
   [self generateAndSaveLogsWithCount:5 groupId:kMSACTestGroupId flags:MSACFlagsDefault andVerifyLogGeneration:YES];
 
   // When
   [self.sut deleteLogsWithBatchId:MSAC_UUID_STRING groupId:kMSACTestGroupId];
 
   // Then
-  assertThatInteger(self.sut.batches.count, equalToInteger(0));
+  assertThatInteger([self batchIds].count, equalToInteger(0));
   assertThatInteger([self.sut countEntriesForTable:kMSACLogTableName condition:nil withValues:nil], equalToInteger(5));
 }
 
+- (void)testDeleteLogsSchedulesIncrementalVacuum {
+
+  // If
+  [self generateAndSaveLogsWithCount:5 groupId:kMSACTestGroupId flags:MSACFlagsDefault andVerifyLogGeneration:YES];
+  __block NSString *batchIdToDelete;
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                          limit:2
+             excludedTargetKeys:nil
+              completionHandler:^(__unused NSArray<MSACLog> *_Nonnull logArray, NSString *batchId) {
+                batchIdToDelete = batchId;
+              }];
+  OCMExpect([self.sut scheduleIncrementalVacuum]);
+
+  // When
+  [self.sut deleteLogsWithBatchId:batchIdToDelete groupId:kMSACTestGroupId];
+
+  // Then
+  OCMVerifyAll((id)self.sut);
+
+  // If
+  OCMExpect([self.sut scheduleIncrementalVacuum]);
+
+  // When
+  [self.sut deleteLogsWithGroupId:kMSACTestGroupId];
+
+  // Then
+  OCMVerifyAll((id)self.sut);
+}
+
+- (void)testDeleteLogsResumesMigrationWaitingForRoom {
+
+  // If
+  [self generateAndSaveLogsWithCount:5 groupId:kMSACTestGroupId flags:MSACFlagsDefault andVerifyLogGeneration:YES];
+  __block NSString *batchIdToDelete;
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                          limit:2
+             excludedTargetKeys:nil
+              completionHandler:^(__unused NSArray<MSACLog> *_Nonnull logArray, NSString *batchId) {
+                batchIdToDelete = batchId;
+              }];
+  self.sut.incrementalMigrationWaitingForRoom = YES;
+
+  // When
+  [self.sut deleteLogsWithBatchId:batchIdToDelete groupId:kMSACTestGroupId];
+
+  // Then
+  OCMVerify([self.sut resumeIncrementalMigration]);
+  assertThatBool(self.sut.incrementalMigrationWaitingForRoom, isFalse());
+}
+
 - (void)testAddLogsWhenBelowStorageCapacity {
 
   // If
@@ -708,6 +1121,105 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   XCTAssertEqual(criticalLogs.count, 0);
 }
 
+- (void)testCriticalLogIsSyncedOnCommit {
+
+  // If
+  MSACAbstractLog *aLog = [MSACAbstractLog new];
+  OCMExpect([self.sut executeSynchronousQueryUsingBlock:OCMOCK_ANY]).andForwardToRealObject();
+
+  // When
+  BOOL saved = [self.sut saveLog:aLog withGroupId:kMSACTestGroupId flags:MSACFlagsCritical];
+
+  // Then
+  XCTAssertTrue(saved);
+  OCMVerifyAll((id)self.sut);
+}
+
+- (void)testNormalLogIsNotSyncedOnCommit {
+
+  // If
+  MSACAbstractLog *aLog = [MSACAbstractLog new];
+  OCMReject([self.sut executeSynchronousQueryUsingBlock:OCMOCK_ANY]);
+
+  // When
+  BOOL saved = [self.sut saveLog:aLog withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+
+  // Then
+  XCTAssertTrue(saved);
+}
+
+- (void)testNormalLogsAreGroupedUntilCriticalLogIsSaved {
+
+  // If
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.LogDBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableGroupCommitWithMaxChangesCount:10 window:60 queue:queue];
+
+  // When
+  BOOL firstSaved = [self.sut saveLog:[MSACAbstractLog new] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  BOOL secondSaved = [self.sut saveLog:[MSACAbstractLog new] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+
+  // Then
+  XCTAssertTrue(firstSaved);
+  XCTAssertTrue(secondSaved);
+  XCTAssertEqual(self.sut.pendingTransactionChangesCount, 2);
+  XCTAssertEqual([self loadLogsWhere:nil withValues:nil].count, 0);
+  XCTAssertEqual([self.sut countLogs], 2);
+
+  // When
+  BOOL criticalSaved = [self.sut saveLog:[MSACAbstractLog new] withGroupId:kMSACTestGroupId flags:MSACFlagsCritical];
+
+  // Then
+  XCTAssertTrue(criticalSaved);
+  XCTAssertEqual(self.sut.pendingTransactionChangesCount, 0);
+  XCTAssertEqual([self loadLogsWhere:nil withValues:nil].count, 3);
+}
+
+- (void)testCommitPendingLogsCommitsGroupedLogs {
+
+  // If
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.LogDBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableGroupCommitWithMaxChangesCount:10 window:60 queue:queue];
+  __block NSDictionary *lostLogsCounts;
+  self.sut.lostLogsHandler = ^(NSDictionary<NSString *, NSNumber *> *counts) {
+    lostLogsCounts = counts;
+  };
+  [self.sut saveLog:[MSACAbstractLog new] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+
+  // When
+  [self.sut commitPendingLogs];
+
+  // Then
+  XCTAssertEqual(self.sut.pendingTransactionChangesCount, 0);
+  XCTAssertEqual(self.sut.pendingLogsCounts.count, 0);
+  XCTAssertEqual([self loadLogsWhere:nil withValues:nil].count, 1);
+  XCTAssertNil(lostLogsCounts);
+}
+
+- (void)testLostLogsAreReportedWhenGroupedTransactionFailsToCommit {
+
+  // If
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.LogDBStorageTestsQueue", DISPATCH_QUEUE_SERIAL);
+  [self.sut enableGroupCommitWithMaxChangesCount:10 window:60 queue:queue];
+  __block NSDictionary *lostLogsCounts;
+  self.sut.lostLogsHandler = ^(NSDictionary<NSString *, NSNumber *> *counts) {
+    lostLogsCounts = counts;
+  };
+  [self.sut saveLog:[MSACAbstractLog new] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self.sut saveLog:[MSACAbstractLog new] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self.sut saveLog:[MSACAbstractLog new] withGroupId:kMSACAnotherTestGroupId flags:MSACFlagsNormal];
+  OCMStub([self.sut executeCachedNonSelectionQuery:@"COMMIT" inOpenedDatabase:[OCMArg anyPointer] withValues:OCMOCK_ANY])
+      .andReturn(SQLITE_FULL);
+
+  // When
+  [self.sut commitPendingLogs];
+
+  // Then
+  XCTAssertEqualObjects(lostLogsCounts, (@{kMSACTestGroupId : @2, kMSACAnotherTestGroupId : @1}));
+  XCTAssertEqual(self.sut.pendingLogsCounts.count, 0);
+  XCTAssertEqual([self loadLogsWhere:nil withValues:nil].count, 0);
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(0));
+}
+
 - (void)testAddLogsDoesNotExceedCapacity {
 
   // If
@@ -847,35 +1359,268 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   XCTAssertEqual(1, [self findUnknownDBIdsFromKnownIdList:knownIds].count);
 }
 
-- (void)testSaveLargeNormalPriorityLogDoesNotPurgeOldLogs {
-  [self DoNotPurgeOldLogsWhenSavingLargeLogExceedsCapacityWithPriority:MSACFlagsNormal];
-}
+- (void)testSaveLogStoresLogSize {
 
-- (void)testSaveLargeCriticalPriorityLogDoesNotPurgeOldLogs {
-  [self DoNotPurgeOldLogsWhenSavingLargeLogExceedsCapacityWithPriority:MSACFlagsCritical];
+  // If
+  id<MSACLog> log = [self generateLogWithSize:@(1024)];
+
+  // When
+  [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+
+  // Then
+  NSString *query = [NSString stringWithFormat:@"SELECT \"%@\", LENGTH(\"%@\") FROM \"%@\"", kMSACSizeColumnName, kMSACLogColumnName,
+                                               kMSACLogTableName];
+  NSArray<NSArray *> *rows = [self.sut executeSelectionQuery:query withValues:nil];
+  assertThat(rows[0][0], is(rows[0][1]));
+  assertThatUnsignedInteger([rows[0][0] unsignedIntegerValue], equalToUnsignedInteger([self storedSizeOfLog:log]));
 }
 
-- (void)DoNotPurgeOldLogsWhenSavingLargeLogExceedsCapacityWithPriority:(MSACFlags)priority {
+- (void)testSaveLogStoresTimestamp {
 
   // If
-  long maxCapacityInBytes = kMSACTestStorageSizeMinimumUpperLimitInBytes + 4 * 1024;
-  [self.sut setMaxStorageSize:maxCapacityInBytes
-            completionHandler:^(__unused BOOL success){
-            }];
-  [self generateAndSaveLogsWithCount:1 groupId:kMSACTestGroupId flags:MSACFlagsCritical andVerifyLogGeneration:YES];
-  [self generateAndSaveLogsWithCount:2 groupId:kMSACTestGroupId flags:MSACFlagsNormal andVerifyLogGeneration:YES];
-  id<MSACLog> largeLog = [self generateLogWithSize:@(maxCapacityInBytes)];
-  sqlite3 *db = [self.storageTestUtil openDatabase];
-  NSArray<NSNumber *> *criticalDbIds = [self dbIdsForPriority:MSACFlagsCritical inOpenedDatabase:db];
-  NSArray<NSNumber *> *normalDbIds = [self dbIdsForPriority:MSACFlagsNormal inOpenedDatabase:db];
-  sqlite3_close(db);
+  long long before = (long long)[[NSDate date] timeIntervalSince1970];
 
   // When
-  BOOL logSavedSuccessfully = [self.sut saveLog:largeLog withGroupId:kMSACAnotherTestGroupId flags:priority];
+  [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
 
   // Then
-  XCTAssertTrue([self.storageTestUtil getDataLengthInBytes] <= maxCapacityInBytes);
-  XCTAssertFalse(logSavedSuccessfully);
+  long long after = (long long)[[NSDate date] timeIntervalSince1970];
+  NSString *query = [NSString stringWithFormat:@"SELECT \"%@\" FROM \"%@\"", kMSACTimestampColumnName, kMSACLogTableName];
+  long long timestamp = [[self.sut executeSelectionQuery:query withValues:nil][0][0] longLongValue];
+  XCTAssertGreaterThanOrEqual(timestamp, before);
+  XCTAssertLessThanOrEqual(timestamp, after);
+}
+
+- (void)testDeleteExpiredLogsByGroupIdAndPriority {
+
+  // If
+  [self.sut setTimeToLive:60 forGroupId:nil flags:MSACFlagsNormal];
+  [self.sut setTimeToLive:0 forGroupId:kMSACAnotherTestGroupId flags:MSACFlagsNormal];
+  for (NSUInteger i = 0; i < 2; ++i) {
+    [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+    [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACAnotherTestGroupId flags:MSACFlagsNormal];
+  }
+  [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsCritical];
+  [self ageLogsBy:120];
+
+  // When
+  NSDictionary<NSString *, NSNumber *> *expiredLogsCounts = [self.sut deleteExpiredLogsWithLimit:100];
+
+  // Then
+  // Critical logs don't expire by default and the other group keeps its logs.
+  assertThat(expiredLogsCounts, is(@{kMSACTestGroupId : @2}));
+  assertThatUnsignedInteger([self.sut countLogs], equalToUnsignedInteger(3));
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addNumber:@(MSACFlagsCritical)];
+  NSUInteger criticalLogsCount =
+      [self.sut countEntriesForTable:kMSACLogTableName
+                           condition:[NSString stringWithFormat:@"\"%@\" = ?", kMSACPriorityColumnName]
+                          withValues:values];
+  assertThatUnsignedInteger(criticalLogsCount, equalToUnsignedInteger(1));
+}
+
+- (void)testDeleteExpiredLogsKeepsRecentLogs {
+
+  // If
+  [self.sut setTimeToLive:60 forGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self ageLogsBy:120];
+  [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+
+  // When
+  NSDictionary<NSString *, NSNumber *> *expiredLogsCounts = [self.sut deleteExpiredLogsWithLimit:100];
+
+  // Then
+  assertThat(expiredLogsCounts, is(@{kMSACTestGroupId : @1}));
+  assertThatUnsignedInteger([self.sut countLogs], equalToUnsignedInteger(1));
+}
+
+- (void)testDeleteExpiredLogsIsLimited {
+
+  // If
+  [self.sut setTimeToLive:60 forGroupId:nil flags:MSACFlagsNormal];
+  for (NSUInteger i = 0; i < 5; ++i) {
+    [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  }
+  [self ageLogsBy:120];
+
+  // When
+  NSDictionary<NSString *, NSNumber *> *firstCounts = [self.sut deleteExpiredLogsWithLimit:3];
+  NSDictionary<NSString *, NSNumber *> *secondCounts = [self.sut deleteExpiredLogsWithLimit:3];
+  NSDictionary<NSString *, NSNumber *> *thirdCounts = [self.sut deleteExpiredLogsWithLimit:3];
+
+  // Then
+  assertThat(firstCounts, is(@{kMSACTestGroupId : @3}));
+  assertThat(secondCounts, is(@{kMSACTestGroupId : @2}));
+  assertThatUnsignedInteger(thirdCounts.count, equalToUnsignedInteger(0));
+  assertThatUnsignedInteger([self.sut countLogs], equalToUnsignedInteger(0));
+}
+
+- (void)testLogCountersFollowSavedAndDeletedLogs {
+
+  // If
+  MSACCommonSchemaLog *commonSchemaLog = [MSACCommonSchemaLog new];
+  [commonSchemaLog addTransmissionTargetToken:@"targetKey-secret"];
+  id<MSACLog> log = [self generateLogWithSize:@(100)];
+  NSUInteger logSize = [self storedSizeOfLog:log] + [self storedSizeOfLog:commonSchemaLog];
+
+  // When
+  [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self.sut saveLog:commonSchemaLog withGroupId:kMSACTestGroupId flags:MSACFlagsCritical];
+  [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACAnotherTestGroupId flags:MSACFlagsNormal];
+
+  // Then
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(2));
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:@[ @"targetKey" ]],
+                            equalToUnsignedInteger(1));
+  assertThatLongLong([self.sut sizeOfLogsWithGroupId:kMSACTestGroupId], equalToLongLong(logSize));
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACAnotherTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(1));
+
+  // When
+  __block NSString *batchId;
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                          limit:1
+             excludedTargetKeys:nil
+              completionHandler:^(__unused NSArray<id<MSACLog>> *logArray, NSString *loadedBatchId) {
+                batchId = loadedBatchId;
+              }];
+
+  // Then
+  // Logs of pending batches are still counted.
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(2));
+
+  // When
+  [self.sut deleteLogsWithBatchId:batchId groupId:kMSACTestGroupId];
+
+  // Then
+  // The critical log was loaded first.
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:@[ @"targetKey" ]],
+                            equalToUnsignedInteger(1));
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(1));
+
+  // When
+  [self.sut deleteLogsWithGroupId:kMSACTestGroupId];
+
+  // Then
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(0));
+  assertThatLongLong([self.sut sizeOfLogsWithGroupId:kMSACTestGroupId], equalToLongLong(0));
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACAnotherTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(1));
+}
+
+- (void)testLogCountersAreRebuiltWhenOpened {
+
+  // If
+  [self generateAndSaveLogsWithCount:3 groupId:kMSACTestGroupId flags:MSACFlagsNormal andVerifyLogGeneration:YES];
+  [self generateAndSaveLogsWithCount:2 groupId:kMSACAnotherTestGroupId flags:MSACFlagsNormal andVerifyLogGeneration:YES];
+
+  // When
+  self.sut = [MSACLogDBStorage new];
+
+  // Then
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(3));
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACAnotherTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(2));
+}
+
+- (void)testLogCountersAreRebuiltAfterTransactionRollBack {
+
+  // If
+  [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self.sut executeNonSelectionQuery:[NSString stringWithFormat:@"DELETE FROM \"%@\"", kMSACLogTableName] withValues:nil];
+
+  // When
+  [self.sut transactionDidRollBack];
+
+  // Then
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(0));
+}
+
+- (void)testSaveLogEvictsOldestLogsCoveringLogSizeAndHeadroom {
+
+  // If
+  long maxCapacityInBytes = kMSACTestStorageSizeMinimumUpperLimitInBytes + 4 * 1024;
+  NSArray<NSNumber *> *addedDbIds = [self fillDatabaseWithLogsOfSizeInBytes:maxCapacityInBytes ofPriority:MSACFlagsNormal];
+
+  // The large log keeps its size.
+  self.sut.compressionEnabled = NO;
+  [self.sut setMaxStorageSize:maxCapacityInBytes
+            completionHandler:^(__unused BOOL success){
+            }];
+  self.sut.evictionHeadroom = 4 * 1024;
+  __block NSUInteger evictionHandlerCallsCount = 0;
+  __block NSDictionary<NSString *, NSNumber *> *evictedLogsCounts;
+  self.sut.evictionHandler = ^(NSDictionary<NSString *, NSNumber *> *counts) {
+    evictionHandlerCallsCount++;
+    evictedLogsCounts = counts;
+  };
+  NSString *sizeQuery = [NSString stringWithFormat:@"SELECT LENGTH(\"%@\") FROM \"%@\" LIMIT 1", kMSACLogColumnName, kMSACLogTableName];
+  NSUInteger storedLogSize = [[self.sut executeSelectionQuery:sizeQuery withValues:nil][0][0] unsignedIntegerValue];
+  id<MSACLog> largeLog = [self generateLogWithSize:@(8 * 1024)];
+  NSUInteger requiredSize = [MSACLogDBStorage archiveLog:largeLog].length + self.sut.evictionHeadroom;
+
+  // When
+  BOOL logSavedSuccessfully = [self.sut saveLog:largeLog withGroupId:kMSACAnotherTestGroupId flags:MSACFlagsNormal];
+
+  // Then
+  XCTAssertTrue(logSavedSuccessfully);
+  XCTAssertTrue([self.storageTestUtil getDataLengthInBytes] <= maxCapacityInBytes);
+  assertThatUnsignedInteger(evictionHandlerCallsCount, equalToUnsignedInteger(1));
+  assertThat(evictedLogsCounts.allKeys, is(@[ kMSACTestGroupId ]));
+  NSUInteger evictedCount = evictedLogsCounts[kMSACTestGroupId].unsignedIntegerValue;
+  XCTAssertGreaterThanOrEqual(evictedCount, (requiredSize + storedLogSize - 1) / storedLogSize);
+
+  // The oldest logs are evicted.
+  for (NSUInteger i = 0; i < addedDbIds.count; i++) {
+    XCTAssertEqual([self containsLogWithDbId:addedDbIds[i]], i >= evictedCount);
+  }
+}
+
+- (void)testSaveLogDoesNotCallEvictionHandlerWhenStorageNotFull {
+
+  // If
+  __block BOOL evictionHandlerCalled = NO;
+  self.sut.evictionHandler = ^(__unused NSDictionary<NSString *, NSNumber *> *counts) {
+    evictionHandlerCalled = YES;
+  };
+
+  // When
+  [self generateAndSaveLogsWithCount:5 groupId:kMSACTestGroupId flags:MSACFlagsNormal andVerifyLogGeneration:YES];
+
+  // Then
+  XCTAssertFalse(evictionHandlerCalled);
+}
+
+- (void)testSaveLargeNormalPriorityLogDoesNotPurgeOldLogs {
+  [self DoNotPurgeOldLogsWhenSavingLargeLogExceedsCapacityWithPriority:MSACFlagsNormal];
+}
+
+- (void)testSaveLargeCriticalPriorityLogDoesNotPurgeOldLogs {
+  [self DoNotPurgeOldLogsWhenSavingLargeLogExceedsCapacityWithPriority:MSACFlagsCritical];
+}
+
+- (void)DoNotPurgeOldLogsWhenSavingLargeLogExceedsCapacityWithPriority:(MSACFlags)priority {
+
+  // If
+  long maxCapacityInBytes = kMSACTestStorageSizeMinimumUpperLimitInBytes + 4 * 1024;
+  [self.sut setMaxStorageSize:maxCapacityInBytes
+            completionHandler:^(__unused BOOL success){
+            }];
+  [self generateAndSaveLogsWithCount:1 groupId:kMSACTestGroupId flags:MSACFlagsCritical andVerifyLogGeneration:YES];
+  [self generateAndSaveLogsWithCount:2 groupId:kMSACTestGroupId flags:MSACFlagsNormal andVerifyLogGeneration:YES];
+
+  // The large log keeps its size.
+  self.sut.compressionEnabled = NO;
+  id<MSACLog> largeLog = [self generateLogWithSize:@(maxCapacityInBytes)];
+  sqlite3 *db = [self.storageTestUtil openDatabase];
+  NSArray<NSNumber *> *criticalDbIds = [self dbIdsForPriority:MSACFlagsCritical inOpenedDatabase:db];
+  NSArray<NSNumber *> *normalDbIds = [self dbIdsForPriority:MSACFlagsNormal inOpenedDatabase:db];
+  sqlite3_close(db);
+
+  // When
+  BOOL logSavedSuccessfully = [self.sut saveLog:largeLog withGroupId:kMSACAnotherTestGroupId flags:priority];
+
+  // Then
+  XCTAssertTrue([self.storageTestUtil getDataLengthInBytes] <= maxCapacityInBytes);
+  XCTAssertFalse(logSavedSuccessfully);
   NSString *whereCondition = [NSString stringWithFormat:@"\"%@\" = ?", kMSACGroupIdColumnName];
   MSACStorageBindableArray *values = [MSACStorageBindableArray new];
   [values addString:kMSACAnotherTestGroupId];
@@ -895,10 +1640,10 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
 - (void)testErrorDeletingOldestLog {
 
   // If
-  id classMock = OCMClassMock([MSACDBStorage class]);
-  OCMStub([classMock executeNonSelectionQuery:startsWith(@"INSERT") inOpenedDatabase:[OCMArg anyPointer] withValues:OCMOCK_ANY])
+  [self generateAndSaveLogsWithCount:1 groupId:kMSACTestGroupId flags:MSACFlagsNormal andVerifyLogGeneration:YES];
+  OCMStub([self.sut executeCachedNonSelectionQuery:startsWith(@"INSERT") inOpenedDatabase:[OCMArg anyPointer] withValues:OCMOCK_ANY])
       .andReturn(SQLITE_FULL);
-  OCMStub([classMock executeNonSelectionQuery:startsWith(@"DELETE") inOpenedDatabase:[OCMArg anyPointer] withValues:OCMOCK_ANY])
+  OCMStub([self.sut executeCachedNonSelectionQuery:startsWith(@"DELETE") inOpenedDatabase:[OCMArg anyPointer] withValues:OCMOCK_ANY])
       .andReturn(SQLITE_ERROR);
 
   // When
@@ -907,7 +1652,119 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
 
   // Then
   XCTAssertFalse(logSavedSuccessfully);
-  [classMock stopMocking];
+}
+
+- (void)testSaveAndLoadReuseCachedStatements {
+
+  // If
+  [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId limit:1 excludedTargetKeys:nil completionHandler:nil];
+  NSDictionary<NSString *, NSValue *> *cachedStatements = [self.sut.cachedStatements copy];
+  void *connection = self.sut.connection;
+
+  // When
+  [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+  [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+  [self.sut countLogs];
+
+  // Then
+  XCTAssertTrue(connection != NULL);
+  XCTAssertTrue(self.sut.connection == connection);
+  for (NSString *query in cachedStatements) {
+    XCTAssertEqualObjects(self.sut.cachedStatements[query], cachedStatements[query]);
+  }
+  assertThatUnsignedInteger([self.sut countLogs], equalToUnsignedInteger(3));
+}
+
+- (void)testStatementsWithListsOfValuesAreNotCached {
+
+  // If
+  [self generateAndSaveLogsWithCount:6 groupId:kMSACTestGroupId flags:MSACFlagsDefault andVerifyLogGeneration:YES];
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId limit:1 excludedTargetKeys:nil completionHandler:nil];
+  [self.sut deleteLogsFromDBWithColumnValues:@[ @1 ] columnName:kMSACIdColumnName];
+  NSUInteger cachedStatementsCount = self.sut.cachedStatements.count;
+
+  // When
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId limit:1 excludedTargetKeys:@[ @"1" ] completionHandler:nil];
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId limit:1 excludedTargetKeys:@[ @"1", @"2" ] completionHandler:nil];
+  [self.sut deleteLogsFromDBWithColumnValues:@[ @2, @3 ] columnName:kMSACIdColumnName];
+  [self.sut deleteLogsFromDBWithColumnValues:@[ @4, @5, @6 ] columnName:kMSACIdColumnName];
+
+  // Then
+  assertThatUnsignedInteger(self.sut.cachedStatements.count, equalToUnsignedInteger(cachedStatementsCount));
+  assertThatUnsignedInteger([self.sut countLogs], equalToUnsignedInteger(0));
+}
+
+- (void)testDevicesAreStoredOnceAndSharedByLoadedLogs {
+
+  // If
+  MSACDevice *device = [self generateDeviceWithModel:@"iPhone"];
+  MSACDevice *otherDevice = [self generateDeviceWithModel:@"iPad"];
+  NSArray<id<MSACLog>> *savedLogs = @[ [self generateLogWithSize:nil], [self generateLogWithSize:nil], [self generateLogWithSize:nil] ];
+  savedLogs[0].device = device;
+  savedLogs[1].device = [self generateDeviceWithModel:@"iPhone"];
+  savedLogs[2].device = otherDevice;
+
+  // When
+  for (id<MSACLog> log in savedLogs) {
+    [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+  }
+
+  // Then
+  NSArray *devices = [self.sut executeSelectionQuery:@"SELECT \"referenceCount\" FROM \"devices\" ORDER BY \"id\"" withValues:nil];
+  assertThat(devices, is(@[ @[ @2 ], @[ @1 ] ]));
+
+  // When
+  NSArray<id<MSACLog>> *logs = [self.sut logsFromDBWithGroupId:kMSACTestGroupId];
+
+  // Then
+  assertThatUnsignedInteger(logs.count, equalToUnsignedInteger(3));
+  assertThat(logs[0].device, is(device));
+  XCTAssertTrue(logs[0].device == logs[1].device);
+  assertThat(logs[2].device, is(otherDevice));
+}
+
+- (void)testDeviceIsDeletedWithLastReferencingLog {
+
+  // If
+  id<MSACLog> log = [self generateLogWithSize:nil];
+  log.device = [self generateDeviceWithModel:@"iPhone"];
+  [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+  [self.sut saveLog:log withGroupId:kMSACAnotherTestGroupId flags:MSACFlagsDefault];
+
+  // When
+  [self.sut deleteLogsWithGroupId:kMSACTestGroupId];
+
+  // Then
+  NSArray *devices = [self.sut executeSelectionQuery:@"SELECT \"referenceCount\" FROM \"devices\"" withValues:nil];
+  assertThat(devices, is(@[ @[ @1 ] ]));
+  assertThat([self.sut logsFromDBWithGroupId:kMSACAnotherTestGroupId][0].device, is(log.device));
+
+  // When
+  [self.sut deleteLogsWithGroupId:kMSACAnotherTestGroupId];
+
+  // Then
+  assertThatUnsignedInteger([self.sut countEntriesForTable:kMSACDeviceTableName condition:nil withValues:nil], equalToUnsignedInteger(0));
+}
+
+- (void)testLogsWithEmbeddedDeviceAreStillLoaded {
+
+  // If
+  id<MSACLog> log = [self generateLogWithSize:nil];
+  log.device = [self generateDeviceWithModel:@"iPhone"];
+  NSString *addLogQuery = [NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\") VALUES (?, ?)", kMSACLogTableName,
+                                                     kMSACGroupIdColumnName, kMSACLogColumnName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addString:kMSACTestGroupId];
+  [values addData:[MSACLogDBStorage archiveLog:log]];
+  [self.sut executeNonSelectionQuery:addLogQuery withValues:values];
+
+  // When
+  NSArray<id<MSACLog>> *logs = [self.sut logsFromDBWithGroupId:kMSACTestGroupId];
+
+  // Then
+  assertThatUnsignedInteger(logs.count, equalToUnsignedInteger(1));
+  assertThat(logs[0].device, is(log.device));
 }
 
 - (void)testCreateFromLatestSchema {
@@ -926,6 +1783,23 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
                                                                  kMSACPriorityColumnName]
                            withValues:nil][0][0];
   assertThat(priorityIndex, is(@"CREATE INDEX \"ix_logs_priority\" ON \"logs\" (\"priority\")"));
+  NSString *batchIndex = [self.sut executeSelectionQuery:@"SELECT sql FROM sqlite_master WHERE name='ix_logs_groupId_batchId_priority_id'"
+                                              withValues:nil][0][0];
+  assertThat(batchIndex, is(@"CREATE INDEX \"ix_logs_groupId_batchId_priority_id\" ON \"logs\" "
+                            @"(\"groupId\", \"batchId\", \"priority\" DESC, \"id\")"));
+  NSString *timestampIndex = [self.sut executeSelectionQuery:@"SELECT sql FROM sqlite_master WHERE "
+                                                             @"name='ix_logs_groupId_priority_timestamp'"
+                                                  withValues:nil][0][0];
+  assertThat(timestampIndex, is(@"CREATE INDEX \"ix_logs_groupId_priority_timestamp\" ON \"logs\" "
+                                @"(\"groupId\", \"priority\", \"timestamp\")"));
+  NSString *devicesTable = [self.sut executeSelectionQuery:@"SELECT sql FROM sqlite_master WHERE name='devices'" withValues:nil][0][0];
+  assertThat(devicesTable, is(@"CREATE TABLE \"devices\" (\"id\" INTEGER PRIMARY KEY AUTOINCREMENT, \"hash\" BLOB NOT NULL, "
+                              @"\"device\" BLOB NOT NULL, \"referenceCount\" INTEGER NOT NULL)"));
+  NSArray *triggers = [self.sut executeSelectionQuery:@"SELECT name FROM sqlite_master WHERE type='trigger' ORDER BY name" withValues:nil];
+  assertThat(triggers, is(@[
+               @[ @"tr_logs_delete_device" ], @[ @"tr_logs_delete_targetToken" ], @[ @"tr_logs_insert_device" ],
+               @[ @"tr_logs_insert_targetToken" ]
+             ]));
 }
 
 - (void)testMigrationToLatest {
@@ -950,14 +1824,270 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
 
   // When
   self.sut = [MSACLogDBStorage new];
+  while ([self.sut migrateIncrementally]) {
+  }
 
   // Then
-  // Migration to version 5 we drop the table and re-create, so we expect 0.
-  assertThatInt([self loadLogsWhere:nil withValues:nil].count, equalToUnsignedInt(0));
+  // Migration from versions prior to 5 stages the table and copies its logs to a new one.
+  assertThatInt([self loadLogsWhere:nil withValues:nil].count, equalToUnsignedInt(10));
+}
+
+- (void)testMigrationFromVersion5KeepsLegacyLogs {
+
+  // If
+  // Create version 5 db with base64 encoded keyed archives.
+  // DO NOT CHANGE. THIS IS ALREADY PUBLISHED SCHEMA.
+  MSACDBSchema *schema5 = @{
+    kMSACLogTableName : @[
+      @{kMSACIdColumnName : @[ kMSACSQLiteTypeInteger, kMSACSQLiteConstraintPrimaryKey, kMSACSQLiteConstraintAutoincrement ]},
+      @{kMSACGroupIdColumnName : @[ kMSACSQLiteTypeText, kMSACSQLiteConstraintNotNull ]},
+      @{kMSACLogColumnName : @[ kMSACSQLiteTypeText, kMSACSQLiteConstraintNotNull ]},
+      @{kMSACTargetTokenColumnName : @[ kMSACSQLiteTypeText ]}, @{kMSACTargetKeyColumnName : @[ kMSACSQLiteTypeText ]},
+      @{kMSACPriorityColumnName : @[ kMSACSQLiteTypeInteger ]}
+    ]
+  };
+  [self.storageTestUtil deleteDatabase];
+  MSACDBStorage *storage5 = [[MSACDBStorage alloc] initWithSchema:schema5 version:5 filename:kMSACDBFileName];
+  for (NSUInteger i = 0; i < 5; ++i) {
+    id<MSACLog> log = [self generateLogWithSize:nil];
+    NSString *base64Data = [[MSACUtility archiveKeyedData:log] base64EncodedStringWithOptions:NSDataBase64EncodingEndLineWithLineFeed];
+    MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+    [values addString:kMSACTestGroupId];
+    [values addString:base64Data];
+    [values addNumber:@((unsigned int)MSACFlagsDefault)];
+    [storage5 executeNonSelectionQuery:[NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\", \"%@\") VALUES (?, ?, ?)",
+                                                                  kMSACLogTableName, kMSACGroupIdColumnName, kMSACLogColumnName,
+                                                                  kMSACPriorityColumnName]
+                            withValues:values];
+  }
+  [storage5 closeConnection];
+
+  // When
+  self.sut = [MSACLogDBStorage new];
+  [self.sut saveLog:[self generateLogWithSize:nil] withGroupId:kMSACTestGroupId flags:MSACFlagsCritical];
+  __block NSArray<id<MSACLog>> *logs;
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                          limit:10
+             excludedTargetKeys:nil
+              completionHandler:^(NSArray<id<MSACLog>> *_Nonnull logArray, __unused NSString *batchId) {
+                logs = logArray;
+              }];
+
+  // Then
+  // Legacy logs are still readable along with the new ones.
+  assertThatUnsignedInteger(logs.count, equalToUnsignedInteger(6));
+  NSString *typesQuery = [NSString
+      stringWithFormat:@"SELECT typeof(\"%@\") FROM \"%@\" ORDER BY \"%@\"", kMSACLogColumnName, kMSACLogTableName, kMSACIdColumnName];
+  NSArray<NSArray *> *types = [self.sut executeSelectionQuery:typesQuery withValues:nil];
+  assertThat(types[0][0], is(@"text"));
+  assertThat(types[5][0], is(@"blob"));
+}
+
+- (void)testMigrationFromLegacyVersionsKeepsLogs {
+
+  // If
+  // Schemas of the versions prior to 5, the logs table is staged and migrated incrementally.
+  NSArray<MSACDBColumnsSchema *> *legacyColumnsSchemas = [self legacyColumnsSchemas];
+  for (NSUInteger version = 1; version <= legacyColumnsSchemas.count; ++version) {
+    MSACDBColumnsSchema *columnsSchema = legacyColumnsSchemas[version - 1];
+    NSArray<id<MSACLog>> *logs = [self createLegacyDatabaseWithColumnsSchema:columnsSchema version:version logsCount:3];
+
+    // When
+    self.sut = [MSACLogDBStorage new];
+
+    // Then
+    // Logs are not migrated yet.
+    assertThatUnsignedInteger([self.sut countLogs], equalToUnsignedInteger(0));
+    assertThatBool([self tableExists:[NSString stringWithFormat:@"%@_v%tu", kMSACLogTableName, version]], isTrue());
+
+    // When
+    NSUInteger chunksCount = 0;
+    self.sut.incrementalMigrationChunkSize = 2;
+    while ([self.sut migrateIncrementally]) {
+      chunksCount++;
+    }
+
+    // Then
+    assertThatUnsignedInteger(chunksCount, equalToUnsignedInteger(2));
+    assertThatBool([self tableExists:[NSString stringWithFormat:@"%@_v%tu", kMSACLogTableName, version]], isFalse());
+    assertThatBool([self tableExists:kMSACMigrationsTableName], isTrue());
+    assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(3));
+    assertThat([self loadLogsWhere:nil withValues:nil], is(logs));
+    [self.sut closeConnection];
+  }
+}
+
+- (void)testIncrementalMigrationResumesAfterRestart {
+
+  // If
+  NSArray<id<MSACLog>> *legacyLogs = [self createLegacyDatabaseWithColumnsSchema:[self legacyColumnsSchemas][0] version:1 logsCount:5];
+  self.sut = [MSACLogDBStorage new];
+  self.sut.incrementalMigrationChunkSize = 2;
+  assertThatBool([self.sut migrateIncrementally], isTrue());
+  id<MSACLog> newLog = [self generateLogWithSize:nil];
+  [self.sut saveLog:newLog withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self.sut closeConnection];
+
+  // When
+  self.sut = [MSACLogDBStorage new];
+  self.sut.incrementalMigrationChunkSize = 2;
+  while ([self.sut migrateIncrementally]) {
+  }
+
+  // Then
+  // Legacy logs are migrated once and keep being sent before the newer logs.
+  NSMutableArray<id<MSACLog>> *expectedLogs = [legacyLogs mutableCopy];
+  [expectedLogs addObject:newLog];
+  assertThatUnsignedInteger([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], equalToUnsignedInteger(6));
+  __block NSArray<id<MSACLog>> *logs;
+  [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                          limit:10
+             excludedTargetKeys:nil
+              completionHandler:^(NSArray<id<MSACLog>> *_Nonnull logArray, __unused NSString *batchId) {
+                logs = logArray;
+              }];
+  assertThat(logs, is(expectedLogs));
+}
+
+- (void)testSaveLogStoresBinaryArchive {
+
+  // If
+  id<MSACLog> log = [self generateLogWithSize:@(10)];
+  self.sut.compressionEnabled = NO;
+
+  // When
+  [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsCritical];
+
+  // Then
+  NSArray<NSArray *> *rows = [self.sut executeSelectionQuery:[NSString stringWithFormat:@"SELECT \"%@\" FROM \"%@\"", kMSACLogColumnName,
+                                                                                         kMSACLogTableName]
+                                                  withValues:nil];
+  NSData *data = rows[0][0];
+  XCTAssertTrue([data isKindOfClass:[NSData class]]);
+  XCTAssertTrue([MSACBinaryUnarchiver isBinaryArchive:data]);
+  XCTAssertLessThan(data.length, [MSACUtility archiveKeyedData:log].length);
+  XCTAssertEqualObjects([self loadLogsWhere:nil withValues:nil].firstObject, log);
+}
+
+- (void)testSaveLogCompressesLogWithDictionary {
+
+  // If
+  id<MSACLog> log = [self generateLogWithSize:@(1024)];
+
+  // When
+  [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsCritical];
+
+  // Then
+  NSString *query = [NSString stringWithFormat:@"SELECT \"%@\", \"%@\" FROM \"%@\"", kMSACLogColumnName, kMSACDictionaryVersionColumnName,
+                                               kMSACLogTableName];
+  NSArray<NSArray *> *rows = [self.sut executeSelectionQuery:query withValues:nil];
+  NSData *data = rows[0][0];
+  assertThat(rows[0][1], is(@(kMSACLogCompressionDictionaryVersion)));
+  XCTAssertFalse([MSACBinaryUnarchiver isBinaryArchive:data]);
+  XCTAssertLessThan(data.length, [MSACLogDBStorage archiveLog:log].length);
+  XCTAssertEqualObjects([self loadLogsWhere:nil withValues:nil].firstObject, log);
+}
+
+- (void)testCompressArchivedLogKeepsDataThatDoesNotShrink {
+
+  // If
+  uint8_t bytes[256];
+  arc4random_buf(bytes, sizeof(bytes));
+  NSData *data = [NSData dataWithBytes:bytes length:sizeof(bytes)];
+  NSUInteger dictionaryVersion = kMSACLogCompressionDictionaryVersion;
+
+  // When
+  NSData *storedData = [MSACLogDBStorage compressArchivedLog:data dictionaryVersion:&dictionaryVersion];
+
+  // Then
+  assertThat(storedData, is(data));
+  assertThatUnsignedInteger(dictionaryVersion, equalToUnsignedInteger(0));
+}
+
+- (void)testLogsWithUnknownDictionaryVersionAreDeleted {
+
+  // If
+  NSData *data = [MSACLogDBStorage archiveLog:[self generateLogWithSize:@(1024)]];
+  NSString *addLogQuery = [NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\", \"%@\") VALUES (?, ?, ?)", kMSACLogTableName,
+                                                     kMSACGroupIdColumnName, kMSACLogColumnName, kMSACDictionaryVersionColumnName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addString:kMSACTestGroupId];
+  [values addData:[MSACLogDBStorage compressArchivedLog:data dictionaryVersion:nil]];
+  [values addNumber:@(kMSACLogCompressionDictionaryVersion + 1)];
+  [self.sut executeNonSelectionQuery:addLogQuery withValues:values];
+
+  // When
+  NSArray<id<MSACLog>> *logs = [self.sut logsFromDBWithGroupId:kMSACTestGroupId];
+
+  // Then
+  assertThatUnsignedInteger(logs.count, equalToUnsignedInteger(0));
+  assertThatUnsignedInteger([self.sut countEntriesForTable:kMSACLogTableName condition:nil withValues:nil], equalToUnsignedInteger(0));
 }
 
 #pragma mark - Helper methods
 
+- (NSArray<MSACDBColumnsSchema *> *)legacyColumnsSchemas {
+
+  // DO NOT CHANGE. THESE ARE ALREADY PUBLISHED SCHEMAS.
+  NSDictionary *idColumn =
+      @{kMSACIdColumnName : @[ kMSACSQLiteTypeInteger, kMSACSQLiteConstraintPrimaryKey, kMSACSQLiteConstraintAutoincrement ]};
+  NSDictionary *groupIdColumn = @{kMSACGroupIdColumnName : @[ kMSACSQLiteTypeText, kMSACSQLiteConstraintNotNull ]};
+  NSDictionary *logColumn = @{kMSACLogColumnName : @[ kMSACSQLiteTypeText, kMSACSQLiteConstraintNotNull ]};
+  NSDictionary *targetTokenColumn = @{kMSACTargetTokenColumnName : @[ kMSACSQLiteTypeText ]};
+  NSDictionary *targetKeyColumn = @{kMSACTargetKeyColumnName : @[ kMSACSQLiteTypeText ]};
+  NSDictionary *priorityColumn = @{kMSACPriorityColumnName : @[ kMSACSQLiteTypeInteger ]};
+  NSDictionary *timestampColumn = @{kMSACTimestampColumnName : @[ kMSACSQLiteTypeInteger ]};
+  return @[
+    @[ idColumn, groupIdColumn, logColumn ], @[ idColumn, groupIdColumn, logColumn, targetTokenColumn ],
+    @[ idColumn, groupIdColumn, logColumn, targetTokenColumn, targetKeyColumn ],
+    @[ idColumn, groupIdColumn, logColumn, targetTokenColumn, targetKeyColumn, priorityColumn, timestampColumn ]
+  ];
+}
+
+- (NSArray<id<MSACLog>> *)createLegacyDatabaseWithColumnsSchema:(MSACDBColumnsSchema *)columnsSchema
+                                                        version:(NSUInteger)version
+                                                      logsCount:(NSUInteger)logsCount {
+  [self.sut closeConnection];
+  [self.storageTestUtil deleteDatabase];
+  MSACDBSchema *schema = @{kMSACLogTableName : columnsSchema};
+  MSACDBStorage *storage = [[MSACDBStorage alloc] initWithSchema:schema version:version filename:kMSACDBFileName];
+  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray new];
+  for (NSUInteger i = 0; i < logsCount; ++i) {
+    id<MSACLog> log = [self generateLogWithSize:nil];
+    NSString *base64Data = [[MSACUtility archiveKeyedData:log] base64EncodedStringWithOptions:NSDataBase64EncodingEndLineWithLineFeed];
+    MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+    [values addString:kMSACTestGroupId];
+    [values addString:base64Data];
+    [storage executeNonSelectionQuery:[NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\") VALUES (?, ?)", kMSACLogTableName,
+                                                                 kMSACGroupIdColumnName, kMSACLogColumnName]
+                           withValues:values];
+    [logs addObject:log];
+  }
+  [storage closeConnection];
+  return logs;
+}
+
+- (BOOL)tableExists:(NSString *)tableName {
+  NSString *query = @"SELECT COUNT(*) FROM \"sqlite_master\" WHERE \"type\" = 'table' AND \"name\" = ?";
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addString:tableName];
+  return [[self.sut executeSelectionQuery:query withValues:values][0][0] integerValue] > 0;
+}
+
+- (MSACDevice *)generateDeviceWithModel:(NSString *)model {
+  MSACDevice *device = [MSACDevice new];
+  device.sdkName = @"appcenter.ios";
+  device.sdkVersion = @"4.2.1";
+  device.model = model;
+  device.osName = @"iOS";
+  device.locale = @"en_US";
+  return device;
+}
+
+- (NSUInteger)storedSizeOfLog:(id<MSACLog>)log {
+  return [MSACLogDBStorage compressArchivedLog:(NSData *)[MSACLogDBStorage archiveLog:log] dictionaryVersion:nil].length;
+}
+
 - (id<MSACLog>)generateLogWithSize:(NSNumber *)size {
   MSACLogWithProperties *log = [MSACLogWithProperties new];
   if (size) {
@@ -994,13 +2124,13 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   NSUInteger trueLogCount;
   for (NSUInteger i = 0; i < count; ++i) {
     id<MSACLog> log = [self generateLogWithSize:size];
-    NSString *base64Data = [[MSACUtility archiveKeyedData:log] base64EncodedStringWithOptions:NSDataBase64EncodingEndLineWithLineFeed];
+    NSData *logData = [MSACLogDBStorage archiveLog:log];
     NSString *addLogQuery = [NSString stringWithFormat:@"INSERT INTO \"%@\" (\"%@\", \"%@\", \"%@\") VALUES (?, ?, ?)", kMSACLogTableName,
                                                        kMSACGroupIdColumnName, kMSACLogColumnName, kMSACPriorityColumnName];
 
     MSACStorageBindableArray *values = [MSACStorageBindableArray new];
     [values addString:groupId];
-    [values addString:base64Data];
+    [values addData:logData];
     [values addNumber:@((unsigned int)flags)];
     [storage executeNonSelectionQuery:addLogQuery withValues:values];
     [logs addObject:log];
@@ -1020,6 +2150,36 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   return logs;
 }
 
+- (void)ageLogsBy:(long long)seconds {
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addNumber:@(seconds)];
+  [self.sut executeNonSelectionQuery:[NSString stringWithFormat:@"UPDATE \"%@\" SET \"%@\" = \"%@\" - ?", kMSACLogTableName,
+                                                                kMSACTimestampColumnName, kMSACTimestampColumnName]
+                          withValues:values];
+}
+
+- (NSArray<NSString *> *)batchIds {
+  NSString *query = [NSString stringWithFormat:@"SELECT DISTINCT \"%@\" FROM \"%@\" WHERE \"%@\" IS NOT NULL", kMSACBatchIdColumnName,
+                                               kMSACLogTableName, kMSACBatchIdColumnName];
+  NSMutableArray *batchIds = [NSMutableArray new];
+  for (NSArray *row in [self.sut executeSelectionQuery:query withValues:nil]) {
+    [batchIds addObject:row[0]];
+  }
+  return batchIds;
+}
+
+- (NSArray<NSNumber *> *)dbIdsForBatchId:(NSString *)batchId {
+  NSString *query = [NSString stringWithFormat:@"SELECT \"%@\" FROM \"%@\" WHERE \"%@\" = ? ORDER BY \"%@\" ASC", kMSACIdColumnName,
+                                               kMSACLogTableName, kMSACBatchIdColumnName, kMSACIdColumnName];
+  MSACStorageBindableArray *values = [MSACStorageBindableArray new];
+  [values addString:batchId];
+  NSMutableArray *ids = [NSMutableArray new];
+  for (NSArray *row in [self.sut executeSelectionQuery:query withValues:values]) {
+    [ids addObject:row[0]];
+  }
+  return ids;
+}
+
 - (NSArray<NSNumber *> *)dbIdsForPriority:(MSACFlags)flags inOpenedDatabase:(void *)db {
   NSString *selectLogQuery = [NSString stringWithFormat:@"SELECT \"%@\" FROM \"%@\" WHERE \"%@\" = ? ORDER BY \"%@\" ASC",
                                                         kMSACIdColumnName, kMSACLogTableName, kMSACPriorityColumnName, kMSACIdColumnName];
@@ -1057,6 +2217,9 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
       case SQLITE_TEXT:
         value = [NSString stringWithUTF8String:(const char *)sqlite3_column_text(statement, i)];
         break;
+      case SQLITE_BLOB:
+        value = [NSData dataWithBytes:sqlite3_column_blob(statement, i) length:(NSUInteger)sqlite3_column_bytes(statement, i)];
+        break;
       default:
         value = [NSNull null];
         break;
@@ -1069,9 +2232,7 @@ static NSString *const kMSACLatestSchema = @"CREATE TABLE \"logs\" ("
   }
   sqlite3_finalize(statement);
   for (NSArray *row in rows) {
-    NSString *base64Data = row[2];
-    NSData *logData = [[NSData alloc] initWithBase64EncodedString:base64Data options:NSDataBase64DecodingIgnoreUnknownCharacters];
-    id<MSACLog> log = (id<MSACLog>)[MSACUtility unarchiveKeyedData:logData];
+    id<MSACLog> log = [MSACLogDBStorage unarchiveLogFromColumnValue:row[2]];
     [logs addObject:log];
   }
   sqlite3_close(db);
@@ -0,0 +1,479 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACAbstractLogInternal.h"
+#import "MSACCommonSchemaLog.h"
+#import "MSACLogSegmentStoragePrivate.h"
+#import "MSACLogWithProperties.h"
+#import "MSACTestFrameworks.h"
+#import "MSACUtility.h"
+
+static NSString *const kMSACTestGroupId = @"TestGroupId";
+static NSString *const kMSACAnotherTestGroupId = @"AnotherGroupId";
+
+@interface MSACLogSegmentStorageTests : XCTestCase
+
+@property(nonatomic) NSURL *directoryURL;
+@property(nonatomic) MSACLogSegmentStorage *sut;
+
+@end
+
+@implementation MSACLogSegmentStorageTests
+
+#pragma mark - Setup
+
+- (void)setUp {
+  [super setUp];
+  self.directoryURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:MSAC_UUID_STRING];
+  self.sut = [[MSACLogSegmentStorage alloc] initWithDirectoryURL:self.directoryURL];
+}
+
+- (void)tearDown {
+  [self.sut close];
+  [[NSFileManager defaultManager] removeItemAtURL:self.directoryURL error:nil];
+  [super tearDown];
+}
+
+#pragma mark - Tests
+
+- (void)testSaveAndLoadLogs {
+
+  // If
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:5 size:nil groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self saveLogsWithCount:2 size:nil groupId:kMSACAnotherTestGroupId flags:MSACFlagsNormal];
+
+  // When
+  NSString *loadedBatchId;
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:&loadedBatchId];
+
+  // Then
+  XCTAssertNotNil(loadedBatchId);
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:logs]);
+  XCTAssertEqual([self.sut countLogs], 7);
+  XCTAssertEqual([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], 5);
+
+  // When
+  loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:&loadedBatchId];
+
+  // Then
+  XCTAssertEqual(loadedLogs.count, 0);
+  XCTAssertNil(loadedBatchId);
+}
+
+- (void)testLoadLogsClaimsHighestPriorityLogsFirst {
+
+  // If
+  NSArray<id<MSACLog>> *normalLogs = [self saveLogsWithCount:3 size:nil groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  NSArray<id<MSACLog>> *criticalLogs = [self saveLogsWithCount:2 size:nil groupId:kMSACTestGroupId flags:MSACFlagsCritical];
+
+  // When
+  BOOL moreLogsAvailable =
+      [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                              limit:3
+                 excludedTargetKeys:nil
+                  completionHandler:^(NSArray<id<MSACLog>> *_Nonnull logArray, __unused NSString *batchId) {
+                    // Then
+                    NSArray *expectedLogs = [criticalLogs arrayByAddingObject:normalLogs[0]];
+                    XCTAssertEqualObjects([self sidsOfLogs:logArray], [self sidsOfLogs:expectedLogs]);
+                  }];
+
+  // Then
+  XCTAssertTrue(moreLogsAvailable);
+}
+
+- (void)testLoadLogsCutsBatchesAtSizeInBytesLimit {
+
+  // If
+  self.sut.compressionEnabled = NO;
+  [self saveLogsWithCount:1 size:@1000 groupId:kMSACAnotherTestGroupId flags:MSACFlagsNormal];
+  long long logSize = [self.sut sizeOfLogsWithGroupId:kMSACAnotherTestGroupId];
+  [self.sut setBatchSizeInBytesLimit:(NSUInteger)(logSize * 5 / 2) forGroupId:kMSACTestGroupId];
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:4 size:@1000 groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  NSArray<id<MSACLog>> *oversizedLogs = [self saveLogsWithCount:1 size:@5000 groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  logs = [logs arrayByAddingObjectsFromArray:oversizedLogs];
+  logs = [logs arrayByAddingObjectsFromArray:[self saveLogsWithCount:1 size:@1000 groupId:kMSACTestGroupId flags:MSACFlagsNormal]];
+
+  // When
+  NSMutableArray<NSArray<id<MSACLog>> *> *batches = [NSMutableArray new];
+  NSArray<id<MSACLog>> *loadedLogs;
+  while ((loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:nil]).count > 0) {
+    [batches addObject:loadedLogs];
+  }
+
+  // Then
+  // Batches hold two logs at most, the oversized log is loaded alone.
+  NSArray *expectedBatches = @[
+    [logs subarrayWithRange:NSMakeRange(0, 2)], [logs subarrayWithRange:NSMakeRange(2, 2)], oversizedLogs,
+    [logs subarrayWithRange:NSMakeRange(5, 1)]
+  ];
+  XCTAssertEqual(batches.count, expectedBatches.count);
+  for (NSUInteger i = 0; i < MIN(batches.count, expectedBatches.count); i++) {
+    XCTAssertEqualObjects([self sidsOfLogs:batches[i]], [self sidsOfLogs:expectedBatches[i]]);
+  }
+}
+
+- (void)testSizeOfUnbatchedLogsExcludesLogsOfPendingBatches {
+
+  // If
+  [self saveLogsWithCount:2 size:@1000 groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  long long unbatchedSize = [self.sut sizeOfUnbatchedLogsWithGroupId:kMSACTestGroupId];
+  long long payloadSize = (long long)self.sut.groups[kMSACTestGroupId].entries[0].payloadSize;
+
+  // Then
+  // Logs are sized before compression.
+  XCTAssertGreaterThan(unbatchedSize, [self.sut sizeOfLogsWithGroupId:kMSACTestGroupId]);
+
+  // When
+  NSString *batchId;
+  [self loadLogsWithGroupId:kMSACTestGroupId limit:1 batchId:&batchId];
+
+  // Then
+  XCTAssertEqual([self.sut sizeOfUnbatchedLogsWithGroupId:kMSACTestGroupId], unbatchedSize - payloadSize);
+
+  // When
+  [self.sut releaseLogsWithBatchId:(NSString *)batchId groupId:kMSACTestGroupId];
+
+  // Then
+  XCTAssertEqual([self.sut sizeOfUnbatchedLogsWithGroupId:kMSACTestGroupId], unbatchedSize);
+
+  // When
+  [self loadLogsWithGroupId:kMSACTestGroupId limit:1 batchId:&batchId];
+  [self.sut deleteLogsWithBatchId:(NSString *)batchId groupId:kMSACTestGroupId];
+  [self reopenStorage];
+
+  // Then
+  XCTAssertEqual([self.sut sizeOfUnbatchedLogsWithGroupId:kMSACTestGroupId], unbatchedSize - payloadSize);
+}
+
+- (void)testDeletedBatchIsNotLoadedAfterReopening {
+
+  // If
+  [self saveLogsWithCount:3 size:nil groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  NSArray<id<MSACLog>> *remainingLogs = [self saveLogsWithCount:2 size:nil groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  NSString *batchId;
+  [self loadLogsWithGroupId:kMSACTestGroupId limit:3 batchId:&batchId];
+
+  // When
+  [self.sut deleteLogsWithBatchId:(NSString *)batchId groupId:kMSACTestGroupId];
+  [self reopenStorage];
+
+  // Then
+  XCTAssertEqual([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], 2);
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:nil];
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:remainingLogs]);
+}
+
+- (void)testReleasedAndPendingBatchesAreLoadedAgain {
+
+  // If
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:4 size:nil groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  NSString *batchId;
+  [self loadLogsWithGroupId:kMSACTestGroupId limit:2 batchId:&batchId];
+
+  // When
+  [self.sut releaseLogsWithBatchId:(NSString *)batchId groupId:kMSACTestGroupId];
+
+  // Then
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:2 batchId:nil];
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:[logs subarrayWithRange:NSMakeRange(0, 2)]]);
+
+  // When
+  [self reopenStorage];
+
+  // Then
+  loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:nil];
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:logs]);
+}
+
+- (void)testTornRecordIsTruncatedWhenOpening {
+
+  // If
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:3 size:nil groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  NSURL *segmentURL = [self segmentURLsOfGroupId:kMSACTestGroupId].lastObject;
+  unsigned long long segmentSize = [self sizeOfFileAtURL:segmentURL];
+  [self.sut close];
+
+  // When
+  NSData *record = [MSACLogSegmentStorage recordWithType:MSACSegmentRecordTypeLog payload:[NSMutableData dataWithLength:100]];
+  NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingToURL:segmentURL error:nil];
+  [fileHandle seekToEndOfFile];
+  [fileHandle writeData:[record subdataWithRange:NSMakeRange(0, 50)]];
+  [fileHandle closeFile];
+  [self reopenStorage];
+
+  // Then
+  XCTAssertEqual([self sizeOfFileAtURL:segmentURL], segmentSize);
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:nil];
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:logs]);
+
+  // When
+  NSArray<id<MSACLog>> *newLogs = [self saveLogsWithCount:1 size:nil groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self reopenStorage];
+
+  // Then
+  loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:nil];
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:[logs arrayByAddingObjectsFromArray:newLogs]]);
+}
+
+- (void)testCorruptedRecordIsDiscardedWhenOpening {
+
+  // If
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:3 size:nil groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  MSACLogSegmentEntry *secondEntry = self.sut.groups[kMSACTestGroupId].entries[1];
+  NSURL *segmentURL = [self segmentURLsOfGroupId:kMSACTestGroupId].lastObject;
+  [self.sut close];
+
+  // When
+  NSMutableData *data = [NSMutableData dataWithContentsOfURL:segmentURL];
+  ((uint8_t *)data.mutableBytes)[secondEntry.offset + secondEntry.recordLength - 1] ^= 0xFF;
+  [data writeToURL:segmentURL atomically:NO];
+  [self reopenStorage];
+
+  // Then
+  XCTAssertEqual([self sizeOfFileAtURL:segmentURL], secondEntry.offset);
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:nil];
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:@[ logs[0] ]]);
+}
+
+- (void)testSegmentsAreCompactedWhenLogsAreDeleted {
+
+  // If
+  self.sut.compressionEnabled = NO;
+  self.sut.maxSegmentSizeInBytes = 2 * 1024;
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:20 size:@500 groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  NSUInteger segmentsCount = [self segmentURLsOfGroupId:kMSACTestGroupId].count;
+  XCTAssertGreaterThan(segmentsCount, 5);
+
+  // When
+  NSString *batchId;
+  [self loadLogsWithGroupId:kMSACTestGroupId limit:15 batchId:&batchId];
+  [self.sut deleteLogsWithBatchId:(NSString *)batchId groupId:kMSACTestGroupId];
+
+  // Then
+  XCTAssertLessThan([self segmentURLsOfGroupId:kMSACTestGroupId].count, segmentsCount / 2);
+  XCTAssertFalse([[self segmentURLsOfGroupId:kMSACTestGroupId].firstObject.lastPathComponent hasPrefix:@"0000000001"]);
+
+  // When
+  [self reopenStorage];
+
+  // Then
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:20 batchId:nil];
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:[logs subarrayWithRange:NSMakeRange(15, 5)]]);
+}
+
+- (void)testOldestLogsAreEvictedWhenStorageIsFull {
+
+  // If
+  __block NSUInteger evictedLogsCount = 0;
+  self.sut.evictionHandler = ^(NSDictionary<NSString *, NSNumber *> *evictedLogsCounts) {
+    evictedLogsCount += evictedLogsCounts[kMSACTestGroupId].unsignedIntegerValue;
+  };
+  self.sut.compressionEnabled = NO;
+  self.sut.evictionHeadroom = 0;
+  [self.sut setMaxStorageSize:16 * 1024 completionHandler:nil];
+
+  // When
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:100 size:@500 groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+
+  // Then
+  XCTAssertGreaterThan(evictedLogsCount, 0);
+  XCTAssertLessThanOrEqual([self.sut totalSize], 16 * 1024);
+  NSUInteger count = [self.sut countLogs];
+  XCTAssertEqual(count + evictedLogsCount, 100);
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:100 batchId:nil];
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:[logs subarrayWithRange:NSMakeRange(100 - count, count)]]);
+}
+
+- (void)testCriticalLogsAreNotEvictedForNormalLogs {
+
+  // If
+  self.sut.compressionEnabled = NO;
+  [self.sut setMaxStorageSize:16 * 1024 completionHandler:nil];
+  while ([self.sut totalSize] < 14 * 1024) {
+    [self saveLogsWithCount:1 size:@500 groupId:kMSACTestGroupId flags:MSACFlagsCritical];
+  }
+  NSUInteger criticalLogsCount = [self.sut countLogs];
+
+  // When
+  BOOL saved = YES;
+  for (int i = 0; i < 10 && saved; i++) {
+    saved = [self.sut saveLog:[self logWithSize:@500] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  }
+
+  // Then
+  XCTAssertFalse(saved);
+  XCTAssertGreaterThanOrEqual([self.sut countLogs], criticalLogsCount);
+
+  // When
+  criticalLogsCount = [self.sut countLogs];
+  unsigned long long totalSize = [self.sut totalSize];
+  saved = [self.sut saveLog:[self logWithSize:@500] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+
+  // Then
+  XCTAssertFalse(saved);
+  XCTAssertEqual([self.sut countLogs], criticalLogsCount);
+  XCTAssertEqual([self.sut totalSize], totalSize);
+}
+
+- (void)testNormalLogsAreSavedAtCapacityWhenOldestSegmentHoldsCriticalLogs {
+
+  // If
+  __block NSUInteger evictedLogsCount = 0;
+  self.sut.evictionHandler = ^(NSDictionary<NSString *, NSNumber *> *evictedLogsCounts) {
+    evictedLogsCount += evictedLogsCounts[kMSACTestGroupId].unsignedIntegerValue;
+  };
+  self.sut.compressionEnabled = NO;
+  self.sut.evictionHeadroom = 0;
+  self.sut.maxSegmentSizeInBytes = 2 * 1024;
+  [self.sut setMaxStorageSize:16 * 1024 completionHandler:nil];
+  NSArray<id<MSACLog>> *criticalLogs = [self saveLogsWithCount:8 size:@500 groupId:kMSACTestGroupId flags:MSACFlagsCritical];
+
+  // When
+  BOOL saved = YES;
+  for (int i = 0; i < 100 && saved; i++) {
+    saved = [self.sut saveLog:[self logWithSize:@500] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  }
+
+  // Then
+  XCTAssertTrue(saved);
+  XCTAssertGreaterThan(evictedLogsCount, 0);
+  XCTAssertLessThanOrEqual([self.sut totalSize], 16 * 1024);
+  XCTAssertEqual([self.sut countLogs] + evictedLogsCount, 108);
+
+  // When
+  [self reopenStorage];
+
+  // Then
+  XCTAssertEqual([self.sut countLogs] + evictedLogsCount, 108);
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:8 batchId:nil];
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:criticalLogs]);
+}
+
+- (void)testExpiredLogsAreDeleted {
+
+  // If
+  [self.sut setTimeToLive:60 forGroupId:nil flags:MSACFlagsNormal];
+  [self saveLogsWithCount:3 size:nil groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self saveLogsWithCount:2 size:nil groupId:kMSACTestGroupId flags:MSACFlagsCritical];
+  for (MSACLogSegmentEntry *entry in self.sut.groups[kMSACTestGroupId].entries) {
+    entry.timestamp -= 120;
+  }
+  NSArray<id<MSACLog>> *newLogs = [self saveLogsWithCount:1 size:nil groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+
+  // When
+  NSDictionary<NSString *, NSNumber *> *expiredLogsCounts = [self.sut deleteExpiredLogsWithLimit:100];
+
+  // Then
+  XCTAssertEqualObjects(expiredLogsCounts, @{kMSACTestGroupId : @3});
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:nil];
+  XCTAssertEqual(loadedLogs.count, 3);
+  XCTAssertEqualObjects([self sidsOfLogs:@[ loadedLogs.lastObject ]], [self sidsOfLogs:newLogs]);
+}
+
+- (void)testDeleteLogsWithGroupId {
+
+  // If
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:3 size:nil groupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self saveLogsWithCount:2 size:nil groupId:kMSACAnotherTestGroupId flags:MSACFlagsNormal];
+  [self loadLogsWithGroupId:kMSACTestGroupId limit:1 batchId:nil];
+
+  // When
+  NSArray<id<MSACLog>> *deletedLogs = [self.sut deleteLogsWithGroupId:kMSACTestGroupId];
+
+  // Then
+  XCTAssertEqualObjects([self sidsOfLogs:deletedLogs], [self sidsOfLogs:logs]);
+  XCTAssertEqual([self segmentURLsOfGroupId:kMSACTestGroupId].count, 0);
+  XCTAssertEqual([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], 0);
+
+  // When
+  [self reopenStorage];
+
+  // Then
+  XCTAssertEqual([self.sut countLogs], 2);
+}
+
+- (void)testCommonSchemaLogTargetTokenIsSavedAndRestored {
+
+  // If
+  NSString *testTargetToken = @"targetKey-secret";
+  MSACCommonSchemaLog *log = [MSACCommonSchemaLog new];
+  [log addTransmissionTargetToken:testTargetToken];
+
+  // When
+  [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+  [self reopenStorage];
+
+  // Then
+  XCTAssertEqual([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:@[ @"targetKey" ]], 0);
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:1 batchId:nil];
+  XCTAssertEqualObjects([loadedLogs[0] transmissionTargetTokens], [NSSet setWithObject:testTargetToken]);
+}
+
+#pragma mark - Helper
+
+- (void)reopenStorage {
+  [self.sut close];
+  self.sut = [[MSACLogSegmentStorage alloc] initWithDirectoryURL:self.directoryURL];
+}
+
+- (id<MSACLog>)logWithSize:(NSNumber *)size {
+  MSACLogWithProperties *log = [MSACLogWithProperties new];
+  if (size) {
+    NSString *s = [@"" stringByPaddingToLength:[size unsignedIntegerValue] withString:@"." startingAtIndex:0];
+    log.properties = [NSMutableDictionary new];
+    [log.properties setValue:s forKey:@"s"];
+  }
+  log.sid = MSAC_UUID_STRING;
+  return log;
+}
+
+- (NSArray<id<MSACLog>> *)saveLogsWithCount:(NSUInteger)count size:(NSNumber *)size groupId:(NSString *)groupId flags:(MSACFlags)flags {
+  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray new];
+  for (NSUInteger i = 0; i < count; i++) {
+    id<MSACLog> log = [self logWithSize:size];
+    XCTAssertTrue([self.sut saveLog:log withGroupId:groupId flags:flags]);
+    [logs addObject:log];
+  }
+  return logs;
+}
+
+- (NSArray<id<MSACLog>> *)loadLogsWithGroupId:(NSString *)groupId limit:(NSUInteger)limit batchId:(NSString **)batchId {
+  __block NSArray<id<MSACLog>> *loadedLogs;
+  NSString *loadedBatchId;
+  [self.sut loadLogsWithGroupId:groupId
+                          limit:limit
+             excludedTargetKeys:nil
+              completionHandler:^(NSArray<id<MSACLog>> *_Nonnull logArray, NSString *_Nullable loadBatchId) {
+                loadedLogs = logArray;
+                loadedBatchId = loadBatchId;
+              }];
+  if (batchId) {
+    *batchId = loadedBatchId;
+  }
+  return loadedLogs;
+}
+
+- (NSArray<NSString *> *)sidsOfLogs:(NSArray<id<MSACLog>> *)logs {
+  NSMutableArray<NSString *> *sids = [NSMutableArray new];
+  for (id<MSACLog> log in logs) {
+    [sids addObject:log.sid ?: @""];
+  }
+  return sids;
+}
+
+- (NSArray<NSURL *> *)segmentURLsOfGroupId:(NSString *)groupId {
+  NSURL *groupURL = [self.directoryURL URLByAppendingPathComponent:groupId];
+  NSArray<NSURL *> *fileURLs = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:groupURL
+                                                             includingPropertiesForKeys:nil
+                                                                                options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                                  error:nil];
+  return [fileURLs sortedArrayUsingComparator:^NSComparisonResult(NSURL *url1, NSURL *url2) {
+    return [url1.lastPathComponent compare:url2.lastPathComponent];
+  }];
+}
+
+- (unsigned long long)sizeOfFileAtURL:(NSURL *)fileURL {
+  return [[[NSFileManager defaultManager] attributesOfItemAtPath:(NSString *)fileURL.path error:nil] fileSize];
+}
+
+@end
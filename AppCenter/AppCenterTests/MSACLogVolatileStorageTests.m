@@ -0,0 +1,233 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACAbstractLogInternal.h"
+#import "MSACCommonSchemaLog.h"
+#import "MSACLogVolatileStorage.h"
+#import "MSACTestFrameworks.h"
+#import "MSACUtility.h"
+
+static NSString *const kMSACTestGroupId = @"TestGroupId";
+static NSString *const kMSACAnotherTestGroupId = @"AnotherGroupId";
+
+@interface MSACLogVolatileStorageTests : XCTestCase
+
+@property(nonatomic) MSACLogVolatileStorage *sut;
+
+@end
+
+@implementation MSACLogVolatileStorageTests
+
+#pragma mark - Setup
+
+- (void)setUp {
+  [super setUp];
+  self.sut = [[MSACLogVolatileStorage alloc] initWithCapacity:5];
+}
+
+#pragma mark - Tests
+
+- (void)testSaveAndLoadLogs {
+
+  // If
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:3 groupId:kMSACTestGroupId];
+  [self saveLogsWithCount:2 groupId:kMSACAnotherTestGroupId];
+
+  // When
+  NSString *loadedBatchId;
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:&loadedBatchId];
+
+  // Then
+  XCTAssertNotNil(loadedBatchId);
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:logs]);
+  XCTAssertEqual([self.sut countLogs], 5);
+  XCTAssertEqual([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:nil], 3);
+
+  // When
+  loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:&loadedBatchId];
+
+  // Then
+  XCTAssertEqual(loadedLogs.count, 0);
+  XCTAssertNil(loadedBatchId);
+}
+
+- (void)testLoadLogsReturnsMoreLogsAvailable {
+
+  // If
+  [self saveLogsWithCount:3 groupId:kMSACTestGroupId];
+
+  // When
+  BOOL moreLogsAvailable = [self.sut loadLogsWithGroupId:kMSACTestGroupId limit:2 excludedTargetKeys:nil completionHandler:nil];
+
+  // Then
+  XCTAssertTrue(moreLogsAvailable);
+
+  // When
+  moreLogsAvailable = [self.sut loadLogsWithGroupId:kMSACTestGroupId limit:2 excludedTargetKeys:nil completionHandler:nil];
+
+  // Then
+  XCTAssertFalse(moreLogsAvailable);
+}
+
+- (void)testOldestLogIsDroppedWhenStorageIsFull {
+
+  // If
+  __block NSDictionary<NSString *, NSNumber *> *droppedLogsCounts;
+  self.sut.evictionHandler = ^(NSDictionary<NSString *, NSNumber *> *logsCounts) {
+    droppedLogsCounts = logsCounts;
+  };
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:5 groupId:kMSACTestGroupId];
+
+  // When
+  NSArray<id<MSACLog>> *newLogs = [self saveLogsWithCount:1 groupId:kMSACTestGroupId];
+
+  // Then
+  XCTAssertEqualObjects(droppedLogsCounts, @{kMSACTestGroupId : @1});
+  XCTAssertEqual([self.sut countLogs], 5);
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:10 batchId:nil];
+  NSMutableArray<id<MSACLog>> *expectedLogs = [[logs subarrayWithRange:NSMakeRange(1, 4)] mutableCopy];
+  [expectedLogs addObjectsFromArray:newLogs];
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:expectedLogs]);
+}
+
+- (void)testLogsOfBatchesAreNotDropped {
+
+  // If
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:5 groupId:kMSACTestGroupId];
+  [self loadLogsWithGroupId:kMSACTestGroupId limit:5 batchId:nil];
+
+  // When
+  BOOL saved = [self.sut saveLog:[self log] withGroupId:kMSACTestGroupId flags:MSACFlagsVolatile];
+
+  // Then
+  XCTAssertFalse(saved);
+  XCTAssertEqual([self.sut countLogs], logs.count);
+}
+
+- (void)testReleasedBatchIsLoadedAgain {
+
+  // If
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:2 groupId:kMSACTestGroupId];
+  NSString *batchId;
+  [self loadLogsWithGroupId:kMSACTestGroupId limit:2 batchId:&batchId];
+
+  // When
+  [self.sut releaseLogsWithBatchId:batchId groupId:kMSACTestGroupId];
+
+  // Then
+  NSArray<id<MSACLog>> *loadedLogs = [self loadLogsWithGroupId:kMSACTestGroupId limit:2 batchId:nil];
+  XCTAssertEqualObjects([self sidsOfLogs:loadedLogs], [self sidsOfLogs:logs]);
+}
+
+- (void)testDeleteLogsWithBatchId {
+
+  // If
+  [self saveLogsWithCount:3 groupId:kMSACTestGroupId];
+  NSString *batchId;
+  [self loadLogsWithGroupId:kMSACTestGroupId limit:2 batchId:&batchId];
+
+  // When
+  [self.sut deleteLogsWithBatchId:batchId groupId:kMSACTestGroupId];
+
+  // Then
+  XCTAssertEqual([self.sut countLogs], 1);
+}
+
+- (void)testDeleteLogsWithGroupId {
+
+  // If
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:3 groupId:kMSACTestGroupId];
+  [self saveLogsWithCount:2 groupId:kMSACAnotherTestGroupId];
+  [self loadLogsWithGroupId:kMSACTestGroupId limit:1 batchId:nil];
+
+  // When
+  NSArray<id<MSACLog>> *deletedLogs = [self.sut deleteLogsWithGroupId:kMSACTestGroupId];
+
+  // Then
+  XCTAssertEqualObjects([self sidsOfLogs:deletedLogs], [self sidsOfLogs:logs]);
+  XCTAssertEqual([self.sut countLogs], 2);
+}
+
+- (void)testMoveLogsToStorageKeepsLogsOfBatches {
+
+  // If
+  id storageMock = OCMProtocolMock(@protocol(MSACStorage));
+  OCMStub([storageMock saveLog:OCMOCK_ANY withGroupId:OCMOCK_ANY flags:MSACFlagsNormal]).andReturn(YES);
+  NSArray<id<MSACLog>> *logs = [self saveLogsWithCount:3 groupId:kMSACTestGroupId];
+  NSArray<id<MSACLog>> *anotherLogs = [self saveLogsWithCount:1 groupId:kMSACAnotherTestGroupId];
+  [self loadLogsWithGroupId:kMSACTestGroupId limit:1 batchId:nil];
+
+  // When
+  NSDictionary<NSString *, NSNumber *> *movedLogsCounts = [self.sut moveLogsToStorage:storageMock];
+
+  // Then
+  XCTAssertEqualObjects(movedLogsCounts, (@{kMSACTestGroupId : @2, kMSACAnotherTestGroupId : @1}));
+  OCMVerify([storageMock saveLog:logs[1] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal]);
+  OCMVerify([storageMock saveLog:logs[2] withGroupId:kMSACTestGroupId flags:MSACFlagsNormal]);
+  OCMVerify([storageMock saveLog:anotherLogs[0] withGroupId:kMSACAnotherTestGroupId flags:MSACFlagsNormal]);
+  XCTAssertEqual([self.sut countLogs], 1);
+  [storageMock stopMocking];
+}
+
+- (void)testCommonSchemaLogOfPausedTargetIsNotLoaded {
+
+  // If
+  MSACCommonSchemaLog *log = [MSACCommonSchemaLog new];
+  [log addTransmissionTargetToken:@"targetKey-secret"];
+  [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsVolatile];
+
+  // When
+  BOOL moreLogsAvailable = [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                                                   limit:1
+                                      excludedTargetKeys:@[ @"targetKey" ]
+                                       completionHandler:nil];
+
+  // Then
+  XCTAssertFalse(moreLogsAvailable);
+  XCTAssertEqual([self.sut countLogsWithGroupId:kMSACTestGroupId excludedTargetKeys:@[ @"targetKey" ]], 0);
+  XCTAssertEqual([self loadLogsWithGroupId:kMSACTestGroupId limit:1 batchId:nil].count, 1);
+}
+
+#pragma mark - Helper
+
+- (id<MSACLog>)log {
+  MSACAbstractLog *log = [MSACAbstractLog new];
+  log.sid = MSAC_UUID_STRING;
+  return log;
+}
+
+- (NSArray<id<MSACLog>> *)saveLogsWithCount:(NSUInteger)count groupId:(NSString *)groupId {
+  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray new];
+  for (NSUInteger i = 0; i < count; i++) {
+    id<MSACLog> log = [self log];
+    XCTAssertTrue([self.sut saveLog:log withGroupId:groupId flags:MSACFlagsVolatile]);
+    [logs addObject:log];
+  }
+  return logs;
+}
+
+- (NSArray<id<MSACLog>> *)loadLogsWithGroupId:(NSString *)groupId limit:(NSUInteger)limit batchId:(NSString **)batchId {
+  __block NSArray<id<MSACLog>> *loadedLogs;
+  __block NSString *loadedBatchId;
+  [self.sut loadLogsWithGroupId:groupId
+                          limit:limit
+             excludedTargetKeys:nil
+              completionHandler:^(NSArray<id<MSACLog>> *_Nonnull logArray, NSString *_Nullable loadBatchId) {
+                loadedLogs = logArray;
+                loadedBatchId = loadBatchId;
+              }];
+  if (batchId) {
+    *batchId = loadedBatchId;
+  }
+  return loadedLogs;
+}
+
+- (NSArray<NSString *> *)sidsOfLogs:(NSArray<id<MSACLog>> *)logs {
+  NSMutableArray<NSString *> *sids = [NSMutableArray new];
+  for (id<MSACLog> log in logs) {
+    [sids addObject:log.sid];
+  }
+  return sids;
+}
+
+@end
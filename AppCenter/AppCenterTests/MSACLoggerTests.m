@@ -28,7 +28,11 @@
   id channelGroupMock = OCMClassMock([MSACChannelGroupDefault class]);
   id channelUnitMock = OCMProtocolMock(@protocol(MSACChannelUnitProtocol));
   OCMStub([channelGroupMock alloc]).andReturn(channelGroupMock);
-  OCMStub([channelGroupMock initWithHttpClient:OCMOCK_ANY installId:OCMOCK_ANY logUrl:OCMOCK_ANY]).andReturn(channelGroupMock);
+  OCMStub([channelGroupMock initWithHttpClient:OCMOCK_ANY
+                                     installId:OCMOCK_ANY
+                                        logUrl:OCMOCK_ANY
+                                storageBackend:MSACStorageBackendDatabase])
+      .andReturn(channelGroupMock);
   OCMStub([channelGroupMock addChannelUnitWithConfiguration:OCMOCK_ANY]).andReturn(channelUnitMock);
 
   // Check default loglevel before MSACAppCenter was started.
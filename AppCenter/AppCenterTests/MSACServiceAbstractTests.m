@@ -93,7 +93,11 @@
   self.channelGroupMock = OCMClassMock([MSACChannelGroupDefault class]);
   self.channelUnitMock = OCMProtocolMock(@protocol(MSACChannelUnitProtocol));
   OCMStub([self.channelGroupMock alloc]).andReturn(self.channelGroupMock);
-  OCMStub([self.channelGroupMock initWithHttpClient:OCMOCK_ANY installId:OCMOCK_ANY logUrl:OCMOCK_ANY]).andReturn(self.channelGroupMock);
+  OCMStub([self.channelGroupMock initWithHttpClient:OCMOCK_ANY
+                                          installId:OCMOCK_ANY
+                                             logUrl:OCMOCK_ANY
+                                     storageBackend:MSACStorageBackendDatabase])
+      .andReturn(self.channelGroupMock);
   OCMStub([self.channelGroupMock addChannelUnitWithConfiguration:OCMOCK_ANY]).andReturn(self.channelUnitMock);
 
   // System Under Test.
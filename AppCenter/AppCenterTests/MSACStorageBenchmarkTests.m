@@ -0,0 +1,402 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import <malloc/malloc.h>
+#import <sqlite3.h>
+
+#import "MSACAppCenter.h"
+#import "MSACDBStoragePrivate.h"
+#import "MSACDBStorageProfile.h"
+#import "MSACLogDBStoragePrivate.h"
+#import "MSACLogWithProperties.h"
+#import "MSACTestFrameworks.h"
+#import "MSACUtility.h"
+
+/*
+ * Benchmarks of the database storage as it fills up, driven with synthetic logs of various sizes and priorities.
+ *
+ * A reduced sweep runs by default. Set the `MSAC_STORAGE_BENCHMARK_SCALE` environment variable to `full` for the complete sweep
+ * (`TEST_RUNNER_MSAC_STORAGE_BENCHMARK_SCALE` when running xcodebuild). Results are written as JSON to the path in
+ * `MSAC_STORAGE_BENCHMARK_OUTPUT`, or to the temporary directory, so that they can be compared between releases.
+ */
+
+static NSString *const kMSACTestGroupId = @"BenchmarkGroupId";
+static NSString *const kMSACBenchmarkScaleEnvironmentKey = @"MSAC_STORAGE_BENCHMARK_SCALE";
+static NSString *const kMSACBenchmarkOutputEnvironmentKey = @"MSAC_STORAGE_BENCHMARK_OUTPUT";
+static NSUInteger const kMSACBenchmarkResultsVersion = 1;
+
+// Storage size used by the fill level sweeps, small enough to be filled quickly.
+static long const kMSACBenchmarkStorageSize = 2 * 1024 * 1024;
+
+// Storage size used when the number of rows matters, large enough to never evict.
+static long const kMSACBenchmarkLargeStorageSize = 256 * 1024 * 1024;
+
+// One log out of this number is saved as critical.
+static NSUInteger const kMSACBenchmarkCriticalLogsInterval = 10;
+
+static NSMutableArray<NSDictionary *> *benchmarkResults;
+
+@interface MSACStorageBenchmarkTests : XCTestCase
+
+@property(nonatomic) MSACLogDBStorage *sut;
+
+@property(nonatomic, getter=isFullScale) BOOL fullScale;
+
+@end
+
+@implementation MSACStorageBenchmarkTests
+
+#pragma mark - Housekeeping
+
++ (void)setUp {
+  [super setUp];
+  benchmarkResults = [NSMutableArray new];
+}
+
++ (void)tearDown {
+  [self writeResults];
+  [super tearDown];
+}
+
+- (void)setUp {
+  [super setUp];
+  self.fullScale = [[NSProcessInfo processInfo].environment[kMSACBenchmarkScaleEnvironmentKey] isEqualToString:@"full"];
+  self.sut = [self createStorageWithMaxSize:kMSACBenchmarkStorageSize];
+}
+
+- (void)tearDown {
+  [self.sut dropDatabase];
+  [super tearDown];
+}
+
+#pragma mark - Benchmarks
+
+- (void)testSaveLogAtFillLevels {
+  NSArray<NSNumber *> *payloadSizes = self.fullScale ? @[ @256, @1024, @4096, @16384 ] : @[ @1024 ];
+  NSUInteger samplesCount = self.fullScale ? 500 : 50;
+  for (NSNumber *payloadSize in payloadSizes) {
+    for (NSNumber *fillLevel in @[ @0.1, @0.5, @0.9 ]) {
+
+      // If
+      [self recreateStorageWithMaxSize:kMSACBenchmarkStorageSize];
+      [self fillStorageToLevel:fillLevel.doubleValue payloadSize:payloadSize.unsignedIntegerValue];
+      NSArray<id<MSACLog>> *logs = [self generateLogsWithCount:samplesCount payloadSize:payloadSize.unsignedIntegerValue];
+
+      // When
+      NSDictionary *result = [self measureOperation:@"saveLog"
+                                         parameters:@{@"fillLevel" : fillLevel, @"payloadSize" : payloadSize}
+                                       samplesCount:samplesCount
+                                          withBlock:^(NSUInteger index) {
+                                            [self.sut saveLog:logs[index]
+                                                  withGroupId:kMSACTestGroupId
+                                                        flags:[self flagsOfLogAtIndex:index]];
+                                          }];
+
+      // Then
+      XCTAssertGreaterThan([result[@"p50Ms"] doubleValue], 0);
+    }
+  }
+}
+
+- (void)testSaveLogWhenStorageIsFull {
+  NSArray<NSNumber *> *payloadSizes = self.fullScale ? @[ @256, @1024, @4096, @16384 ] : @[ @1024 ];
+  NSUInteger samplesCount = self.fullScale ? 500 : 50;
+  for (NSNumber *payloadSize in payloadSizes) {
+
+    // If
+    [self recreateStorageWithMaxSize:kMSACBenchmarkStorageSize];
+    __block NSUInteger evictedLogsCount = 0;
+    self.sut.evictionHandler = ^(NSDictionary<NSString *, NSNumber *> *evictedLogsCounts) {
+      evictedLogsCount += evictedLogsCounts[kMSACTestGroupId].unsignedIntegerValue;
+    };
+    [self fillStorageToLevel:1.0 payloadSize:payloadSize.unsignedIntegerValue];
+    evictedLogsCount = 0;
+    NSArray<id<MSACLog>> *logs = [self generateLogsWithCount:samplesCount payloadSize:payloadSize.unsignedIntegerValue];
+
+    // When
+    NSMutableDictionary *result = [self measureOperation:@"saveLogWithEviction"
+                                              parameters:@{@"fillLevel" : @1.0, @"payloadSize" : payloadSize}
+                                            samplesCount:samplesCount
+                                               withBlock:^(NSUInteger index) {
+                                                 [self.sut saveLog:logs[index]
+                                                       withGroupId:kMSACTestGroupId
+                                                             flags:[self flagsOfLogAtIndex:index]];
+                                               }];
+    result[@"evictedLogsCount"] = @(evictedLogsCount);
+
+    // Then
+    XCTAssertGreaterThan(evictedLogsCount, 0);
+  }
+}
+
+- (void)testLoadLogsWithRowsCounts {
+  NSArray<NSNumber *> *rowsCounts = self.fullScale ? @[ @1000, @10000, @100000 ] : @[ @1000 ];
+  NSArray<NSNumber *> *batchSizes = self.fullScale ? @[ @10, @50, @200 ] : @[ @50 ];
+  NSUInteger samplesCount = self.fullScale ? 200 : 20;
+  for (NSNumber *rowsCount in rowsCounts) {
+
+    // If
+    [self recreateStorageWithMaxSize:kMSACBenchmarkLargeStorageSize];
+    [self saveLogsWithCount:rowsCount.unsignedIntegerValue payloadSize:256];
+    for (NSNumber *batchSize in batchSizes) {
+
+      // When
+      NSDictionary *result = [self measureLoadLogsWithParameters:@{@"rowsCount" : rowsCount, @"batchSize" : batchSize}
+                                                    samplesCount:samplesCount
+                                                           limit:batchSize.unsignedIntegerValue
+                                              excludedTargetKeys:nil];
+
+      // Then
+      XCTAssertGreaterThan([result[@"p50Ms"] doubleValue], 0);
+    }
+  }
+}
+
+- (void)testLoadLogsWithExcludedTargetKeys {
+  NSUInteger rowsCount = self.fullScale ? 10000 : 1000;
+  NSArray<NSNumber *> *excludedKeysCounts = self.fullScale ? @[ @0, @10, @100, @500 ] : @[ @0, @100 ];
+  NSUInteger samplesCount = self.fullScale ? 200 : 20;
+
+  // If
+  [self recreateStorageWithMaxSize:kMSACBenchmarkLargeStorageSize];
+  [self saveLogsWithCount:rowsCount payloadSize:256];
+  for (NSNumber *excludedKeysCount in excludedKeysCounts) {
+    NSMutableArray<NSString *> *excludedTargetKeys = [NSMutableArray new];
+    for (NSUInteger i = 0; i < excludedKeysCount.unsignedIntegerValue; i++) {
+      [excludedTargetKeys addObject:MSAC_UUID_STRING];
+    }
+
+    // When
+    NSDictionary *parameters = @{@"rowsCount" : @(rowsCount), @"excludedTargetKeysCount" : excludedKeysCount};
+    NSDictionary *result = [self measureLoadLogsWithParameters:parameters
+                                                  samplesCount:samplesCount
+                                                         limit:50
+                                            excludedTargetKeys:excludedTargetKeys];
+
+    // Then
+    XCTAssertGreaterThan([result[@"p50Ms"] doubleValue], 0);
+  }
+}
+
+- (void)testSaveAndLoadLogsWithProfiles {
+  NSUInteger rowsCount = self.fullScale ? 10000 : 1000;
+  NSUInteger samplesCount = self.fullScale ? 500 : 50;
+  NSDictionary<NSString *, MSACDBStorageProfile *> *profiles =
+      @{@"sqliteDefaults" : [MSACDBStorageProfile sqliteDefaultsProfile], @"default" : [MSACDBStorageProfile defaultProfile]};
+  for (NSString *profileName in @[ @"sqliteDefaults", @"default" ]) {
+
+    // If
+    [self recreateStorageWithMaxSize:kMSACBenchmarkLargeStorageSize];
+    [self.sut closeConnection];
+    self.sut.profile = profiles[profileName];
+    [self saveLogsWithCount:rowsCount payloadSize:1024];
+    NSArray<id<MSACLog>> *logs = [self generateLogsWithCount:samplesCount payloadSize:1024];
+
+    // When
+    NSDictionary *saveResult = [self measureOperation:@"saveLog"
+                                           parameters:@{@"profile" : profileName, @"rowsCount" : @(rowsCount), @"payloadSize" : @1024}
+                                         samplesCount:samplesCount
+                                            withBlock:^(NSUInteger index) {
+                                              [self.sut saveLog:logs[index]
+                                                    withGroupId:kMSACTestGroupId
+                                                          flags:[self flagsOfLogAtIndex:index]];
+                                            }];
+    NSDictionary *loadParameters = @{@"profile" : profileName, @"rowsCount" : @(rowsCount), @"batchSize" : @50};
+    NSDictionary *loadResult = [self measureLoadLogsWithParameters:loadParameters
+                                                      samplesCount:samplesCount
+                                                             limit:50
+                                                excludedTargetKeys:nil];
+
+    // Then
+    XCTAssertGreaterThan([saveResult[@"p50Ms"] doubleValue], 0);
+    XCTAssertGreaterThan([loadResult[@"p50Ms"] doubleValue], 0);
+  }
+}
+
+#pragma mark - Measures
+
+- (NSDictionary *)measureLoadLogsWithParameters:(NSDictionary *)parameters
+                                   samplesCount:(NSUInteger)samplesCount
+                                          limit:(NSUInteger)limit
+                             excludedTargetKeys:(NSArray<NSString *> *)excludedTargetKeys {
+
+  // Batches are released once loaded so that every sample loads from the same number of rows.
+  return [self measureOperation:@"loadLogs"
+                     parameters:parameters
+                   samplesCount:samplesCount
+                      withBlock:^(__unused NSUInteger index) {
+                        [self.sut loadLogsWithGroupId:kMSACTestGroupId
+                                                limit:limit
+                                   excludedTargetKeys:excludedTargetKeys
+                                    completionHandler:^(__unused NSArray<id<MSACLog>> *_Nonnull logArray, NSString *batchId) {
+                                      if (batchId) {
+                                        [self.sut releaseLogsWithBatchId:(NSString *)batchId groupId:kMSACTestGroupId];
+                                      }
+                                    }];
+                      }];
+}
+
+- (NSMutableDictionary *)measureOperation:(NSString *)operation
+                               parameters:(NSDictionary *)parameters
+                             samplesCount:(NSUInteger)samplesCount
+                                withBlock:(void (^)(NSUInteger index))block {
+  NSMutableArray<NSNumber *> *latencies = [NSMutableArray arrayWithCapacity:samplesCount];
+  [self resetPagesWrittenCount];
+  malloc_statistics_t memoryBefore, memoryAfter;
+  malloc_zone_statistics(NULL, &memoryBefore);
+  for (NSUInteger i = 0; i < samplesCount; i++) {
+    @autoreleasepool {
+      CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+      block(i);
+      [latencies addObject:@((CFAbsoluteTimeGetCurrent() - start) * 1000)];
+    }
+  }
+  malloc_zone_statistics(NULL, &memoryAfter);
+  long long bytesWritten = (long long)[self pagesWrittenCount] * self.sut.pageSize;
+  [latencies sortUsingSelector:@selector(compare:)];
+  NSMutableDictionary *result = [NSMutableDictionary dictionaryWithDictionary:parameters];
+  result[@"operation"] = operation;
+  result[@"samplesCount"] = @(samplesCount);
+  result[@"p50Ms"] = [self percentile:0.5 ofSortedValues:latencies];
+  result[@"p99Ms"] = [self percentile:0.99 ofSortedValues:latencies];
+  result[@"bytesWritten"] = @(bytesWritten);
+
+  // Heap usage left by the operations once their autorelease pools are drained, as reported by malloc.
+  result[@"heapBlocksDelta"] = @((long long)memoryAfter.blocks_in_use - (long long)memoryBefore.blocks_in_use);
+  result[@"heapBytesDelta"] = @((long long)memoryAfter.size_in_use - (long long)memoryBefore.size_in_use);
+  [benchmarkResults addObject:result];
+  NSLog(@"%@ %@: p50 %.3f ms, p99 %.3f ms, %lld bytes written.", operation, parameters, [result[@"p50Ms"] doubleValue],
+        [result[@"p99Ms"] doubleValue], bytesWritten);
+  return result;
+}
+
+- (NSNumber *)percentile:(double)percentile ofSortedValues:(NSArray<NSNumber *> *)values {
+  if (values.count == 0) {
+    return @0;
+  }
+
+  // Nearest-rank method.
+  NSUInteger rank = (NSUInteger)ceil(percentile * values.count);
+  return values[MAX(rank, 1) - 1];
+}
+
+- (void)resetPagesWrittenCount {
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    int current, highest;
+    return sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_WRITE, &current, &highest, 1);
+  }];
+}
+
+- (int)pagesWrittenCount {
+  __block int pagesWritten = 0;
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    int highest;
+    return sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_WRITE, &pagesWritten, &highest, 0);
+  }];
+  return pagesWritten;
+}
+
+- (long)usedSize {
+  __block long usedPagesCount = 0;
+  [self.sut executeQueryUsingBlock:^int(void *db) {
+    usedPagesCount = [MSACDBStorage getPageCountInOpenedDatabase:db] - [MSACDBStorage getFreePageCountInOpenedDatabase:db];
+    return SQLITE_OK;
+  }];
+  return usedPagesCount * self.sut.pageSize;
+}
+
+#pragma mark - Results
+
++ (void)writeResults {
+  NSString *outputPath = [NSProcessInfo processInfo].environment[kMSACBenchmarkOutputEnvironmentKey];
+  if (outputPath.length == 0) {
+    outputPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"MSACStorageBenchmark.json"];
+  }
+  NSDictionary *report = @{
+    @"version" : @(kMSACBenchmarkResultsVersion),
+    @"sdkVersion" : MSACAppCenter.sdkVersion,
+    @"sqliteVersion" : @(sqlite3_libversion()),
+    @"date" : [[NSISO8601DateFormatter new] stringFromDate:[NSDate date]],
+    @"scale" : [[NSProcessInfo processInfo].environment[kMSACBenchmarkScaleEnvironmentKey] isEqualToString:@"full"] ? @"full" : @"reduced",
+    @"results" : benchmarkResults ?: @[]
+  };
+  NSError *error;
+  NSData *data = [NSJSONSerialization dataWithJSONObject:report options:NSJSONWritingPrettyPrinted error:&error];
+  if (![data writeToFile:outputPath options:NSDataWritingAtomic error:&error]) {
+    NSLog(@"Failed to write the storage benchmark results: %@", error);
+    return;
+  }
+  NSLog(@"Storage benchmark results written to %@", outputPath);
+}
+
+#pragma mark - Private
+
+- (MSACLogDBStorage *)createStorageWithMaxSize:(long)maxSize {
+  MSACLogDBStorage *storage = [MSACLogDBStorage new];
+  [storage setMaxStorageSize:maxSize completionHandler:nil];
+  return storage;
+}
+
+- (void)recreateStorageWithMaxSize:(long)maxSize {
+  [self.sut dropDatabase];
+  self.sut = [self createStorageWithMaxSize:maxSize];
+}
+
+- (void)fillStorageToLevel:(double)fillLevel payloadSize:(NSUInteger)payloadSize {
+
+  // A full storage is one that started evicting logs to save new ones.
+  __block BOOL evicted = NO;
+  MSACLogEvictionHandler evictionHandler = self.sut.evictionHandler;
+  self.sut.evictionHandler = ^(NSDictionary<NSString *, NSNumber *> *evictedLogsCounts) {
+    evicted = YES;
+    if (evictionHandler) {
+      evictionHandler(evictedLogsCounts);
+    }
+  };
+  long targetSize = (long)(fillLevel * self.sut.maxSizeInBytes);
+  NSUInteger index = 0;
+  while (!evicted && (fillLevel >= 1.0 || [self usedSize] < targetSize)) {
+    @autoreleasepool {
+      for (id<MSACLog> log in [self generateLogsWithCount:20 payloadSize:payloadSize]) {
+        [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:[self flagsOfLogAtIndex:index++]];
+      }
+    }
+  }
+  self.sut.evictionHandler = evictionHandler;
+}
+
+- (void)saveLogsWithCount:(NSUInteger)count payloadSize:(NSUInteger)payloadSize {
+  for (NSUInteger i = 0; i < count; i += 100) {
+    @autoreleasepool {
+      NSUInteger index = i;
+      for (id<MSACLog> log in [self generateLogsWithCount:MIN(100, count - i) payloadSize:payloadSize]) {
+        [self.sut saveLog:log withGroupId:kMSACTestGroupId flags:[self flagsOfLogAtIndex:index++]];
+      }
+    }
+  }
+}
+
+- (MSACFlags)flagsOfLogAtIndex:(NSUInteger)index {
+  return index % kMSACBenchmarkCriticalLogsInterval ? MSACFlagsNormal : MSACFlagsCritical;
+}
+
+- (NSArray<id<MSACLog>> *)generateLogsWithCount:(NSUInteger)count payloadSize:(NSUInteger)payloadSize {
+
+  // Payloads are made of random identifiers so that they don't compress much better than real properties.
+  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray arrayWithCapacity:count];
+  for (NSUInteger i = 0; i < count; i++) {
+    NSMutableString *payload = [NSMutableString stringWithCapacity:payloadSize];
+    while (payload.length < payloadSize) {
+      [payload appendString:MSAC_UUID_STRING];
+    }
+    MSACLogWithProperties *log = [MSACLogWithProperties new];
+    log.type = @"event";
+    log.sid = MSAC_UUID_STRING;
+    log.timestamp = [NSDate date];
+    log.properties = @{@"payload" : [payload substringToIndex:payloadSize]};
+    [logs addObject:log];
+  }
+  return logs;
+}
+
+@end
@@ -1,14 +1,40 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
-#import "MSACLogDBStorage.h"
+#import <sqlite3.h>
+
+#import "MSACBinaryArchiver.h"
+#import "MSACBinaryUnarchiver.h"
+#import "MSACCSData.h"
+#import "MSACCommonSchemaLog.h"
+#import "MSACDBStoragePrivate.h"
+#import "MSACLogCompressionDictionary.h"
+#import "MSACLogDBStoragePrivate.h"
+#import "MSACLogSegmentStoragePrivate.h"
+#import "MSACLogWithProperties.h"
+#import "MSACModelTestsUtililty.h"
 #import "MSACStartServiceLog.h"
 #import "MSACTestFrameworks.h"
+#import "MSACUtility.h"
 
 static const int kMSACNumLogs = 50;
 static const int kMSACNumServices = 5;
 static NSString *const kMSACTestGroupId = @"TestGroupId";
 
+/*
+ * Write-ahead log hook checkpointing the log at the same threshold as the automatic checkpoint it replaces, and counting the pages
+ * copied to the database file.
+ */
+static int MSACCountingCheckpointHook(void *context, sqlite3 *db, const char *dbName, int pageCount) {
+  if (pageCount >= kMSACWALAutoCheckpointPageCount) {
+    int logPageCount = 0;
+    int checkpointedPageCount = 0;
+    sqlite3_wal_checkpoint_v2(db, dbName, SQLITE_CHECKPOINT_PASSIVE, &logPageCount, &checkpointedPageCount);
+    *(int *)context += checkpointedPageCount;
+  }
+  return SQLITE_OK;
+}
+
 @interface MSACStoragePerformanceTests : XCTestCase
 @end
 
@@ -16,6 +42,10 @@ static NSString *const kMSACTestGroupId = @"TestGroupId";
 
 @property(nonatomic) MSACLogDBStorage *dbStorage;
 
+@property(nonatomic) NSURL *segmentsDirectoryURL;
+
+@property(nonatomic) MSACLogSegmentStorage *segmentStorage;
+
 @end
 
 @implementation MSACStoragePerformanceTests
@@ -25,10 +55,14 @@ static NSString *const kMSACTestGroupId = @"TestGroupId";
 - (void)setUp {
   [super setUp];
   self.dbStorage = [MSACLogDBStorage new];
+  self.segmentsDirectoryURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:MSAC_UUID_STRING];
+  self.segmentStorage = [[MSACLogSegmentStorage alloc] initWithDirectoryURL:self.segmentsDirectoryURL];
 }
 
 - (void)tearDown {
   [self.dbStorage deleteLogsWithGroupId:kMSACTestGroupId];
+  [self.segmentStorage close];
+  [[NSFileManager defaultManager] removeItemAtURL:self.segmentsDirectoryURL error:nil];
   [super tearDown];
 }
 
@@ -90,8 +124,410 @@ static NSString *const kMSACTestGroupId = @"TestGroupId";
   }];
 }
 
+#pragma mark - Segment storage tests
+
+- (void)testSegmentStorageWriteShortLogsPerformance {
+  NSArray<MSACStartServiceLog *> *arrayOfLogs = [self generateLogsWithShortServicesNames:kMSACNumLogs withNumService:kMSACNumServices];
+  [self measureBlock:^{
+    for (MSACStartServiceLog *log in arrayOfLogs) {
+      [self.segmentStorage saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+    }
+  }];
+}
+
+- (void)testSegmentStorageWriteLongLogsPerformance {
+  NSArray<MSACStartServiceLog *> *arrayOfLogs = [self generateLogsWithLongServicesNames:kMSACNumLogs withNumService:kMSACNumServices];
+  [self measureBlock:^{
+    for (MSACStartServiceLog *log in arrayOfLogs) {
+      [self.segmentStorage saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+    }
+  }];
+}
+
+- (void)testSegmentStorageWriteVeryLongLogsPerformance {
+  NSArray<MSACStartServiceLog *> *arrayOfLogs = [self generateLogsWithVeryLongServicesNames:kMSACNumLogs withNumService:kMSACNumServices];
+  [self measureBlock:^{
+    for (MSACStartServiceLog *log in arrayOfLogs) {
+      [self.segmentStorage saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+    }
+  }];
+}
+
+- (void)testSegmentStorageSaveLoadAndDeleteLogsPerformance {
+  NSArray<id<MSACLog>> *logs = [self generateEventLogs:kMSACNumLogs * 4];
+  [self measureBlock:^{
+    [self compareStorage:self.segmentStorage withLogs:logs];
+  }];
+}
+
+- (void)testSegmentStorageVersusDatabase {
+
+  /*
+   * Write amplification is the number of bytes written to disk by archived byte. SQLite pages written to the write-ahead log are counted,
+   * and so are their copies to the database file when checkpointing. Segment files count the rewrites and moves of compaction.
+   */
+  NSArray<id<MSACLog>> *logs = [self generateEventLogs:kMSACNumLogs * 10];
+  NSUInteger archivedSize = 0;
+  for (NSData *data in [self archiveLogs:logs]) {
+    archivedSize += data.length;
+  }
+  int checkpointedPageCount = 0;
+  int *checkpointedPageCounter = &checkpointedPageCount;
+  [self.dbStorage executeQueryUsingBlock:^int(void *db) {
+    int current, highest;
+    sqlite3_wal_hook(db, MSACCountingCheckpointHook, checkpointedPageCounter);
+    return sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_WRITE, &current, &highest, 1);
+  }];
+  NSDictionary<NSString *, NSNumber *> *dbMetrics = [self compareStorage:self.dbStorage withLogs:logs];
+  __block int pagesWritten = 0;
+  [self.dbStorage executeSynchronousQueryUsingBlock:^int(void *db) {
+    int highest;
+    sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_WRITE, &pagesWritten, &highest, 0);
+
+    // The pages left in the write-ahead log are copied by a later checkpoint.
+    int logPageCount = 0;
+    int finalPageCount = 0;
+    int result = sqlite3_wal_checkpoint_v2(db, NULL, SQLITE_CHECKPOINT_TRUNCATE, &logPageCount, &finalPageCount);
+    *checkpointedPageCounter += finalPageCount;
+    sqlite3_wal_autocheckpoint(db, kMSACWALAutoCheckpointPageCount);
+    return result;
+  }];
+  pagesWritten += checkpointedPageCount;
+  unsigned long long segmentBytesWritten = self.segmentStorage.bytesWritten;
+  NSDictionary<NSString *, NSNumber *> *segmentMetrics = [self compareStorage:self.segmentStorage withLogs:logs];
+  segmentBytesWritten = self.segmentStorage.bytesWritten - segmentBytesWritten;
+  NSLog(@"Database: %.0f logs/s, %.2f ms by batch, write amplification: %.2f.", dbMetrics[@"throughput"].doubleValue,
+        dbMetrics[@"latency"].doubleValue * 1000, (double)pagesWritten * self.dbStorage.pageSize / archivedSize);
+  NSLog(@"Segment files: %.0f logs/s, %.2f ms by batch, write amplification: %.2f.", segmentMetrics[@"throughput"].doubleValue,
+        segmentMetrics[@"latency"].doubleValue * 1000, (double)segmentBytesWritten / archivedSize);
+  XCTAssertEqual([self.segmentStorage countLogs], 0);
+}
+
+#pragma mark - Serialization tests
+
+- (void)testKeyedArchiverEncodePerformance {
+  NSDictionary<NSString *, NSArray<id<MSACLog>> *> *logsByKind = [self generateSerializationLogs];
+  [self measureBlock:^{
+    for (NSArray<id<MSACLog>> *logs in [logsByKind objectEnumerator]) {
+      for (id<MSACLog> log in logs) {
+        [MSACUtility archiveKeyedData:log];
+      }
+    }
+  }];
+  [self logArchivedSizesOfLogs:logsByKind
+                  archiverName:@"Keyed archiver"
+                    usingBlock:^NSData *(id<MSACLog> log) {
+                      return [MSACUtility archiveKeyedData:log];
+                    }];
+}
+
+- (void)testBinaryArchiverEncodePerformance {
+  NSDictionary<NSString *, NSArray<id<MSACLog>> *> *logsByKind = [self generateSerializationLogs];
+  [self measureBlock:^{
+    for (NSArray<id<MSACLog>> *logs in [logsByKind objectEnumerator]) {
+      for (id<MSACLog> log in logs) {
+        [MSACBinaryArchiver archivedDataWithRootObject:log];
+      }
+    }
+  }];
+  [self logArchivedSizesOfLogs:logsByKind
+                  archiverName:@"Binary archiver"
+                    usingBlock:^NSData *(id<MSACLog> log) {
+                      return [MSACBinaryArchiver archivedDataWithRootObject:log];
+                    }];
+}
+
+- (void)testKeyedArchiverDecodePerformance {
+  NSMutableArray<NSData *> *arrayOfData = [NSMutableArray new];
+  for (NSArray<id<MSACLog>> *logs in [[self generateSerializationLogs] objectEnumerator]) {
+    for (id<MSACLog> log in logs) {
+      [arrayOfData addObject:[MSACUtility archiveKeyedData:log]];
+    }
+  }
+  [self measureBlock:^{
+    for (NSData *data in arrayOfData) {
+      [MSACUtility unarchiveKeyedData:data];
+    }
+  }];
+}
+
+- (void)testBinaryArchiverDecodePerformance {
+  NSMutableArray<NSData *> *arrayOfData = [NSMutableArray new];
+  for (NSArray<id<MSACLog>> *logs in [[self generateSerializationLogs] objectEnumerator]) {
+    for (id<MSACLog> log in logs) {
+      [arrayOfData addObject:[MSACBinaryArchiver archivedDataWithRootObject:log]];
+    }
+  }
+  [self measureBlock:^{
+    for (NSData *data in arrayOfData) {
+      [MSACBinaryUnarchiver unarchivedObjectWithData:data];
+    }
+  }];
+}
+
+#pragma mark - Selection tests
+
+- (void)testBoxedRowsSelectionPerformance {
+  [self saveLogs:[self generateLogsWithLongServicesNames:kMSACNumLogs withNumService:kMSACNumServices]];
+  NSString *query = [NSString stringWithFormat:@"SELECT * FROM \"%@\"", kMSACLogTableName];
+  [self measureSelectionBlock:^{
+    for (NSArray *row in [self.dbStorage executeSelectionQuery:query withValues:nil]) {
+      [MSACLogDBStorage unarchiveLogFromColumnValue:row[2]];
+    }
+  }];
+}
+
+- (void)testStreamedRowsSelectionPerformance {
+  [self saveLogs:[self generateLogsWithLongServicesNames:kMSACNumLogs withNumService:kMSACNumServices]];
+  NSString *query = [NSString stringWithFormat:@"SELECT \"%@\" FROM \"%@\"", kMSACLogColumnName, kMSACLogTableName];
+  [self measureSelectionBlock:^{
+    [self.dbStorage enumerateRowsOfQuery:query
+                              withValues:nil
+                              usingBlock:^(MSACStorageCursor *cursor, __unused BOOL *stop) {
+                                [MSACLogDBStorage unarchiveLogFromColumnValue:(NSData *)[cursor dataWithoutCopyAtIndex:0]];
+                              }];
+  }];
+}
+
+#pragma mark - Compression tests
+
+- (void)testCompressionEncodePerformance {
+  NSArray<NSData *> *archives = [self archiveLogs:[self generateEventLogs:kMSACNumLogs]];
+  [self measureBlock:^{
+    for (NSData *data in archives) {
+      [MSACLogDBStorage compressArchivedLog:data dictionaryVersion:nil];
+    }
+  }];
+}
+
+- (void)testCompressionDecodePerformance {
+  NSMutableArray<NSData *> *compressedArchives = [NSMutableArray new];
+  for (NSData *data in [self archiveLogs:[self generateEventLogs:kMSACNumLogs]]) {
+    [compressedArchives addObject:[MSACLogDBStorage compressArchivedLog:data dictionaryVersion:nil]];
+  }
+  [self measureBlock:^{
+    for (NSData *data in compressedArchives) {
+      [MSACLogDBStorage decompressArchivedLog:data dictionaryVersion:kMSACLogCompressionDictionaryVersion];
+    }
+  }];
+}
+
+- (void)testCompressionRatioAndCapacity {
+  NSUInteger archivedSize = 0;
+  NSUInteger compressedSize = 0;
+  CFAbsoluteTime encodeTime = 0;
+  CFAbsoluteTime decodeTime = 0;
+  NSArray<NSData *> *archives = [self archiveLogs:[self generateEventLogs:kMSACNumLogs]];
+  for (NSData *data in archives) {
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    NSUInteger dictionaryVersion;
+    NSData *compressedData = [MSACLogDBStorage compressArchivedLog:data dictionaryVersion:&dictionaryVersion];
+    encodeTime += CFAbsoluteTimeGetCurrent() - start;
+    if (dictionaryVersion > 0) {
+      start = CFAbsoluteTimeGetCurrent();
+      XCTAssertEqualObjects([MSACLogDBStorage decompressArchivedLog:compressedData dictionaryVersion:dictionaryVersion], data);
+      decodeTime += CFAbsoluteTimeGetCurrent() - start;
+    }
+    archivedSize += data.length;
+    compressedSize += compressedData.length;
+  }
+
+  // The capacity is the number of logs fitting in a storage of default size, in the current and in the previous format.
+  double megabytes = (double)archivedSize / (1024 * 1024);
+  NSLog(@"Compression ratio: %.2f, encoding: %.1f MiB/s, decoding: %.1f MiB/s, capacity: %lu logs instead of %lu logs.",
+        (double)archivedSize / compressedSize, megabytes / MAX(encodeTime, DBL_EPSILON), megabytes / MAX(decodeTime, DBL_EPSILON),
+        (unsigned long)(kMSACDefaultDatabaseSizeInBytes * archives.count / compressedSize),
+        (unsigned long)(kMSACDefaultDatabaseSizeInBytes * archives.count / archivedSize));
+  XCTAssertLessThan(compressedSize, archivedSize);
+}
+
+#pragma mark - Concurrent load tests
+
+- (void)testEnqueueWhileFlushingPerformance {
+  NSArray<id<MSACLog>> *logs = [self generateEventLogs:kMSACNumLogs * 4];
+  [self measureBlock:^{
+    [self enqueueLogs:logs whileFlushingWithReaderConnection:NO];
+  }];
+}
+
+- (void)testEnqueueWhileFlushingOnReaderConnectionPerformance {
+  NSArray<id<MSACLog>> *logs = [self generateEventLogs:kMSACNumLogs * 4];
+  [self measureBlock:^{
+    [self enqueueLogs:logs whileFlushingWithReaderConnection:YES];
+  }];
+}
+
 #pragma mark - Private
 
+- (void)saveLogs:(NSArray<MSACStartServiceLog *> *)logs {
+
+  // Selection benchmarks unarchive the rows as they are stored.
+  self.dbStorage.compressionEnabled = NO;
+  for (MSACStartServiceLog *log in logs) {
+    [self.dbStorage saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+  }
+}
+
+- (void)enqueueLogs:(NSArray<id<MSACLog>> *)logs whileFlushingWithReaderConnection:(BOOL)readerConnectionEnabled {
+
+  // Storage is set up as in the channel group, a batch is loaded and deleted every 10 saved logs.
+  dispatch_queue_t queue = dispatch_queue_create("com.microsoft.appcenter.StoragePerformanceTestsQueue", DISPATCH_QUEUE_SERIAL);
+  MSACLogDBStorage *storage = [MSACLogDBStorage new];
+  [storage enableGroupCommitWithMaxChangesCount:10 window:0.1 queue:queue];
+  if (readerConnectionEnabled) {
+    [storage enableReaderConnectionWithReaderQueue:dispatch_queue_create("com.microsoft.appcenter.StoragePerformanceTestsReaderQueue",
+                                                                         DISPATCH_QUEUE_SERIAL)
+                                             queue:queue];
+  }
+  dispatch_group_t flushGroup = dispatch_group_create();
+  __block NSUInteger flushedLogsCount = 0;
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  dispatch_sync(queue, ^{
+    for (NSUInteger i = 0; i < logs.count; ++i) {
+      [storage saveLog:logs[i] withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+      if ((i + 1) % 10 == 0) {
+        dispatch_group_enter(flushGroup);
+        [storage loadLogsWithGroupId:kMSACTestGroupId
+                               limit:10
+                  excludedTargetKeys:nil
+                   completionHandler:^(NSArray<id<MSACLog>> *_Nonnull logArray, NSString *batchId) {
+                     flushedLogsCount += logArray.count;
+                     if (batchId) {
+                       [storage deleteLogsWithBatchId:(NSString *)batchId groupId:kMSACTestGroupId];
+                     }
+                     dispatch_group_leave(flushGroup);
+                   }];
+      }
+    }
+  });
+  dispatch_group_wait(flushGroup, DISPATCH_TIME_FOREVER);
+  CFAbsoluteTime elapsed = CFAbsoluteTimeGetCurrent() - start;
+  NSLog(@"Enqueued and flushed %lu logs at %.0f logs/s, reader connection: %@.", (unsigned long)flushedLogsCount,
+        flushedLogsCount / MAX(elapsed, DBL_EPSILON), readerConnectionEnabled ? @"YES" : @"NO");
+  XCTAssertEqual(flushedLogsCount, logs.count);
+  dispatch_sync(queue, ^{
+    [storage deleteLogsWithGroupId:kMSACTestGroupId];
+  });
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)compareStorage:(id<MSACStorage>)storage withLogs:(NSArray<id<MSACLog>> *)logs {
+
+  // Logs are saved then loaded and deleted by batches of 50, as the channels do.
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  for (id<MSACLog> log in logs) {
+    [storage saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsDefault];
+  }
+  CFAbsoluteTime writeTime = CFAbsoluteTimeGetCurrent() - start;
+  NSUInteger batchesCount = 0;
+  start = CFAbsoluteTimeGetCurrent();
+  __block NSString *loadedBatchId;
+  do {
+    loadedBatchId = nil;
+    [storage loadLogsWithGroupId:kMSACTestGroupId
+                           limit:50
+              excludedTargetKeys:nil
+               completionHandler:^(__unused NSArray<id<MSACLog>> *_Nonnull logArray, NSString *batchId) {
+                 loadedBatchId = batchId;
+               }];
+    if (loadedBatchId) {
+      [storage deleteLogsWithBatchId:loadedBatchId groupId:kMSACTestGroupId];
+      batchesCount++;
+    }
+  } while (loadedBatchId);
+  CFAbsoluteTime loadTime = CFAbsoluteTimeGetCurrent() - start;
+  return @{@"throughput" : @(logs.count / MAX(writeTime, DBL_EPSILON)), @"latency" : @(loadTime / MAX(batchesCount, 1))};
+}
+
+- (void)measureSelectionBlock:(void (^)(void))block {
+
+  // Memory metrics reflect the allocations made by the rows, they are only available on recent systems.
+  if (@available(iOS 13.0, macOS 10.15, tvOS 13.0, *)) {
+    [self measureWithMetrics:@[ [XCTClockMetric new], [XCTMemoryMetric new] ] block:block];
+  } else {
+    [self measureBlock:block];
+  }
+}
+
+- (NSArray<NSData *> *)archiveLogs:(NSArray<id<MSACLog>> *)logs {
+  NSMutableArray<NSData *> *archives = [NSMutableArray new];
+  for (id<MSACLog> log in logs) {
+    [archives addObject:(NSData *)[MSACLogDBStorage archiveLog:log]];
+  }
+  return archives;
+}
+
+- (NSArray<id<MSACLog>> *)generateEventLogs:(int)numLogs {
+  NSMutableArray<id<MSACLog>> *logs = [NSMutableArray new];
+  NSString *sid = [[NSUUID UUID] UUIDString];
+  for (int i = 0; i < numLogs; ++i) {
+    MSACLogWithProperties *log = [MSACLogWithProperties new];
+    log.type = @"event";
+    log.sid = sid;
+    log.userId = @"user@example.com";
+    log.timestamp = [NSDate dateWithTimeIntervalSinceNow:i];
+    log.properties = @{
+      @"screen" : [NSString stringWithFormat:@"Screen %d", i % 5],
+      @"action" : i % 2 ? @"Tap" : @"Swipe",
+      @"item" : [[NSUUID UUID] UUIDString],
+      @"count" : [NSString stringWithFormat:@"%d", i]
+    };
+    [logs addObject:log];
+  }
+  return logs;
+}
+
+/**
+ * Logs of each kind stored by the services, with a device and properties like the logs of an app.
+ */
+- (NSDictionary<NSString *, NSArray<id<MSACLog>> *> *)generateSerializationLogs {
+  MSACDevice *device = [MSACModelTestsUtililty dummyDevice];
+  NSArray<id<MSACLog>> *eventLogs = [self generateEventLogs:kMSACNumLogs];
+  NSArray<id<MSACLog>> *pageLogs = [self generateEventLogs:kMSACNumLogs];
+  for (MSACLogWithProperties *log in eventLogs) {
+    log.device = device;
+  }
+  for (MSACLogWithProperties *log in pageLogs) {
+    log.type = @"page";
+    log.device = device;
+  }
+  NSMutableArray<id<MSACLog>> *commonSchemaLogs = [NSMutableArray new];
+  for (int i = 0; i < kMSACNumLogs; ++i) {
+    MSACCommonSchemaLog *log = [MSACCommonSchemaLog new];
+    [MSACModelTestsUtililty populateAbstractLogWithDummies:log];
+    log.ver = @"3.0";
+    log.name = @"TestEvent";
+    log.iKey = @"o:60cd0b94-6060-11e8-9c2d-fa7ae01bbebc";
+    log.flags = MSACFlagsNormal;
+    log.ext = [MSACModelTestsUtililty extensionsWithDummyValues:[MSACModelTestsUtililty extensionDummies]];
+    NSMutableDictionary *properties = [[MSACModelTestsUtililty unorderedDataDummies] mutableCopy];
+    properties[@"item"] = [[NSUUID UUID] UUIDString];
+    properties[@"count"] = @(i);
+    log.data = [MSACCSData new];
+    log.data.properties = properties;
+    [commonSchemaLogs addObject:log];
+  }
+  return @{
+    @"start service" : [self generateLogsWithLongServicesNames:kMSACNumLogs withNumService:kMSACNumServices],
+    @"event" : eventLogs,
+    @"page" : pageLogs,
+    @"common schema" : commonSchemaLogs
+  };
+}
+
+- (void)logArchivedSizesOfLogs:(NSDictionary<NSString *, NSArray<id<MSACLog>> *> *)logsByKind
+                  archiverName:(NSString *)archiverName
+                    usingBlock:(NSData * (^)(id<MSACLog> log))archive {
+  NSMutableArray<NSString *> *sizes = [NSMutableArray new];
+  for (NSString *kind in [logsByKind.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+    NSUInteger size = 0;
+    for (id<MSACLog> log in logsByKind[kind]) {
+      size += archive(log).length;
+    }
+    [sizes addObject:[NSString stringWithFormat:@"%@ %tu bytes", kind, size / MAX(logsByKind[kind].count, 1)]];
+  }
+  NSLog(@"%@ stored size by log: %@.", archiverName, [sizes componentsJoinedByString:@", "]);
+}
+
 - (NSArray<MSACStartServiceLog *> *)generateLogsWithShortServicesNames:(int)numLogs withNumService:(int)numServices {
   NSMutableArray<MSACStartServiceLog *> *dic = [NSMutableArray new];
   for (int i = 0; i < numLogs; ++i) {
@@ -0,0 +1,244 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACConstants+Internal.h"
+#import "MSACTestFrameworks.h"
+#import "MSACTimerWheel.h"
+#import "MSACTimerWheelPrivate.h"
+
+static NSTimeInterval const kMSACTestTimeout = 1.0;
+static NSTimeInterval const kMSACTestStartTime = 1000;
+
+/**
+ * Flush interval of a channel, delay before its first log and delay before its next log once its queue has been flushed.
+ */
+typedef struct {
+  NSTimeInterval flushInterval;
+  NSTimeInterval firstLogDelay;
+  NSTimeInterval nextLogDelay;
+} MSACTestChannelWorkload;
+
+// Analytics, Crashes, Distribute, critical, One Collector and a channel with a custom interval.
+static const MSACTestChannelWorkload kMSACTestWorkloads[] = {{3, 0.1, 0.35}, {3, 0.4, 1.1}, {3, 0.75, 2.6},
+                                                             {3, 1.3, 0.8},  {3, 2.2, 4.3}, {10, 2.9, 1.7}};
+
+@interface MSACTimerWheelTests : XCTestCase
+
+@property(nonatomic) MSACTimerWheel *sut;
+
+@property(nonatomic) id sutMock;
+
+@property(nonatomic) NSTimeInterval currentTime;
+
+@property(nonatomic) NSUInteger firedDeadlinesCount;
+
+@end
+
+@implementation MSACTimerWheelTests
+
+#pragma mark - Housekeeping
+
+- (void)setUp {
+  [super setUp];
+  self.currentTime = kMSACTestStartTime;
+  self.sut = [[MSACTimerWheel alloc] initWithQueue:dispatch_queue_create("MSACTimerWheelTests", DISPATCH_QUEUE_SERIAL) tolerance:1];
+  self.sutMock = OCMPartialMock(self.sut);
+  __weak typeof(self) weakSelf = self;
+  OCMStub([self.sutMock currentTime]).andDo(^(NSInvocation *invocation) {
+    NSTimeInterval currentTime = weakSelf.currentTime;
+    [invocation setReturnValue:&currentTime];
+  });
+
+  // The timer is not set, tests move time forward themselves.
+  OCMStub([self.sutMock armTimer]);
+}
+
+- (void)tearDown {
+  [self.sutMock stopMocking];
+  [super tearDown];
+}
+
+#pragma mark - Tests
+
+- (void)testDeadlinesInSameTickShareWakeup {
+
+  // If
+  self.currentTime = kMSACTestStartTime + 0.2;
+  NSObject *owner1 = [NSObject new];
+  NSObject *owner2 = [NSObject new];
+  __block NSUInteger firedCount = 0;
+
+  // When
+  [self.sut scheduleDeadlineForOwner:owner1
+                          afterDelay:3
+                              leeway:0
+                             handler:^{
+                               firedCount++;
+                             }];
+  [self.sut scheduleDeadlineForOwner:owner2
+                          afterDelay:3.5
+                              leeway:0
+                             handler:^{
+                               firedCount++;
+                             }];
+
+  // Then
+  XCTAssertEqualObjects(self.sut.nextFireDate, [NSDate dateWithTimeIntervalSinceReferenceDate:kMSACTestStartTime + 4]);
+  XCTAssertEqualObjects([self.sut fireDateForOwner:owner1], [self.sut fireDateForOwner:owner2]);
+
+  // When
+  [self advanceToTime:kMSACTestStartTime + 3.9];
+
+  // Then
+  XCTAssertEqual(firedCount, 0);
+
+  // When
+  [self advanceToTime:kMSACTestStartTime + 10];
+
+  // Then
+  XCTAssertEqual(firedCount, 2);
+  XCTAssertEqual(self.sut.wakeupsCount, 1);
+  XCTAssertNil(self.sut.nextFireDate);
+}
+
+- (void)testLeewayJoinsLaterWakeup {
+
+  // If
+  NSObject *owner1 = [NSObject new];
+  NSObject *owner2 = [NSObject new];
+  NSObject *owner3 = [NSObject new];
+  [self.sut scheduleDeadlineForOwner:owner1
+                          afterDelay:5
+                              leeway:0
+                             handler:^{
+                             }];
+
+  // When
+  [self.sut scheduleDeadlineForOwner:owner2
+                          afterDelay:3.2
+                              leeway:2
+                             handler:^{
+                             }];
+  [self.sut scheduleDeadlineForOwner:owner3
+                          afterDelay:3.2
+                              leeway:1
+                             handler:^{
+                             }];
+
+  // Then
+  XCTAssertEqualObjects([self.sut fireDateForOwner:owner2], [NSDate dateWithTimeIntervalSinceReferenceDate:kMSACTestStartTime + 5]);
+  XCTAssertEqualObjects([self.sut fireDateForOwner:owner3], [NSDate dateWithTimeIntervalSinceReferenceDate:kMSACTestStartTime + 4]);
+}
+
+- (void)testScheduleReplacesAndCancelRemovesDeadline {
+
+  // If
+  NSObject *owner = [NSObject new];
+  __block NSUInteger firedCount = 0;
+  [self.sut scheduleDeadlineForOwner:owner
+                          afterDelay:3
+                              leeway:0
+                             handler:^{
+                               firedCount++;
+                             }];
+
+  // When
+  [self.sut scheduleDeadlineForOwner:owner
+                          afterDelay:10
+                              leeway:0
+                             handler:^{
+                               firedCount++;
+                             }];
+
+  // Then
+  XCTAssertEqualObjects(self.sut.nextFireDate, [NSDate dateWithTimeIntervalSinceReferenceDate:kMSACTestStartTime + 10]);
+
+  // When
+  [self.sut cancelDeadlineForOwner:owner];
+  [self advanceToTime:kMSACTestStartTime + 20];
+
+  // Then
+  XCTAssertNil([self.sut fireDateForOwner:owner]);
+  XCTAssertNil(self.sut.nextFireDate);
+  XCTAssertEqual(firedCount, 0);
+  XCTAssertEqual(self.sut.wakeupsCount, 0);
+}
+
+- (void)testWakeupsForMultiChannelWorkload {
+
+  // If
+  NSUInteger channelsCount = sizeof(kMSACTestWorkloads) / sizeof(kMSACTestWorkloads[0]);
+  NSMutableArray *owners = [NSMutableArray new];
+  for (NSUInteger i = 0; i < channelsCount; i++) {
+    [owners addObject:[NSObject new]];
+    [self scheduleChannelAtIndex:i owner:owners[i] afterDelay:kMSACTestWorkloads[i].firstLogDelay + kMSACTestWorkloads[i].flushInterval];
+  }
+
+  // When
+  [self advanceToTime:kMSACTestStartTime + 600];
+
+  // Then
+
+  // With a timer per channel, each deadline would have been a wakeup of its own.
+  XCTAssertEqual(self.firedDeadlinesCount, 643);
+  XCTAssertEqual(self.sut.wakeupsCount, 439);
+}
+
+- (void)testDeadlineFiresOnQueue {
+
+  // If
+  [self.sutMock stopMocking];
+  dispatch_queue_t queue = dispatch_queue_create("MSACTimerWheelTests", DISPATCH_QUEUE_SERIAL);
+  MSACTimerWheel *timerWheel = [[MSACTimerWheel alloc] initWithQueue:queue tolerance:0.1];
+  NSObject *owner = [NSObject new];
+  XCTestExpectation *expectation = [self expectationWithDescription:@"Deadline fired"];
+
+  // When
+  dispatch_async(queue, ^{
+    [timerWheel scheduleDeadlineForOwner:owner
+                              afterDelay:0.05
+                                  leeway:0
+                                 handler:^{
+                                   [expectation fulfill];
+                                 }];
+  });
+
+  // Then
+  [self waitForExpectationsWithTimeout:kMSACTestTimeout
+                               handler:^(NSError *error) {
+                                 XCTAssertEqual(timerWheel.wakeupsCount, 1);
+                                 if (error) {
+                                   XCTFail(@"Expectation Failed with error: %@", error);
+                                 }
+                               }];
+}
+
+#pragma mark - Private
+
+- (void)scheduleChannelAtIndex:(NSUInteger)index owner:(NSObject *)owner afterDelay:(NSTimeInterval)delay {
+  MSACTestChannelWorkload workload = kMSACTestWorkloads[index];
+  __weak typeof(self) weakSelf = self;
+  __weak NSObject *weakOwner = owner;
+  [self.sut scheduleDeadlineForOwner:owner
+                          afterDelay:delay
+                              leeway:MAX(kMSACFlushTimerMinLeeway, workload.flushInterval * kMSACFlushTimerLeewayRatio)
+                             handler:^{
+                               typeof(self) strongSelf = weakSelf;
+                               strongSelf.firedDeadlinesCount++;
+
+                               // The channel starts its timer again with its next log.
+                               [strongSelf scheduleChannelAtIndex:index
+                                                            owner:weakOwner
+                                                       afterDelay:workload.nextLogDelay + workload.flushInterval];
+                             }];
+}
+
+- (void)advanceToTime:(NSTimeInterval)time {
+  while (self.sut.nextFireDate && self.sut.nextFireDate.timeIntervalSinceReferenceDate <= time) {
+    self.currentTime = self.sut.nextFireDate.timeIntervalSinceReferenceDate;
+    [self.sut fireDueDeadlines];
+  }
+  self.currentTime = time;
+}
+
+@end
@@ -0,0 +1,321 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACAppCenter.h"
+#import "MSACChannelUnitConfiguration.h"
+#import "MSACChannelUnitDefault.h"
+#import "MSACChannelUnitDefaultPrivate.h"
+#import "MSACDBStorage.h"
+#import "MSACIngestionProtocol.h"
+#import "MSACLogContainer.h"
+#import "MSACLogDBStorage.h"
+#import "MSACLogWithProperties.h"
+#import "MSACTestFrameworks.h"
+#import "MSACUploadBudget.h"
+#import "MSACUploadWindow.h"
+#import "MSACUtility.h"
+
+/*
+ * Benchmarks of the time needed to drain a backlog of logs, from the storage to an ingestion stand-in answering after a simulated round
+ * trip time. Batches sent by a fixed number of pending batches are compared with batches pipelined within a growing upload window.
+ *
+ * A reduced sweep runs by default. Set the `MSAC_UPLOAD_BENCHMARK_SCALE` environment variable to `full` for the complete sweep
+ * (`TEST_RUNNER_MSAC_UPLOAD_BENCHMARK_SCALE` when running xcodebuild). Results are written as JSON to the path in
+ * `MSAC_UPLOAD_BENCHMARK_OUTPUT`, or to the temporary directory, so that they can be compared between releases.
+ */
+
+static NSString *const kMSACTestGroupId = @"BenchmarkGroupId";
+static NSString *const kMSACBenchmarkScaleEnvironmentKey = @"MSAC_UPLOAD_BENCHMARK_SCALE";
+static NSString *const kMSACBenchmarkOutputEnvironmentKey = @"MSAC_UPLOAD_BENCHMARK_OUTPUT";
+static NSUInteger const kMSACBenchmarkResultsVersion = 1;
+
+// Number of pending batches of a channel before this SDK pipelined them.
+static NSUInteger const kMSACBenchmarkFixedPendingBatchesLimit = 3;
+
+// Number of requests the ingestion stand-in answers at the same time, the others wait as they would for a connection.
+static NSUInteger const kMSACBenchmarkMaxConcurrentRequests = 16;
+
+static NSUInteger const kMSACBenchmarkBatchSizeLimit = 50;
+
+static NSMutableArray<NSDictionary *> *benchmarkResults;
+
+/**
+ * Ingestion answering every request with success after a fixed round trip time.
+ */
+@interface MSACIngestionStandIn : NSObject <MSACIngestionProtocol>
+
+- (instancetype)initWithRoundTripTime:(NSTimeInterval)roundTripTime maxConcurrentRequests:(NSUInteger)maxConcurrentRequests;
+
+@property(nonatomic, readonly, getter=isReadyToSend) BOOL readyToSend;
+
+@property(nonatomic, readonly, getter=isEnabled) BOOL enabled;
+
+/**
+ * Called on an internal queue with the number of logs sent so far, after each request.
+ */
+@property(nonatomic, copy, nullable) void (^requestCompletedHandler)(NSUInteger sentLogsCount);
+
+@property(nonatomic, readonly) NSUInteger requestsCount;
+
+@property(nonatomic, readonly) NSUInteger maxRequestsInFlightCount;
+
+@end
+
+@interface MSACIngestionStandIn ()
+
+@property(nonatomic, readonly) NSTimeInterval roundTripTime;
+
+@property(nonatomic, readonly) NSUInteger maxConcurrentRequests;
+
+@property(nonatomic, readonly) dispatch_queue_t queue;
+
+@property(nonatomic, readonly) NSMutableArray<dispatch_block_t> *waitingRequests;
+
+@property(nonatomic) NSUInteger runningRequestsCount;
+
+@property(nonatomic) NSUInteger requestsInFlightCount;
+
+@property(nonatomic) NSUInteger requestsCount;
+
+@property(nonatomic) NSUInteger maxRequestsInFlightCount;
+
+@property(nonatomic) NSUInteger sentLogsCount;
+
+@end
+
+@implementation MSACIngestionStandIn
+
+- (instancetype)initWithRoundTripTime:(NSTimeInterval)roundTripTime maxConcurrentRequests:(NSUInteger)maxConcurrentRequests {
+  if ((self = [super init])) {
+    _roundTripTime = roundTripTime;
+    _maxConcurrentRequests = maxConcurrentRequests;
+    _queue = dispatch_queue_create("com.microsoft.appcenter.IngestionStandInQueue", DISPATCH_QUEUE_SERIAL);
+    _waitingRequests = [NSMutableArray new];
+    _readyToSend = YES;
+    _enabled = YES;
+  }
+  return self;
+}
+
+- (void)setEnabled:(BOOL)isEnabled andDeleteDataOnDisabled:(__unused BOOL)deleteData {
+  _enabled = isEnabled;
+}
+
+- (void)sendAsync:(nullable NSObject *)data completionHandler:(MSACSendAsyncCompletionHandler)handler {
+  [self sendAsync:data eTag:nil completionHandler:handler];
+}
+
+- (void)sendAsync:(nullable NSObject *)data
+                eTag:(nullable __unused NSString *)eTag
+    completionHandler:(MSACSendAsyncCompletionHandler)handler {
+  MSACLogContainer *container = (MSACLogContainer *)data;
+  NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:(NSURL *)[NSURL URLWithString:@"https://localhost"]
+                                                            statusCode:MSACHTTPCodesNo200OK
+                                                           HTTPVersion:nil
+                                                          headerFields:nil];
+  dispatch_async(self.queue, ^{
+    self.requestsCount += 1;
+    self.requestsInFlightCount += 1;
+    self.maxRequestsInFlightCount = MAX(self.maxRequestsInFlightCount, self.requestsInFlightCount);
+    [self.waitingRequests addObject:^{
+      dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.roundTripTime * NSEC_PER_SEC)), self.queue, ^{
+        self.runningRequestsCount -= 1;
+        self.requestsInFlightCount -= 1;
+        self.sentLogsCount += container.logs.count;
+        handler(container.batchId, response, nil, nil);
+        if (self.requestCompletedHandler) {
+          self.requestCompletedHandler(self.sentLogsCount);
+        }
+        [self startWaitingRequests];
+      });
+    }];
+    [self startWaitingRequests];
+  });
+}
+
+- (void)startWaitingRequests {
+  while (self.waitingRequests.count > 0 && self.runningRequestsCount < self.maxConcurrentRequests) {
+    dispatch_block_t request = self.waitingRequests.firstObject;
+    [self.waitingRequests removeObjectAtIndex:0];
+    self.runningRequestsCount += 1;
+    request();
+  }
+}
+
+@end
+
+@interface MSACUploadBenchmarkTests : XCTestCase
+
+@property(nonatomic) MSACLogDBStorage *storage;
+
+@property(nonatomic) dispatch_queue_t logsDispatchQueue;
+
+@property(nonatomic, getter=isFullScale) BOOL fullScale;
+
+@end
+
+@implementation MSACUploadBenchmarkTests
+
+#pragma mark - Housekeeping
+
++ (void)setUp {
+  [super setUp];
+  benchmarkResults = [NSMutableArray new];
+}
+
++ (void)tearDown {
+  [self writeResults];
+  [super tearDown];
+}
+
+- (void)setUp {
+  [super setUp];
+  self.fullScale = [[NSProcessInfo processInfo].environment[kMSACBenchmarkScaleEnvironmentKey] isEqualToString:@"full"];
+  self.logsDispatchQueue = dispatch_queue_create("com.microsoft.appcenter.UploadBenchmarkQueue", DISPATCH_QUEUE_SERIAL);
+}
+
+- (void)tearDown {
+  [self.storage dropDatabase];
+  [super tearDown];
+}
+
+#pragma mark - Benchmarks
+
+- (void)testDrainBacklogWithRoundTripTimes {
+  NSUInteger logsCount = self.fullScale ? 10000 : 1000;
+  NSArray<NSNumber *> *roundTripTimes = self.fullScale ? @[ @0.02, @0.1, @0.3 ] : @[ @0.05 ];
+  for (NSNumber *roundTripTime in roundTripTimes) {
+    for (NSNumber *pipelined in @[ @NO, @YES ]) {
+
+      // When
+      NSDictionary *result = [self measureDrainWithLogsCount:logsCount
+                                               roundTripTime:roundTripTime.doubleValue
+                                                   pipelined:pipelined.boolValue];
+
+      // Then
+      XCTAssertEqual([result[@"remainingLogsCount"] unsignedIntegerValue], 0);
+      if (pipelined.boolValue) {
+        XCTAssertGreaterThan([result[@"maxRequestsInFlightCount"] unsignedIntegerValue], kMSACBenchmarkFixedPendingBatchesLimit);
+      } else {
+        XCTAssertLessThanOrEqual([result[@"maxRequestsInFlightCount"] unsignedIntegerValue], kMSACBenchmarkFixedPendingBatchesLimit);
+      }
+    }
+  }
+}
+
+#pragma mark - Measures
+
+- (NSDictionary *)measureDrainWithLogsCount:(NSUInteger)logsCount roundTripTime:(NSTimeInterval)roundTripTime pipelined:(BOOL)pipelined {
+
+  // If
+  [self recreateStorage];
+  [self saveLogsWithCount:logsCount payloadSize:256];
+  MSACIngestionStandIn *ingestion = [[MSACIngestionStandIn alloc] initWithRoundTripTime:roundTripTime
+                                                                  maxConcurrentRequests:kMSACBenchmarkMaxConcurrentRequests];
+  MSACChannelUnitConfiguration *configuration =
+      [[MSACChannelUnitConfiguration alloc] initWithGroupId:kMSACTestGroupId
+                                                   priority:MSACPriorityDefault
+                                              flushInterval:kMSACFlushIntervalDefault
+                                             batchSizeLimit:kMSACBenchmarkBatchSizeLimit
+                                        pendingBatchesLimit:kMSACBenchmarkFixedPendingBatchesLimit];
+  MSACChannelUnitDefault *channel = [[MSACChannelUnitDefault alloc] initWithIngestion:ingestion
+                                                                              storage:self.storage
+                                                                        configuration:configuration
+                                                                    logsDispatchQueue:self.logsDispatchQueue];
+  if (pipelined) {
+    channel.uploadWindow = [[MSACUploadWindow alloc] initWithSize:kMSACBenchmarkFixedPendingBatchesLimit
+                                                          maxSize:kMSACMaxPendingBatchesPerChannelDefault];
+    channel.uploadBudget = [[MSACUploadBudget alloc] initWithLimit:kMSACMaxPendingBatchesDefault];
+    [channel.uploadBudget addChannel:channel];
+  }
+  XCTestExpectation *expectation = [self expectationWithDescription:@"Backlog drained"];
+  ingestion.requestCompletedHandler = ^(NSUInteger sentLogsCount) {
+    if (sentLogsCount == logsCount) {
+      [expectation fulfill];
+    }
+  };
+
+  // When
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  dispatch_async(self.logsDispatchQueue, ^{
+    channel.itemsCount = logsCount;
+    [channel flushQueue];
+  });
+  [self waitForExpectations:@[ expectation ] timeout:60];
+  CFAbsoluteTime drainDuration = CFAbsoluteTimeGetCurrent() - start;
+
+  // Logs are deleted on the logs dispatch queue once their batch completes.
+  __block NSUInteger remainingLogsCount;
+  dispatch_sync(self.logsDispatchQueue, ^{
+    remainingLogsCount = [self.storage countLogs];
+  });
+  NSMutableDictionary *result = [NSMutableDictionary new];
+  result[@"operation"] = @"drainBacklog";
+  result[@"pipelined"] = @(pipelined);
+  result[@"logsCount"] = @(logsCount);
+  result[@"batchSizeLimit"] = @(kMSACBenchmarkBatchSizeLimit);
+  result[@"roundTripTimeMs"] = @(roundTripTime * 1000);
+  result[@"drainMs"] = @(drainDuration * 1000);
+  result[@"remainingLogsCount"] = @(remainingLogsCount);
+  result[@"requestsCount"] = @(ingestion.requestsCount);
+  result[@"maxRequestsInFlightCount"] = @(ingestion.maxRequestsInFlightCount);
+  result[@"finalWindowSize"] = @(channel.uploadWindow ? channel.uploadWindow.size : configuration.pendingBatchesLimit);
+  [benchmarkResults addObject:result];
+  NSLog(@"drainBacklog pipelined: %d, RTT %.0f ms: %.0f ms, %tu requests, up to %tu in flight.", pipelined, roundTripTime * 1000,
+        drainDuration * 1000, ingestion.requestsCount, ingestion.maxRequestsInFlightCount);
+  return result;
+}
+
+#pragma mark - Results
+
++ (void)writeResults {
+  NSString *outputPath = [NSProcessInfo processInfo].environment[kMSACBenchmarkOutputEnvironmentKey];
+  if (outputPath.length == 0) {
+    outputPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"MSACUploadBenchmark.json"];
+  }
+  NSDictionary *report = @{
+    @"version" : @(kMSACBenchmarkResultsVersion),
+    @"sdkVersion" : MSACAppCenter.sdkVersion,
+    @"date" : [[NSISO8601DateFormatter new] stringFromDate:[NSDate date]],
+    @"scale" : [[NSProcessInfo processInfo].environment[kMSACBenchmarkScaleEnvironmentKey] isEqualToString:@"full"] ? @"full" : @"reduced",
+    @"results" : benchmarkResults ?: @[]
+  };
+  NSError *error;
+  NSData *data = [NSJSONSerialization dataWithJSONObject:report options:NSJSONWritingPrettyPrinted error:&error];
+  if (![data writeToFile:outputPath options:NSDataWritingAtomic error:&error]) {
+    NSLog(@"Failed to write the upload benchmark results: %@", error);
+    return;
+  }
+  NSLog(@"Upload benchmark results written to %@", outputPath);
+}
+
+#pragma mark - Private
+
+- (void)recreateStorage {
+  [self.storage dropDatabase];
+  self.storage = [MSACLogDBStorage new];
+
+  // Batches are loaded on a queue of their own, as they are by the channel group.
+  [self.storage enableReaderConnectionWithReaderQueue:dispatch_queue_create("com.microsoft.appcenter.UploadBenchmarkReaderQueue",
+                                                                            DISPATCH_QUEUE_SERIAL)
+                                                queue:self.logsDispatchQueue];
+}
+
+- (void)saveLogsWithCount:(NSUInteger)count payloadSize:(NSUInteger)payloadSize {
+  for (NSUInteger i = 0; i < count; i++) {
+    @autoreleasepool {
+      NSMutableString *payload = [NSMutableString stringWithCapacity:payloadSize];
+      while (payload.length < payloadSize) {
+        [payload appendString:MSAC_UUID_STRING];
+      }
+      MSACLogWithProperties *log = [MSACLogWithProperties new];
+      log.type = @"event";
+      log.sid = MSAC_UUID_STRING;
+      log.timestamp = [NSDate date];
+      log.properties = @{@"payload" : [payload substringToIndex:payloadSize]};
+      [self.storage saveLog:log withGroupId:kMSACTestGroupId flags:MSACFlagsNormal];
+    }
+  }
+}
+
+@end
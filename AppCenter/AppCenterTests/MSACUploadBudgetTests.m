@@ -0,0 +1,81 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACChannelUnitDefault.h"
+#import "MSACChannelUnitDefaultPrivate.h"
+#import "MSACTestFrameworks.h"
+#import "MSACUploadBudget.h"
+
+@interface MSACUploadBudgetTests : XCTestCase
+
+@property(nonatomic) MSACUploadBudget *sut;
+
+@end
+
+@implementation MSACUploadBudgetTests
+
+#pragma mark - Setup
+
+- (void)setUp {
+  [super setUp];
+  self.sut = [[MSACUploadBudget alloc] initWithLimit:3];
+}
+
+#pragma mark - Tests
+
+- (void)testPendingBatchesAreCountedFromChannels {
+
+  // If
+  id channelMock = [self channelMockWithPendingBatchesCount:2 loadingBatchesCount:1];
+  id otherChannelMock = [self channelMockWithPendingBatchesCount:1 loadingBatchesCount:0];
+
+  // When
+  [self.sut addChannel:channelMock];
+  [self.sut addChannel:otherChannelMock];
+
+  // Then
+  XCTAssertEqual([self.sut pendingBatchesCount], 4);
+  XCTAssertFalse([self.sut canSendBatchOfChannel:channelMock]);
+}
+
+- (void)testWaitingChannelsFlushOnceBatchCompletes {
+
+  // If
+  id channelMock = [self channelMockWithPendingBatchesCount:3 loadingBatchesCount:0];
+  id otherChannelMock = [self channelMockWithPendingBatchesCount:0 loadingBatchesCount:0];
+  [self.sut addChannel:channelMock];
+  [self.sut addChannel:otherChannelMock];
+  XCTAssertFalse([self.sut canSendBatchOfChannel:otherChannelMock]);
+
+  // When
+  [(NSMutableArray *)[channelMock pendingBatchIds] removeLastObject];
+  [self.sut batchDidComplete];
+
+  // Then
+  OCMVerify([otherChannelMock flushQueue]);
+  XCTAssertTrue([self.sut canSendBatchOfChannel:otherChannelMock]);
+}
+
+- (void)testLimitIsAtLeastOneBatch {
+
+  // When
+  self.sut.limit = 0;
+
+  // Then
+  XCTAssertEqual(self.sut.limit, 1);
+}
+
+#pragma mark - Helper
+
+- (id)channelMockWithPendingBatchesCount:(NSUInteger)pendingBatchesCount loadingBatchesCount:(NSUInteger)loadingBatchesCount {
+  id channelMock = OCMClassMock([MSACChannelUnitDefault class]);
+  NSMutableArray *pendingBatchIds = [NSMutableArray new];
+  for (NSUInteger i = 0; i < pendingBatchesCount; i++) {
+    [pendingBatchIds addObject:[NSUUID UUID].UUIDString];
+  }
+  OCMStub([channelMock pendingBatchIds]).andReturn(pendingBatchIds);
+  OCMStub([channelMock loadingBatchesCount]).andReturn(loadingBatchesCount);
+  return channelMock;
+}
+
+@end
@@ -0,0 +1,102 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#import "MSACTestFrameworks.h"
+#import "MSACUploadWindow.h"
+
+@interface MSACUploadWindowTests : XCTestCase
+
+@property(nonatomic) MSACUploadWindow *sut;
+
+@end
+
+@implementation MSACUploadWindowTests
+
+#pragma mark - Setup
+
+- (void)setUp {
+  [super setUp];
+  self.sut = [[MSACUploadWindow alloc] initWithSize:3 maxSize:8];
+}
+
+#pragma mark - Tests
+
+- (void)testWindowGrowsByOneBatchPerWindowOfFastBatches {
+
+  // When
+  [self.sut batchDidSucceedWithDuration:0.5];
+  [self.sut batchDidSucceedWithDuration:0.5];
+
+  // Then
+  XCTAssertEqual(self.sut.size, 3);
+
+  // When
+  [self.sut batchDidSucceedWithDuration:0.5];
+
+  // Then
+  XCTAssertEqual(self.sut.size, 4);
+
+  // When
+  for (int i = 0; i < 100; i++) {
+    [self.sut batchDidSucceedWithDuration:0.5];
+  }
+
+  // Then
+  XCTAssertEqual(self.sut.size, 8);
+}
+
+- (void)testWindowShrinksOnSlowBatches {
+
+  // When
+  [self.sut batchDidSucceedWithDuration:5];
+
+  // Then
+  XCTAssertEqual(self.sut.size, 3);
+
+  // When
+  [self.sut batchDidSucceedWithDuration:15];
+
+  // Then
+  XCTAssertEqual(self.sut.size, 2);
+}
+
+- (void)testWindowIsHalvedOnFailures {
+
+  // If
+  self.sut = [[MSACUploadWindow alloc] initWithSize:8 maxSize:8];
+
+  // When
+  [self.sut batchDidFail];
+
+  // Then
+  XCTAssertEqual(self.sut.size, 4);
+
+  // When
+  [self.sut batchDidFail];
+  [self.sut batchDidFail];
+  [self.sut batchDidFail];
+
+  // Then
+  XCTAssertEqual(self.sut.size, 1);
+}
+
+- (void)testReducingMaxSizeReducesSize {
+
+  // If
+  self.sut = [[MSACUploadWindow alloc] initWithSize:8 maxSize:8];
+
+  // When
+  self.sut.maxSize = 5;
+
+  // Then
+  XCTAssertEqual(self.sut.size, 5);
+
+  // When
+  self.sut.maxSize = 0;
+
+  // Then
+  XCTAssertEqual(self.sut.maxSize, 1);
+  XCTAssertEqual(self.sut.size, 1);
+}
+
+@end
@@ -18,6 +18,10 @@
 - (void)deleteDatabase {
   if (self.path) {
     [MSACUtility deleteItemForPathComponent:self.path];
+
+    // A write-ahead log left over would be replayed into the next database created with the same name.
+    [MSACUtility deleteItemForPathComponent:[self.path stringByAppendingString:@"-wal"]];
+    [MSACUtility deleteItemForPathComponent:[self.path stringByAppendingString:@"-shm"]];
   }
 }
 
@@ -85,7 +85,11 @@ static NSString *const kMSACAnalyticsServiceName = @"Analytics";
   self.channelUnitCriticalMock = OCMProtocolMock(@protocol(MSACChannelUnitProtocol));
   [MSACAnalytics sharedInstance].criticalChannelUnit = self.channelUnitCriticalMock;
   OCMStub([self.channelGroupMock alloc]).andReturn(self.channelGroupMock);
-  OCMStub([self.channelGroupMock initWithHttpClient:OCMOCK_ANY installId:OCMOCK_ANY logUrl:OCMOCK_ANY]).andReturn(self.channelGroupMock);
+  OCMStub([self.channelGroupMock initWithHttpClient:OCMOCK_ANY
+                                          installId:OCMOCK_ANY
+                                             logUrl:OCMOCK_ANY
+                                     storageBackend:MSACStorageBackendDatabase])
+      .andReturn(self.channelGroupMock);
   OCMStub([self.channelGroupMock addChannelUnitWithConfiguration:hasProperty(@"groupId", endsWith(kMSACCriticalChannelSuffix))])
       .andReturn(self.channelUnitCriticalMock);
   OCMStub([self.channelGroupMock addChannelUnitWithConfiguration:hasProperty(@"groupId", equalTo(kMSACAnalyticsGroupId))])